@@ -0,0 +1,1107 @@
+/***********************************************************************
+CPUWaterSolver - Class to run the water flow simulation of class
+WaterTable2 on the CPU, split into horizontal bands processed by a pool
+of worker threads.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "CPUWaterSolver.h"
+
+#include <string.h>
+#include <algorithm>
+#include <Misc/FunctionCalls.h>
+#include <Math/Math.h>
+#include <Math/Constants.h>
+#if CPUWATERSOLVER_USE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+/********************************************************************
+The following functions evaluate the same sequence of floating-point
+operations as the Water2SlopeAndFluxAndDerivativeShader fragment
+shader. They are written without conditional computations so that the
+compiler can vectorize the per-row loops calling them.
+********************************************************************/
+
+inline float minf(float a,float b) // Returns the minimum of two values with the semantics of the minps instruction
+	{
+	return a<b?a:b;
+	}
+
+inline float maxf(float a,float b) // Returns the maximum of two values with the semantics of the maxps instruction
+	{
+	return a>b?a:b;
+	}
+
+inline float getVertex(const std::vector<float>& grid,int width,int height,int x,int y) // Returns a vertex of a grid with clamp-to-edge semantics, like an OpenGL texture
+	{
+	x=x<0?0:x>=width?width-1:x;
+	y=y<0?0:y>=height?height-1:y;
+	return grid[y*width+x];
+	}
+
+inline float calcSlope(float q0,float q1,float q2,float thetaOverCellSize,float twoCellSize) // Returns the minmod-limited slope of one quantity component
+	{
+	/* Calculate the left, central, and right differences: */
+	float d01=(q1-q0)*thetaOverCellSize;
+	float d02=(q2-q0)/twoCellSize;
+	float d12=(q2-q1)*thetaOverCellSize;
+	
+	/* Calculate the minmod-limited slope: */
+	float dMin=Math::min(Math::min(d01,d02),d12);
+	float dMax=Math::max(Math::max(d01,d02),d12);
+	return dMin>0.0f?dMin:dMax<0.0f?dMax:0.0f;
+	}
+
+inline float limitSurfaceSlope(float slope,float q1,float b0,float b1,float cellSize) // Adjusts the slope of the water surface against the left and right face-centered bathymetry values
+	{
+	float slope0=(q1-b0)/(cellSize*0.5f);
+	slope=q1-slope*cellSize*0.5f<b0?slope0:slope;
+	float slope1=(b1-q1)/(cellSize*0.5f);
+	slope=q1+slope*cellSize*0.5f<b1?slope1:slope;
+	return slope;
+	}
+
+inline float calcFlux(float wm,float nm,float tm,float wp,float np,float tp,float b,float g,float epsilon,float cellSize,float& fw,float& fn,float& ft) // Calculates the partial flux across a face between the given one-sided quantities in face-normal and face-tangential components; returns the maximum stable step size
+	{
+	/* Calculate one-sided water column heights: */
+	float hm=maxf(wm-b,0.0f);
+	float hp=maxf(wp-b,0.0f);
+	
+	/* Calculate one-sided velocities using a desingularizing division operator, and recalculate discharges based on them: */
+	float hm4=hm*hm*hm*hm;
+	float sm=1.41421356237309f*hm/Math::sqrt(hm4+maxf(hm4,epsilon));
+	float um=nm*sm;
+	float vm=tm*sm;
+	nm=um*hm;
+	tm=vm*hm;
+	float hp4=hp*hp*hp*hp;
+	float sp=1.41421356237309f*hp/Math::sqrt(hp4+maxf(hp4,epsilon));
+	float up=np*sp;
+	float vp=tp*sp;
+	np=up*hp;
+	tp=vp*hp;
+	
+	/* Calculate one-sided face-normal flux quadratures: */
+	float fm0=nm;
+	float fm1=um*nm+0.5f*g*hm*hm;
+	float fm2=vm*nm;
+	float fp0=np;
+	float fp1=up*np+0.5f*g*hp*hp;
+	float fp2=vp*np;
+	
+	/* Calculate one-sided local speeds of propagation: */
+	float sghm=Math::sqrt(g*hm);
+	float sghp=Math::sqrt(g*hp);
+	float am=minf(minf(um-sghm,up-sghp),0.0f);
+	float ap=maxf(maxf(um+sghm,up+sghp),0.0f);
+	
+	/* Calculate the complete flux; if both local speeds are zero, so are the numerators, and dividing them by one yields the zero flux without a conditional: */
+	float denominator=ap-am!=0.0f?ap-am:1.0f;
+	float a=ap*am;
+	fw=((fm0*ap-fp0*am)+(wp-wm)*a)/denominator;
+	fn=((fm1*ap-fp1*am)+(np-nm)*a)/denominator;
+	ft=((fm2*ap-fp2*am)+(tp-tm)*a)/denominator;
+	
+	/* Return the maximum stable step size, which is infinite between dry cells; negating am by subtraction avoids a negative zero that would turn it into negative infinity: */
+	return 0.5f*cellSize/maxf(0.0f-am,ap);
+	}
+
+/***********************************************************************
+The following kernels calculate the partial fluxes across a range of
+faces, reconstructing the one-sided quantities from cell quantities and
+offsets on the fly, and return the range's maximum stable step size. The
+vectorized kernels evaluate exactly the same sequence of IEEE
+single-precision operations as the scalar kernel, including the operand
+order of all minimum and maximum operations, and therefore produce
+bit-identical results (requires -ffp-contract=off, see makefile).
+***********************************************************************/
+
+inline float calcFaceFlux(int i,const float* const qm[3],const float* const om[3],const float* const qp[3],const float* const op[3],const float* b,float g,float epsilon,float cellSize,float* const f[3]) // Calculates the partial flux across a single face
+	{
+	return calcFlux(qm[0][i]+om[0][i],qm[1][i]+om[1][i],qm[2][i]+om[2][i],
+	                qp[0][i]-op[0][i],qp[1][i]-op[1][i],qp[2][i]-op[2][i],
+	                b[i],g,epsilon,cellSize,f[0][i],f[1][i],f[2][i]);
+	}
+
+float calcFluxesScalar(int numFaces,const float* const qm[3],const float* const om[3],const float* const qp[3],const float* const op[3],const float* b,float g,float epsilon,float cellSize,float* const f[3])
+	{
+	float result=Math::Constants<float>::max;
+	for(int i=0;i<numFaces;++i)
+		result=minf(result,calcFaceFlux(i,qm,om,qp,op,b,g,epsilon,cellSize,f));
+	
+	return result;
+	}
+
+#if CPUWATERSOLVER_USE_X86_KERNELS
+
+__attribute__((target("sse")))
+float calcFluxesSSE(int numFaces,const float* const qm[3],const float* const om[3],const float* const qp[3],const float* const op[3],const float* b,float g,float epsilon,float cellSize,float* const f[3])
+	{
+	const __m128 zero=_mm_setzero_ps();
+	const __m128 one=_mm_set1_ps(1.0f);
+	const __m128 sqrt2=_mm_set1_ps(1.41421356237309f);
+	const __m128 gv=_mm_set1_ps(g);
+	const __m128 halfG=_mm_set1_ps(0.5f*g);
+	const __m128 eps=_mm_set1_ps(epsilon);
+	const __m128 halfCellSize=_mm_set1_ps(0.5f*cellSize);
+	
+	/* Process four faces at a time: */
+	__m128 maxSteps=_mm_set1_ps(Math::Constants<float>::max);
+	int i=0;
+	for(;i+4<=numFaces;i+=4)
+		{
+		/* Reconstruct the one-sided quantities: */
+		__m128 wm=_mm_add_ps(_mm_loadu_ps(qm[0]+i),_mm_loadu_ps(om[0]+i));
+		__m128 nm=_mm_add_ps(_mm_loadu_ps(qm[1]+i),_mm_loadu_ps(om[1]+i));
+		__m128 tm=_mm_add_ps(_mm_loadu_ps(qm[2]+i),_mm_loadu_ps(om[2]+i));
+		__m128 wp=_mm_sub_ps(_mm_loadu_ps(qp[0]+i),_mm_loadu_ps(op[0]+i));
+		__m128 np=_mm_sub_ps(_mm_loadu_ps(qp[1]+i),_mm_loadu_ps(op[1]+i));
+		__m128 tp=_mm_sub_ps(_mm_loadu_ps(qp[2]+i),_mm_loadu_ps(op[2]+i));
+		__m128 bv=_mm_loadu_ps(b+i);
+		
+		/* Calculate one-sided water column heights: */
+		__m128 hm=_mm_max_ps(_mm_sub_ps(wm,bv),zero);
+		__m128 hp=_mm_max_ps(_mm_sub_ps(wp,bv),zero);
+		
+		/* Calculate one-sided velocities and recalculate discharges based on them: */
+		__m128 hm4=_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(hm,hm),hm),hm);
+		__m128 sm=_mm_div_ps(_mm_mul_ps(sqrt2,hm),_mm_sqrt_ps(_mm_add_ps(hm4,_mm_max_ps(hm4,eps))));
+		__m128 um=_mm_mul_ps(nm,sm);
+		__m128 vm=_mm_mul_ps(tm,sm);
+		nm=_mm_mul_ps(um,hm);
+		tm=_mm_mul_ps(vm,hm);
+		__m128 hp4=_mm_mul_ps(_mm_mul_ps(_mm_mul_ps(hp,hp),hp),hp);
+		__m128 sp=_mm_div_ps(_mm_mul_ps(sqrt2,hp),_mm_sqrt_ps(_mm_add_ps(hp4,_mm_max_ps(hp4,eps))));
+		__m128 up=_mm_mul_ps(np,sp);
+		__m128 vp=_mm_mul_ps(tp,sp);
+		np=_mm_mul_ps(up,hp);
+		tp=_mm_mul_ps(vp,hp);
+		
+		/* Calculate one-sided face-normal flux quadratures: */
+		__m128 fm1=_mm_add_ps(_mm_mul_ps(um,nm),_mm_mul_ps(_mm_mul_ps(halfG,hm),hm));
+		__m128 fm2=_mm_mul_ps(vm,nm);
+		__m128 fp1=_mm_add_ps(_mm_mul_ps(up,np),_mm_mul_ps(_mm_mul_ps(halfG,hp),hp));
+		__m128 fp2=_mm_mul_ps(vp,np);
+		
+		/* Calculate one-sided local speeds of propagation: */
+		__m128 sghm=_mm_sqrt_ps(_mm_mul_ps(gv,hm));
+		__m128 sghp=_mm_sqrt_ps(_mm_mul_ps(gv,hp));
+		__m128 am=_mm_min_ps(_mm_min_ps(_mm_sub_ps(um,sghm),_mm_sub_ps(up,sghp)),zero);
+		__m128 ap=_mm_max_ps(_mm_max_ps(_mm_add_ps(um,sghm),_mm_add_ps(up,sghp)),zero);
+		
+		/* Calculate the complete flux: */
+		__m128 d=_mm_sub_ps(ap,am);
+		__m128 dNonZero=_mm_cmpneq_ps(d,zero);
+		__m128 denominator=_mm_or_ps(_mm_and_ps(dNonZero,d),_mm_andnot_ps(dNonZero,one));
+		__m128 a=_mm_mul_ps(ap,am);
+		_mm_storeu_ps(f[0]+i,_mm_div_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(nm,ap),_mm_mul_ps(np,am)),_mm_mul_ps(_mm_sub_ps(wp,wm),a)),denominator));
+		_mm_storeu_ps(f[1]+i,_mm_div_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(fm1,ap),_mm_mul_ps(fp1,am)),_mm_mul_ps(_mm_sub_ps(np,nm),a)),denominator));
+		_mm_storeu_ps(f[2]+i,_mm_div_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(fm2,ap),_mm_mul_ps(fp2,am)),_mm_mul_ps(_mm_sub_ps(tp,tm),a)),denominator));
+		
+		/* Update the maximum stable step sizes: */
+		maxSteps=_mm_min_ps(maxSteps,_mm_div_ps(halfCellSize,_mm_max_ps(_mm_sub_ps(zero,am),ap)));
+		}
+	
+	/* Reduce the maximum stable step sizes: */
+	maxSteps=_mm_min_ps(maxSteps,_mm_movehl_ps(maxSteps,maxSteps));
+	maxSteps=_mm_min_ss(maxSteps,_mm_shuffle_ps(maxSteps,maxSteps,0x55));
+	float result=_mm_cvtss_f32(maxSteps);
+	
+	/* Process the remaining faces: */
+	for(;i<numFaces;++i)
+		result=minf(result,calcFaceFlux(i,qm,om,qp,op,b,g,epsilon,cellSize,f));
+	
+	return result;
+	}
+
+__attribute__((target("avx")))
+float calcFluxesAVX(int numFaces,const float* const qm[3],const float* const om[3],const float* const qp[3],const float* const op[3],const float* b,float g,float epsilon,float cellSize,float* const f[3])
+	{
+	const __m256 zero=_mm256_setzero_ps();
+	const __m256 one=_mm256_set1_ps(1.0f);
+	const __m256 sqrt2=_mm256_set1_ps(1.41421356237309f);
+	const __m256 gv=_mm256_set1_ps(g);
+	const __m256 halfG=_mm256_set1_ps(0.5f*g);
+	const __m256 eps=_mm256_set1_ps(epsilon);
+	const __m256 halfCellSize=_mm256_set1_ps(0.5f*cellSize);
+	
+	/* Process eight faces at a time: */
+	__m256 maxSteps=_mm256_set1_ps(Math::Constants<float>::max);
+	int i=0;
+	for(;i+8<=numFaces;i+=8)
+		{
+		/* Reconstruct the one-sided quantities: */
+		__m256 wm=_mm256_add_ps(_mm256_loadu_ps(qm[0]+i),_mm256_loadu_ps(om[0]+i));
+		__m256 nm=_mm256_add_ps(_mm256_loadu_ps(qm[1]+i),_mm256_loadu_ps(om[1]+i));
+		__m256 tm=_mm256_add_ps(_mm256_loadu_ps(qm[2]+i),_mm256_loadu_ps(om[2]+i));
+		__m256 wp=_mm256_sub_ps(_mm256_loadu_ps(qp[0]+i),_mm256_loadu_ps(op[0]+i));
+		__m256 np=_mm256_sub_ps(_mm256_loadu_ps(qp[1]+i),_mm256_loadu_ps(op[1]+i));
+		__m256 tp=_mm256_sub_ps(_mm256_loadu_ps(qp[2]+i),_mm256_loadu_ps(op[2]+i));
+		__m256 bv=_mm256_loadu_ps(b+i);
+		
+		/* Calculate one-sided water column heights: */
+		__m256 hm=_mm256_max_ps(_mm256_sub_ps(wm,bv),zero);
+		__m256 hp=_mm256_max_ps(_mm256_sub_ps(wp,bv),zero);
+		
+		/* Calculate one-sided velocities and recalculate discharges based on them: */
+		__m256 hm4=_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(hm,hm),hm),hm);
+		__m256 sm=_mm256_div_ps(_mm256_mul_ps(sqrt2,hm),_mm256_sqrt_ps(_mm256_add_ps(hm4,_mm256_max_ps(hm4,eps))));
+		__m256 um=_mm256_mul_ps(nm,sm);
+		__m256 vm=_mm256_mul_ps(tm,sm);
+		nm=_mm256_mul_ps(um,hm);
+		tm=_mm256_mul_ps(vm,hm);
+		__m256 hp4=_mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(hp,hp),hp),hp);
+		__m256 sp=_mm256_div_ps(_mm256_mul_ps(sqrt2,hp),_mm256_sqrt_ps(_mm256_add_ps(hp4,_mm256_max_ps(hp4,eps))));
+		__m256 up=_mm256_mul_ps(np,sp);
+		__m256 vp=_mm256_mul_ps(tp,sp);
+		np=_mm256_mul_ps(up,hp);
+		tp=_mm256_mul_ps(vp,hp);
+		
+		/* Calculate one-sided face-normal flux quadratures: */
+		__m256 fm1=_mm256_add_ps(_mm256_mul_ps(um,nm),_mm256_mul_ps(_mm256_mul_ps(halfG,hm),hm));
+		__m256 fm2=_mm256_mul_ps(vm,nm);
+		__m256 fp1=_mm256_add_ps(_mm256_mul_ps(up,np),_mm256_mul_ps(_mm256_mul_ps(halfG,hp),hp));
+		__m256 fp2=_mm256_mul_ps(vp,np);
+		
+		/* Calculate one-sided local speeds of propagation: */
+		__m256 sghm=_mm256_sqrt_ps(_mm256_mul_ps(gv,hm));
+		__m256 sghp=_mm256_sqrt_ps(_mm256_mul_ps(gv,hp));
+		__m256 am=_mm256_min_ps(_mm256_min_ps(_mm256_sub_ps(um,sghm),_mm256_sub_ps(up,sghp)),zero);
+		__m256 ap=_mm256_max_ps(_mm256_max_ps(_mm256_add_ps(um,sghm),_mm256_add_ps(up,sghp)),zero);
+		
+		/* Calculate the complete flux: */
+		__m256 d=_mm256_sub_ps(ap,am);
+		__m256 denominator=_mm256_blendv_ps(one,d,_mm256_cmp_ps(d,zero,_CMP_NEQ_UQ));
+		__m256 a=_mm256_mul_ps(ap,am);
+		_mm256_storeu_ps(f[0]+i,_mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(nm,ap),_mm256_mul_ps(np,am)),_mm256_mul_ps(_mm256_sub_ps(wp,wm),a)),denominator));
+		_mm256_storeu_ps(f[1]+i,_mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(fm1,ap),_mm256_mul_ps(fp1,am)),_mm256_mul_ps(_mm256_sub_ps(np,nm),a)),denominator));
+		_mm256_storeu_ps(f[2]+i,_mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(fm2,ap),_mm256_mul_ps(fp2,am)),_mm256_mul_ps(_mm256_sub_ps(tp,tm),a)),denominator));
+		
+		/* Update the maximum stable step sizes: */
+		maxSteps=_mm256_min_ps(maxSteps,_mm256_div_ps(halfCellSize,_mm256_max_ps(_mm256_sub_ps(zero,am),ap)));
+		}
+	
+	/* Reduce the maximum stable step sizes: */
+	__m128 maxSteps4=_mm_min_ps(_mm256_castps256_ps128(maxSteps),_mm256_extractf128_ps(maxSteps,1));
+	maxSteps4=_mm_min_ps(maxSteps4,_mm_movehl_ps(maxSteps4,maxSteps4));
+	maxSteps4=_mm_min_ss(maxSteps4,_mm_shuffle_ps(maxSteps4,maxSteps4,0x55));
+	float result=_mm_cvtss_f32(maxSteps4);
+	
+	/* Process the remaining faces: */
+	for(;i<numFaces;++i)
+		result=minf(result,calcFaceFlux(i,qm,om,qp,op,b,g,epsilon,cellSize,f));
+	
+	return result;
+	}
+
+#endif
+
+}
+
+/*******************************
+Methods of class CPUWaterSolver:
+*******************************/
+
+void CPUWaterSolver::selectKernels(void)
+	{
+	/* Start with the scalar kernel: */
+	fluxFunction=calcFluxesScalar;
+	
+	#if CPUWATERSOLVER_USE_X86_KERNELS
+	if(vectorize)
+		{
+		/* Select the fastest vectorized kernel supported by the CPU: */
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx"))
+			fluxFunction=calcFluxesAVX;
+		else if(__builtin_cpu_supports("sse"))
+			fluxFunction=calcFluxesSSE;
+		}
+	#endif
+	}
+
+void CPUWaterSolver::fillGhostColumns(std::vector<float>& grid,int y0,int y1)
+	{
+	for(int y=y0;y<y1;++y)
+		{
+		float* row=&grid[origin+y*stride];
+		row[-2]=row[-1]=row[0];
+		row[size[0]+1]=row[size[0]]=row[size[0]-1];
+		}
+	}
+
+void CPUWaterSolver::fillGhostRows(std::vector<float>& grid,int y)
+	{
+	/* Copy the entire padded row, including its ghost cells, into the two ghost rows beyond it: */
+	int dy=y==0?-1:1;
+	const float* row=&grid[origin-2+y*stride];
+	for(int i=1;i<=2;++i)
+		memcpy(&grid[origin-2+(y+i*dy)*stride],row,stride*sizeof(float));
+	}
+
+void CPUWaterSolver::fillGhostCells(std::vector<float>& grid)
+	{
+	fillGhostColumns(grid,0,size[1]);
+	fillGhostRows(grid,0);
+	fillGhostRows(grid,size[1]-1);
+	}
+
+void CPUWaterSolver::calcDerivedBathymetries(void)
+	{
+	int bw=size[0]-1;
+	int bh=size[1]-1;
+	
+	/* Calculate the bathymetry elevations at the centers of the western faces of all cells and ghost cells needed by the slope and flux computations: */
+	for(int y=0;y<size[1];++y)
+		{
+		float* fbxPtr=&faceBathymetryX[origin+y*stride];
+		for(int x=-1;x<=size[0]+1;++x)
+			fbxPtr[x]=(getVertex(bathymetry,bw,bh,x-1,y-1)+getVertex(bathymetry,bw,bh,x-1,y))*0.5f;
+		}
+	
+	/* Calculate the bathymetry elevations at the centers of the southern faces: */
+	for(int y=-1;y<=size[1]+1;++y)
+		{
+		float* fbyPtr=&faceBathymetryY[origin+y*stride];
+		for(int x=0;x<size[0];++x)
+			fbyPtr[x]=(getVertex(bathymetry,bw,bh,x-1,y-1)+getVertex(bathymetry,bw,bh,x,y-1))*0.5f;
+		}
+	
+	/* Calculate the bathymetry elevations at the cell centers: */
+	for(int y=0;y<size[1];++y)
+		{
+		float* cbPtr=&cellBathymetry[origin+y*stride];
+		for(int x=0;x<size[0];++x)
+			cbPtr[x]=(getVertex(bathymetry,bw,bh,x-1,y-1)+getVertex(bathymetry,bw,bh,x,y-1)+getVertex(bathymetry,bw,bh,x-1,y)+getVertex(bathymetry,bw,bh,x,y))*0.25f;
+		}
+	}
+
+void CPUWaterSolver::calcOffsetsY(int y,int x0,int x1,float* const offsets[3]) const
+	{
+	/* Access the row, its two neighbors, and its southern and northern faces through local variables: */
+	int rowOffset=origin+y*stride;
+	const float* q0=&jobQuantities[0][rowOffset];
+	const float* q1=&jobQuantities[1][rowOffset];
+	const float* q2=&jobQuantities[2][rowOffset];
+	const float* fbs=&faceBathymetryY[rowOffset];
+	const float* fbn=fbs+stride;
+	float* o0=offsets[0];
+	float* o1=offsets[1];
+	float* o2=offsets[2];
+	int s=stride;
+	float cs=cellSize[1];
+	float thetaOverCellSize=theta/cs;
+	float twoCellSize=2.0f*cs;
+	float halfCellSize=cs*0.5f;
+	
+	/* Calculate the limited slopes and turn them into reconstruction offsets, one component at a time to keep the loops vectorizable: */
+	for(int x=x0;x<x1;++x)
+		o0[x]=limitSurfaceSlope(calcSlope(q0[x-s],q0[x],q0[x+s],thetaOverCellSize,twoCellSize),q0[x],fbs[x],fbn[x],cs)*halfCellSize;
+	for(int x=x0;x<x1;++x)
+		o1[x]=calcSlope(q1[x-s],q1[x],q1[x+s],thetaOverCellSize,twoCellSize)*halfCellSize;
+	for(int x=x0;x<x1;++x)
+		o2[x]=calcSlope(q2[x-s],q2[x],q2[x+s],thetaOverCellSize,twoCellSize)*halfCellSize;
+	}
+
+float CPUWaterSolver::calcFluxesY(int y,int x0,int x1,float* const offsets0[3],float* const offsets1[3],float* const fluxes[3]) const
+	{
+	/* Access the rows below and above the faces, with hv as the face-normal discharge: */
+	int rowOffset=origin+y*stride;
+	const float* qm[3];
+	const float* om[3];
+	const float* qp[3];
+	const float* op[3];
+	float* f[3];
+	for(int i=0;i<3;++i)
+		{
+		int component=i==0?0:3-i;
+		qp[i]=&jobQuantities[component][rowOffset+x0];
+		qm[i]=qp[i]-stride;
+		om[i]=offsets0[component]+x0;
+		op[i]=offsets1[component]+x0;
+		f[i]=fluxes[component]+x0;
+		}
+	
+	/* Calculate the fluxes across the faces: */
+	return fluxFunction(x1-x0,qm,om,qp,op,&faceBathymetryY[rowOffset+x0],g,epsilon,cellSize[1],f);
+	}
+
+float CPUWaterSolver::calcFluxesX(int y,int x0,int x1,CPUWaterSolver::Band& band) const
+	{
+	/* Access the row and its vertical faces through local variables: */
+	int rowOffset=origin+y*stride;
+	const float* q0=&jobQuantities[0][rowOffset];
+	const float* q1=&jobQuantities[1][rowOffset];
+	const float* q2=&jobQuantities[2][rowOffset];
+	const float* fb=&faceBathymetryX[rowOffset];
+	float* o0=band.offsetX[0];
+	float* o1=band.offsetX[1];
+	float* o2=band.offsetX[2];
+	float cs=cellSize[0];
+	float thetaOverCellSize=theta/cs;
+	float twoCellSize=2.0f*cs;
+	float halfCellSize=cs*0.5f;
+	
+	/* Calculate reconstruction offsets for the range's cells and the cells on either side: */
+	for(int x=x0-1;x<=x1;++x)
+		o0[x]=limitSurfaceSlope(calcSlope(q0[x-1],q0[x],q0[x+1],thetaOverCellSize,twoCellSize),q0[x],fb[x],fb[x+1],cs)*halfCellSize;
+	for(int x=x0-1;x<=x1;++x)
+		o1[x]=calcSlope(q1[x-1],q1[x],q1[x+1],thetaOverCellSize,twoCellSize)*halfCellSize;
+	for(int x=x0-1;x<=x1;++x)
+		o2[x]=calcSlope(q2[x-1],q2[x],q2[x+1],thetaOverCellSize,twoCellSize)*halfCellSize;
+	
+	/* Calculate the fluxes across the western faces of the range's cells and the eastern face of its last cell, with hu as the face-normal discharge: */
+	const float* qm[3];
+	const float* om[3];
+	const float* qp[3];
+	const float* op[3];
+	float* f[3];
+	for(int i=0;i<3;++i)
+		{
+		qp[i]=&jobQuantities[i][rowOffset+x0];
+		qm[i]=qp[i]-1;
+		op[i]=band.offsetX[i]+x0;
+		om[i]=op[i]-1;
+		f[i]=band.fluxX[i]+x0;
+		}
+	return fluxFunction(x1+1-x0,qm,om,qp,op,fb+x0,g,epsilon,cs,f);
+	}
+
+void CPUWaterSolver::calcBandDerivative(unsigned int bandIndex)
+	{
+	Band& band=bands[bandIndex];
+	float maxStep=Math::Constants<float>::max;
+	
+	float gg=g;
+	float csx=cellSize[0];
+	float csy=cellSize[1];
+	for(std::vector<int>::const_iterator sIt=band.spans.begin();sIt!=band.spans.end();sIt+=2)
+		{
+		int x0=sIt[0];
+		int x1=sIt[1];
+		
+		/* Calculate the fluxes across the southern faces of the span's first row: */
+		float** offsetsBelow=band.offsetY[0];
+		float** offsetsAbove=band.offsetY[1];
+		float** fluxesSouth=band.fluxY[0];
+		float** fluxesNorth=band.fluxY[1];
+		calcOffsetsY(band.y0-1,x0,x1,offsetsBelow);
+		calcOffsetsY(band.y0,x0,x1,offsetsAbove);
+		maxStep=Math::min(maxStep,calcFluxesY(band.y0,x0,x1,offsetsBelow,offsetsAbove,fluxesSouth));
+		
+		for(int y=band.y0;y<band.y1;++y)
+			{
+			/* Calculate the fluxes across the row's northern faces, reusing the row's reconstruction offsets: */
+			std::swap(offsetsBelow,offsetsAbove);
+			calcOffsetsY(y+1,x0,x1,offsetsAbove);
+			maxStep=Math::min(maxStep,calcFluxesY(y+1,x0,x1,offsetsBelow,offsetsAbove,fluxesNorth));
+			
+			/* Calculate the fluxes across the row's vertical faces: */
+			maxStep=Math::min(maxStep,calcFluxesX(y,x0,x1,band));
+			
+			/* Access the row, its faces, and its flux buffers through local variables: */
+			int rowOffset=origin+y*stride;
+			const float* q0=&jobQuantities[0][rowOffset];
+			const float* fbx=&faceBathymetryX[rowOffset];
+			const float* fbs=&faceBathymetryY[rowOffset];
+			const float* fbn=fbs+stride;
+			const float* fx0=band.fluxX[0];
+			const float* fx1=band.fluxX[1];
+			const float* fx2=band.fluxX[2];
+			const float* fs0=fluxesSouth[0];
+			const float* fs1=fluxesSouth[1];
+			const float* fs2=fluxesSouth[2];
+			const float* fn0=fluxesNorth[0];
+			const float* fn1=fluxesNorth[1];
+			const float* fn2=fluxesNorth[2];
+			float* qt0=&derivatives[0][rowOffset];
+			float* qt1=&derivatives[1][rowOffset];
+			float* qt2=&derivatives[2][rowOffset];
+			
+			/* Calculate the temporal derivative from the source terms at the cell centers and the fluxes, one component at a time: */
+			for(int x=x0;x<x1;++x)
+				qt0[x]=0.0f-(fx0[x+1]-fx0[x])/csx-(fn0[x]-fs0[x])/csy;
+			for(int x=x0;x<x1;++x)
+				{
+				float h=Math::max(q0[x]-(fbx[x]+fbx[x+1])*0.5f,0.0f);
+				qt1[x]=-gg*h*(fbx[x+1]-fbx[x])/csx-(fx1[x+1]-fx1[x])/csx-(fn1[x]-fs1[x])/csy;
+				}
+			for(int x=x0;x<x1;++x)
+				{
+				float h=Math::max(q0[x]-(fbx[x]+fbx[x+1])*0.5f,0.0f);
+				qt2[x]=-gg*h*(fbn[x]-fbs[x])/csy-(fx2[x+1]-fx2[x])/csx-(fn2[x]-fs2[x])/csy;
+				}
+			
+			/* The row's northern faces are the next row's southern faces: */
+			std::swap(fluxesSouth,fluxesNorth);
+			}
+		}
+	
+	band.maxStepSize=maxStep;
+	}
+
+void CPUWaterSolver::runBandEulerStep(unsigned int bandIndex)
+	{
+	const Band& band=bands[bandIndex];
+	
+	float dt=jobStepSize;
+	float att=jobAttenuation;
+	for(int y=band.y0;y<band.y1;++y)
+		{
+		/* Calculate the Euler step on the row's active spans one component at a time: */
+		int rowOffset=origin+y*stride;
+		for(std::vector<int>::const_iterator sIt=band.spans.begin();sIt!=band.spans.end();sIt+=2)
+			for(int i=0;i<3;++i)
+				{
+				const float* q=&quantities[i][rowOffset];
+				const float* qt=&derivatives[i][rowOffset];
+				float* qStar=&starQuantities[i][rowOffset];
+				if(i==0)
+					{
+					for(int x=sIt[0];x<sIt[1];++x)
+						qStar[x]=q[x]+qt[x]*dt;
+					}
+				else
+					{
+					for(int x=sIt[0];x<sIt[1];++x)
+						qStar[x]=(q[x]+qt[x]*dt)*att;
+					}
+				}
+		}
+	
+	/* Update the band's ghost cells: */
+	for(int i=0;i<3;++i)
+		{
+		fillGhostColumns(starQuantities[i],band.y0,band.y1);
+		if(band.y0==0)
+			fillGhostRows(starQuantities[i],0);
+		if(band.y1==size[1])
+			fillGhostRows(starQuantities[i],size[1]-1);
+		}
+	}
+
+void CPUWaterSolver::runBandRungeKuttaStep(unsigned int bandIndex)
+	{
+	Band& band=bands[bandIndex];
+	
+	/* Reset the wet flags of the band's tiles if the band covers a row of tiles: */
+	unsigned char* wetRow=0;
+	if(skipDryTiles)
+		{
+		wetRow=&wetTiles[(band.y0/tileSize)*numTiles[0]];
+		memset(wetRow,0,numTiles[0]);
+		}
+	
+	int width=size[0];
+	float dt=jobStepSize;
+	float att=jobAttenuation;
+	float waterStep=waterDeposit*dt;
+	bool updateWater=waterDeposit!=0.0f||jobWaterRates!=0;
+	for(int y=band.y0;y<band.y1;++y)
+		{
+		int rowOffset=origin+y*stride;
+		float* q0=&quantities[0][rowOffset];
+		float* q1=&quantities[1][rowOffset];
+		float* q2=&quantities[2][rowOffset];
+		const float* b=&cellBathymetry[rowOffset];
+		for(std::vector<int>::const_iterator sIt=band.spans.begin();sIt!=band.spans.end();sIt+=2)
+			{
+			int x0=sIt[0];
+			int x1=sIt[1];
+			
+			/* Calculate the Runge-Kutta step one component at a time: */
+			for(int i=0;i<3;++i)
+				{
+				float* q=&quantities[i][rowOffset];
+				const float* qStar=&starQuantities[i][rowOffset];
+				const float* qt=&derivatives[i][rowOffset];
+				if(i==0)
+					{
+					for(int x=x0;x<x1;++x)
+						q[x]=(q[x]+qStar[x]+qt[x]*dt)*0.5f;
+					}
+				else
+					{
+					for(int x=x0;x<x1;++x)
+						q[x]=((q[x]+qStar[x]+qt[x]*dt)*0.5f)*att;
+					}
+				}
+			
+			if(dryBoundary)
+				{
+				/* Set the quantities in the span's part of the outermost layer of cells to dry conditions: */
+				int xStep=y==0||y==size[1]-1?1:Math::max(width-1,1);
+				for(int x=0;x<width;x+=xStep)
+					if(x>=x0&&x<x1)
+						{
+						q0[x]=b[x];
+						q1[x]=0.0f;
+						q2[x]=0.0f;
+						}
+				}
+			
+			if(updateWater)
+				{
+				/* Add or remove water, adding new water with zero velocity and removing water at current velocity: */
+				const float* rates=jobWaterRates!=0?jobWaterRates+y*width:0;
+				for(int x=x0;x<x1;++x)
+					{
+					float water=rates!=0?waterStep+rates[x]*dt:waterStep;
+					float hOld=q0[x]-b[x];
+					float hNew=Math::max(hOld+water,0.0f);
+					q0[x]=hNew+b[x];
+					float scale=hNew/hOld;
+					scale=hNew==0.0f?0.0f:hNew<hOld?scale:1.0f;
+					q1[x]*=scale;
+					q2[x]*=scale;
+					}
+				}
+			
+			if(wetRow!=0)
+				{
+				/* Flag the span's tiles that hold water: */
+				for(int tx0=x0;tx0<x1;tx0+=tileSize)
+					{
+					int tx1=Math::min(tx0+tileSize,x1);
+					unsigned char wet=0;
+					for(int x=tx0;x<tx1;++x)
+						wet|=q0[x]>b[x];
+					wetRow[tx0/tileSize]|=wet;
+					}
+				}
+			}
+		}
+	
+	/* Update the band's ghost cells: */
+	for(int i=0;i<3;++i)
+		{
+		fillGhostColumns(quantities[i],band.y0,band.y1);
+		if(band.y0==0)
+			fillGhostRows(quantities[i],0);
+		if(band.y1==size[1])
+			fillGhostRows(quantities[i],size[1]-1);
+		}
+	}
+
+void CPUWaterSolver::createBands(void)
+	{
+	int numBands;
+	if(skipDryTiles)
+		{
+		/* Create one band per row of tiles, and let the worker threads claim bands as they go to balance unevenly distributed water: */
+		numBands=numTiles[1];
+		}
+	else
+		{
+		/* Split the water table into one band per thread, but keep bands high enough to outweigh the fluxes calculated twice along band boundaries: */
+		numBands=Math::min(int(getNumThreads()),size[1]/8);
+		if(numBands<1)
+			numBands=1;
+		}
+	bands.clear();
+	bands.resize(numBands);
+	for(int i=0;i<numBands;++i)
+		{
+		Band& band=bands[i];
+		if(skipDryTiles)
+			{
+			band.y0=i*tileSize;
+			band.y1=Math::min((i+1)*tileSize,size[1]);
+			}
+		else
+			{
+			band.y0=i*size[1]/numBands;
+			band.y1=(i+1)*size[1]/numBands;
+			
+			/* Simulate all of the band's cells: */
+			band.spans.push_back(0);
+			band.spans.push_back(size[0]);
+			}
+		
+		/* Carve the band's row buffers out of a single block, leaving room for a ghost cell at the start of each row: */
+		band.rowBuffer.resize(stride*18,0.0f);
+		float* rbPtr=&band.rowBuffer[0];
+		for(int j=0;j<3;++j,rbPtr+=stride)
+			band.offsetX[j]=rbPtr+1;
+		for(int j=0;j<3;++j,rbPtr+=stride)
+			band.fluxX[j]=rbPtr;
+		for(int k=0;k<2;++k)
+			for(int j=0;j<3;++j,rbPtr+=stride)
+				band.offsetY[k][j]=rbPtr;
+		for(int k=0;k<2;++k)
+			for(int j=0;j<3;++j,rbPtr+=stride)
+				band.fluxY[k][j]=rbPtr;
+		band.maxStepSize=Math::Constants<float>::max;
+		}
+	}
+
+void CPUWaterSolver::flagWetTiles(void)
+	{
+	/* Flag all tiles containing at least one cell that holds water: */
+	memset(&wetTiles[0],0,wetTiles.size());
+	for(int y=0;y<size[1];++y)
+		{
+		const float* q0=&quantities[0][origin+y*stride];
+		const float* b=&cellBathymetry[origin+y*stride];
+		unsigned char* wetRow=&wetTiles[(y/tileSize)*numTiles[0]];
+		for(int x=0;x<size[0];++x)
+			wetRow[x/tileSize]|=q0[x]>b[x];
+		}
+	}
+
+void CPUWaterSolver::flagRainTiles(const float* waterRates)
+	{
+	/* Flag all tiles containing at least one cell that receives water: */
+	memset(&rainTiles[0],0,rainTiles.size());
+	if(waterRates!=0)
+		{
+		for(int y=0;y<size[1];++y)
+			{
+			const float* rPtr=waterRates+y*size[0];
+			unsigned char* rainRow=&rainTiles[(y/tileSize)*numTiles[0]];
+			for(int x=0;x<size[0];++x)
+				rainRow[x/tileSize]|=rPtr[x]>0.0f;
+			}
+		}
+	}
+
+void CPUWaterSolver::updateActiveTiles(void)
+	{
+	/* Water deposited everywhere wets all tiles: */
+	bool allActive=waterDeposit>0.0f;
+	
+	for(int ty=0;ty<numTiles[1];++ty)
+		{
+		Band& band=bands[ty];
+		band.spans.clear();
+		for(int tx=0;tx<numTiles[0];++tx)
+			{
+			/* Activate the tile if it or any of its neighbors holds or receives water: */
+			bool active=allActive;
+			for(int y=Math::max(ty-1,0);y<=Math::min(ty+1,numTiles[1]-1);++y)
+				for(int x=Math::max(tx-1,0);x<=Math::min(tx+1,numTiles[0]-1);++x)
+					active=active||wetTiles[y*numTiles[0]+x]!=0||rainTiles[y*numTiles[0]+x]!=0;
+			
+			int x0=tx*tileSize;
+			int x1=Math::min(x0+tileSize,size[0]);
+			unsigned char& activeTile=activeTiles[ty*numTiles[0]+tx];
+			if(activeTile&&!active)
+				{
+				/* Synchronize the deactivated tile's intermediate quantities with its final dry quantities, which both stay constant until the tile is activated again: */
+				for(int y=band.y0;y<band.y1;++y)
+					for(int i=0;i<3;++i)
+						memcpy(&starQuantities[i][origin+y*stride+x0],&quantities[i][origin+y*stride+x0],(x1-x0)*sizeof(float));
+				}
+			activeTile=active?1:0;
+			
+			if(active)
+				{
+				/* Add the tile to the band's spans, merging it with the previous tile if possible: */
+				if(!band.spans.empty()&&band.spans.back()==x0)
+					band.spans.back()=x1;
+				else
+					{
+					band.spans.push_back(x0);
+					band.spans.push_back(x1);
+					}
+				}
+			}
+		}
+	}
+
+void CPUWaterSolver::runBandJob(const WorkerPool::BandFunction& bandFunction)
+	{
+	if(workerPool!=0&&bands.size()>1)
+		{
+		/* Process all bands in parallel: */
+		workerPool->runJob(bandFunction,bands.size());
+		}
+	else
+		{
+		/* Process all bands on the calling thread: */
+		for(unsigned int band=0;band<bands.size();++band)
+			bandFunction(band);
+		}
+	}
+
+float CPUWaterSolver::calcDerivative(const std::vector<float>* newJobQuantities)
+	{
+	/* Calculate the temporal derivative of all bands: */
+	jobQuantities=newJobQuantities;
+	runBandJob(*derivativeFunction);
+	
+	/* Gather the maximum step size from all bands: */
+	float result=Math::Constants<float>::max;
+	for(std::vector<Band>::iterator bIt=bands.begin();bIt!=bands.end();++bIt)
+		result=Math::min(result,bIt->maxStepSize);
+	return result;
+	}
+
+void CPUWaterSolver::integrate(float stepSize,const float* waterRates)
+	{
+	jobStepSize=stepSize;
+	jobAttenuation=Math::pow(attenuation,stepSize);
+	jobWaterRates=waterRates;
+	
+	/* Perform the tentative Euler integration step: */
+	runBandJob(*eulerStepFunction);
+	
+	/* Calculate the temporal derivative of the intermediate quantities: */
+	calcDerivative(starQuantities);
+	
+	/* Perform the final Runge-Kutta integration step, enforce boundary conditions, and add or remove water: */
+	runBandJob(*rungeKuttaStepFunction);
+	
+	++version;
+	}
+
+CPUWaterSolver::CPUWaterSolver(int width,int height,const float sCellSize[2],float baseElevation,unsigned int numThreads)
+	:theta(1.3f),g(9.81f),
+	 attenuation(127.0f/128.0f),maxStepSize(1.0f),waterDeposit(0.0f),dryBoundary(true),skipDryTiles(false),
+	 vectorize(true),fluxFunction(calcFluxesScalar),
+	 remainingTime(0.0f),version(0),
+	 workerPool(numThreads>1?new WorkerPool(numThreads):0),
+	 derivativeFunction(Misc::createFunctionCall(this,&CPUWaterSolver::calcBandDerivative)),
+	 eulerStepFunction(Misc::createFunctionCall(this,&CPUWaterSolver::runBandEulerStep)),
+	 rungeKuttaStepFunction(Misc::createFunctionCall(this,&CPUWaterSolver::runBandRungeKuttaStep)),
+	 jobQuantities(0),jobStepSize(0.0f),jobAttenuation(1.0f),jobWaterRates(0)
+	{
+	/* Initialize the water table size and cell size: */
+	size[0]=width;
+	size[1]=height;
+	for(int i=0;i<2;++i)
+		cellSize[i]=sCellSize[i];
+	epsilon=0.01f*Math::max(Math::max(cellSize[0],cellSize[1]),1.0f);
+	
+	/* Create a flat bathymetry grid: */
+	bathymetry.resize((size[0]-1)*(size[1]-1),baseElevation);
+	
+	/* Create the padded grids: */
+	stride=size[0]+4;
+	origin=2*stride+2;
+	size_t paddedSize=stride*(size[1]+4);
+	faceBathymetryX.resize(paddedSize,baseElevation);
+	faceBathymetryY.resize(paddedSize,baseElevation);
+	cellBathymetry.resize(paddedSize,baseElevation);
+	calcDerivedBathymetries();
+	for(int i=0;i<3;++i)
+		{
+		quantities[i].resize(paddedSize,i==0?baseElevation:0.0f);
+		starQuantities[i].resize(paddedSize,i==0?baseElevation:0.0f);
+		derivatives[i].resize(paddedSize,0.0f);
+		}
+	
+	/* Initialize the dry tile flags: */
+	for(int i=0;i<2;++i)
+		numTiles[i]=(size[i]+tileSize-1)/tileSize;
+	wetTiles.resize(numTiles[1]*numTiles[0],0);
+	rainTiles.resize(numTiles[1]*numTiles[0],0);
+	activeTiles.resize(numTiles[1]*numTiles[0],0);
+	
+	createBands();
+	
+	/* Select the flux kernel: */
+	selectKernels();
+	}
+
+CPUWaterSolver::~CPUWaterSolver(void)
+	{
+	/* Shut down the worker threads: */
+	delete workerPool;
+	delete derivativeFunction;
+	delete eulerStepFunction;
+	delete rungeKuttaStepFunction;
+	}
+
+void CPUWaterSolver::setSchemeParameters(float newTheta,float newG,float newEpsilon)
+	{
+	theta=newTheta;
+	g=newG;
+	epsilon=newEpsilon;
+	}
+
+void CPUWaterSolver::setAttenuation(float newAttenuation)
+	{
+	attenuation=newAttenuation;
+	}
+
+void CPUWaterSolver::setMaxStepSize(float newMaxStepSize)
+	{
+	maxStepSize=newMaxStepSize;
+	}
+
+void CPUWaterSolver::setWaterDeposit(float newWaterDeposit)
+	{
+	waterDeposit=newWaterDeposit;
+	}
+
+void CPUWaterSolver::setDryBoundary(bool newDryBoundary)
+	{
+	dryBoundary=newDryBoundary;
+	}
+
+void CPUWaterSolver::setSkipDryTiles(bool newSkipDryTiles)
+	{
+	if(skipDryTiles!=newSkipDryTiles)
+		{
+		skipDryTiles=newSkipDryTiles;
+		if(skipDryTiles)
+			{
+			/* Start with all tiles inactive, whose intermediate quantities must match their final quantities: */
+			for(int i=0;i<3;++i)
+				starQuantities[i]=quantities[i];
+			memset(&activeTiles[0],0,activeTiles.size());
+			flagWetTiles();
+			}
+		
+		/* Split the water table into bands suitable for the new mode: */
+		createBands();
+		}
+	}
+
+bool CPUWaterSolver::getVectorized(void) const
+	{
+	return fluxFunction!=calcFluxesScalar;
+	}
+
+void CPUWaterSolver::setVectorized(bool newVectorize)
+	{
+	vectorize=newVectorize;
+	selectKernels();
+	}
+
+void CPUWaterSolver::updateBathymetry(const float* bathymetryGrid)
+	{
+	/* Remember the old cell-centered bathymetry while calculating the new one: */
+	std::vector<float> oldCellBathymetry;
+	oldCellBathymetry.swap(cellBathymetry);
+	cellBathymetry.resize(oldCellBathymetry.size(),0.0f);
+	memcpy(&bathymetry[0],bathymetryGrid,bathymetry.size()*sizeof(float));
+	calcDerivedBathymetries();
+	
+	/* Keep the water column heights of all cells: */
+	for(int y=0;y<size[1];++y)
+		{
+		int rowOffset=origin+y*stride;
+		float* q0=&quantities[0][rowOffset];
+		const float* bOld=&oldCellBathymetry[rowOffset];
+		const float* bNew=&cellBathymetry[rowOffset];
+		for(int x=0;x<size[0];++x)
+			q0[x]=Math::max(q0[x]-bOld[x],0.0f)+bNew[x];
+		}
+	fillGhostCells(quantities[0]);
+	if(skipDryTiles)
+		{
+		/* Carry the water levels of inactive tiles into the intermediate quantities and find the wet tiles: */
+		starQuantities[0]=quantities[0];
+		flagWetTiles();
+		}
+	++version;
+	}
+
+void CPUWaterSolver::setWaterLevel(const float* waterGrid)
+	{
+	/* Clamp the new water level to the bathymetry: */
+	for(int y=0;y<size[1];++y)
+		{
+		float* q0=&quantities[0][origin+y*stride];
+		const float* b=&cellBathymetry[origin+y*stride];
+		const float* wPtr=waterGrid+y*size[0];
+		for(int x=0;x<size[0];++x)
+			q0[x]=Math::max(wPtr[x],b[x]);
+		}
+	fillGhostCells(quantities[0]);
+	if(skipDryTiles)
+		{
+		/* Carry the water levels of inactive tiles into the intermediate quantities and find the wet tiles: */
+		starQuantities[0]=quantities[0];
+		flagWetTiles();
+		}
+	++version;
+	}
+
+float CPUWaterSolver::runSimulationStep(bool forceStepSize,const float* waterRates)
+	{
+	if(skipDryTiles)
+		{
+		/* Find the tiles that need to be simulated: */
+		flagRainTiles(waterRates);
+		updateActiveTiles();
+		}
+	
+	/* Calculate the temporal derivative of the most recent quantities: */
+	float stepSize=calcDerivative(quantities);
+	
+	/* Limit the step size to the client-specified range: */
+	stepSize=forceStepSize?maxStepSize:Math::min(stepSize,maxStepSize);
+	
+	/* Run the remaining passes: */
+	integrate(stepSize,waterRates);
+	
+	return stepSize;
+	}
+
+unsigned int CPUWaterSolver::runSimulationSteps(float totalTimeStep,unsigned int maxNumSteps,const float* waterRates)
+	{
+	if(totalTimeStep<=0.0f||maxNumSteps==0)
+		return 0;
+	
+	/* Add the given time to the remaining time, carrying over at most one frame's worth of left-over time: */
+	remainingTime=Math::min(remainingTime,totalTimeStep)+totalTimeStep;
+	
+	/* Find the tiles receiving water during this call: */
+	if(skipDryTiles)
+		flagRainTiles(waterRates);
+	
+	/* Take the largest stable steps that do not exceed the remaining time: */
+	unsigned int numSteps=0;
+	while(numSteps<maxNumSteps&&remainingTime>1.0e-8f)
+		{
+		/* Find the tiles that need to be simulated in this step: */
+		if(skipDryTiles)
+			updateActiveTiles();
+		
+		float stepSize=Math::min(Math::min(calcDerivative(quantities),maxStepSize),remainingTime);
+		integrate(stepSize,waterRates);
+		remainingTime-=stepSize;
+		++numSteps;
+		}
+	
+	return numSteps;
+	}
+
+void CPUWaterSolver::getQuantities(float* quantityGrid) const
+	{
+	float* qgPtr=quantityGrid;
+	for(int y=0;y<size[1];++y)
+		{
+		int rowOffset=origin+y*stride;
+		for(int x=0;x<size[0];++x,qgPtr+=3)
+			for(int i=0;i<3;++i)
+				qgPtr[i]=quantities[i][rowOffset+x];
+		}
+	}
+
@@ -0,0 +1,164 @@
+/***********************************************************************
+CPUWaterSolver - Class to run the water flow simulation of class
+WaterTable2 on the CPU, split into horizontal bands processed by a pool
+of worker threads.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef CPUWATERSOLVER_INCLUDED
+#define CPUWATERSOLVER_INCLUDED
+
+#include <vector>
+
+#include "WorkerPool.h"
+
+/* Use vectorized flux kernels on x86 CPUs when compiling with GCC or a compatible compiler: */
+#if defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#define CPUWATERSOLVER_USE_X86_KERNELS 1
+#else
+#define CPUWATERSOLVER_USE_X86_KERNELS 0
+#endif
+
+class CPUWaterSolver
+	{
+	/* Embedded classes: */
+	public:
+	static const int tileSize=32; // Width and height of the square tiles that are skipped if they and their neighbors are dry
+	
+	private:
+	typedef float (*FluxFunction)(int,const float* const[3],const float* const[3],const float* const[3],const float* const[3],const float*,float,float,float,float* const[3]); // Type for functions calculating the partial fluxes across a range of faces; returns the maximum stable step size
+	
+	struct Band // Structure holding the row range, row buffers, and partial results of one horizontal band
+		{
+		/* Elements: */
+		public:
+		int y0,y1; // Half-open range of grid rows covered by the band
+		std::vector<float> rowBuffer; // Storage for the band's row buffers
+		float* offsetX[3]; // Slope-limited reconstruction offsets in x direction for the cells of the current row, including one ghost cell on either side
+		float* fluxX[3]; // Partial fluxes across the vertical faces of the current row
+		float* offsetY[2][3]; // Slope-limited reconstruction offsets in y direction for the current and the next row
+		float* fluxY[2][3]; // Partial fluxes across the southern and northern faces of the current row
+		std::vector<int> spans; // Half-open ranges of columns of the band's simulated cells, as consecutive pairs of first and one-past-last column
+		float maxStepSize; // Maximum stable step size for all faces processed by the band
+		};
+	
+	/* Elements: */
+	int size[2]; // Width and height of the water table in cells
+	float cellSize[2]; // Width and height of water table cells in world coordinate units
+	float theta; // Coefficient for minmod flux-limiting differential operator
+	float g; // Gravitiational acceleration constant
+	float epsilon; // Coefficient for desingularizing division operator
+	float attenuation; // Attenuation factor for partial discharges
+	float maxStepSize; // Maximum step size for each Runge-Kutta integration step
+	float waterDeposit; // A fixed amount of water added at every iteration of the flow simulation, for evaporation etc.
+	bool dryBoundary; // Flag whether to enforce dry boundary conditions at the end of each simulation step
+	bool skipDryTiles; // Flag whether to skip tiles that neither hold nor receive water and have no neighbors that do
+	bool vectorize; // Flag whether to use a vectorized flux kernel if supported by the CPU
+	FluxFunction fluxFunction; // Function calculating partial fluxes across ranges of faces
+	int stride; // Distance between adjacent rows in all padded grids, which have two ghost cells around the water table's cells
+	int origin; // Index of cell (0, 0) in all padded grids
+	std::vector<float> bathymetry; // Vertex-centered bathymetry grid of grid size minus 1
+	std::vector<float> faceBathymetryX; // Padded grid of bathymetry elevations at the centers of cells' western faces
+	std::vector<float> faceBathymetryY; // Padded grid of bathymetry elevations at the centers of cells' southern faces
+	std::vector<float> cellBathymetry; // Padded grid of bathymetry elevations at cell centers
+	std::vector<float> quantities[3]; // Padded cell-centered conserved quantity grid (w, hu, hv) in structure-of-arrays layout
+	std::vector<float> starQuantities[3]; // Padded cell-centered intermediate quantity grid after the tentative Euler step
+	std::vector<float> derivatives[3]; // Padded cell-centered temporal derivative grid
+	int numTiles[2]; // Number of tiles horizontally and vertically
+	std::vector<unsigned char> wetTiles; // Flags for tiles holding water after the most recent simulation step, in row-major order
+	std::vector<unsigned char> rainTiles; // Flags for tiles receiving water from the current water rate grid
+	std::vector<unsigned char> activeTiles; // Flags for tiles simulated by the current simulation step
+	float remainingTime; // Simulation time left over from the most recent call to runSimulationSteps()
+	unsigned int version; // Version number of the conserved quantity grid, incremented on every change
+	WorkerPool* workerPool; // Pool of worker threads to process bands in parallel, or null if all bands are processed by the calling thread
+	std::vector<Band> bands; // List of horizontal bands into which the water table is split
+	WorkerPool::BandFunction* derivativeFunction; // Function calculating the temporal derivative of one band of the current job's quantities
+	WorkerPool::BandFunction* eulerStepFunction; // Function running the tentative Euler step on one band
+	WorkerPool::BandFunction* rungeKuttaStepFunction; // Function running the final Runge-Kutta step, the boundary conditions, and the water update on one band
+	const std::vector<float>* jobQuantities; // Quantity grid whose temporal derivative is calculated by the current job
+	float jobStepSize; // Step size of the current integration job
+	float jobAttenuation; // Attenuation factor for partial discharges for the current integration job's step size
+	const float* jobWaterRates; // Cell-centered grid of water amounts per second to add or remove during the current integration job, or null
+	
+	/* Private methods: */
+	void selectKernels(void); // Selects the flux kernel according to the vectorization flag and the CPU's capabilities
+	void fillGhostColumns(std::vector<float>& grid,int y0,int y1); // Copies the outermost cells of the given range of rows of a padded grid into their rows' ghost cells
+	void fillGhostRows(std::vector<float>& grid,int y); // Copies the given outermost row of a padded grid into its adjacent ghost rows
+	void fillGhostCells(std::vector<float>& grid); // Copies the outermost cells of a padded grid into all its ghost cells
+	void calcDerivedBathymetries(void); // Calculates the face- and cell-centered bathymetry grids from the vertex-centered bathymetry grid
+	void calcOffsetsY(int y,int x0,int x1,float* const offsets[3]) const; // Calculates reconstruction offsets in y direction for the given column range of the given row of the current job's quantities
+	float calcFluxesY(int y,int x0,int x1,float* const offsets0[3],float* const offsets1[3],float* const fluxes[3]) const; // Calculates partial fluxes across the southern faces of the given column range of the given row from the reconstruction offsets of the rows below and at the faces; returns the maximum stable step size
+	float calcFluxesX(int y,int x0,int x1,Band& band) const; // Calculates partial fluxes across the vertical faces of the given column range of the given row into the given band's row buffers; returns the maximum stable step size
+	void calcBandDerivative(unsigned int bandIndex); // Calculates the temporal derivative of one band of the current job's quantities
+	void runBandEulerStep(unsigned int bandIndex); // Runs the tentative Euler step on one band
+	void runBandRungeKuttaStep(unsigned int bandIndex); // Runs the final Runge-Kutta step, boundary conditions, and water update on one band
+	void createBands(void); // Splits the water table into horizontal bands according to the current number of threads and tile skipping mode
+	void flagWetTiles(void); // Flags all tiles holding water in the current quantity grid
+	void flagRainTiles(const float* waterRates); // Flags all tiles receiving water from the given water rate grid, which may be null
+	void updateActiveTiles(void); // Activates all tiles that hold or receive water or have neighbors that do, and updates the bands' column spans
+	void runBandJob(const WorkerPool::BandFunction& bandFunction); // Calls the given function on all bands, in parallel if there are worker threads
+	float calcDerivative(const std::vector<float>* newJobQuantities); // Calculates the temporal derivative of the given quantity grid and returns the maximum stable step size
+	void integrate(float stepSize,const float* waterRates); // Runs the integration and water update passes of a simulation step whose temporal derivative was already calculated
+	
+	/* Constructors and destructors: */
+	public:
+	CPUWaterSolver(int width,int height,const float sCellSize[2],float baseElevation,unsigned int numThreads); // Creates a dry water table of the given size in cells over a flat bathymetry at the given elevation, using the given total number of threads
+	private:
+	CPUWaterSolver(const CPUWaterSolver& source); // Prohibit copy constructor
+	CPUWaterSolver& operator=(const CPUWaterSolver& source); // Prohibit assignment operator
+	public:
+	~CPUWaterSolver(void);
+	
+	/* Methods: */
+	const int* getSize(void) const // Returns the size of the water table
+		{
+		return size;
+		}
+	const float* getCellSize(void) const // Returns the water table's cell size
+		{
+		return cellSize;
+		}
+	unsigned int getNumThreads(void) const // Returns the total number of threads running the simulation
+		{
+		return workerPool!=0?workerPool->getNumWorkers():1U;
+		}
+	void setSchemeParameters(float newTheta,float newG,float newEpsilon); // Sets the flux limiter coefficient, gravitational acceleration, and desingularization coefficient
+	void setAttenuation(float newAttenuation); // Sets the attenuation factor for partial discharges
+	void setMaxStepSize(float newMaxStepSize); // Sets the maximum step size for all subsequent integration steps
+	void setWaterDeposit(float newWaterDeposit); // Sets the amount of water deposited per second on every simulation step
+	void setDryBoundary(bool newDryBoundary); // Enables or disables enforcement of dry boundaries
+	bool getSkipDryTiles(void) const // Returns true if dry tiles are skipped
+		{
+		return skipDryTiles;
+		}
+	void setSkipDryTiles(bool newSkipDryTiles); // Enables or disables skipping of tiles that neither hold nor receive water and have no neighbors that do
+	bool getVectorized(void) const; // Returns true if the solver uses a vectorized flux kernel
+	void setVectorized(bool newVectorize); // Enables the fastest vectorized flux kernel supported by the CPU, or forces the scalar kernel
+	void updateBathymetry(const float* bathymetryGrid); // Updates the bathymetry with a vertex-centered elevation grid of grid size minus 1, keeping water column heights
+	void setWaterLevel(const float* waterGrid); // Sets the current water level to the given cell-centered grid, clamped to the bathymetry
+	float runSimulationStep(bool forceStepSize,const float* waterRates); // Runs a water flow simulation step, always uses maxStepSize if flag is true; adds the given cell-centered grid of water amounts per second if not null; returns the step size taken
+	unsigned int runSimulationSteps(float totalTimeStep,unsigned int maxNumSteps,const float* waterRates); // Advances the simulation by the given time using at most the given number of self-determined steps, carrying left-over time over to the next call like WaterTable2::runSimulationSteps(); returns the number of steps run
+	unsigned int getVersion(void) const // Returns the version number of the conserved quantity grid
+		{
+		return version;
+		}
+	void getQuantities(float* quantityGrid) const; // Writes the current conserved quantities (w, hu, hv) into the given interleaved cell-centered grid
+	};
+
+#endif
@@ -37,6 +37,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <GL/GLTransformationWrappers.h>
 
 #include "ShaderHelper.h"
+#include "TileChangeMask.h"
 
 /*********************************************
 Methods of class DepthImageRenderer::DataItem:
@@ -78,7 +79,8 @@ Methods of class DepthImageRenderer:
 ***********************************/
 
 DepthImageRenderer::DepthImageRenderer(const unsigned int sDepthImageSize[2])
-	:depthImageVersion(0)
+	:depthImageVersion(0),
+	 depthImageChanges(0),depthImageIncremental(false)
 	{
 	/* Copy the depth image size: */
 	for(int i=0;i<2;++i)
@@ -220,10 +222,70 @@ void DepthImageRenderer::setBasePlane(const Plane& newBasePlane)
 		basePlaneDicEq[i]=GLfloat(dpm(0,i)*bpn[0]+dpm(1,i)*bpn[1]+dpm(2,i)*bpn[2]-dpm(3,i)*bpo);
 	}
 
+void DepthImageRenderer::updateDepthTexture(DepthImageRenderer::DataItem* dataItem) const
+	{
+	if(dataItem->depthTextureVersion==depthImageVersion)
+		return;
+	
+	if(depthImageIncremental&&dataItem->depthTextureVersion+1==depthImageVersion)
+		{
+		/* Upload runs of horizontally adjacent changed tiles directly from the depth image: */
+		glPixelStorei(GL_UNPACK_ROW_LENGTH,depthImageSize[0]);
+		const unsigned int* numTiles=depthImageChanges->getNumTiles();
+		const GLfloat* diPtr=depthImage.getData<GLfloat>();
+		for(unsigned int ty=0;ty<numTiles[1];++ty)
+			{
+			unsigned int y0=ty*TileChangeMask::tileSize;
+			unsigned int y1=y0+TileChangeMask::tileSize<depthImageSize[1]?y0+TileChangeMask::tileSize:depthImageSize[1];
+			unsigned int tx=0;
+			while(tx<numTiles[0])
+				{
+				/* Find the next run of changed tiles: */
+				while(tx<numTiles[0]&&!depthImageChanges->isChanged(tx,ty))
+					++tx;
+				unsigned int runStart=tx;
+				while(tx<numTiles[0]&&depthImageChanges->isChanged(tx,ty))
+					++tx;
+				
+				if(runStart<tx)
+					{
+					/* Upload the run's pixels: */
+					unsigned int x0=runStart*TileChangeMask::tileSize;
+					unsigned int x1=tx*TileChangeMask::tileSize<depthImageSize[0]?tx*TileChangeMask::tileSize:depthImageSize[0];
+					glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB,0,x0,y0,x1-x0,y1-y0,GL_LUMINANCE,GL_FLOAT,diPtr+(size_t(y0)*size_t(depthImageSize[0])+size_t(x0)));
+					}
+				}
+			}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH,0);
+		}
+	else
+		{
+		/* Upload the new depth texture: */
+		glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB,0,0,0,depthImageSize[0],depthImageSize[1],GL_LUMINANCE,GL_FLOAT,depthImage.getData<GLfloat>());
+		}
+	
+	/* Mark the depth texture as current: */
+	dataItem->depthTextureVersion=depthImageVersion;
+	}
+
 void DepthImageRenderer::setDepthImage(const Kinect::FrameBuffer& newDepthImage)
 	{
 	/* Update the depth image: */
 	depthImage=newDepthImage;
+	depthImageChanges=0;
+	depthImageIncremental=false;
+	++depthImageVersion;
+	}
+
+void DepthImageRenderer::setIncrementalDepthImage(const Kinect::FrameBuffer& newDepthImage)
+	{
+	/* Check if the new depth image directly follows the current one before releasing the current one: */
+	const TileChangeMask& newChanges=TileChangeMask::get(newDepthImage);
+	depthImageIncremental=depthImageChanges!=0&&newChanges.getFrameIndex()==depthImageChanges->getFrameIndex()+1;
+	
+	/* Update the depth image: */
+	depthImage=newDepthImage;
+	depthImageChanges=&newChanges;
 	++depthImageVersion;
 	}
 
@@ -268,14 +330,7 @@ void DepthImageRenderer::bindDepthTexture(GLContextData& contextData) const
 	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->depthTexture);
 	
 	/* Check if the texture is outdated: */
-	if(dataItem->depthTextureVersion!=depthImageVersion)
-		{
-		/* Upload the new depth texture: */
-		glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB,0,0,0,depthImageSize[0],depthImageSize[1],GL_LUMINANCE,GL_FLOAT,depthImage.getData<GLfloat>());
-		
-		/* Mark the depth texture as current: */
-		dataItem->depthTextureVersion=depthImageVersion;
-		}
+	updateDepthTexture(dataItem);
 	}
 
 void DepthImageRenderer::renderSurfaceTemplate(GLContextData& contextData) const
@@ -317,14 +372,7 @@ void DepthImageRenderer::renderDepth(const PTransform& projectionModelview,GLCon
 	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->depthTexture);
 	
 	/* Check if the texture is outdated: */
-	if(dataItem->depthTextureVersion!=depthImageVersion)
-		{
-		/* Upload the new depth texture: */
-		glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB,0,0,0,depthImageSize[0],depthImageSize[1],GL_LUMINANCE,GL_FLOAT,depthImage.getData<GLfloat>());
-		
-		/* Mark the depth texture as current: */
-		dataItem->depthTextureVersion=depthImageVersion;
-		}
+	updateDepthTexture(dataItem);
 	glUniform1iARB(dataItem->depthShaderUniforms[0],0); // Tell the shader that the depth texture is in texture unit 0
 	
 	/* Upload the combined projection, modelview, and depth projection matrix: */
@@ -362,14 +410,7 @@ void DepthImageRenderer::renderElevation(const PTransform& projectionModelview,G
 	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->depthTexture);
 	
 	/* Check if the texture is outdated: */
-	if(dataItem->depthTextureVersion!=depthImageVersion)
-		{
-		/* Upload the new depth texture: */
-		glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB,0,0,0,depthImageSize[0],depthImageSize[1],GL_LUMINANCE,GL_FLOAT,depthImage.getData<GLfloat>());
-		
-		/* Mark the depth texture as current: */
-		dataItem->depthTextureVersion=depthImageVersion;
-		}
+	updateDepthTexture(dataItem);
 	glUniform1iARB(dataItem->elevationShaderUniforms[0],0); // Tell the shader that the depth texture is in texture unit 0
 	
 	/* Upload the base plane equation in depth image space: */
@@ -33,6 +33,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "Types.h"
 
+/* Forward declarations: */
+class TileChangeMask;
+
 class DepthImageRenderer:public GLObject
 	{
 	/* Embedded classes: */
@@ -73,6 +76,11 @@ class DepthImageRenderer:public GLObject
 	/* Transient state: */
 	Kinect::FrameBuffer depthImage; // The most recent float-pixel depth image
 	unsigned int depthImageVersion; // Version number of the depth image
+	const TileChangeMask* depthImageChanges; // Tile change mask carried by the depth image, or null
+	bool depthImageIncremental; // Flag whether the depth image's tile change mask is relative to the previous depth image
+	
+	/* Private methods: */
+	void updateDepthTexture(DataItem* dataItem) const; // Uploads the depth image into the currently bound depth texture if the texture is outdated
 	
 	/* Constructors and destructors: */
 	public:
@@ -102,6 +110,7 @@ class DepthImageRenderer:public GLObject
 	void setIntrinsics(const Kinect::FrameSource::IntrinsicParameters& ips); // Sets a new depth unprojection matrix and, if present, 2D lens distortion parameters
 	void setBasePlane(const Plane& newBasePlane); // Sets a new base plane for elevation rendering
 	void setDepthImage(const Kinect::FrameBuffer& newDepthImage); // Sets a new depth image for subsequent surface rendering
+	void setIncrementalDepthImage(const Kinect::FrameBuffer& newDepthImage); // Ditto, for a depth image carrying a tile change mask; only changed tiles are uploaded into the depth texture if the new image directly follows the previous one
 	Scalar intersectLine(const Point& p0,const Point& p1,Scalar elevationMin,Scalar elevationMax) const; // Intersects a line segment with the current depth image in camera space; returns intersection point's parameter along line
 	unsigned int getDepthImageVersion(void) const // Returns the version number of the current depth image
 		{
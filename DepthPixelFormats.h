@@ -0,0 +1,123 @@
+/***********************************************************************
+DepthPixelFormats - Policy classes describing the pixel types, valid
+value ranges, and temporal filter accumulator types of the raw depth
+frames produced by different kinds of 3D cameras.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef DEPTHPIXELFORMATS_INCLUDED
+#define DEPTHPIXELFORMATS_INCLUDED
+
+#include <float.h>
+
+/***********************************************************************
+Each policy class defines the type of raw depth pixels, the interval of
+raw depth values that can be valid, where all other values including the
+camera's marker for invalid pixels are rejected by the frame filter's
+per-pixel validity test, the type of samples in the frame filter's
+averaging buffer and the sample marking empty slots, and the types of
+the running sums of samples and squared samples, which must represent
+the sums of a full averaging buffer exactly.
+***********************************************************************/
+
+class KinectDepthPixels // 11-bit raw disparity values from first-generation Kinect cameras, where 2047 marks invalid pixels
+	{
+	/* Embedded classes: */
+	public:
+	typedef unsigned short Pixel; // Type of raw depth pixels
+	typedef unsigned short Sample; // Type of samples in the averaging buffer
+	typedef unsigned int Sum; // Type of running sums of samples
+	typedef unsigned int SumSq; // Type of running sums of squared samples; the stability test's products wrap around, but remain exact for up to 31 averaging slots
+
+	/* Methods: */
+	static const char* getName(void) // Returns the pixel format's name
+		{
+		return "Kinect";
+		}
+	static Pixel getMinValid(void) // Returns the smallest raw depth value that can be valid
+		{
+		return 0U;
+		}
+	static Pixel getMaxValid(void) // Returns the largest raw depth value that can be valid
+		{
+		return 2046U;
+		}
+	static Sample getInvalidSample(void) // Returns the sample marking an empty averaging buffer slot
+		{
+		return 2048U;
+		}
+	};
+
+class MillimeterDepthPixels // 16-bit depth values in millimeters, where 0 marks invalid pixels
+	{
+	/* Embedded classes: */
+	public:
+	typedef unsigned short Pixel;
+	typedef unsigned short Sample;
+	typedef unsigned int Sum;
+	typedef unsigned long long SumSq; // Squares of 16-bit samples need 32 bits, and their sums need more
+
+	/* Methods: */
+	static const char* getName(void)
+		{
+		return "Millimeter";
+		}
+	static Pixel getMinValid(void)
+		{
+		return 1U;
+		}
+	static Pixel getMaxValid(void)
+		{
+		return 65535U;
+		}
+	static Sample getInvalidSample(void)
+		{
+		return 0U;
+		}
+	};
+
+class FloatDepthPixels // 32-bit floating-point depth values, where zero, negative, infinite, or NaN values mark invalid pixels
+	{
+	/* Embedded classes: */
+	public:
+	typedef float Pixel;
+	typedef float Sample;
+	typedef double Sum; // Sums and squares of single-precision samples are exact or nearly exact in double precision
+	typedef double SumSq;
+
+	/* Methods: */
+	static const char* getName(void)
+		{
+		return "Float";
+		}
+	static Pixel getMinValid(void)
+		{
+		return FLT_MIN;
+		}
+	static Pixel getMaxValid(void)
+		{
+		return FLT_MAX;
+		}
+	static Sample getInvalidSample(void)
+		{
+		return -1.0f;
+		}
+	};
+
+#endif
@@ -0,0 +1,173 @@
+/***********************************************************************
+DepthPreprocessor - Class to apply per-pixel depth correction and
+validity and foreground tests to each raw depth frame once, and share
+the results read-only between all consumers of raw depth frames.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "DepthPreprocessor.h"
+
+#include <Misc/FunctionCalls.h>
+#include <Geometry/HVector.h>
+#include <Geometry/Matrix.h>
+
+namespace {
+
+/****************
+Helper constants:
+****************/
+
+const unsigned int inputQueueCapacity=2; // Maximum number of raw depth frames waiting for the background preprocessing thread; older frames are dropped to bound latency
+
+}
+
+/**********************************
+Methods of class DepthPreprocessor:
+**********************************/
+
+void* DepthPreprocessor::preprocessingThreadMethod(void)
+	{
+	/* Process raw depth frames until the input queue is shut down: */
+	Kinect::FrameBuffer rawFrame;
+	while(inputFrames.waitAndPop(rawFrame))
+		{
+		/* Preprocess the new frame into fresh buffers, as consumers may still hold on to the previous ones: */
+		Frame frame;
+		preprocessFrame(rawFrame,frame);
+		
+		/* Pass the preprocessed frame to all consumers: */
+		for(std::vector<FrameFunction*>::iterator cIt=consumers.begin();cIt!=consumers.end();++cIt)
+			(**cIt)(frame);
+		}
+	
+	return 0;
+	}
+
+DepthPreprocessor::DepthPreprocessor(const unsigned int sSize[2],const DepthPreprocessor::PixelDepthCorrection* sPixelDepthCorrection,DepthPreprocessor::RawDepth minValidDepth,DepthPreprocessor::RawDepth maxValidDepth)
+	:pixelDepthCorrection(sPixelDepthCorrection),
+	 validDepthBounds(sSize,minValidDepth,maxValidDepth),
+	 maxFgDepth(0x07ffU-1U),
+	 inputFrames(inputQueueCapacity)
+	{
+	/* Copy the frame size: */
+	for(int i=0;i<2;++i)
+		size[i]=sSize[i];
+	
+	/* Start the preprocessing thread: */
+	preprocessingThread.start(this,&DepthPreprocessor::preprocessingThreadMethod);
+	}
+
+DepthPreprocessor::~DepthPreprocessor(void)
+	{
+	/* Shut down the preprocessing thread: */
+	inputFrames.shutDown();
+	preprocessingThread.join();
+	
+	/* Release all consumers: */
+	for(std::vector<FrameFunction*>::iterator cIt=consumers.begin();cIt!=consumers.end();++cIt)
+		delete *cIt;
+	}
+
+void DepthPreprocessor::setValidDepthPlanes(const float minPlane[4],const float maxPlane[4])
+	{
+	/* Update the per-pixel intervals of valid raw depth values while no frame is being preprocessed: */
+	Threads::Mutex::Lock validDepthBoundsLock(validDepthBoundsMutex);
+	validDepthBounds.setPlanes(pixelDepthCorrection,minPlane,maxPlane);
+	}
+
+void DepthPreprocessor::setValidElevationInterval(const PTransform& depthProjection,const Plane& basePlane,double newMinElevation,double newMaxElevation)
+	{
+	/* Calculate the equations of the minimum and maximum elevation planes in camera space: */
+	PTransform::HVector minPlaneCc(basePlane.getNormal());
+	minPlaneCc[3]=-(basePlane.getOffset()+newMinElevation*basePlane.getNormal().mag());
+	PTransform::HVector maxPlaneCc(basePlane.getNormal());
+	maxPlaneCc[3]=-(basePlane.getOffset()+newMaxElevation*basePlane.getNormal().mag());
+	
+	/* Transform the plane equations to depth image space and flip and swap the min and max planes because elevation increases opposite to raw depth: */
+	float minPlane[4],maxPlane[4];
+	PTransform::HVector minPlaneDic(depthProjection.getMatrix().transposeMultiply(minPlaneCc));
+	double minPlaneScale=-1.0/Geometry::mag(minPlaneDic.toVector());
+	for(int i=0;i<4;++i)
+		maxPlane[i]=float(minPlaneDic[i]*minPlaneScale);
+	PTransform::HVector maxPlaneDic(depthProjection.getMatrix().transposeMultiply(maxPlaneCc));
+	double maxPlaneScale=-1.0/Geometry::mag(maxPlaneDic.toVector());
+	for(int i=0;i<4;++i)
+		minPlane[i]=float(maxPlaneDic[i]*maxPlaneScale);
+	
+	/* Update the per-pixel intervals of valid raw depth values: */
+	setValidDepthPlanes(minPlane,maxPlane);
+	}
+
+void DepthPreprocessor::setMaxFgDepth(DepthPreprocessor::RawDepth newMaxFgDepth)
+	{
+	maxFgDepth=newMaxFgDepth;
+	}
+
+void DepthPreprocessor::addConsumer(DepthPreprocessor::FrameFunction* newConsumer)
+	{
+	consumers.push_back(newConsumer);
+	}
+
+void DepthPreprocessor::preprocessFrame(const Kinect::FrameBuffer& rawFrame,DepthPreprocessor::Frame& frame) const
+	{
+	/* Share the raw frame and create the result frames: */
+	size_t numPixels=size_t(size[1])*size_t(size[0]);
+	frame.rawDepth=rawFrame;
+	frame.correctedDepth=Kinect::FrameBuffer(size[0],size[1],numPixels*sizeof(float));
+	frame.validMask=Kinect::FrameBuffer(size[0],size[1],numPixels*sizeof(unsigned char));
+	frame.foregroundMask=Kinect::FrameBuffer(size[0],size[1],numPixels*sizeof(unsigned char));
+	
+	/* Record the maximum foreground depth so that consumers can tell whether the foreground mask is current: */
+	RawDepth fgDepth=maxFgDepth;
+	frame.maxFgDepth=fgDepth;
+	
+	/* Correct, validate, and classify all pixels in a single pass over the raw frame: */
+	Threads::Mutex::Lock validDepthBoundsLock(validDepthBoundsMutex);
+	const RawDepth* rPtr=rawFrame.getData<RawDepth>();
+	const RawDepth* minDPtr=validDepthBounds.getMinDepths();
+	const RawDepth* maxDPtr=validDepthBounds.getMaxDepths();
+	float* cPtr=frame.correctedDepth.getData<float>();
+	unsigned char* vPtr=frame.validMask.getData<unsigned char>();
+	unsigned char* fPtr=frame.foregroundMask.getData<unsigned char>();
+	if(pixelDepthCorrection!=0)
+		{
+		const PixelDepthCorrection* pdcPtr=pixelDepthCorrection;
+		for(size_t i=0;i<numPixels;++i)
+			{
+			cPtr[i]=pdcPtr[i].correct(float(rPtr[i]));
+			vPtr[i]=rPtr[i]>=minDPtr[i]&&rPtr[i]<=maxDPtr[i]?1U:0U;
+			fPtr[i]=rPtr[i]<=fgDepth?1U:0U;
+			}
+		}
+	else
+		{
+		for(size_t i=0;i<numPixels;++i)
+			{
+			cPtr[i]=float(rPtr[i]);
+			vPtr[i]=rPtr[i]>=minDPtr[i]&&rPtr[i]<=maxDPtr[i]?1U:0U;
+			fPtr[i]=rPtr[i]<=fgDepth?1U:0U;
+			}
+		}
+	}
+
+void DepthPreprocessor::receiveRawFrame(const Kinect::FrameBuffer& newFrame)
+	{
+	/* Queue the new frame for the background thread: */
+	inputFrames.push(newFrame);
+	}
@@ -0,0 +1,99 @@
+/***********************************************************************
+DepthPreprocessor - Class to apply per-pixel depth correction and
+validity and foreground tests to each raw depth frame once, and share
+the results read-only between all consumers of raw depth frames.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef DEPTHPREPROCESSOR_INCLUDED
+#define DEPTHPREPROCESSOR_INCLUDED
+
+#include <vector>
+#include <Threads/Mutex.h>
+#include <Threads/Thread.h>
+#include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameSource.h>
+
+#include "Types.h"
+#include "ValidDepthBounds.h"
+#include "FrameRing.h"
+
+/* Forward declarations: */
+namespace Misc {
+template <class ParameterParam>
+class FunctionCall;
+}
+
+class DepthPreprocessor
+	{
+	/* Embedded classes: */
+	public:
+	typedef unsigned short RawDepth; // Data type for raw depth values
+	typedef Kinect::FrameSource::DepthCorrection::PixelCorrection PixelDepthCorrection; // Type for per-pixel depth correction factors
+	
+	struct Frame // Structure holding the results of preprocessing one raw depth frame; consumers must treat all buffers as read-only
+		{
+		/* Elements: */
+		public:
+		Kinect::FrameBuffer rawDepth; // The raw depth frame
+		Kinect::FrameBuffer correctedDepth; // Frame of per-pixel depth-corrected depth values as floats
+		Kinect::FrameBuffer validMask; // Frame of bytes, 1 where the raw depth value is between the valid depth planes, 0 elsewhere
+		Kinect::FrameBuffer foregroundMask; // Frame of bytes, 1 where the raw depth value is at most the maximum foreground depth, 0 elsewhere
+		RawDepth maxFgDepth; // Maximum foreground depth with which the foreground mask was calculated
+		};
+	
+	typedef Misc::FunctionCall<const Frame&> FrameFunction; // Type for functions called when a new raw depth frame has been preprocessed
+	
+	/* Elements: */
+	private:
+	unsigned int size[2]; // Width and height of raw depth frames
+	const PixelDepthCorrection* pixelDepthCorrection; // Buffer of per-pixel depth correction coefficients, or null to use raw depth values
+	mutable Threads::Mutex validDepthBoundsMutex; // Mutex serializing updates of the per-pixel intervals of valid raw depth values with preprocessing frames
+	ValidDepthBounds<RawDepth> validDepthBounds; // Per-pixel intervals of raw depth values between the lower and upper valid depth planes
+	volatile RawDepth maxFgDepth; // Maximum raw depth value for foreground pixels
+	FrameRing inputFrames; // Lock-free queue handing raw depth frames from the camera's streaming thread to the preprocessing thread
+	Threads::Thread preprocessingThread; // The background preprocessing thread
+	std::vector<FrameFunction*> consumers; // List of functions receiving each preprocessed frame
+	
+	/* Private methods: */
+	void* preprocessingThreadMethod(void); // Method for the background preprocessing thread
+	
+	/* Constructors and destructors: */
+	public:
+	DepthPreprocessor(const unsigned int sSize[2],const PixelDepthCorrection* sPixelDepthCorrection,RawDepth minValidDepth,RawDepth maxValidDepth); // Creates a preprocessor for raw depth frames of the given size that accepts all raw depth values in the given interval as valid
+	private:
+	DepthPreprocessor(const DepthPreprocessor& source); // Prohibit copy constructor
+	DepthPreprocessor& operator=(const DepthPreprocessor& source); // Prohibit assignment operator
+	public:
+	~DepthPreprocessor(void);
+	
+	/* Methods: */
+	void setValidDepthPlanes(const float minPlane[4],const float maxPlane[4]); // Sets the lower and upper valid depth planes in depth image space
+	void setValidElevationInterval(const PTransform& depthProjection,const Plane& basePlane,double newMinElevation,double newMaxElevation); // Sets the valid depth planes from the given elevation range relative to the given base plane in camera space
+	RawDepth getMaxFgDepth(void) const // Returns the maximum raw depth value for foreground pixels
+		{
+		return maxFgDepth;
+		}
+	void setMaxFgDepth(RawDepth newMaxFgDepth); // Sets the maximum raw depth value for foreground pixels, which takes effect with the next preprocessed frame
+	void addConsumer(FrameFunction* newConsumer); // Adds a function receiving each preprocessed frame on the preprocessing thread; adopts given functor object; must be called before the first frame is received
+	void preprocessFrame(const Kinect::FrameBuffer& rawFrame,Frame& frame) const; // Synchronously preprocesses the given raw depth frame into the given result structure
+	void receiveRawFrame(const Kinect::FrameBuffer& newFrame); // Called to receive a new raw depth frame; never blocks, and drops the oldest pending frame if the preprocessing thread falls behind
+	};
+
+#endif
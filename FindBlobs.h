@@ -2,6 +2,7 @@
 FindBlobs - Helper function to extract all eight-connected blobs of
 pixels from a frame that match an arbitrary property.
 Copyright (c) 2010-2013 Oliver Kreylos
+Copyright (c) 2026 the SARndbox contributors
 
 This file is part of the Augmented Reality Sandbox (SARndbox).
 
@@ -69,9 +70,77 @@ class PixelProperty // Class to check whether a pixel should be considered part
 		}
 	};
 
+template <class PixelParam>
+class BlobFinder // Class to extract connected blobs from a sequence of frames, reusing its internal storage between frames
+	{
+	/* Embedded classes: */
+	public:
+	typedef PixelParam Pixel; // Underlying pixel type
+	
+	private:
+	struct Run // Structure for a horizontal run of property pixels; runs are nodes in a union-find forest
+		{
+		/* Elements: */
+		public:
+		unsigned int x1,x2; // Half-open interval of pixel columns covered by the run
+		unsigned int parent,rank; // Index of the run's parent in the union-find forest and upper bound on the height of its sub-tree
+		};
+	
+	struct Accumulator // Structure to accumulate the bounding box, centroid, and additional property of a union-find sub-tree
+		{
+		/* Elements: */
+		public:
+		unsigned int min[2],max[2]; // Bounding box of the sub-tree's runs
+		double sumX,sumY,sumW; // Weighted sums of the sub-tree's pixel positions, and number of pixels
+		BlobProperty<Pixel> blobProperty; // Additional accumulated property of the sub-tree's pixels
+		
+		/* Methods: */
+		void merge(const Accumulator& other); // Merges another sub-tree's accumulator into this one
+		};
+	
+	/* Elements: */
+	unsigned int maskSize[2]; // Frame size for which the property mask was allocated
+	unsigned int maskStride; // Distance between rows in the property mask, a multiple of eight with at least eight padding bytes per row
+	std::vector<unsigned char> mask; // Frame of bytes, 1 for pixels that have the property, 0 for those that don't and for padding bytes
+	std::vector<Run> runs; // Runs of all rows processed so far, in row-major order
+	std::vector<Accumulator> accumulators; // Accumulators for all runs, only valid for the current roots of the union-find forest
+	
+	/* Private methods: */
+	unsigned int findRoot(unsigned int run) // Returns the root of the given run's union-find tree, and points all runs on the path directly to it
+		{
+		unsigned int root=run;
+		while(runs[root].parent!=root)
+			root=runs[root].parent;
+		while(runs[run].parent!=root)
+			{
+			unsigned int next=runs[run].parent;
+			runs[run].parent=root;
+			run=next;
+			}
+		return root;
+		}
+	void unite(unsigned int run1,unsigned int run2); // Merges the union-find trees of the two given runs
+	
+	/* Constructors and destructors: */
+	public:
+	BlobFinder(void)
+		:maskStride(0)
+		{
+		for(int i=0;i<2;++i)
+			maskSize[i]=0;
+		}
+	
+	/* Methods: */
+	template <class PixelPropertyParam>
+	void findBlobs(const unsigned int size[2],const Pixel* frame,const PixelPropertyParam& property,std::vector<Blob<Pixel> >& blobs); // Replaces the contents of the given list with all connected blobs from the given frame whose pixels have the given property
+	};
+
 template <class PixelParam,class PixelPropertyParam>
 std::vector<Blob<PixelParam> > findBlobs(const unsigned int size[2],const PixelParam* frame,const PixelPropertyParam& property); // Extracts all connected blobs from the given frame whose pixels have the given property
 
+template <class PixelParam,class PixelPropertyParam>
+std::vector<Blob<PixelParam> > findBlobsReference(const unsigned int size[2],const PixelParam* frame,const PixelPropertyParam& property); // Original per-pixel implementation of findBlobs, kept to validate and benchmark the blob finder against
+
 #ifndef FINDBLOBS_IMPLEMENTATION
 #include "FindBlobs.icpp"
 #endif
@@ -23,180 +23,1781 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "FrameFilter.h"
 
+#include <stddef.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <time.h>
+#if FRAMEFILTER_USE_X86_KERNELS
+#include <immintrin.h>
+#endif
+#include <algorithm>
 #include <Misc/FunctionCalls.h>
+#include <Math/Math.h>
+#include <Math/Constants.h>
 #include <Geometry/HVector.h>
 #include <Geometry/Matrix.h>
 
+namespace {
+
+/****************
+Helper constants:
+****************/
+
+const unsigned int spatialTileWidth=1024; // Width of the column tiles processed by the spatial filter's vertical pass; 2*radius+1 source rows of one tile should fit into L2 cache; must be a multiple of the change mask's tile size
+const unsigned int inputQueueCapacity=2; // Maximum number of raw depth frames waiting for the background filtering thread; older frames are dropped to bound latency
+const unsigned int motionChunkSize=16; // Number of pixels tested together for motion; must be a power of two
+const unsigned int holeFillMinBandRows=16; // Minimum height of bands of hole filling pyramid levels, to avoid waking up worker threads for tiny levels
+
+/****************
+Helper functions:
+****************/
+
+inline double getMonotonicTime(void) // Returns the current monotonic time in seconds
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return double(ts.tv_sec)+double(ts.tv_nsec)*1.0e-9;
+	}
+
+inline double getGaussianWeight(unsigned int tap,unsigned int radius) // Returns the unnormalized weight of the given tap of a Gaussian kernel whose standard deviation is half its radius
+	{
+	if(radius==0)
+		return 1.0;
+	double d=double(int(tap)-int(radius));
+	return Math::exp(-2.0*d*d/double(radius*radius));
+	}
+
+/***********************************************************************
+Pruned sorting networks selecting the median of 3x3 and 5x5 pixel
+neighborhoods stored in row-major order. The networks only retain the
+comparators that influence the center tap, which holds the median at the
+end. They are templates so that the same networks run on scalars and on
+the x86 kernels' SIMD vectors, where each comparator compiles to a pair
+of minimum and maximum instructions.
+***********************************************************************/
+
+template <class ValueParam>
+inline void sortTaps(ValueParam& a,ValueParam& b) // Moves the smaller of the two taps into the first and the larger into the second tap
+	{
+	ValueParam min=a<b?a:b;
+	ValueParam max=b<a?a:b;
+	a=min;
+	b=max;
+	}
+
+template <class ValueParam>
+inline ValueParam selectMedian3x3(ValueParam p[9]) // Returns the median of a 3x3 neighborhood using 19 comparators
+	{
+	sortTaps(p[1],p[2]);sortTaps(p[4],p[5]);sortTaps(p[7],p[8]);sortTaps(p[0],p[1]);sortTaps(p[3],p[4]);
+	sortTaps(p[6],p[7]);sortTaps(p[1],p[2]);sortTaps(p[4],p[5]);sortTaps(p[7],p[8]);sortTaps(p[0],p[3]);
+	sortTaps(p[5],p[8]);sortTaps(p[4],p[7]);sortTaps(p[3],p[6]);sortTaps(p[1],p[4]);sortTaps(p[2],p[5]);
+	sortTaps(p[4],p[7]);sortTaps(p[4],p[2]);sortTaps(p[6],p[4]);sortTaps(p[4],p[2]);
+	return p[4];
+	}
+
+template <class ValueParam>
+inline ValueParam selectMedian5x5(ValueParam p[25]) // Returns the median of a 5x5 neighborhood using 99 comparators
+	{
+	sortTaps(p[0],p[1]);sortTaps(p[3],p[4]);sortTaps(p[2],p[4]);sortTaps(p[2],p[3]);sortTaps(p[6],p[7]);
+	sortTaps(p[5],p[7]);sortTaps(p[5],p[6]);sortTaps(p[9],p[10]);sortTaps(p[8],p[10]);sortTaps(p[8],p[9]);
+	sortTaps(p[12],p[13]);sortTaps(p[11],p[13]);sortTaps(p[11],p[12]);sortTaps(p[15],p[16]);sortTaps(p[14],p[16]);
+	sortTaps(p[14],p[15]);sortTaps(p[18],p[19]);sortTaps(p[17],p[19]);sortTaps(p[17],p[18]);sortTaps(p[21],p[22]);
+	sortTaps(p[20],p[22]);sortTaps(p[20],p[21]);sortTaps(p[23],p[24]);sortTaps(p[2],p[5]);sortTaps(p[3],p[6]);
+	sortTaps(p[0],p[6]);sortTaps(p[0],p[3]);sortTaps(p[4],p[7]);sortTaps(p[1],p[7]);sortTaps(p[1],p[4]);
+	sortTaps(p[11],p[14]);sortTaps(p[8],p[14]);sortTaps(p[8],p[11]);sortTaps(p[12],p[15]);sortTaps(p[9],p[15]);
+	sortTaps(p[9],p[12]);sortTaps(p[13],p[16]);sortTaps(p[10],p[16]);sortTaps(p[10],p[13]);sortTaps(p[20],p[23]);
+	sortTaps(p[17],p[23]);sortTaps(p[17],p[20]);sortTaps(p[21],p[24]);sortTaps(p[18],p[24]);sortTaps(p[18],p[21]);
+	sortTaps(p[19],p[22]);sortTaps(p[8],p[17]);sortTaps(p[9],p[18]);sortTaps(p[0],p[18]);sortTaps(p[0],p[9]);
+	sortTaps(p[10],p[19]);sortTaps(p[1],p[19]);sortTaps(p[1],p[10]);sortTaps(p[11],p[20]);sortTaps(p[2],p[20]);
+	sortTaps(p[2],p[11]);sortTaps(p[12],p[21]);sortTaps(p[3],p[21]);sortTaps(p[3],p[12]);sortTaps(p[13],p[22]);
+	sortTaps(p[4],p[22]);sortTaps(p[4],p[13]);sortTaps(p[14],p[23]);sortTaps(p[5],p[23]);sortTaps(p[5],p[14]);
+	sortTaps(p[15],p[24]);sortTaps(p[6],p[24]);sortTaps(p[6],p[15]);sortTaps(p[7],p[16]);sortTaps(p[7],p[19]);
+	sortTaps(p[13],p[21]);sortTaps(p[15],p[23]);sortTaps(p[7],p[13]);sortTaps(p[7],p[15]);sortTaps(p[1],p[9]);
+	sortTaps(p[3],p[11]);sortTaps(p[5],p[17]);sortTaps(p[11],p[17]);sortTaps(p[9],p[17]);sortTaps(p[4],p[10]);
+	sortTaps(p[6],p[12]);sortTaps(p[7],p[14]);sortTaps(p[4],p[6]);sortTaps(p[4],p[7]);sortTaps(p[12],p[14]);
+	sortTaps(p[10],p[14]);sortTaps(p[6],p[7]);sortTaps(p[10],p[12]);sortTaps(p[6],p[10]);sortTaps(p[6],p[17]);
+	sortTaps(p[12],p[17]);sortTaps(p[7],p[17]);sortTaps(p[7],p[10]);sortTaps(p[12],p[18]);sortTaps(p[7],p[12]);
+	sortTaps(p[10],p[18]);sortTaps(p[12],p[20]);sortTaps(p[10],p[20]);sortTaps(p[10],p[12]);
+	return p[12];
+	}
+
+#if FRAMEFILTER_USE_X86_KERNELS
+
+__attribute__((target("avx2")))
+inline __m256i loadValidDepths(const unsigned short* dPtr,const unsigned short* minDPtr,const unsigned short* maxDPtr,__m256& depths) // Loads eight integer raw depth values as floats, and returns a mask of the values inside the given per-pixel intervals of valid raw depth values
+	{
+	/* Load the raw depth values: */
+	__m256i values=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(dPtr)));
+	depths=_mm256_cvtepi32_ps(values);
+	
+	/* Check the values against the intervals using unsigned comparisons: */
+	__m256i minD=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(minDPtr)));
+	__m256i maxD=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(maxDPtr)));
+	return _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(values,minD),values),_mm256_cmpeq_epi32(_mm256_min_epu32(values,maxD),values));
+	}
+
+__attribute__((target("avx2")))
+inline __m256i loadValidDepths(const float* dPtr,const float* minDPtr,const float* maxDPtr,__m256& depths) // Ditto, for floating-point raw depth values; NaN values fail the ordered comparisons
+	{
+	depths=_mm256_loadu_ps(dPtr);
+	return _mm256_castps_si256(_mm256_and_ps(_mm256_cmp_ps(depths,_mm256_loadu_ps(minDPtr),_CMP_GE_OQ),_mm256_cmp_ps(depths,_mm256_loadu_ps(maxDPtr),_CMP_LE_OQ)));
+	}
+
+#endif
+
+}
+
 /****************************
 Methods of class FrameFilter:
 ****************************/
 
-void* FrameFilter::filterThreadMethod(void)
+template <>
+const ValidDepthBounds<unsigned short>& FrameFilter::getValidDepthBounds<unsigned short>(void) const
+	{
+	return *integerDepthBounds;
+	}
+
+template <>
+const ValidDepthBounds<float>& FrameFilter::getValidDepthBounds<float>(void) const
+	{
+	return *floatDepthBounds;
+	}
+
+template <class PixelFormatParam>
+void FrameFilter::initPixelFormat(void)
+	{
+	typedef typename PixelFormatParam::Sample Sample;
+	typedef typename PixelFormatParam::Sum Sum;
+	typedef typename PixelFormatParam::SumSq SumSq;
+	
+	pixelSize=sizeof(typename PixelFormatParam::Pixel);
+	
+	/* Create current and pending per-pixel intervals of valid raw depth values that accept all raw depth values that can be valid: */
+	if(pixelFormat==FLOAT_DEPTH)
+		{
+		floatDepthBounds=new ValidDepthBounds<float>(size,float(PixelFormatParam::getMinValid()),float(PixelFormatParam::getMaxValid()));
+		newFloatDepthBounds=new ValidDepthBounds<float>(size,float(PixelFormatParam::getMinValid()),float(PixelFormatParam::getMaxValid()));
+		}
+	else
+		{
+		integerDepthBounds=new ValidDepthBounds<unsigned short>(size,(unsigned short)(PixelFormatParam::getMinValid()),(unsigned short)(PixelFormatParam::getMaxValid()));
+		newIntegerDepthBounds=new ValidDepthBounds<unsigned short>(size,(unsigned short)(PixelFormatParam::getMinValid()),(unsigned short)(PixelFormatParam::getMaxValid()));
+		}
+	
+	size_t numPixels=size_t(size[1])*size_t(size[0]);
+	if(temporalFilterType==AVERAGING_BUFFER)
+		{
+		/* Initialize the averaging buffer: */
+		averagingBuffer=new unsigned char[numAveragingSlots*numPixels*sizeof(Sample)];
+		Sample* abPtr=reinterpret_cast<Sample*>(averagingBuffer);
+		for(size_t i=0;i<numAveragingSlots*numPixels;++i,++abPtr)
+			*abPtr=PixelFormatParam::getInvalidSample(); // Mark sample as invalid
+		
+		/* Initialize the statistics buffer as three consecutive planes of sums of squares, sums, and sample counts, ordered by decreasing size to keep all planes aligned: */
+		statBuffer=new unsigned char[numPixels*(sizeof(SumSq)+sizeof(Sum)+sizeof(unsigned int))];
+		SumSq* ssPtr=reinterpret_cast<SumSq*>(statBuffer);
+		for(size_t i=0;i<numPixels;++i)
+			ssPtr[i]=SumSq(0);
+		Sum* sPtr=reinterpret_cast<Sum*>(ssPtr+numPixels);
+		for(size_t i=0;i<numPixels;++i)
+			sPtr[i]=Sum(0);
+		numSamplesBuffer=reinterpret_cast<unsigned int*>(sPtr+numPixels);
+		for(size_t i=0;i<numPixels;++i)
+			numSamplesBuffer[i]=0;
+		sumBuffer=sPtr;
+		sumSqBuffer=ssPtr;
+		}
+	else
+		{
+		/* Initialize the statistics buffer as a single plane of sample counts: */
+		statBuffer=new unsigned char[numPixels*sizeof(unsigned int)];
+		numSamplesBuffer=reinterpret_cast<unsigned int*>(statBuffer);
+		for(size_t i=0;i<numPixels;++i)
+			numSamplesBuffer[i]=0;
+		
+		/* Initialize the estimate buffer as two consecutive planes of means and variances: */
+		estimateBuffer=new float[numPixels*2];
+		for(size_t i=0;i<numPixels*2;++i)
+			estimateBuffer[i]=0.0f;
+		meanBuffer=estimateBuffer;
+		varianceBuffer=meanBuffer+numPixels;
+		
+		/* Calculate the estimator's gains, which yield the exact mean and variance of all samples until the gain drops to that of an exponential moving average with the same center of mass as the averaging buffer: */
+		gainTable=new float[numAveragingSlots+1];
+		gainTable[0]=1.0f;
+		float minGain=2.0f/float(numAveragingSlots+1);
+		for(unsigned int i=1;i<=numAveragingSlots;++i)
+			gainTable[i]=1.0f/float(i)>minGain?1.0f/float(i):minGain;
+		}
+	}
+
+void FrameFilter::setValidDepthPlanes(const float minPlane[4],const float maxPlane[4])
+	{
+	/* Calculate the pending per-pixel intervals of valid raw depth values of the pixel format's type, which no filter kernel reads: */
+	Threads::Mutex::Lock newDepthBoundsLock(newDepthBoundsMutex);
+	if(newFloatDepthBounds!=0)
+		newFloatDepthBounds->setPlanes(pixelDepthCorrection,minPlane,maxPlane);
+	else
+		newIntegerDepthBounds->setPlanes(pixelDepthCorrection,minPlane,maxPlane);
+	
+	/* Swap the new intervals in before the next frame is filtered: */
+	__atomic_store_n(&newDepthBoundsReady,true,__ATOMIC_RELEASE);
+	}
+
+template <class PixelFormatParam>
+void FrameFilter::filterRowScalar(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr)
+	{
+	typedef typename PixelFormatParam::Pixel Pixel;
+	typedef typename PixelFormatParam::Sample Sample;
+	typedef typename PixelFormatParam::Sum Sum;
+	typedef typename PixelFormatParam::SumSq SumSq;
+	
+	/* Get pointers to the first processed pixel in all buffers: */
+	ptrdiff_t rowOffset=ptrdiff_t(y)*ptrdiff_t(size[0])+ptrdiff_t(xStart);
+	const Pixel* ifPtr=static_cast<const Pixel*>(ifRowPtr)+xStart;
+	Sample* abPtr=getAveragingSlot<PixelFormatParam>(averagingSlotIndex)+rowOffset;
+	unsigned int* nsPtr=numSamplesBuffer+rowOffset;
+	Sum* sPtr=getSumBuffer<PixelFormatParam>()+rowOffset;
+	SumSq* ssPtr=getSumSqBuffer<PixelFormatParam>()+rowOffset;
+	float* ofPtr=validBuffer+rowOffset;
+	float* nofPtr=nofRowPtr+xStart;
+	const PixelDepthCorrection* pdcPtr=pixelDepthCorrection+rowOffset;
+	const Pixel* minDPtr=getValidDepthBounds<Pixel>().getMinDepths()+rowOffset;
+	const Pixel* maxDPtr=getValidDepthBounds<Pixel>().getMaxDepths()+rowOffset;
+	const Sample invalid=PixelFormatParam::getInvalidSample();
+	
+	for(unsigned int x=xStart;x<size[0];++x,++ifPtr,++pdcPtr,++minDPtr,++maxDPtr,++abPtr,++nsPtr,++sPtr,++ssPtr,++ofPtr,++nofPtr)
+		{
+		Sample oldVal=*abPtr;
+		Pixel newVal=*ifPtr;
+		
+		/* Retrieve the pixel's statistics: */
+		unsigned int numSamples=*nsPtr;
+		Sum sum=*sPtr;
+		SumSq sumSq=*ssPtr;
+		
+		/* Check the new value against the pixel's interval of valid raw depth values: */
+		if(newVal>=*minDPtr&&newVal<=*maxDPtr)
+			{
+			/* Store the new input value: */
+			*abPtr=Sample(newVal);
+			
+			/* Update the pixel's statistics: */
+			++numSamples; // Number of valid samples
+			sum+=Sum(newVal); // Sum of valid samples
+			sumSq+=SumSq(newVal)*SumSq(newVal); // Sum of squares of valid samples
+			
+			/* Check if the previous value in the averaging buffer was valid: */
+			if(oldVal!=invalid)
+				{
+				--numSamples; // Number of valid samples
+				sum-=Sum(oldVal); // Sum of valid samples
+				sumSq-=SumSq(oldVal)*SumSq(oldVal); // Sum of squares of valid samples
+				}
+			}
+		else if(!retainValids)
+			{
+			/* Store an invalid input value: */
+			*abPtr=invalid;
+			
+			/* Check if the previous value in the averaging buffer was valid: */
+			if(oldVal!=invalid)
+				{
+				--numSamples; // Number of valid samples
+				sum-=Sum(oldVal); // Sum of valid samples
+				sumSq-=SumSq(oldVal)*SumSq(oldVal); // Sum of squares of valid samples
+				}
+			}
+		
+		/* Store the pixel's updated statistics: */
+		*nsPtr=numSamples;
+		*sPtr=sum;
+		*ssPtr=sumSq;
+		
+		/* Check if the pixel is considered "stable": */
+		if(numSamples>=minNumSamples&&sumSq*SumSq(numSamples)<=SumSq(maxVariance)*SumSq(numSamples)*SumSq(numSamples)+SumSq(sum)*SumSq(sum))
+			{
+			/* Check if the new depth-corrected running mean is outside the previous value's envelope: */
+			float newFiltered=pdcPtr->correct(float(sum)/float(numSamples));
+			if(Math::abs(newFiltered-*ofPtr)>=hysteresis)
+				{
+				/* Set the output pixel value to the depth-corrected running mean: */
+				*nofPtr=*ofPtr=newFiltered;
+				}
+			else
+				{
+				/* Leave the pixel at its previous value: */
+				*nofPtr=*ofPtr;
+				}
+			}
+		else if(retainValids)
+			{
+			/* Leave the pixel at its previous value: */
+			*nofPtr=*ofPtr;
+			}
+		else
+			{
+			/* Assign default value to instable pixels: */
+			*nofPtr=instableValue;
+			}
+		}
+	}
+
+#if FRAMEFILTER_USE_X86_KERNELS
+
+/***********************************************************************
+The vectorized kernels evaluate exactly the same sequence of IEEE
+single-precision operations as the scalar kernel, and emulate its
+wrapping unsigned integer arithmetic, to produce bit-identical results.
+This requires that the compiler does not contract multiplications and
+additions into fused multiply-adds, see makefile.
+***********************************************************************/
+
+__attribute__((target("sse4.1")))
+void FrameFilter::filterRowSSE41(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr)
+	{
+	/* Get pointers to the first processed pixel in all buffers: */
+	ptrdiff_t rowOffset=ptrdiff_t(y)*ptrdiff_t(size[0])+ptrdiff_t(xStart);
+	const RawDepth* ifPtr=static_cast<const RawDepth*>(ifRowPtr)+xStart;
+	RawDepth* abPtr=getAveragingSlot<KinectDepthPixels>(averagingSlotIndex)+rowOffset;
+	unsigned int* nsPtr=numSamplesBuffer+rowOffset;
+	unsigned int* sPtr=getSumBuffer<KinectDepthPixels>()+rowOffset;
+	unsigned int* ssPtr=getSumSqBuffer<KinectDepthPixels>()+rowOffset;
+	float* ofPtr=validBuffer+rowOffset;
+	float* nofPtr=nofRowPtr+xStart;
+	const float* pdcPtr=reinterpret_cast<const float*>(pixelDepthCorrection+rowOffset);
+	const RawDepth* minDPtr=getValidDepthBounds<RawDepth>().getMinDepths()+rowOffset;
+	const RawDepth* maxDPtr=getValidDepthBounds<RawDepth>().getMaxDepths()+rowOffset;
+	
+	/* Broadcast all filter parameters: */
+	const __m128 signMask=_mm_set1_ps(-0.0f);
+	const __m128i invalid=_mm_set1_epi32(2048);
+	const __m128i minN=_mm_set1_epi32(int(minNumSamples));
+	const __m128i maxVar=_mm_set1_epi32(int(maxVariance));
+	const __m128 hyst=_mm_set1_ps(hysteresis);
+	const __m128i writeInvalids=_mm_set1_epi32(retainValids?0:-1);
+	const __m128 instable=_mm_set1_ps(instableValue);
+	
+	/* Process groups of eight pixels as two groups of four: */
+	unsigned int x=xStart;
+	for(;x+8<=size[0];x+=8)
+		{
+		for(int group=0;group<2;++group,ifPtr+=4,pdcPtr+=8,minDPtr+=4,maxDPtr+=4,abPtr+=4,nsPtr+=4,sPtr+=4,ssPtr+=4,ofPtr+=4,nofPtr+=4)
+			{
+			/* Load the old and new raw depth values: */
+			__m128i oldVal=_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(abPtr)));
+			__m128i newVal=_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(ifPtr)));
+			
+			/* Check the new values against the pixels' intervals of valid raw depth values using unsigned comparisons: */
+			__m128i minD=_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(minDPtr)));
+			__m128i maxD=_mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(maxDPtr)));
+			__m128i valid=_mm_and_si128(_mm_cmpeq_epi32(_mm_max_epu32(newVal,minD),newVal),_mm_cmpeq_epi32(_mm_min_epu32(newVal,maxD),newVal));
+			
+			/* Load the pixels' depth correction coefficients: */
+			__m128 pdc0=_mm_loadu_ps(pdcPtr);
+			__m128 pdc1=_mm_loadu_ps(pdcPtr+4);
+			__m128 scale=_mm_shuffle_ps(pdc0,pdc1,_MM_SHUFFLE(2,0,2,0));
+			__m128 offset=_mm_shuffle_ps(pdc0,pdc1,_MM_SHUFFLE(3,1,3,1));
+			
+			/* Determine which averaging buffer slots are overwritten, and which old values are removed from the statistics: */
+			__m128i write=_mm_or_si128(valid,writeInvalids);
+			__m128i remove=_mm_andnot_si128(_mm_cmpeq_epi32(oldVal,invalid),write);
+			
+			/* Store the new averaging buffer values: */
+			__m128i newAb=_mm_blendv_epi8(oldVal,_mm_blendv_epi8(invalid,newVal,valid),write);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(abPtr),_mm_packus_epi32(newAb,newAb));
+			
+			/* Update the pixels' statistics; masks are -1 where set: */
+			__m128i count=_mm_loadu_si128(reinterpret_cast<const __m128i*>(nsPtr));
+			__m128i sum=_mm_loadu_si128(reinterpret_cast<const __m128i*>(sPtr));
+			__m128i sumSq=_mm_loadu_si128(reinterpret_cast<const __m128i*>(ssPtr));
+			count=_mm_add_epi32(_mm_sub_epi32(count,valid),remove);
+			sum=_mm_sub_epi32(_mm_add_epi32(sum,_mm_and_si128(newVal,valid)),_mm_and_si128(oldVal,remove));
+			sumSq=_mm_sub_epi32(_mm_add_epi32(sumSq,_mm_and_si128(_mm_mullo_epi32(newVal,newVal),valid)),_mm_and_si128(_mm_mullo_epi32(oldVal,oldVal),remove));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(nsPtr),count);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(sPtr),sum);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(ssPtr),sumSq);
+			
+			/* Check if the pixels are considered "stable" using unsigned comparisons: */
+			__m128i enough=_mm_cmpeq_epi32(_mm_max_epu32(count,minN),count);
+			__m128i lhs=_mm_mullo_epi32(sumSq,count);
+			__m128i rhs=_mm_add_epi32(_mm_mullo_epi32(_mm_mullo_epi32(maxVar,count),count),_mm_mullo_epi32(sum,sum));
+			__m128 stable=_mm_castsi128_ps(_mm_and_si128(enough,_mm_cmpeq_epi32(_mm_min_epu32(lhs,rhs),lhs)));
+			
+			/* Calculate the depth-corrected running means and check them against the previous values' envelopes: */
+			__m128 oldFiltered=_mm_loadu_ps(ofPtr);
+			__m128 newFiltered=_mm_add_ps(_mm_mul_ps(_mm_div_ps(_mm_cvtepi32_ps(sum),_mm_cvtepi32_ps(count)),scale),offset);
+			__m128 update=_mm_and_ps(stable,_mm_cmpge_ps(_mm_andnot_ps(signMask,_mm_sub_ps(newFiltered,oldFiltered)),hyst));
+			__m128 filtered=_mm_blendv_ps(oldFiltered,newFiltered,update);
+			_mm_storeu_ps(ofPtr,filtered);
+			
+			/* Assign output values; instable pixels retain their previous values or are reset to the default value: */
+			__m128 instableOut=_mm_blendv_ps(filtered,instable,_mm_castsi128_ps(writeInvalids));
+			_mm_storeu_ps(nofPtr,_mm_blendv_ps(instableOut,filtered,stable));
+			}
+		}
+	
+	/* Process the remaining pixels with scalar code: */
+	if(x<size[0])
+		filterRowScalar<KinectDepthPixels>(y,x,ifRowPtr,nofRowPtr);
+	}
+
+__attribute__((target("avx2")))
+void FrameFilter::filterRowAVX2(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr)
+	{
+	/* Get pointers to the first processed pixel in all buffers: */
+	ptrdiff_t rowOffset=ptrdiff_t(y)*ptrdiff_t(size[0])+ptrdiff_t(xStart);
+	const RawDepth* ifPtr=static_cast<const RawDepth*>(ifRowPtr)+xStart;
+	RawDepth* abPtr=getAveragingSlot<KinectDepthPixels>(averagingSlotIndex)+rowOffset;
+	unsigned int* nsPtr=numSamplesBuffer+rowOffset;
+	unsigned int* sPtr=getSumBuffer<KinectDepthPixels>()+rowOffset;
+	unsigned int* ssPtr=getSumSqBuffer<KinectDepthPixels>()+rowOffset;
+	float* ofPtr=validBuffer+rowOffset;
+	float* nofPtr=nofRowPtr+xStart;
+	const float* pdcPtr=reinterpret_cast<const float*>(pixelDepthCorrection+rowOffset);
+	const RawDepth* minDPtr=getValidDepthBounds<RawDepth>().getMinDepths()+rowOffset;
+	const RawDepth* maxDPtr=getValidDepthBounds<RawDepth>().getMaxDepths()+rowOffset;
+	
+	/* Broadcast all filter parameters: */
+	const __m256 signMask=_mm256_set1_ps(-0.0f);
+	const __m256i invalid=_mm256_set1_epi32(2048);
+	const __m256i minN=_mm256_set1_epi32(int(minNumSamples));
+	const __m256i maxVar=_mm256_set1_epi32(int(maxVariance));
+	const __m256 hyst=_mm256_set1_ps(hysteresis);
+	const __m256i writeInvalids=_mm256_set1_epi32(retainValids?0:-1);
+	const __m256 instable=_mm256_set1_ps(instableValue);
+	
+	/* Process groups of eight pixels: */
+	unsigned int x=xStart;
+	for(;x+8<=size[0];x+=8,ifPtr+=8,pdcPtr+=16,minDPtr+=8,maxDPtr+=8,abPtr+=8,nsPtr+=8,sPtr+=8,ssPtr+=8,ofPtr+=8,nofPtr+=8)
+		{
+		/* Load the old and new raw depth values: */
+		__m256i oldVal=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(abPtr)));
+		__m256i newVal=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ifPtr)));
+		
+		/* Check the new values against the pixels' intervals of valid raw depth values using unsigned comparisons: */
+		__m256i minD=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(minDPtr)));
+		__m256i maxD=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(maxDPtr)));
+		__m256i valid=_mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(newVal,minD),newVal),_mm256_cmpeq_epi32(_mm256_min_epu32(newVal,maxD),newVal));
+		
+		/* Load the pixels' depth correction coefficients; the in-lane shuffles leave the pixels in 0,1,4,5,2,3,6,7 order, which is fixed by a cross-lane permutation: */
+		__m256 pdc0=_mm256_loadu_ps(pdcPtr);
+		__m256 pdc1=_mm256_loadu_ps(pdcPtr+8);
+		__m256 scale=_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(pdc0,pdc1,_MM_SHUFFLE(2,0,2,0))),_MM_SHUFFLE(3,1,2,0)));
+		__m256 offset=_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(pdc0,pdc1,_MM_SHUFFLE(3,1,3,1))),_MM_SHUFFLE(3,1,2,0)));
+		
+		/* Determine which averaging buffer slots are overwritten, and which old values are removed from the statistics: */
+		__m256i write=_mm256_or_si256(valid,writeInvalids);
+		__m256i remove=_mm256_andnot_si256(_mm256_cmpeq_epi32(oldVal,invalid),write);
+		
+		/* Store the new averaging buffer values: */
+		__m256i newAb=_mm256_blendv_epi8(oldVal,_mm256_blendv_epi8(invalid,newVal,valid),write);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(abPtr),_mm_packus_epi32(_mm256_castsi256_si128(newAb),_mm256_extracti128_si256(newAb,1)));
+		
+		/* Update the pixels' statistics; masks are -1 where set: */
+		__m256i count=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(nsPtr));
+		__m256i sum=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sPtr));
+		__m256i sumSq=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ssPtr));
+		count=_mm256_add_epi32(_mm256_sub_epi32(count,valid),remove);
+		sum=_mm256_sub_epi32(_mm256_add_epi32(sum,_mm256_and_si256(newVal,valid)),_mm256_and_si256(oldVal,remove));
+		sumSq=_mm256_sub_epi32(_mm256_add_epi32(sumSq,_mm256_and_si256(_mm256_mullo_epi32(newVal,newVal),valid)),_mm256_and_si256(_mm256_mullo_epi32(oldVal,oldVal),remove));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(nsPtr),count);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(sPtr),sum);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(ssPtr),sumSq);
+		
+		/* Check if the pixels are considered "stable" using unsigned comparisons: */
+		__m256i enough=_mm256_cmpeq_epi32(_mm256_max_epu32(count,minN),count);
+		__m256i lhs=_mm256_mullo_epi32(sumSq,count);
+		__m256i rhs=_mm256_add_epi32(_mm256_mullo_epi32(_mm256_mullo_epi32(maxVar,count),count),_mm256_mullo_epi32(sum,sum));
+		__m256 stable=_mm256_castsi256_ps(_mm256_and_si256(enough,_mm256_cmpeq_epi32(_mm256_min_epu32(lhs,rhs),lhs)));
+		
+		/* Calculate the depth-corrected running means and check them against the previous values' envelopes: */
+		__m256 oldFiltered=_mm256_loadu_ps(ofPtr);
+		__m256 newFiltered=_mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(_mm256_cvtepi32_ps(sum),_mm256_cvtepi32_ps(count)),scale),offset);
+		__m256 update=_mm256_and_ps(stable,_mm256_cmp_ps(_mm256_andnot_ps(signMask,_mm256_sub_ps(newFiltered,oldFiltered)),hyst,_CMP_GE_OQ));
+		__m256 filtered=_mm256_blendv_ps(oldFiltered,newFiltered,update);
+		_mm256_storeu_ps(ofPtr,filtered);
+		
+		/* Assign output values; instable pixels retain their previous values or are reset to the default value: */
+		__m256 instableOut=_mm256_blendv_ps(filtered,instable,_mm256_castsi256_ps(writeInvalids));
+		_mm256_storeu_ps(nofPtr,_mm256_blendv_ps(instableOut,filtered,stable));
+		}
+	
+	/* Process the remaining pixels with scalar code: */
+	if(x<size[0])
+		filterRowScalar<KinectDepthPixels>(y,x,ifRowPtr,nofRowPtr);
+	}
+
+/***********************************************************************
+The millimeter kernel differs from the Kinect kernel in the sample
+marking empty averaging buffer slots, and in keeping the sums of squared
+samples, and the stability test's products, in 64 bits. Each group of
+eight pixels' 64-bit values is processed as two vectors of four pixels.
+***********************************************************************/
+
+__attribute__((target("avx2")))
+void FrameFilter::filterRowMillimeterAVX2(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr)
+	{
+	typedef MillimeterDepthPixels::Pixel Pixel;
+	typedef MillimeterDepthPixels::SumSq SumSq;
+	
+	/* Get pointers to the first processed pixel in all buffers: */
+	ptrdiff_t rowOffset=ptrdiff_t(y)*ptrdiff_t(size[0])+ptrdiff_t(xStart);
+	const Pixel* ifPtr=static_cast<const Pixel*>(ifRowPtr)+xStart;
+	Pixel* abPtr=getAveragingSlot<MillimeterDepthPixels>(averagingSlotIndex)+rowOffset;
+	unsigned int* nsPtr=numSamplesBuffer+rowOffset;
+	unsigned int* sPtr=getSumBuffer<MillimeterDepthPixels>()+rowOffset;
+	SumSq* ssPtr=getSumSqBuffer<MillimeterDepthPixels>()+rowOffset;
+	float* ofPtr=validBuffer+rowOffset;
+	float* nofPtr=nofRowPtr+xStart;
+	const float* pdcPtr=reinterpret_cast<const float*>(pixelDepthCorrection+rowOffset);
+	const Pixel* minDPtr=getValidDepthBounds<Pixel>().getMinDepths()+rowOffset;
+	const Pixel* maxDPtr=getValidDepthBounds<Pixel>().getMaxDepths()+rowOffset;
+	
+	/* Broadcast all filter parameters: */
+	const __m256 signMask=_mm256_set1_ps(-0.0f);
+	const __m256i invalid=_mm256_set1_epi32(int(MillimeterDepthPixels::getInvalidSample()));
+	const __m256i minN=_mm256_set1_epi32(int(minNumSamples));
+	const __m256i maxVar=_mm256_set1_epi64x((long long)(maxVariance));
+	const __m256 hyst=_mm256_set1_ps(hysteresis);
+	const __m256i writeInvalids=_mm256_set1_epi32(retainValids?0:-1);
+	const __m256 instable=_mm256_set1_ps(instableValue);
+	const __m256i evenLanes=_mm256_setr_epi32(0,2,4,6,0,2,4,6);
+	
+	/* Process groups of eight pixels: */
+	unsigned int x=xStart;
+	for(;x+8<=size[0];x+=8,ifPtr+=8,pdcPtr+=16,minDPtr+=8,maxDPtr+=8,abPtr+=8,nsPtr+=8,sPtr+=8,ssPtr+=8,ofPtr+=8,nofPtr+=8)
+		{
+		/* Load the old and new raw depth values: */
+		__m256i oldVal=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(abPtr)));
+		__m256i newVal=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ifPtr)));
+		
+		/* Check the new values against the pixels' intervals of valid raw depth values using unsigned comparisons: */
+		__m256i minD=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(minDPtr)));
+		__m256i maxD=_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(maxDPtr)));
+		__m256i valid=_mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(newVal,minD),newVal),_mm256_cmpeq_epi32(_mm256_min_epu32(newVal,maxD),newVal));
+		
+		/* Load the pixels' depth correction coefficients; the in-lane shuffles leave the pixels in 0,1,4,5,2,3,6,7 order, which is fixed by a cross-lane permutation: */
+		__m256 pdc0=_mm256_loadu_ps(pdcPtr);
+		__m256 pdc1=_mm256_loadu_ps(pdcPtr+8);
+		__m256 scale=_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(pdc0,pdc1,_MM_SHUFFLE(2,0,2,0))),_MM_SHUFFLE(3,1,2,0)));
+		__m256 offset=_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(pdc0,pdc1,_MM_SHUFFLE(3,1,3,1))),_MM_SHUFFLE(3,1,2,0)));
+		
+		/* Determine which averaging buffer slots are overwritten, and which old values are removed from the statistics: */
+		__m256i write=_mm256_or_si256(valid,writeInvalids);
+		__m256i remove=_mm256_andnot_si256(_mm256_cmpeq_epi32(oldVal,invalid),write);
+		
+		/* Store the new averaging buffer values: */
+		__m256i newAb=_mm256_blendv_epi8(oldVal,_mm256_blendv_epi8(invalid,newVal,valid),write);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(abPtr),_mm_packus_epi32(_mm256_castsi256_si128(newAb),_mm256_extracti128_si256(newAb,1)));
+		
+		/* Update the pixels' sample counts and sums; masks are -1 where set: */
+		__m256i count=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(nsPtr));
+		__m256i sum=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sPtr));
+		count=_mm256_add_epi32(_mm256_sub_epi32(count,valid),remove);
+		sum=_mm256_sub_epi32(_mm256_add_epi32(sum,_mm256_and_si256(newVal,valid)),_mm256_and_si256(oldVal,remove));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(nsPtr),count);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(sPtr),sum);
+		
+		/* Update the pixels' sums of squares; squares of 16-bit values fit into 32 unsigned bits: */
+		__m256i addSq=_mm256_and_si256(_mm256_mullo_epi32(newVal,newVal),valid);
+		__m256i subSq=_mm256_and_si256(_mm256_mullo_epi32(oldVal,oldVal),remove);
+		__m256i stable64[2];
+		for(int half=0;half<2;++half)
+			{
+			__m256i sumSq=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ssPtr+half*4));
+			__m128i addSqHalf=half==0?_mm256_castsi256_si128(addSq):_mm256_extracti128_si256(addSq,1);
+			__m128i subSqHalf=half==0?_mm256_castsi256_si128(subSq):_mm256_extracti128_si256(subSq,1);
+			sumSq=_mm256_sub_epi64(_mm256_add_epi64(sumSq,_mm256_cvtepu32_epi64(addSqHalf)),_mm256_cvtepu32_epi64(subSqHalf));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(ssPtr+half*4),sumSq);
+			
+			/* Evaluate the stability test's products modulo 2^64 like the scalar kernel; they stay below 2^63 for any practical number of averaging slots, where signed comparisons match its unsigned ones: */
+			__m256i count64=_mm256_cvtepu32_epi64(half==0?_mm256_castsi256_si128(count):_mm256_extracti128_si256(count,1));
+			__m256i sum64=_mm256_cvtepu32_epi64(half==0?_mm256_castsi256_si128(sum):_mm256_extracti128_si256(sum,1));
+			__m256i lhs=_mm256_add_epi64(_mm256_mul_epu32(sumSq,count64),_mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(sumSq,32),count64),32));
+			__m256i rhs=_mm256_add_epi64(_mm256_mul_epu32(maxVar,_mm256_mul_epu32(count64,count64)),_mm256_mul_epu32(sum64,sum64));
+			stable64[half]=_mm256_cmpgt_epi64(lhs,rhs);
+			}
+		
+		/* Check if the pixels are considered "stable" by narrowing the 64-bit test results to 32 bits: */
+		__m256i unstable=_mm256_blend_epi32(_mm256_permutevar8x32_epi32(stable64[0],evenLanes),_mm256_permutevar8x32_epi32(stable64[1],evenLanes),0xf0);
+		__m256i enough=_mm256_cmpeq_epi32(_mm256_max_epu32(count,minN),count);
+		__m256 stable=_mm256_castsi256_ps(_mm256_andnot_si256(unstable,enough));
+		
+		/* Calculate the depth-corrected running means and check them against the previous values' envelopes: */
+		__m256 oldFiltered=_mm256_loadu_ps(ofPtr);
+		__m256 newFiltered=_mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(_mm256_cvtepi32_ps(sum),_mm256_cvtepi32_ps(count)),scale),offset);
+		__m256 update=_mm256_and_ps(stable,_mm256_cmp_ps(_mm256_andnot_ps(signMask,_mm256_sub_ps(newFiltered,oldFiltered)),hyst,_CMP_GE_OQ));
+		__m256 filtered=_mm256_blendv_ps(oldFiltered,newFiltered,update);
+		_mm256_storeu_ps(ofPtr,filtered);
+		
+		/* Assign output values; instable pixels retain their previous values or are reset to the default value: */
+		__m256 instableOut=_mm256_blendv_ps(filtered,instable,_mm256_castsi256_ps(writeInvalids));
+		_mm256_storeu_ps(nofPtr,_mm256_blendv_ps(instableOut,filtered,stable));
+		}
+	
+	/* Process the remaining pixels with scalar code: */
+	if(x<size[0])
+		filterRowScalar<MillimeterDepthPixels>(y,x,ifRowPtr,nofRowPtr);
+	}
+
+#endif
+
+template <class PixelFormatParam>
+void FrameFilter::filterRowRecursive(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr)
+	{
+	typedef typename PixelFormatParam::Pixel Pixel;
+	
+	/* Get pointers to the first processed pixel in all buffers: */
+	ptrdiff_t rowOffset=ptrdiff_t(y)*ptrdiff_t(size[0])+ptrdiff_t(xStart);
+	const Pixel* ifPtr=static_cast<const Pixel*>(ifRowPtr)+xStart;
+	unsigned int* nsPtr=numSamplesBuffer+rowOffset;
+	float* mPtr=meanBuffer+rowOffset;
+	float* vPtr=varianceBuffer+rowOffset;
+	float* ofPtr=validBuffer+rowOffset;
+	float* nofPtr=nofRowPtr+xStart;
+	const PixelDepthCorrection* pdcPtr=pixelDepthCorrection+rowOffset;
+	const Pixel* minDPtr=getValidDepthBounds<Pixel>().getMinDepths()+rowOffset;
+	const Pixel* maxDPtr=getValidDepthBounds<Pixel>().getMaxDepths()+rowOffset;
+	float maxVar=float(maxVariance);
+	
+	for(unsigned int x=xStart;x<size[0];++x,++ifPtr,++pdcPtr,++minDPtr,++maxDPtr,++nsPtr,++mPtr,++vPtr,++ofPtr,++nofPtr)
+		{
+		Pixel newVal=*ifPtr;
+		
+		/* Retrieve the pixel's state: */
+		unsigned int numSamples=*nsPtr;
+		float mean=*mPtr;
+		float variance=*vPtr;
+		
+		/* Check the new value against the pixel's interval of valid raw depth values: */
+		if(newVal>=*minDPtr&&newVal<=*maxDPtr)
+			{
+			/* Count the new value, saturating at the equivalent window length: */
+			if(numSamples<numAveragingSlots)
+				++numSamples;
+			
+			/* Blend the new value into the running mean and variance: */
+			float gain=gainTable[numSamples];
+			float delta=float(newVal)-mean;
+			mean+=gain*delta;
+			variance=(1.0f-gain)*(variance+gain*delta*delta);
+			*mPtr=mean;
+			*vPtr=variance;
+			}
+		else if(!retainValids&&numSamples>0)
+			{
+			/* Let the invalid value displace a valid one, as in the averaging buffer: */
+			--numSamples;
+			}
+		*nsPtr=numSamples;
+		
+		/* Check if the pixel is considered "stable": */
+		if(numSamples>=minNumSamples&&variance<=maxVar)
+			{
+			/* Check if the new depth-corrected running mean is outside the previous value's envelope: */
+			float newFiltered=pdcPtr->correct(mean);
+			if(Math::abs(newFiltered-*ofPtr)>=hysteresis)
+				{
+				/* Set the output pixel value to the depth-corrected running mean: */
+				*nofPtr=*ofPtr=newFiltered;
+				}
+			else
+				{
+				/* Leave the pixel at its previous value: */
+				*nofPtr=*ofPtr;
+				}
+			}
+		else if(retainValids)
+			{
+			/* Leave the pixel at its previous value: */
+			*nofPtr=*ofPtr;
+			}
+		else
+			{
+			/* Assign default value to instable pixels: */
+			*nofPtr=instableValue;
+			}
+		}
+	}
+
+#if FRAMEFILTER_USE_X86_KERNELS
+
+template <class PixelFormatParam>
+__attribute__((target("avx2")))
+void FrameFilter::filterRowRecursiveAVX2(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr)
+	{
+	typedef typename PixelFormatParam::Pixel Pixel;
+	
+	/* Get pointers to the first processed pixel in all buffers: */
+	ptrdiff_t rowOffset=ptrdiff_t(y)*ptrdiff_t(size[0])+ptrdiff_t(xStart);
+	const Pixel* ifPtr=static_cast<const Pixel*>(ifRowPtr)+xStart;
+	unsigned int* nsPtr=numSamplesBuffer+rowOffset;
+	float* mPtr=meanBuffer+rowOffset;
+	float* vPtr=varianceBuffer+rowOffset;
+	float* ofPtr=validBuffer+rowOffset;
+	float* nofPtr=nofRowPtr+xStart;
+	const float* pdcPtr=reinterpret_cast<const float*>(pixelDepthCorrection+rowOffset);
+	const Pixel* minDPtr=getValidDepthBounds<Pixel>().getMinDepths()+rowOffset;
+	const Pixel* maxDPtr=getValidDepthBounds<Pixel>().getMaxDepths()+rowOffset;
+	
+	/* Broadcast all filter parameters: */
+	const __m256 signMask=_mm256_set1_ps(-0.0f);
+	const __m256 one=_mm256_set1_ps(1.0f);
+	const __m256i maxN=_mm256_set1_epi32(int(numAveragingSlots));
+	const __m256i minN=_mm256_set1_epi32(int(minNumSamples));
+	const __m256 maxVar=_mm256_set1_ps(float(maxVariance));
+	const __m256 hyst=_mm256_set1_ps(hysteresis);
+	const __m256i removeInvalids=_mm256_set1_epi32(retainValids?0:-1);
+	const __m256 instable=_mm256_set1_ps(instableValue);
+	
+	/* Process groups of eight pixels: */
+	unsigned int x=xStart;
+	for(;x+8<=size[0];x+=8,ifPtr+=8,pdcPtr+=16,minDPtr+=8,maxDPtr+=8,nsPtr+=8,mPtr+=8,vPtr+=8,ofPtr+=8,nofPtr+=8)
+		{
+		/* Load the new raw depth values and check them against the pixels' intervals of valid raw depth values: */
+		__m256 newVal;
+		__m256i valid=loadValidDepths(ifPtr,minDPtr,maxDPtr,newVal);
+		
+		/* Load the pixels' depth correction coefficients; the in-lane shuffles leave the pixels in 0,1,4,5,2,3,6,7 order, which is fixed by a cross-lane permutation: */
+		__m256 pdc0=_mm256_loadu_ps(pdcPtr);
+		__m256 pdc1=_mm256_loadu_ps(pdcPtr+8);
+		__m256 scale=_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(pdc0,pdc1,_MM_SHUFFLE(2,0,2,0))),_MM_SHUFFLE(3,1,2,0)));
+		__m256 offset=_mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(pdc0,pdc1,_MM_SHUFFLE(3,1,3,1))),_MM_SHUFFLE(3,1,2,0)));
+		
+		/* Update the pixels' sample counts; masks are -1 where set: */
+		__m256i count=_mm256_loadu_si256(reinterpret_cast<const __m256i*>(nsPtr));
+		__m256i nonzero=_mm256_xor_si256(_mm256_cmpeq_epi32(count,_mm256_setzero_si256()),_mm256_set1_epi32(-1));
+		__m256i increment=_mm256_and_si256(valid,_mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_min_epu32(count,maxN),maxN),_mm256_set1_epi32(-1)));
+		__m256i decrement=_mm256_andnot_si256(valid,_mm256_and_si256(removeInvalids,nonzero));
+		count=_mm256_add_epi32(_mm256_sub_epi32(count,increment),decrement);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(nsPtr),count);
+		
+		/* Blend the valid new values into the running means and variances: */
+		__m256 gain=_mm256_i32gather_ps(gainTable,count,4);
+		__m256 mean=_mm256_loadu_ps(mPtr);
+		__m256 variance=_mm256_loadu_ps(vPtr);
+		__m256 delta=_mm256_sub_ps(newVal,mean);
+		__m256 newMean=_mm256_add_ps(mean,_mm256_mul_ps(gain,delta));
+		__m256 newVariance=_mm256_mul_ps(_mm256_sub_ps(one,gain),_mm256_add_ps(variance,_mm256_mul_ps(_mm256_mul_ps(gain,delta),delta)));
+		mean=_mm256_blendv_ps(mean,newMean,_mm256_castsi256_ps(valid));
+		variance=_mm256_blendv_ps(variance,newVariance,_mm256_castsi256_ps(valid));
+		_mm256_storeu_ps(mPtr,mean);
+		_mm256_storeu_ps(vPtr,variance);
+		
+		/* Check if the pixels are considered "stable" using unsigned comparisons: */
+		__m256i enough=_mm256_cmpeq_epi32(_mm256_max_epu32(count,minN),count);
+		__m256 stable=_mm256_and_ps(_mm256_castsi256_ps(enough),_mm256_cmp_ps(variance,maxVar,_CMP_LE_OQ));
+		
+		/* Calculate the depth-corrected running means and check them against the previous values' envelopes: */
+		__m256 oldFiltered=_mm256_loadu_ps(ofPtr);
+		__m256 newFiltered=_mm256_add_ps(_mm256_mul_ps(mean,scale),offset);
+		__m256 update=_mm256_and_ps(stable,_mm256_cmp_ps(_mm256_andnot_ps(signMask,_mm256_sub_ps(newFiltered,oldFiltered)),hyst,_CMP_GE_OQ));
+		__m256 filtered=_mm256_blendv_ps(oldFiltered,newFiltered,update);
+		_mm256_storeu_ps(ofPtr,filtered);
+		
+		/* Assign output values; instable pixels retain their previous values or are reset to the default value: */
+		__m256 instableOut=_mm256_blendv_ps(filtered,instable,_mm256_castsi256_ps(removeInvalids));
+		_mm256_storeu_ps(nofPtr,_mm256_blendv_ps(instableOut,filtered,stable));
+		}
+	
+	/* Process the remaining pixels with scalar code: */
+	if(x<size[0])
+		filterRowRecursive<PixelFormatParam>(y,x,ifRowPtr,nofRowPtr);
+	}
+
+#endif
+
+template <class PixelFormatParam>
+void FrameFilter::selectScalarKernels(void)
+	{
+	if(temporalFilterType==RECURSIVE_ESTIMATOR)
+		rowFilterMethod=&FrameFilter::filterRowRecursive<PixelFormatParam>;
+	else
+		rowFilterMethod=&FrameFilter::filterRowScalar<PixelFormatParam>;
+	adaptRowMethod=&FrameFilter::adaptRowToMotion<PixelFormatParam>;
+	}
+
+void FrameFilter::selectFilterKernels(void)
+	{
+	/* Use the scalar kernels for the pixel format by default: */
+	switch(pixelFormat)
+		{
+		case KINECT_DEPTH:
+			selectScalarKernels<KinectDepthPixels>();
+			break;
+		
+		case MILLIMETER_DEPTH:
+			selectScalarKernels<MillimeterDepthPixels>();
+			break;
+		
+		case FLOAT_DEPTH:
+			selectScalarKernels<FloatDepthPixels>();
+			break;
+		}
+	vectorizedRowFilter=false;
+	spanFilterFunction=&FrameFilter::filterSpanScalar;
+	medianSpanFunction=&FrameFilter::medianSpanScalar;
+	
+	#if FRAMEFILTER_USE_X86_KERNELS
+	
+	/* The vectorized kernels load per-pixel depth correction coefficients as pairs of (scale, offset): */
+	bool vectorizable=sizeof(PixelDepthCorrection)==2*sizeof(float)&&offsetof(PixelDepthCorrection,scale)==0&&offsetof(PixelDepthCorrection,offset)==sizeof(float);
+	
+	/* Pick the widest kernels supported by the CPU: */
+	if(vectorize&&vectorizable)
+		{
+		bool recursive=temporalFilterType==RECURSIVE_ESTIMATOR;
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			{
+			/* There is no AVX2 version of the averaging buffer for floating-point pixels, whose statistics are kept in double precision: */
+			switch(pixelFormat)
+				{
+				case KINECT_DEPTH:
+					rowFilterMethod=recursive?&FrameFilter::filterRowRecursiveAVX2<KinectDepthPixels>:&FrameFilter::filterRowAVX2;
+					vectorizedRowFilter=true;
+					break;
+				
+				case MILLIMETER_DEPTH:
+					rowFilterMethod=recursive?&FrameFilter::filterRowRecursiveAVX2<MillimeterDepthPixels>:&FrameFilter::filterRowMillimeterAVX2;
+					vectorizedRowFilter=true;
+					break;
+				
+				case FLOAT_DEPTH:
+					if(recursive)
+						{
+						rowFilterMethod=&FrameFilter::filterRowRecursiveAVX2<FloatDepthPixels>;
+						vectorizedRowFilter=true;
+						}
+					break;
+				}
+			spanFilterFunction=&FrameFilter::filterSpanAVX;
+			medianSpanFunction=&FrameFilter::medianSpanAVX;
+			}
+		else if(__builtin_cpu_supports("sse4.1"))
+			{
+			/* There is only an SSE4.1 version of the averaging buffer for Kinect pixels: */
+			if(!recursive&&pixelFormat==KINECT_DEPTH)
+				{
+				rowFilterMethod=&FrameFilter::filterRowSSE41;
+				vectorizedRowFilter=true;
+				}
+			spanFilterFunction=&FrameFilter::filterSpanSSE;
+			medianSpanFunction=&FrameFilter::medianSpanSSE;
+			}
+		}
+	
+	#endif
+	}
+
+void FrameFilter::filterSpanScalar(const float* sPtr,ptrdiff_t tapStride,const float* weights,int numTaps,float* dPtr,unsigned int spanLength)
+	{
+	for(unsigned int x=0;x<spanLength;++x,++sPtr,++dPtr)
+		{
+		/* Accumulate the weighted taps: */
+		const float* tPtr=sPtr;
+		float sum=weights[0]**tPtr;
+		for(int k=1;k<numTaps;++k)
+			{
+			tPtr+=tapStride;
+			sum+=weights[k]**tPtr;
+			}
+		*dPtr=sum;
+		}
+	}
+
+#if FRAMEFILTER_USE_X86_KERNELS
+
+__attribute__((target("sse")))
+void FrameFilter::filterSpanSSE(const float* sPtr,ptrdiff_t tapStride,const float* weights,int numTaps,float* dPtr,unsigned int spanLength)
+	{
+	/* Process strips of 16 pixels, keeping all sums in registers while accumulating the weighted taps: */
+	unsigned int x=0;
+	for(;x+16<=spanLength;x+=16,sPtr+=16,dPtr+=16)
+		{
+		const float* tPtr=sPtr;
+		__m128 w=_mm_set1_ps(weights[0]);
+		__m128 sum0=_mm_mul_ps(w,_mm_loadu_ps(tPtr));
+		__m128 sum1=_mm_mul_ps(w,_mm_loadu_ps(tPtr+4));
+		__m128 sum2=_mm_mul_ps(w,_mm_loadu_ps(tPtr+8));
+		__m128 sum3=_mm_mul_ps(w,_mm_loadu_ps(tPtr+12));
+		for(int k=1;k<numTaps;++k)
+			{
+			tPtr+=tapStride;
+			w=_mm_set1_ps(weights[k]);
+			sum0=_mm_add_ps(sum0,_mm_mul_ps(w,_mm_loadu_ps(tPtr)));
+			sum1=_mm_add_ps(sum1,_mm_mul_ps(w,_mm_loadu_ps(tPtr+4)));
+			sum2=_mm_add_ps(sum2,_mm_mul_ps(w,_mm_loadu_ps(tPtr+8)));
+			sum3=_mm_add_ps(sum3,_mm_mul_ps(w,_mm_loadu_ps(tPtr+12)));
+			}
+		_mm_storeu_ps(dPtr,sum0);
+		_mm_storeu_ps(dPtr+4,sum1);
+		_mm_storeu_ps(dPtr+8,sum2);
+		_mm_storeu_ps(dPtr+12,sum3);
+		}
+	
+	/* Process the remaining pixels with scalar code: */
+	if(x<spanLength)
+		filterSpanScalar(sPtr,tapStride,weights,numTaps,dPtr,spanLength-x);
+	}
+
+__attribute__((target("avx")))
+void FrameFilter::filterSpanAVX(const float* sPtr,ptrdiff_t tapStride,const float* weights,int numTaps,float* dPtr,unsigned int spanLength)
+	{
+	/* Process strips of 32 pixels, keeping all sums in registers while accumulating the weighted taps: */
+	unsigned int x=0;
+	for(;x+32<=spanLength;x+=32,sPtr+=32,dPtr+=32)
+		{
+		const float* tPtr=sPtr;
+		__m256 w=_mm256_set1_ps(weights[0]);
+		__m256 sum0=_mm256_mul_ps(w,_mm256_loadu_ps(tPtr));
+		__m256 sum1=_mm256_mul_ps(w,_mm256_loadu_ps(tPtr+8));
+		__m256 sum2=_mm256_mul_ps(w,_mm256_loadu_ps(tPtr+16));
+		__m256 sum3=_mm256_mul_ps(w,_mm256_loadu_ps(tPtr+24));
+		for(int k=1;k<numTaps;++k)
+			{
+			tPtr+=tapStride;
+			w=_mm256_set1_ps(weights[k]);
+			sum0=_mm256_add_ps(sum0,_mm256_mul_ps(w,_mm256_loadu_ps(tPtr)));
+			sum1=_mm256_add_ps(sum1,_mm256_mul_ps(w,_mm256_loadu_ps(tPtr+8)));
+			sum2=_mm256_add_ps(sum2,_mm256_mul_ps(w,_mm256_loadu_ps(tPtr+16)));
+			sum3=_mm256_add_ps(sum3,_mm256_mul_ps(w,_mm256_loadu_ps(tPtr+24)));
+			}
+		_mm256_storeu_ps(dPtr,sum0);
+		_mm256_storeu_ps(dPtr+8,sum1);
+		_mm256_storeu_ps(dPtr+16,sum2);
+		_mm256_storeu_ps(dPtr+24,sum3);
+		}
+	
+	/* Process the remaining pixels with the SSE kernel: */
+	if(x<spanLength)
+		filterSpanSSE(sPtr,tapStride,weights,numTaps,dPtr,spanLength-x);
+	}
+
+#endif
+
+void FrameFilter::medianSpanScalar(const float* const* sRowPtrs,unsigned int filterSize,float* dPtr,unsigned int spanLength)
+	{
+	for(unsigned int x=0;x<spanLength;++x)
+		{
+		/* Gather the pixel's neighborhood and select its median: */
+		float taps[25];
+		for(unsigned int i=0;i<filterSize;++i)
+			for(unsigned int j=0;j<filterSize;++j)
+				taps[i*filterSize+j]=sRowPtrs[i][x+j];
+		dPtr[x]=filterSize==3?selectMedian3x3(taps):selectMedian5x5(taps);
+		}
+	}
+
+#if FRAMEFILTER_USE_X86_KERNELS
+
+__attribute__((target("sse")))
+void FrameFilter::medianSpanSSE(const float* const* sRowPtrs,unsigned int filterSize,float* dPtr,unsigned int spanLength)
+	{
+	/* Process strips of four pixels, running the selection network on all of them in parallel: */
+	unsigned int x=0;
+	for(;x+4<=spanLength;x+=4)
+		{
+		__m128 taps[25];
+		for(unsigned int i=0;i<filterSize;++i)
+			for(unsigned int j=0;j<filterSize;++j)
+				taps[i*filterSize+j]=_mm_loadu_ps(sRowPtrs[i]+(x+j));
+		_mm_storeu_ps(dPtr+x,filterSize==3?selectMedian3x3(taps):selectMedian5x5(taps));
+		}
+	
+	/* Process the remaining pixels with scalar code: */
+	if(x<spanLength)
+		{
+		const float* rowPtrs[5];
+		for(unsigned int i=0;i<filterSize;++i)
+			rowPtrs[i]=sRowPtrs[i]+x;
+		medianSpanScalar(rowPtrs,filterSize,dPtr+x,spanLength-x);
+		}
+	}
+
+__attribute__((target("avx")))
+void FrameFilter::medianSpanAVX(const float* const* sRowPtrs,unsigned int filterSize,float* dPtr,unsigned int spanLength)
+	{
+	/* Process strips of eight pixels, running the selection network on all of them in parallel: */
+	unsigned int x=0;
+	for(;x+8<=spanLength;x+=8)
+		{
+		__m256 taps[25];
+		for(unsigned int i=0;i<filterSize;++i)
+			for(unsigned int j=0;j<filterSize;++j)
+				taps[i*filterSize+j]=_mm256_loadu_ps(sRowPtrs[i]+(x+j));
+		_mm256_storeu_ps(dPtr+x,filterSize==3?selectMedian3x3(taps):selectMedian5x5(taps));
+		}
+	
+	/* Process the remaining pixels with the SSE kernel: */
+	if(x<spanLength)
+		{
+		const float* rowPtrs[5];
+		for(unsigned int i=0;i<filterSize;++i)
+			rowPtrs[i]=sRowPtrs[i]+x;
+		medianSpanSSE(rowPtrs,filterSize,dPtr+x,spanLength-x);
+		}
+	}
+
+#endif
+
+void FrameFilter::getBandRows(unsigned int band,unsigned int& y0,unsigned int& y1) const
+	{
+	y0=(unsigned int)((unsigned long)(band)*(unsigned long)(size[1])/(unsigned long)(numBands));
+	y1=(unsigned int)((unsigned long)(band+1)*(unsigned long)(size[1])/(unsigned long)(numBands));
+	}
+
+template <class PixelFormatParam>
+void FrameFilter::resetPixel(ptrdiff_t pixelOffset,typename PixelFormatParam::Pixel newVal)
+	{
+	typedef typename PixelFormatParam::Sample Sample;
+	typedef typename PixelFormatParam::Sum Sum;
+	typedef typename PixelFormatParam::SumSq SumSq;
+	
+	if(temporalFilterType==AVERAGING_BUFFER)
+		{
+		/* Invalidate all of the pixel's averaging slots except the current one, which holds the new value: */
+		ptrdiff_t slotStride=ptrdiff_t(size[1])*ptrdiff_t(size[0]);
+		Sample* abPtr=getAveragingSlot<PixelFormatParam>(0)+pixelOffset;
+		for(unsigned int slot=0;slot<numAveragingSlots;++slot,abPtr+=slotStride)
+			*abPtr=slot==averagingSlotIndex?Sample(newVal):PixelFormatParam::getInvalidSample();
+		
+		/* Reset the pixel's statistics to the new value: */
+		numSamplesBuffer[pixelOffset]=1U;
+		getSumBuffer<PixelFormatParam>()[pixelOffset]=Sum(newVal);
+		getSumSqBuffer<PixelFormatParam>()[pixelOffset]=SumSq(newVal)*SumSq(newVal);
+		}
+	else
+		{
+		/* Restart the pixel's estimate from the new value: */
+		numSamplesBuffer[pixelOffset]=1U;
+		meanBuffer[pixelOffset]=float(newVal);
+		varianceBuffer[pixelOffset]=0.0f;
+		}
+	}
+
+template <class PixelFormatParam>
+unsigned int FrameFilter::adaptRowToMotion(unsigned int y,const void* ifRowPtr,float* nofRowPtr)
+	{
+	typedef typename PixelFormatParam::Pixel Pixel;
+	
+	/* Get pointers to the first pixel in all buffers: */
+	ptrdiff_t rowOffset=ptrdiff_t(y)*ptrdiff_t(size[0]);
+	const Pixel* ifPtr=static_cast<const Pixel*>(ifRowPtr);
+	unsigned char* mbPtr=motionBuffer+rowOffset;
+	const unsigned int* nsPtr=numSamplesBuffer+rowOffset;
+	float* ofPtr=validBuffer+rowOffset;
+	float* nofPtr=nofRowPtr;
+	const PixelDepthCorrection* pdcPtr=pixelDepthCorrection+rowOffset;
+	const Pixel* minDPtr=getValidDepthBounds<Pixel>().getMinDepths()+rowOffset;
+	const Pixel* maxDPtr=getValidDepthBounds<Pixel>().getMaxDepths()+rowOffset;
+	
+	float motionThreshold2=motionThreshold*motionThreshold;
+	unsigned int numResets=0;
+	for(unsigned int x=0;x<size[0];++x,++ifPtr,++pdcPtr,++minDPtr,++maxDPtr,++mbPtr,++nsPtr,++ofPtr,++nofPtr)
+		{
+		/* Skip ahead over a chunk of pixels that are neither in motion nor recovering from a reset using a branch-free test that can be vectorized: */
+		if((x&(motionChunkSize-1))==0U&&x+motionChunkSize<=size[0])
+			{
+			unsigned int attention=0U;
+			for(unsigned int i=0;i<motionChunkSize;++i)
+				{
+				float delta=pdcPtr[i].correct(float(ifPtr[i]))-ofPtr[i];
+				attention|=(unsigned int)((ifPtr[i]>=minDPtr[i])&(ifPtr[i]<=maxDPtr[i])&(delta*delta>motionThreshold2))|(unsigned int)(mbPtr[i]);
+				}
+			if(attention==0U)
+				{
+				x+=motionChunkSize-1;
+				ifPtr+=motionChunkSize-1;
+				pdcPtr+=motionChunkSize-1;
+				minDPtr+=motionChunkSize-1;
+				maxDPtr+=motionChunkSize-1;
+				mbPtr+=motionChunkSize-1;
+				nsPtr+=motionChunkSize-1;
+				ofPtr+=motionChunkSize-1;
+				nofPtr+=motionChunkSize-1;
+				continue;
+				}
+			}
+		
+		/* Retrieve the pixel's motion state; the low seven bits count consecutive frames indicating motion, and the high bit marks pixels recovering from a reset: */
+		unsigned int state=*mbPtr;
+		
+		/* Check if the new value is valid and outside the pixel's current value's motion envelope without branching: */
+		Pixel newVal=*ifPtr;
+		float newCorrected=pdcPtr->correct(float(newVal));
+		float delta=newCorrected-*ofPtr;
+		bool valid=(newVal>=*minDPtr)&(newVal<=*maxDPtr);
+		bool moved=valid&(delta*delta>motionThreshold2);
+		
+		/* Skip the common case of a pixel that is neither in motion nor recovering from a reset: */
+		if(moved|(state!=0U))
+			{
+			if(moved)
+				{
+				++state;
+				if((state&0x7fU)>=numMotionFrames)
+					{
+					/* Reset the pixel's temporal filter and show the new value immediately: */
+					resetPixel<PixelFormatParam>(rowOffset+ptrdiff_t(x),newVal);
+					*nofPtr=*ofPtr=newCorrected;
+					state=0x80U;
+					++numResets;
+					}
+				}
+			else if(valid)
+				{
+				/* Start counting again: */
+				state&=0x80U;
+				}
+			
+			/* Hold recovering pixels at their current values until they are stable again: */
+			if(state&0x80U)
+				{
+				if(*nsPtr>=minNumSamples)
+					state&=0x7fU;
+				else
+					*nofPtr=*ofPtr;
+				}
+			
+			*mbPtr=(unsigned char)(state);
+			}
+		}
+	
+	return numResets;
+	}
+
+void FrameFilter::filterBandTemporal(unsigned int band)
+	{
+	unsigned int y0,y1;
+	getBandRows(band,y0,y1);
+	
+	/* Enter the band of the new frame into the averaging buffer and calculate the band's output pixel values: */
+	ptrdiff_t inputRowStride=ptrdiff_t(size[0])*ptrdiff_t(pixelSize);
+	const unsigned char* ifRowPtr=currentInputFrame+ptrdiff_t(y0)*inputRowStride;
+	float* nofRowPtr=currentOutputFrame+ptrdiff_t(y0)*ptrdiff_t(size[0]);
+	float* sbRowPtr=spatialBuffer+ptrdiff_t(y0)*ptrdiff_t(size[0]);
+	unsigned int numResets=0;
+	for(unsigned int y=y0;y<y1;++y,ifRowPtr+=inputRowStride,nofRowPtr+=size[0],sbRowPtr+=size[0])
+		{
+		(this->*rowFilterMethod)(y,0,ifRowPtr,nofRowPtr);
+		
+		/* Reset pixels whose depth values moved if requested: */
+		if(adaptCurrentFrame)
+			numResets+=(this->*adaptRowMethod)(y,ifRowPtr,nofRowPtr);
+		
+		/* Run the spatial filter's horizontal pass on the new row while it is still in cache if requested: */
+		if(fuseCurrentFrame)
+			filterRowHorizontal(nofRowPtr,sbRowPtr);
+		
+		/* Detect changes if the row is final: */
+		if(!applyCurrentMedianFilter&&!applyCurrentSpatialFilter&&!fillCurrentFrame)
+			detectRowChanges(y,0,size[0],nofRowPtr);
+		}
+	bandNumFastResets[band]=numResets;
+	}
+
+void FrameFilter::filterRowMedian(unsigned int y,float* dRowPtr) const
+	{
+	int r=int(medianKernelRadius);
+	unsigned int filterSize=medianKernelRadius*2+1;
+	int width=int(size[0]);
+	int height=int(size[1]);
+	
+	/* Find the source rows of the neighborhood, replicating the rows at the top and bottom of the frame: */
+	const float* sRowPtrs[5];
+	for(int i=0;i<int(filterSize);++i)
+		{
+		int sy=int(y)-r+i;
+		sy=sy<0?0:(sy>=height?height-1:sy);
+		sRowPtrs[i]=currentOutputFrame+ptrdiff_t(sy)*ptrdiff_t(size[0]);
+		}
+	
+	/* Filter the interior pixels, where the neighborhood fits entirely inside the row: */
+	int x0=r<width?r:width;
+	int x1=width-r>x0?width-r:x0;
+	if(x1>x0)
+		medianSpanFunction(sRowPtrs,filterSize,dRowPtr+x0,(unsigned int)(x1-x0));
+	
+	/* Filter the border pixels on either side of the interior, replicating the columns at the left and right of the frame: */
+	int borders[2][2]={{0,x0},{x1,width}};
+	for(int border=0;border<2;++border)
+		for(int x=borders[border][0];x<borders[border][1];++x)
+			{
+			float taps[25];
+			for(int i=0;i<int(filterSize);++i)
+				for(int j=0;j<int(filterSize);++j)
+					{
+					int sx=x-r+j;
+					sx=sx<0?0:(sx>=width?width-1:sx);
+					taps[i*filterSize+j]=sRowPtrs[i][sx];
+					}
+			dRowPtr[x]=filterSize==3?selectMedian3x3(taps):selectMedian5x5(taps);
+			}
+	}
+
+void FrameFilter::filterBandMedian(unsigned int band)
+	{
+	unsigned int y0,y1;
+	getBandRows(band,y0,y1);
+	
+	/* Filter the band from the output frame into the median filter buffer, reading up to the neighborhood radius of halo rows from neighboring bands: */
+	for(unsigned int y=y0;y<y1;++y)
+		filterRowMedian(y,medianBuffer+ptrdiff_t(y)*ptrdiff_t(size[0]));
+	}
+
+void FrameFilter::storeBandMedian(unsigned int band)
+	{
+	unsigned int y0,y1;
+	getBandRows(band,y0,y1);
+	
+	/* Copy the band's final output rows back into the output frame and detect their changes: */
+	ptrdiff_t stride=ptrdiff_t(size[0]);
+	for(unsigned int y=y0;y<y1;++y)
+		{
+		const float* mbRowPtr=medianBuffer+ptrdiff_t(y)*stride;
+		float* ofRowPtr=currentOutputFrame+ptrdiff_t(y)*stride;
+		for(unsigned int x=0;x<size[0];++x)
+			ofRowPtr[x]=mbRowPtr[x];
+		detectRowChanges(y,0,size[0],ofRowPtr);
+		}
+	}
+
+void FrameFilter::updateSpatialKernel(void)
+	{
+	/* Calculate the sum of weights of a sampled Gaussian kernel of the requested radius: */
+	spatialKernelRadius=spatialFilterRadius;
+	delete[] spatialKernel;
+	unsigned int kernelSize=spatialKernelRadius*2+1;
+	spatialKernel=new float[kernelSize];
+	double weightSum=0.0;
+	for(unsigned int i=0;i<kernelSize;++i)
+		weightSum+=getGaussianWeight(i,spatialKernelRadius);
+	
+	/* Store the normalized kernel weights: */
+	for(unsigned int i=0;i<kernelSize;++i)
+		spatialKernel[i]=float(getGaussianWeight(i,spatialKernelRadius)/weightSum);
+	}
+
+void FrameFilter::filterRowHorizontal(const float* sRowPtr,float* dRowPtr) const
+	{
+	int r=int(spatialKernelRadius);
+	int width=int(size[0]);
+	
+	/* Filter the interior pixels, where the kernel fits entirely inside the row: */
+	int x0=r<width?r:width;
+	int x1=width-r>x0?width-r:x0;
+	if(x1>x0)
+		spanFilterFunction(sRowPtr+(x0-r),1,spatialKernel,2*r+1,dRowPtr+x0,(unsigned int)(x1-x0));
+	
+	/* Filter the border pixels on either side of the interior with the kernel taps that fall inside the row, and re-normalize: */
+	int borders[2][2]={{0,x0},{x1,width}};
+	for(int border=0;border<2;++border)
+		for(int x=borders[border][0];x<borders[border][1];++x)
+			{
+			int kMin=r-x>0?r-x:0;
+			int kMax=width-1-x+r<2*r?width-1-x+r:2*r;
+			float sum=0.0f;
+			float weightSum=0.0f;
+			for(int k=kMin;k<=kMax;++k)
+				{
+				sum+=spatialKernel[k]*sRowPtr[x-r+k];
+				weightSum+=spatialKernel[k];
+				}
+			dRowPtr[x]=sum/weightSum;
+			}
+	}
+
+void FrameFilter::filterBandHorizontal(unsigned int band)
+	{
+	unsigned int y0,y1;
+	getBandRows(band,y0,y1);
+	
+	/* Filter the band's rows from the output frame, or from the median filter buffer if the median filter was applied, into the spatial filter buffer: */
+	const float* source=applyCurrentMedianFilter?medianBuffer:currentOutputFrame;
+	ptrdiff_t stride=ptrdiff_t(size[0]);
+	for(unsigned int y=y0;y<y1;++y)
+		filterRowHorizontal(source+ptrdiff_t(y)*stride,spatialBuffer+ptrdiff_t(y)*stride);
+	}
+
+void FrameFilter::filterBandVertical(unsigned int band)
 	{
-	unsigned int lastInputFrameVersion=0;
+	unsigned int y0,y1;
+	getBandRows(band,y0,y1);
+	
+	/* Filter the band from the spatial filter buffer back into the output frame, reading up to the kernel radius of halo rows from neighboring bands: */
+	int r=int(spatialKernelRadius);
+	int height=int(size[1]);
+	ptrdiff_t stride=ptrdiff_t(size[0]);
 	
-	while(true)
+	/* Process the band in tiles of columns so that all source rows touched by the kernel stay in cache from one output row to the next: */
+	for(unsigned int tx0=0;tx0<size[0];tx0+=spatialTileWidth)
 		{
-		Kinect::FrameBuffer frame;
+		unsigned int tx1=tx0+spatialTileWidth<size[0]?tx0+spatialTileWidth:size[0];
+		for(unsigned int y=y0;y<y1;++y)
+			{
+			/* Determine the kernel taps that fall inside the frame: */
+			int kMin=r-int(y)>0?r-int(y):0;
+			int kMax=height-1-int(y)+r<2*r?height-1-int(y)+r:2*r;
+			
+			/* Filter the tile's span of the row using the kernel taps that fall inside the frame: */
+			float* dPtr=currentOutputFrame+ptrdiff_t(y)*stride;
+			spanFilterFunction(spatialBuffer+ptrdiff_t(int(y)-r+kMin)*stride+tx0,stride,spatialKernel+kMin,kMax-kMin+1,dPtr+tx0,tx1-tx0);
+			
+			/* Re-normalize the result if the kernel was clipped at the top or bottom of the frame: */
+			if(kMax-kMin<2*r)
+				{
+				float weightSum=spatialKernel[kMin];
+				for(int k=kMin+1;k<=kMax;++k)
+					weightSum+=spatialKernel[k];
+				for(unsigned int x=tx0;x<tx1;++x)
+					dPtr[x]/=weightSum;
+				}
+			
+			/* Detect changes in the final output row: */
+			detectRowChanges(y,tx0,tx1,dPtr);
+			}
+		}
+	}
+
+void FrameFilter::detectRowChanges(unsigned int y,unsigned int xStart,unsigned int xEnd,const float* rowPtr)
+	{
+	/* Compare the span against the last uploaded values one tile at a time; changes inside the hysteresis envelope do not flag a tile: */
+	float changeThreshold=hysteresis;
+	unsigned int numTileColumns=TileChangeMask::getNumTiles(size[0]);
+	const float* pobRowPtr=previousOutputBuffer+ptrdiff_t(y)*ptrdiff_t(size[0]);
+	unsigned char* rtcPtr=rowTileChanges+ptrdiff_t(y)*ptrdiff_t(numTileColumns);
+	for(unsigned int x0=xStart;x0<xEnd;x0+=TileChangeMask::tileSize)
 		{
-		Threads::MutexCond::Lock inputLock(inputCond);
-		
-		/* Wait until a new frame arrives or the program shuts down: */
-		while(runFilterThread&&lastInputFrameVersion==inputFrameVersion)
-			inputCond.wait(inputLock);
-		
-		/* Bail out if the program is shutting down: */
-		if(!runFilterThread)
-			break;
-		
-		/* Work on the new frame: */
-		frame=inputFrame;
-		lastInputFrameVersion=inputFrameVersion;
+		unsigned int x1=x0+TileChangeMask::tileSize<xEnd?x0+TileChangeMask::tileSize:xEnd;
+		unsigned int changed=0U;
+		for(unsigned int x=x0;x<x1;++x)
+			{
+			float delta=rowPtr[x]-pobRowPtr[x];
+			changed|=(unsigned int)(delta!=0.0f)&(unsigned int)(Math::abs(delta)>=changeThreshold);
+			}
+		rtcPtr[x0/TileChangeMask::tileSize]=(unsigned char)(changed);
 		}
+	}
+
+/***********************************************************************
+Holes are filled by push-pull interpolation over a pyramid of
+successively halved levels. The pull phase averages each 2x2 block of a
+level into the next-coarser level, weighted by the block's pixels'
+weights, which are 1 for valid full-resolution pixels and 0 for holes,
+and clamps the block's sum of weights to 1. The push phase then blends
+each pixel of a level whose weight is less than 1 with a bilinear
+interpolation of the next-coarser level, from the coarsest level down.
+Valid full-resolution pixels keep their values, and holes receive smooth
+weighted averages of their surroundings at the scale of their size.
+***********************************************************************/
+
+void FrameFilter::createHoleFillLevels(void)
+	{
+	/* Create the full-resolution level's hole mask; its values are the output frame: */
+	holeMask=new unsigned char[size[1]*size[0]];
+	holeRows=new unsigned char[size[1]];
+	
+	/* Create the coarser levels: */
+	for(unsigned int level=1;level<numHoleFillLevels;++level)
+		{
+		HoleFillLevel& hfl=holeFillLevels[level];
+		hfl.values=new float[hfl.size[1]*hfl.size[0]];
+		hfl.weights=new float[hfl.size[1]*hfl.size[0]];
+		}
+	}
+
+void FrameFilter::getHoleFillBandRows(unsigned int band,unsigned int& y0,unsigned int& y1) const
+	{
+	unsigned int height=holeFillLevels[holeFillLevel].size[1];
+	y0=(unsigned int)((unsigned long)(band)*(unsigned long)(height)/(unsigned long)(holeFillNumBands));
+	y1=(unsigned int)((unsigned long)(band+1)*(unsigned long)(height)/(unsigned long)(holeFillNumBands));
+	}
+
+void FrameFilter::pullBandHoles(unsigned int band)
+	{
+	unsigned int y0,y1;
+	getHoleFillBandRows(band,y0,y1);
+	const HoleFillLevel& fine=holeFillLevels[holeFillLevel-1];
+	HoleFillLevel& coarse=holeFillLevels[holeFillLevel];
+	ptrdiff_t fineStride=ptrdiff_t(fine.size[0]);
+	unsigned int numHoles=0;
+	for(unsigned int y=y0;y<y1;++y)
+		{
+		unsigned int fy0=2*y;
+		unsigned int fyEnd=fy0+2<fine.size[1]?fy0+2:fine.size[1];
+		float* cvPtr=coarse.values+ptrdiff_t(y)*ptrdiff_t(coarse.size[0]);
+		float* cwPtr=coarse.weights+ptrdiff_t(y)*ptrdiff_t(coarse.size[0]);
 		
-		/* Prepare a new output frame: */
-		Kinect::FrameBuffer& newOutputFrame=outputFrames.startNewValue();
-		
-		/* Enter the new frame into the averaging buffer and calculate the output frame's pixel values: */
-		const RawDepth* ifPtr=inputFrame.getData<RawDepth>();
-		RawDepth* abPtr=averagingBuffer+averagingSlotIndex*size[1]*size[0];
-		unsigned int* sPtr=statBuffer;
-		float* ofPtr=validBuffer;
-		float* nofPtr=newOutputFrame.getData<float>();
-		const PixelDepthCorrection* pdcPtr=pixelDepthCorrection;
-		for(unsigned int y=0;y<size[1];++y)
+		if(holeFillLevel==1)
 			{
-			float py=float(y)+0.5f;
-			for(unsigned int x=0;x<size[0];++x,++ifPtr,++pdcPtr,++abPtr,sPtr+=3,++ofPtr,++nofPtr)
+			/* Classify the full-resolution pixels; pixels are holes if their temporal filter has no valid samples, or if they were reset to the instable value: */
+			bool blockHoles=false;
+			for(unsigned int fy=fy0;fy<fyEnd;++fy)
 				{
-				float px=float(x)+0.5f;
-				
-				unsigned int oldVal=*abPtr;
-				unsigned int newVal=*ifPtr;
-				
-				/* Depth-correct the new value: */
-				float newCVal=pdcPtr->correct(newVal);
-				
-				/* Plug the depth-corrected new value into the minimum and maximum plane equations to determine its validity: */
-				float minD=minPlane[0]*px+minPlane[1]*py+minPlane[2]*newCVal+minPlane[3];
-				float maxD=maxPlane[0]*px+maxPlane[1]*py+maxPlane[2]*newCVal+maxPlane[3];
-				if(minD>=0.0f&&maxD<=0.0f)
-					{
-					/* Store the new input value: */
-					*abPtr=newVal;
-					
-					/* Update the pixel's statistics: */
-					++sPtr[0]; // Number of valid samples
-					sPtr[1]+=newVal; // Sum of valid samples
-					sPtr[2]+=newVal*newVal; // Sum of squares of valid samples
-					
-					/* Check if the previous value in the averaging buffer was valid: */
-					if(oldVal!=2048U)
-						{
-						--sPtr[0]; // Number of valid samples
-						sPtr[1]-=oldVal; // Sum of valid samples
-						sPtr[2]-=oldVal*oldVal; // Sum of squares of valid samples
-						}
-					}
-				else if(!retainValids)
+				ptrdiff_t rowOffset=ptrdiff_t(fy)*fineStride;
+				const unsigned int* nsPtr=numSamplesBuffer+rowOffset;
+				const float* vPtr=fine.values+rowOffset;
+				unsigned char* hmPtr=holeMask+rowOffset;
+				unsigned int rowHoles=0;
+				for(unsigned int x=0;x<fine.size[0];++x)
 					{
-					/* Store an invalid input value: */
-					*abPtr=2048U;
-					
-					/* Check if the previous value in the averaging buffer was valid: */
-					if(oldVal!=2048U)
-						{
-						--sPtr[0]; // Number of valid samples
-						sPtr[1]-=oldVal; // Sum of valid samples
-						sPtr[2]-=oldVal*oldVal; // Sum of squares of valid samples
-						}
+					unsigned int valid=nsPtr[x]!=0U&&(retainValids||vPtr[x]!=instableValue)?1U:0U;
+					hmPtr[x]=(unsigned char)(valid);
+					rowHoles+=1U-valid;
 					}
-				
-				/* Check if the pixel is considered "stable": */
-				if(sPtr[0]>=minNumSamples&&sPtr[2]*sPtr[0]<=maxVariance*sPtr[0]*sPtr[0]+sPtr[1]*sPtr[1])
+				holeRows[fy]=(unsigned char)(rowHoles!=0U);
+				numHoles+=rowHoles;
+				blockHoles=blockHoles||rowHoles!=0U;
+				}
+			
+			if(!blockHoles&&fyEnd==fy0+2)
+				{
+				/* Average the complete 2x2 blocks of the hole-free pair of rows, and let the odd last column fall through: */
+				const float* v0Ptr=fine.values+ptrdiff_t(fy0)*fineStride;
+				const float* v1Ptr=v0Ptr+fineStride;
+				unsigned int x;
+				for(x=0;2*x+1<fine.size[0];++x)
 					{
-					/* Check if the new depth-corrected running mean is outside the previous value's envelope: */
-					float newFiltered=pdcPtr->correct(float(sPtr[1])/float(sPtr[0]));
-					if(Math::abs(newFiltered-*ofPtr)>=hysteresis)
-						{
-						/* Set the output pixel value to the depth-corrected running mean: */
-						*nofPtr=*ofPtr=newFiltered;
-						}
-					else
-						{
-						/* Leave the pixel at its previous value: */
-						*nofPtr=*ofPtr;
-						}
+					cvPtr[x]=((v0Ptr[2*x]+v0Ptr[2*x+1])+(v1Ptr[2*x]+v1Ptr[2*x+1]))*0.25f;
+					cwPtr[x]=1.0f;
 					}
-				else if(retainValids)
+				if(x<coarse.size[0])
 					{
-					/* Leave the pixel at its previous value: */
-					*nofPtr=*ofPtr;
+					cvPtr[x]=(v0Ptr[2*x]+v1Ptr[2*x])*0.5f;
+					cwPtr[x]=1.0f;
 					}
-				else
+				}
+			else
+				{
+				/* Average the valid pixels of each block of 2x2 full-resolution pixels: */
+				for(unsigned int x=0;x<coarse.size[0];++x)
 					{
-					/* Assign default value to instable pixels: */
-					*nofPtr=instableValue;
+					unsigned int fx0=2*x;
+					unsigned int fxEnd=fx0+2<fine.size[0]?fx0+2:fine.size[0];
+					unsigned int numValid=0;
+					float valueSum=0.0f;
+					for(unsigned int fy=fy0;fy<fyEnd;++fy)
+						for(unsigned int fx=fx0;fx<fxEnd;++fx)
+							{
+							ptrdiff_t index=ptrdiff_t(fy)*fineStride+ptrdiff_t(fx);
+							if(holeMask[index]!=0U)
+								{
+								++numValid;
+								valueSum+=fine.values[index];
+								}
+							}
+					cvPtr[x]=numValid!=0U?valueSum/float(numValid):0.0f;
+					cwPtr[x]=numValid!=0U?1.0f:0.0f;
 					}
 				}
 			}
-		
-		/* Go to the next averaging slot: */
-		if(++averagingSlotIndex==numAveragingSlots)
-			averagingSlotIndex=0U;
-		
-		/* Apply a spatial filter if requested: */
-		if(spatialFilter)
+		else
 			{
-			for(int filterPass=0;filterPass<2;++filterPass)
+			/* Average each block of 2x2 finer-level pixels, weighted by their weights: */
+			for(unsigned int x=0;x<coarse.size[0];++x)
 				{
-				/* Low-pass filter the entire output frame in-place: */
-				for(unsigned int x=0;x<size[0];++x)
-					{
-					/* Get a pointer to the current column: */
-					float* colPtr=newOutputFrame.getData<float>()+x;
-					
-					/* Filter the first pixel in the column: */
-					float lastVal=*colPtr;
-					*colPtr=(colPtr[0]*2.0f+colPtr[size[0]])/3.0f;
-					colPtr+=size[0];
-					
-					/* Filter the interior pixels in the column: */
-					for(unsigned int y=1;y<size[1]-1;++y,colPtr+=size[0])
+				unsigned int fx0=2*x;
+				unsigned int fxEnd=fx0+2<fine.size[0]?fx0+2:fine.size[0];
+				float weightSum=0.0f;
+				float valueSum=0.0f;
+				for(unsigned int fy=fy0;fy<fyEnd;++fy)
+					for(unsigned int fx=fx0;fx<fxEnd;++fx)
 						{
-						/* Filter the pixel: */
-						float nextLastVal=*colPtr;
-						*colPtr=(lastVal+colPtr[0]*2.0f+colPtr[size[0]])*0.25f;
-						lastVal=nextLastVal;
+						ptrdiff_t index=ptrdiff_t(fy)*fineStride+ptrdiff_t(fx);
+						weightSum+=fine.weights[index];
+						valueSum+=fine.weights[index]*fine.values[index];
 						}
-					
-					/* Filter the last pixel in the column: */
-					*colPtr=(lastVal+colPtr[0]*2.0f)/3.0f;
-					}
-				float* rowPtr=newOutputFrame.getData<float>();
-				for(unsigned int y=0;y<size[1];++y)
+				cvPtr[x]=weightSum>0.0f?valueSum/weightSum:0.0f;
+				cwPtr[x]=weightSum<1.0f?weightSum:1.0f;
+				}
+			}
+		}
+	bandNumHoles[band]=numHoles;
+	}
+
+void FrameFilter::pushBandHoles(unsigned int band)
+	{
+	unsigned int y0,y1;
+	getHoleFillBandRows(band,y0,y1);
+	HoleFillLevel& fine=holeFillLevels[holeFillLevel];
+	const HoleFillLevel& coarse=holeFillLevels[holeFillLevel+1];
+	bool fullResolution=holeFillLevel==0;
+	ptrdiff_t fineStride=ptrdiff_t(fine.size[0]);
+	ptrdiff_t coarseStride=ptrdiff_t(coarse.size[0]);
+	unsigned int numFilled=0;
+	for(unsigned int y=y0;y<y1;++y)
+		{
+		float* fvPtr=fine.values+ptrdiff_t(y)*fineStride;
+		if(!fullResolution||holeRows[y]!=0U)
+			{
+			/* Find the two coarser-level rows bracketing the row's center, and their bilinear weights: */
+			int cy0=(int(y)-1)>>1;
+			int cy1=cy0+1;
+			float wy0=(y&0x1U)!=0U?0.75f:0.25f;
+			float wy1=1.0f-wy0;
+			if(cy0<0)
+				{
+				cy0=0;
+				wy0=0.0f;
+				}
+			if(cy1>=int(coarse.size[1]))
+				{
+				cy1=int(coarse.size[1])-1;
+				wy1=0.0f;
+				}
+			const float* cv0=coarse.values+ptrdiff_t(cy0)*coarseStride;
+			const float* cw0=coarse.weights+ptrdiff_t(cy0)*coarseStride;
+			const float* cv1=coarse.values+ptrdiff_t(cy1)*coarseStride;
+			const float* cw1=coarse.weights+ptrdiff_t(cy1)*coarseStride;
+			
+			/* Blend the row's holes or incompletely covered pixels with the interpolated coarser level: */
+			const unsigned char* hmPtr=fullResolution?holeMask+ptrdiff_t(y)*fineStride:0;
+			float* fwPtr=fullResolution?0:fine.weights+ptrdiff_t(y)*fineStride;
+			for(unsigned int x=0;x<fine.size[0];++x)
+				{
+				float fineWeight=fullResolution?float(hmPtr[x]):fwPtr[x];
+				if(fineWeight<1.0f)
 					{
-					/* Filter the first pixel in the row: */
-					float lastVal=*rowPtr;
-					*rowPtr=(rowPtr[0]*2.0f+rowPtr[1])/3.0f;
-					++rowPtr;
-					
-					/* Filter the interior pixels in the row: */
-					for(unsigned int x=1;x<size[0]-1;++x,++rowPtr)
+					int cx0=(int(x)-1)>>1;
+					int cx1=cx0+1;
+					float wx0=(x&0x1U)!=0U?0.75f:0.25f;
+					float wx1=1.0f-wx0;
+					if(cx0<0)
 						{
-						/* Filter the pixel: */
-						float nextLastVal=*rowPtr;
-						*rowPtr=(lastVal+rowPtr[0]*2.0f+rowPtr[1])*0.25f;
-						lastVal=nextLastVal;
+						cx0=0;
+						wx0=0.0f;
+						}
+					if(cx1>=int(coarse.size[0]))
+						{
+						cx1=int(coarse.size[0])-1;
+						wx1=0.0f;
+						}
+					float w00=cw0[cx0]*wy0*wx0;
+					float w01=cw0[cx1]*wy0*wx1;
+					float w10=cw1[cx0]*wy1*wx0;
+					float w11=cw1[cx1]*wy1*wx1;
+					float weightSum=w00+w01+w10+w11;
+					if(weightSum>0.0f)
+						{
+						float interpolated=(w00*cv0[cx0]+w01*cv0[cx1]+w10*cv1[cx0]+w11*cv1[cx1])/weightSum;
+						if(fullResolution)
+							{
+							fvPtr[x]=interpolated;
+							++numFilled;
+							}
+						else
+							{
+							fvPtr[x]=fineWeight*fvPtr[x]+(1.0f-fineWeight)*interpolated;
+							fwPtr[x]=1.0f;
+							}
 						}
-					
-					/* Filter the last pixel in the row: */
-					*rowPtr=(lastVal+rowPtr[0]*2.0f)/3.0f;
-					++rowPtr;
 					}
 				}
 			}
 		
+		/* Detect changes if the row is a final output row: */
+		if(fullResolution&&!applyCurrentMedianFilter&&!applyCurrentSpatialFilter)
+			detectRowChanges(y,0,size[0],fvPtr);
+		}
+	bandNumFilledHoles[band]=numFilled;
+	}
+
+void FrameFilter::runHoleFillJob(const WorkerPool::BandFunction& bandFunction,unsigned int level)
+	{
+	/* Split the level into as many bands as the frame, but keep bands high enough to be worth a worker thread: */
+	holeFillLevel=level;
+	holeFillNumBands=holeFillLevels[level].size[1]/holeFillMinBandRows;
+	if(holeFillNumBands>numBands)
+		holeFillNumBands=numBands;
+	if(holeFillNumBands<1)
+		holeFillNumBands=1;
+	runBandJob(bandFunction,holeFillNumBands);
+	}
+
+void FrameFilter::fillHoles(void)
+	{
+	double startTime=getMonotonicTime();
+	
+	/* Create the hole filling pyramid on first use: */
+	if(holeMask==0)
+		createHoleFillLevels();
+	holeFillLevels[0].values=currentOutputFrame;
+	
+	/* Find the holes in the output frame while pulling it into the first coarser level: */
+	runHoleFillJob(*pullFunction,1);
+	unsigned int numHoles=0;
+	for(unsigned int band=0;band<holeFillNumBands;++band)
+		numHoles+=bandNumHoles[band];
+	
+	/* Pull depth values further up the pyramid if there are holes, but stop adding coarser levels once half the time budget is spent, leaving the other half to push them back down: */
+	double pullBudget=double(holeFillingBudget)*0.5e-3;
+	unsigned int numLevels=2;
+	if(numHoles!=0U)
+		{
+		for(;numLevels<numHoleFillLevels&&getMonotonicTime()-startTime<pullBudget;++numLevels)
+			runHoleFillJob(*pullFunction,numLevels);
+		
+		/* Push depth values down the pyramid into the coarser levels' incompletely covered pixels: */
+		for(unsigned int level=numLevels-2;level>0;--level)
+			runHoleFillJob(*pushFunction,level);
+		}
+	
+	/* Fill the holes in the output frame, which also detects changes in the final output rows if there is no median or spatial filter: */
+	unsigned int newNumFilledHoles=0;
+	if(numHoles!=0U||!(applyCurrentMedianFilter||applyCurrentSpatialFilter))
+		{
+		runHoleFillJob(*pushFunction,0);
+		for(unsigned int band=0;band<holeFillNumBands;++band)
+			newNumFilledHoles+=bandNumFilledHoles[band];
+		}
+	numFilledHoles=newNumFilledHoles;
+	}
+
+void FrameFilter::runBandJob(const WorkerPool::BandFunction& bandFunction,unsigned int numJobBands)
+	{
+	if(workerPool!=0&&numJobBands>1)
+		{
+		/* Process all bands in parallel: */
+		workerPool->runJob(bandFunction,numJobBands);
+		}
+	else
+		{
+		/* Process all bands on the filtering thread: */
+		for(unsigned int band=0;band<numJobBands;++band)
+			bandFunction(band);
+		}
+	}
+
+
+void FrameFilter::filterFrame(const void* inputFrameData,Kinect::FrameBuffer& outputFrame)
+	{
+	/* Swap in new per-pixel intervals of valid raw depth values; the previous frame's band jobs, the only readers of the current intervals, are finished: */
+	if(__atomic_load_n(&newDepthBoundsReady,__ATOMIC_ACQUIRE))
+		{
+		Threads::Mutex::Lock newDepthBoundsLock(newDepthBoundsMutex);
+		std::swap(integerDepthBounds,newIntegerDepthBounds);
+		std::swap(floatDepthBounds,newFloatDepthBounds);
+		__atomic_store_n(&newDepthBoundsReady,false,__ATOMIC_RELAXED);
+		}
+	
+	/* Re-create the worker pool if the requested number of filter threads changed: */
+	unsigned int newNumThreads=numThreads;
+	if(newNumThreads!=(workerPool!=0?workerPool->getNumWorkers():1U))
+		{
+		delete workerPool;
+		workerPool=newNumThreads>1?new WorkerPool(newNumThreads):0;
+		}
+	
+	/* Pick up the requested median filter radius: */
+	medianKernelRadius=medianFilterRadius;
+	
+	/* Re-create the spatial filter kernel if the requested radius changed: */
+	if(spatialKernelRadius!=spatialFilterRadius)
+		updateSpatialKernel();
+	
+	/* Split frames into one band per filter thread, but keep bands at least two rows high: */
+	numBands=newNumThreads;
+	if(numBands>size[1]/2)
+		numBands=size[1]/2;
+	if(numBands<1)
+		numBands=1;
+	
+	/* Enter the new frame into the averaging buffer and calculate the output frame's pixel values: */
+	applyCurrentMedianFilter=medianFilter;
+	applyCurrentSpatialFilter=spatialFilter;
+	fillCurrentFrame=holeFilling&&numHoleFillLevels>1;
+	fuseCurrentFrame=applyCurrentSpatialFilter&&fuseSpatialFilter&&!fillCurrentFrame&&!applyCurrentMedianFilter;
+	adaptCurrentFrame=motionThreshold>0.0f;
+	currentInputFrame=static_cast<const unsigned char*>(inputFrameData);
+	currentOutputFrame=outputFrame.getData<float>();
+	runBandJob(*temporalFunction);
+	
+	/* Count the pixels that were reset due to motion: */
+	unsigned int newNumFastResets=0;
+	for(unsigned int band=0;band<numBands;++band)
+		newNumFastResets+=bandNumFastResets[band];
+	numFastResets=newNumFastResets;
+	
+	/* Go to the next averaging slot: */
+	if(temporalFilterType==AVERAGING_BUFFER&&++averagingSlotIndex==numAveragingSlots)
+		averagingSlotIndex=0U;
+	
+	/* Fill holes in the output frame before the spatial filter smooths them into their surroundings if requested: */
+	if(fillCurrentFrame)
+		fillHoles();
+	else
+		numFilledHoles=0;
+	
+	/* Reject outliers with a median filter if requested: */
+	if(applyCurrentMedianFilter)
+		{
+		/* Create the median filter buffer on first use: */
+		if(medianBuffer==0)
+			medianBuffer=new float[size[1]*size[0]];
+		
+		/* Filter the output frame into the median filter buffer, and copy the result back unless the spatial filter reads it from there: */
+		runBandJob(*medianFunction);
+		if(!applyCurrentSpatialFilter)
+			runBandJob(*storeMedianFunction);
+		}
+	
+	/* Apply a spatial filter if requested: */
+	if(applyCurrentSpatialFilter)
+		{
+		/* Low-pass filter the output frame horizontally into the spatial filter buffer unless the temporal pass already did, and vertically back into the output frame: */
+		if(!fuseCurrentFrame)
+			runBandJob(*horizontalFunction);
+		runBandJob(*verticalFunction);
+		}
+	
+	/* Combine the per-row change flags into the output frame's tile change mask: */
+	TileChangeMask& changeMask=TileChangeMask::get(outputFrame);
+	changeMask.setFrame(size,outputFrameIndex);
+	++outputFrameIndex;
+	unsigned int numTileColumns=changeMask.getNumTiles()[0];
+	unsigned char* tileRowPtr=changeMask.getTiles();
+	const unsigned char* rtcPtr=rowTileChanges;
+	for(unsigned int y0=0;y0<size[1];y0+=TileChangeMask::tileSize,tileRowPtr+=numTileColumns)
+		{
+		for(unsigned int tx=0;tx<numTileColumns;++tx)
+			tileRowPtr[tx]=0U;
+		unsigned int y1=y0+TileChangeMask::tileSize<size[1]?y0+TileChangeMask::tileSize:size[1];
+		for(unsigned int y=y0;y<y1;++y,rtcPtr+=numTileColumns)
+			for(unsigned int tx=0;tx<numTileColumns;++tx)
+				tileRowPtr[tx]|=rtcPtr[tx];
+		
+		/* Remember the values of all changed tiles, which is what incremental consumers upload, so that small changes in unchanged tiles accumulate until they exceed the hysteresis: */
+		for(unsigned int tx=0;tx<numTileColumns;++tx)
+			if(tileRowPtr[tx]!=0U)
+				{
+				unsigned int x0=tx*TileChangeMask::tileSize;
+				unsigned int x1=x0+TileChangeMask::tileSize<size[0]?x0+TileChangeMask::tileSize:size[0];
+				for(unsigned int y=y0;y<y1;++y)
+					{
+					const float* ofRowPtr=currentOutputFrame+ptrdiff_t(y)*ptrdiff_t(size[0]);
+					float* pobRowPtr=previousOutputBuffer+ptrdiff_t(y)*ptrdiff_t(size[0]);
+					for(unsigned int x=x0;x<x1;++x)
+						pobRowPtr[x]=ofRowPtr[x];
+					}
+				}
+		}
+	}
+
+void* FrameFilter::filterThreadMethod(void)
+	{
+	/* Process raw depth frames until the input queue is shut down: */
+	Kinect::FrameBuffer frame;
+	while(inputFrames.waitAndPop(frame))
+		{
+		/* Prepare a new output frame: */
+		Kinect::FrameBuffer& newOutputFrame=outputFrames.startNewValue();
+		
+		/* Filter the new frame: */
+		filterFrame(frame.getData<unsigned char>(),newOutputFrame);
+		__atomic_store_n(&numProcessedFrames,numProcessedFrames+1,__ATOMIC_RELAXED);
+		
 		/* Finalize the new output frame in the output buffer: */
 		outputFrames.postNewValue();
 		
@@ -208,39 +1809,46 @@ void* FrameFilter::filterThreadMethod(void)
 	return 0;
 	}
 
-FrameFilter::FrameFilter(const unsigned int sSize[2],unsigned int sNumAveragingSlots,const FrameFilter::PixelDepthCorrection* sPixelDepthCorrection,const PTransform& depthProjection,const Plane& basePlane)
+FrameFilter::FrameFilter(const unsigned int sSize[2],unsigned int sNumAveragingSlots,FrameFilter::TemporalFilterType sTemporalFilterType,FrameFilter::DepthPixelFormat sPixelFormat,const FrameFilter::PixelDepthCorrection* sPixelDepthCorrection,const PTransform& depthProjection,const Plane& basePlane)
 	:pixelDepthCorrection(sPixelDepthCorrection),
+	 inputFrames(inputQueueCapacity),numProcessedFrames(0),
+	 pixelFormat(sPixelFormat),pixelSize(0),
+	 integerDepthBounds(0),floatDepthBounds(0),
+	 newIntegerDepthBounds(0),newFloatDepthBounds(0),newDepthBoundsReady(false),
+	 temporalFilterType(sTemporalFilterType),
 	 averagingBuffer(0),
-	 statBuffer(0),
+	 statBuffer(0),numSamplesBuffer(0),sumBuffer(0),sumSqBuffer(0),
+	 estimateBuffer(0),meanBuffer(0),varianceBuffer(0),gainTable(0),
+	 motionBuffer(0),bandNumFastResets(0),numFastResets(0),
+	 spatialKernel(0),
+	 holeFillLevels(0),holeMask(0),holeRows(0),bandNumHoles(0),bandNumFilledHoles(0),numFilledHoles(0),
+	 medianBuffer(0),spatialBuffer(0),previousOutputBuffer(0),rowTileChanges(0),
+	 numThreads(1),workerPool(0),numBands(1),
+	 applyCurrentMedianFilter(false),applyCurrentSpatialFilter(false),fuseCurrentFrame(false),adaptCurrentFrame(false),fillCurrentFrame(false),currentInputFrame(0),currentOutputFrame(0),
+	 temporalFunction(0),medianFunction(0),storeMedianFunction(0),horizontalFunction(0),verticalFunction(0),pullFunction(0),pushFunction(0),
 	 outputFrameFunction(0)
 	{
 	/* Remember the frame size: */
 	for(int i=0;i<2;++i)
 		size[i]=sSize[i];
 	
-	/* Initialize the input frame slot: */
-	inputFrameVersion=0;
-	
-	/* Initialize the valid depth range: */
-	setValidDepthInterval(0U,2046U);
-	
-	/* Initialize the averaging buffer: */
-	numAveragingSlots=sNumAveragingSlots;
-	averagingBuffer=new RawDepth[numAveragingSlots*size[1]*size[0]];
-	RawDepth* abPtr=averagingBuffer;
-	for(unsigned int i=0;i<numAveragingSlots;++i)
-		for(unsigned int y=0;y<size[1];++y)
-			for(unsigned int x=0;x<size[0];++x,++abPtr)
-				*abPtr=2048U; // Mark sample as invalid
+	/* Create the valid depth range, which initially accepts all raw depth values that can be valid, and the temporal filter's state for the pixel format: */
+	numAveragingSlots=sNumAveragingSlots>0?sNumAveragingSlots:1;
 	averagingSlotIndex=0U;
-	
-	/* Initialize the statistics buffer: */
-	statBuffer=new unsigned int[size[1]*size[0]*3];
-	unsigned int* sbPtr=statBuffer;
-	for(unsigned int y=0;y<size[1];++y)
-		for(unsigned int x=0;x<size[0];++x)
-			for(int i=0;i<3;++i,++sbPtr)
-				*sbPtr=0;
+	switch(pixelFormat)
+		{
+		case KINECT_DEPTH:
+			initPixelFormat<KinectDepthPixels>();
+			break;
+		
+		case MILLIMETER_DEPTH:
+			initPixelFormat<MillimeterDepthPixels>();
+			break;
+		
+		case FLOAT_DEPTH:
+			initPixelFormat<FloatDepthPixels>();
+			break;
+		}
 	
 	/* Initialize the stability criterion: */
 	minNumSamples=(numAveragingSlots+1)/2;
@@ -249,8 +1857,55 @@ FrameFilter::FrameFilter(const unsigned int sSize[2],unsigned int sNumAveragingS
 	retainValids=true;
 	instableValue=0.0;
 	
-	/* Enable spatial filtering: */
+	/* Disable motion adaptation: */
+	motionThreshold=0.0f;
+	numMotionFrames=2;
+	motionBuffer=new unsigned char[size[1]*size[0]];
+	for(unsigned int i=0;i<size[1]*size[0];++i)
+		motionBuffer[i]=0U;
+	bandNumFastResets=new unsigned int[size[1]/2+1];
+	for(unsigned int i=0;i<size[1]/2+1;++i)
+		bandNumFastResets[i]=0;
+	
+	/* Disable median filtering, but default to 3x3 neighborhoods: */
+	medianFilter=false;
+	medianFilterRadius=1;
+	medianKernelRadius=1;
+	
+	/* Enable spatial filtering with a kernel of radius 2, fused with the temporal filter: */
 	spatialFilter=true;
+	fuseSpatialFilter=true;
+	spatialFilterRadius=2;
+	updateSpatialKernel();
+	
+	/* Disable hole filling, and prepare the levels of the hole filling pyramid, from full resolution down to a single pixel: */
+	holeFilling=false;
+	holeFillingBudget=2.0f;
+	numHoleFillLevels=1;
+	for(unsigned int w=size[0],h=size[1];w>1||h>1;w=(w+1)/2,h=(h+1)/2)
+		++numHoleFillLevels;
+	holeFillLevels=new HoleFillLevel[numHoleFillLevels];
+	for(unsigned int level=0;level<numHoleFillLevels;++level)
+		{
+		HoleFillLevel& hfl=holeFillLevels[level];
+		for(int i=0;i<2;++i)
+			hfl.size[i]=level>0?(holeFillLevels[level-1].size[i]+1)/2:size[i];
+		hfl.values=0;
+		hfl.weights=0;
+		}
+	holeFillLevel=0;
+	holeFillNumBands=1;
+	bandNumHoles=new unsigned int[size[1]/2+1];
+	bandNumFilledHoles=new unsigned int[size[1]/2+1];
+	for(unsigned int i=0;i<size[1]/2+1;++i)
+		{
+		bandNumHoles[i]=0;
+		bandNumFilledHoles[i]=0;
+		}
+	
+	/* Select the fastest supported filter kernel: */
+	vectorize=true;
+	selectFilterKernels();
 	
 	/* Convert the base plane equation from camera space to depth-image space: */
 	PTransform::HVector basePlaneCc(basePlane.getNormal());
@@ -265,35 +1920,130 @@ FrameFilter::FrameFilter(const unsigned int sSize[2],unsigned int sNumAveragingS
 		for(unsigned int x=0;x<size[0];++x,++vbPtr)
 			*vbPtr=float(-((double(x)+0.5)*basePlaneDic[0]+(double(y)+0.5)*basePlaneDic[1]+basePlaneDic[3])/basePlaneDic[2]);
 	
+	/* Initialize the spatial filter buffer: */
+	spatialBuffer=new float[size[1]*size[0]];
+	
+	/* Initialize the previous output frame such that all tiles of the first output frame are marked as changed: */
+	previousOutputBuffer=new float[size[1]*size[0]];
+	for(unsigned int i=0;i<size[1]*size[0];++i)
+		previousOutputBuffer[i]=Math::Constants<float>::max;
+	rowTileChanges=new unsigned char[size[1]*TileChangeMask::getNumTiles(size[0])];
+	outputFrameIndex=0;
+	
+	/* Create the band processing functions: */
+	temporalFunction=Misc::createFunctionCall(this,&FrameFilter::filterBandTemporal);
+	medianFunction=Misc::createFunctionCall(this,&FrameFilter::filterBandMedian);
+	storeMedianFunction=Misc::createFunctionCall(this,&FrameFilter::storeBandMedian);
+	horizontalFunction=Misc::createFunctionCall(this,&FrameFilter::filterBandHorizontal);
+	verticalFunction=Misc::createFunctionCall(this,&FrameFilter::filterBandVertical);
+	pullFunction=Misc::createFunctionCall(this,&FrameFilter::pullBandHoles);
+	pushFunction=Misc::createFunctionCall(this,&FrameFilter::pushBandHoles);
+	
 	/* Initialize the output frame buffer: */
 	for(int i=0;i<3;++i)
-		outputFrames.getBuffer(i)=Kinect::FrameBuffer(size[0],size[1],size[1]*size[0]*sizeof(float));
+		outputFrames.getBuffer(i)=createOutputFrame();
 	
 	/* Start the filtering thread: */
-	runFilterThread=true;
 	filterThread.start(this,&FrameFilter::filterThreadMethod);
 	}
 
 FrameFilter::~FrameFilter(void)
 	{
 	/* Shut down the filtering thread: */
-	{
-	Threads::MutexCond::Lock inputLock(inputCond);
-	runFilterThread=false;
-	inputCond.signal();
-	}
+	inputFrames.shutDown();
 	filterThread.join();
 	
+	/* Shut down the worker threads: */
+	delete workerPool;
+	delete temporalFunction;
+	delete medianFunction;
+	delete storeMedianFunction;
+	delete horizontalFunction;
+	delete verticalFunction;
+	delete pullFunction;
+	delete pushFunction;
+	
 	/* Release all allocated buffers: */
+	delete integerDepthBounds;
+	delete floatDepthBounds;
+	delete newIntegerDepthBounds;
+	delete newFloatDepthBounds;
 	delete[] averagingBuffer;
 	delete[] statBuffer;
+	delete[] estimateBuffer;
+	delete[] gainTable;
+	delete[] motionBuffer;
+	delete[] bandNumFastResets;
 	delete[] validBuffer;
+	delete[] spatialKernel;
+	for(unsigned int level=1;level<numHoleFillLevels;++level)
+		{
+		delete[] holeFillLevels[level].values;
+		delete[] holeFillLevels[level].weights;
+		}
+	delete[] holeFillLevels;
+	delete[] holeMask;
+	delete[] holeRows;
+	delete[] bandNumHoles;
+	delete[] bandNumFilledHoles;
+	delete[] medianBuffer;
+	delete[] spatialBuffer;
+	delete[] previousOutputBuffer;
+	delete[] rowTileChanges;
 	delete outputFrameFunction;
 	}
 
+const char* FrameFilter::getPixelFormatName(FrameFilter::DepthPixelFormat pixelFormat)
+	{
+	switch(pixelFormat)
+		{
+		case KINECT_DEPTH:
+			return KinectDepthPixels::getName();
+		
+		case MILLIMETER_DEPTH:
+			return MillimeterDepthPixels::getName();
+		
+		case FLOAT_DEPTH:
+			return FloatDepthPixels::getName();
+		}
+	
+	return 0;
+	}
+
+bool FrameFilter::parsePixelFormat(const char* name,FrameFilter::DepthPixelFormat& pixelFormat)
+	{
+	static const DepthPixelFormat pixelFormats[3]={KINECT_DEPTH,MILLIMETER_DEPTH,FLOAT_DEPTH};
+	for(int i=0;i<3;++i)
+		if(strcasecmp(name,getPixelFormatName(pixelFormats[i]))==0)
+			{
+			pixelFormat=pixelFormats[i];
+			return true;
+			}
+	
+	return false;
+	}
+
+bool FrameFilter::parseNumThreads(const char* string,unsigned int& numThreads)
+	{
+	return WorkerPool::parseNumWorkers(string,1,numThreads);
+	}
+
+bool FrameFilter::parseSpatialFilterRadius(const char* string,unsigned int& spatialFilterRadius)
+	{
+	/* Parse the entire string as a decimal number and check it against the valid range: */
+	char* end;
+	long value=strtol(string,&end,10);
+	if(end==string||*end!='\0'||value<0||value>long(maxSpatialFilterRadius))
+		return false;
+	
+	spatialFilterRadius=(unsigned int)(value);
+	return true;
+	}
+
 void FrameFilter::setValidDepthInterval(unsigned int newMinDepth,unsigned int newMaxDepth)
 	{
 	/* Set the equations for the minimum and maximum plane in depth image space: */
+	float minPlane[4],maxPlane[4];
 	minPlane[0]=0.0f;
 	minPlane[1]=0.0f;
 	minPlane[2]=1.0f;
@@ -302,6 +2052,9 @@ void FrameFilter::setValidDepthInterval(unsigned int newMinDepth,unsigned int ne
 	maxPlane[1]=0.0f;
 	maxPlane[2]=1.0f;
 	maxPlane[3]=-float(newMaxDepth)-0.5f;
+	
+	/* Update the per-pixel intervals of valid raw depth values: */
+	setValidDepthPlanes(minPlane,maxPlane);
 	}
 
 void FrameFilter::setValidElevationInterval(const PTransform& depthProjection,const Plane& basePlane,double newMinElevation,double newMaxElevation)
@@ -313,6 +2066,7 @@ void FrameFilter::setValidElevationInterval(const PTransform& depthProjection,co
 	maxPlaneCc[3]=-(basePlane.getOffset()+newMaxElevation*basePlane.getNormal().mag());
 	
 	/* Transform the plane equations to depth image space and flip and swap the min and max planes because elevation increases opposite to raw depth: */
+	float minPlane[4],maxPlane[4];
 	PTransform::HVector minPlaneDic(depthProjection.getMatrix().transposeMultiply(minPlaneCc));
 	double minPlaneScale=-1.0/Geometry::mag(minPlaneDic.toVector());
 	for(int i=0;i<4;++i)
@@ -321,6 +2075,9 @@ void FrameFilter::setValidElevationInterval(const PTransform& depthProjection,co
 	double maxPlaneScale=-1.0/Geometry::mag(maxPlaneDic.toVector());
 	for(int i=0;i<4;++i)
 		minPlane[i]=float(maxPlaneDic[i]*maxPlaneScale);
+	
+	/* Update the per-pixel intervals of valid raw depth values: */
+	setValidDepthPlanes(minPlane,maxPlane);
 	}
 
 void FrameFilter::setStableParameters(unsigned int newMinNumSamples,unsigned int newMaxVariance)
@@ -344,25 +2101,84 @@ void FrameFilter::setInstableValue(float newInstableValue)
 	instableValue=newInstableValue;
 	}
 
+void FrameFilter::setMotionAdaptive(float newMotionThreshold,unsigned int newNumMotionFrames)
+	{
+	/* Limit the number of frames to what fits into a pixel's motion state: */
+	if(newNumMotionFrames<1)
+		newNumMotionFrames=1;
+	if(newNumMotionFrames>0x7fU)
+		newNumMotionFrames=0x7fU;
+	numMotionFrames=newNumMotionFrames;
+	motionThreshold=newMotionThreshold>0.0f?newMotionThreshold:0.0f;
+	}
+
+void FrameFilter::setHoleFilling(bool newHoleFilling)
+	{
+	holeFilling=newHoleFilling;
+	}
+
+void FrameFilter::setHoleFillingBudget(float newHoleFillingBudget)
+	{
+	holeFillingBudget=newHoleFillingBudget>0.0f?newHoleFillingBudget:0.0f;
+	}
+
+void FrameFilter::setMedianFilter(bool newMedianFilter)
+	{
+	medianFilter=newMedianFilter;
+	}
+
+void FrameFilter::setMedianFilterRadius(unsigned int newMedianFilterRadius)
+	{
+	/* Only 3x3 and 5x5 neighborhoods have selection networks: */
+	medianFilterRadius=newMedianFilterRadius<1?1:(newMedianFilterRadius>2?2:newMedianFilterRadius);
+	}
+
 void FrameFilter::setSpatialFilter(bool newSpatialFilter)
 	{
 	spatialFilter=newSpatialFilter;
 	}
 
+void FrameFilter::setSpatialFilterRadius(unsigned int newSpatialFilterRadius)
+	{
+	/* Request the new radius; the filtering thread will re-create the kernel before processing the next frame: */
+	spatialFilterRadius=newSpatialFilterRadius>maxSpatialFilterRadius?maxSpatialFilterRadius:newSpatialFilterRadius;
+	}
+
+void FrameFilter::setFuseSpatialFilter(bool newFuseSpatialFilter)
+	{
+	fuseSpatialFilter=newFuseSpatialFilter;
+	}
+
+void FrameFilter::setNumThreads(unsigned int newNumThreads)
+	{
+	/* Request the new number of threads; the filtering thread will re-create its worker pool before processing the next frame: */
+	if(newNumThreads<1)
+		numThreads=1;
+	else if(newNumThreads>maxNumThreads)
+		numThreads=maxNumThreads;
+	else
+		numThreads=newNumThreads;
+	}
+
+void FrameFilter::setVectorized(bool newVectorize)
+	{
+	vectorize=newVectorize;
+	selectFilterKernels();
+	}
+
 void FrameFilter::setOutputFrameFunction(FrameFilter::OutputFrameFunction* newOutputFrameFunction)
 	{
 	delete outputFrameFunction;
 	outputFrameFunction=newOutputFrameFunction;
 	}
 
+void FrameFilter::filterFrame(const Kinect::FrameBuffer& rawFrame,Kinect::FrameBuffer& filteredFrame)
+	{
+	filterFrame(rawFrame.getData<unsigned char>(),filteredFrame);
+	}
+
 void FrameFilter::receiveRawFrame(const Kinect::FrameBuffer& newFrame)
 	{
-	Threads::MutexCond::Lock inputLock(inputCond);
-	
-	/* Store the new buffer in the input buffer: */
-	inputFrame=newFrame;
-	++inputFrameVersion;
-	
-	/* Signal the background thread: */
-	inputCond.signal();
+	/* Queue the new frame for the background thread: */
+	inputFrames.push(newFrame);
 	}
@@ -24,13 +24,26 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #ifndef FRAMEFILTER_INCLUDED
 #define FRAMEFILTER_INCLUDED
 
+#include <stddef.h>
+#include <Threads/Mutex.h>
 #include <Threads/Thread.h>
-#include <Threads/MutexCond.h>
 #include <Threads/TripleBuffer.h>
 #include <Kinect/FrameBuffer.h>
 #include <Kinect/FrameSource.h>
 
 #include "Types.h"
+#include "WorkerPool.h"
+#include "DepthPixelFormats.h"
+#include "ValidDepthBounds.h"
+#include "TileChangeMask.h"
+#include "FrameRing.h"
+
+/* Use vectorized filter kernels on x86 CPUs when compiling with GCC or a compatible compiler: */
+#if defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#define FRAMEFILTER_USE_X86_KERNELS 1
+#else
+#define FRAMEFILTER_USE_X86_KERNELS 0
+#endif
 
 /* Forward declarations: */
 namespace Misc {
@@ -42,54 +55,293 @@ class FrameFilter
 	{
 	/* Embedded classes: */
 	public:
-	typedef unsigned short RawDepth; // Data type for raw depth values
+	typedef KinectDepthPixels::Pixel RawDepth; // Data type for raw depth values in the default pixel format
 	typedef float FilteredDepth; // Data type for filtered depth values
 	typedef Misc::FunctionCall<const Kinect::FrameBuffer&> OutputFrameFunction; // Type for functions called when a new output frame is ready
 	typedef Kinect::FrameSource::DepthCorrection::PixelCorrection PixelDepthCorrection; // Type for per-pixel depth correction factors
+	static const unsigned int maxNumThreads=WorkerPool::maxNumWorkers; // Maximum number of threads filtering each frame
+	static const unsigned int maxSpatialFilterRadius=16; // Maximum radius of the spatial filter's Gaussian kernel
+	
+	enum TemporalFilterType // Enumerated type for temporal filter algorithms
+		{
+		AVERAGING_BUFFER, // Running average over a sliding window of the most recent frames
+		RECURSIVE_ESTIMATOR // Recursive estimate of each pixel's mean and variance with constant state per pixel
+		};
+	
+	enum DepthPixelFormat // Enumerated type for formats of raw depth pixels, see DepthPixelFormats.h
+		{
+		KINECT_DEPTH, // 11-bit raw disparity values from first-generation Kinect cameras
+		MILLIMETER_DEPTH, // 16-bit depth values in millimeters
+		FLOAT_DEPTH // 32-bit floating-point depth values
+		};
+	
+	private:
+	typedef void (FrameFilter::*RowFilterMethod)(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr); // Type for methods entering a partial row of a new frame in the current pixel format into the averaging buffer
+	typedef unsigned int (FrameFilter::*AdaptRowMethod)(unsigned int y,const void* ifRowPtr,float* nofRowPtr); // Type for methods resetting pixels indicating motion in a row of a new frame in the current pixel format
+	typedef void (*SpanFilterFunction)(const float* sPtr,ptrdiff_t tapStride,const float* weights,int numTaps,float* dPtr,unsigned int spanLength); // Type for functions convolving a span of pixels with a one-dimensional kernel whose taps are the given stride apart
+	typedef void (*MedianSpanFunction)(const float* const* sRowPtrs,unsigned int filterSize,float* dPtr,unsigned int spanLength); // Type for functions replacing a span of pixels by the medians of their square neighborhoods, whose rows start at the given source row pointers
+	
+	struct HoleFillLevel // Structure for a level of the hole filling pyramid
+		{
+		/* Elements: */
+		public:
+		unsigned int size[2]; // Width and height of the level
+		float* values; // Plane of the level's depth values, normalized by their weights; the full-resolution level uses the output frame
+		float* weights; // Plane of the level's weights in [0, 1]; null for the full-resolution level, which uses the hole mask
+		};
 	
 	/* Elements: */
 	private:
 	unsigned int size[2]; // Width and height of processed frames
 	const PixelDepthCorrection* pixelDepthCorrection; // Buffer of per-pixel depth correction coefficients
-	Threads::MutexCond inputCond; // Condition variable to signal arrival of a new input frame
-	Kinect::FrameBuffer inputFrame; // The most recent input frame
-	unsigned int inputFrameVersion; // Version number of input frame
-	volatile bool runFilterThread; // Flag to keep the background filtering thread running
+	FrameRing inputFrames; // Lock-free queue handing raw depth frames from the camera's streaming thread to the background filtering thread
+	unsigned int numProcessedFrames; // Number of raw depth frames processed by the background filtering thread
 	Threads::Thread filterThread; // The background filtering thread
-	float minPlane[4]; // Plane equation of the lower bound of valid depth values in depth image space
-	float maxPlane[4]; // Plane equation of the upper bound of valid depth values in depth image space
-	unsigned int numAveragingSlots; // Number of slots in each pixel's averaging buffer
-	RawDepth* averagingBuffer; // Buffer to calculate running averages of each pixel's depth value
+	DepthPixelFormat pixelFormat; // Format of raw depth pixels
+	size_t pixelSize; // Size of a raw depth pixel in bytes
+	ValidDepthBounds<unsigned short>* integerDepthBounds; // Per-pixel intervals of raw depth values between the lower and upper bounds of valid depth values for integer pixel formats
+	ValidDepthBounds<float>* floatDepthBounds; // Ditto, for floating-point pixel formats
+	Threads::Mutex newDepthBoundsMutex; // Mutex serializing updates of the pending per-pixel intervals of valid raw depth values with swapping them in
+	ValidDepthBounds<unsigned short>* newIntegerDepthBounds; // Pending per-pixel intervals for integer pixel formats, swapped with the current intervals before the next frame is filtered
+	ValidDepthBounds<float>* newFloatDepthBounds; // Ditto, for floating-point pixel formats
+	bool newDepthBoundsReady; // Flag whether the pending per-pixel intervals hold new values; only accessed atomically
+	TemporalFilterType temporalFilterType; // Algorithm used to filter each pixel's depth values over time
+	unsigned int numAveragingSlots; // Number of slots in each pixel's averaging buffer, or equivalent window length of the recursive estimator
+	unsigned char* averagingBuffer; // Buffer of samples of the pixel format's sample type to calculate running averages of each pixel's depth value; null for the recursive estimator
 	unsigned int averagingSlotIndex; // Index of averaging slot in which to store the next frame's depth values
-	unsigned int* statBuffer; // Buffer retaining the running means and variances of each pixel's depth value
+	unsigned char* statBuffer; // Buffer retaining the running means and variances of each pixel's depth value, stored as separate planes
+	unsigned int* numSamplesBuffer; // Plane of numbers of valid samples in each pixel's averaging buffer
+	void* sumBuffer; // Plane of sums of valid samples of the pixel format's sum type
+	void* sumSqBuffer; // Plane of sums of squares of valid samples of the pixel format's squared sum type
+	float* estimateBuffer; // Buffer retaining the recursive estimator's running means and variances of each pixel's depth value, stored as two separate planes
+	float* meanBuffer; // Plane of estimated means
+	float* varianceBuffer; // Plane of estimated variances
+	float* gainTable; // Table of recursive estimator gains indexed by number of valid samples
 	unsigned int minNumSamples; // Minimum number of valid samples needed to consider a pixel stable
 	unsigned int maxVariance; // Maximum variance to consider a pixel stable
 	float hysteresis; // Amount by which a new filtered value has to differ from the current value to update
 	bool retainValids; // Flag whether to retain previous stable values if a new pixel in instable, or reset to a default value
 	float instableValue; // Value to assign to instable pixels if retainValids is false
+	float motionThreshold; // Amount by which a valid new depth-corrected sample has to differ from a pixel's current value to indicate motion; 0 disables motion adaptation
+	unsigned int numMotionFrames; // Number of consecutive frames in which a pixel has to indicate motion to reset its temporal filter
+	unsigned char* motionBuffer; // Buffer holding each pixel's number of consecutive frames indicating motion, and a flag whether the pixel is recovering from a reset
+	unsigned int* bandNumFastResets; // Array of numbers of pixels reset due to motion in each band of the current frame
+	volatile unsigned int numFastResets; // Number of pixels reset due to motion in the most recently filtered frame
+	bool medianFilter; // Flag whether to replace time-averaged depth values by the medians of their neighborhoods to reject outliers
+	volatile unsigned int medianFilterRadius; // Requested radius of the median filter's square neighborhood, either 1 or 2
+	unsigned int medianKernelRadius; // Radius of the median filter's neighborhood applied to the current frame
 	bool spatialFilter; // Flag whether to apply a spatial filter to time-averaged depth values
+	bool fuseSpatialFilter; // Flag whether to run the spatial filter's horizontal pass on each row right after the temporal filter
+	volatile unsigned int spatialFilterRadius; // Requested radius of the spatial filter's separable Gaussian kernel
+	unsigned int spatialKernelRadius; // Radius of the current spatial filter kernel
+	float* spatialKernel; // Normalized weights of the current spatial filter kernel
+	bool holeFilling; // Flag whether to fill holes in the temporally filtered frame before the spatial filter
+	float holeFillingBudget; // Time budget for hole filling per frame in milliseconds
+	unsigned int numHoleFillLevels; // Number of levels in the hole filling pyramid, from full resolution down to a single pixel
+	HoleFillLevel* holeFillLevels; // Array of levels of the hole filling pyramid; coarser levels are created on first use
+	unsigned char* holeMask; // Buffer of flags marking pixels of the current output frame that hold valid depth values
+	unsigned char* holeRows; // Array of flags marking rows of the current output frame that contain holes
+	unsigned int* bandNumHoles; // Array of numbers of holes in each band of the current frame
+	unsigned int holeFillLevel; // Pyramid level processed by the current hole filling band job
+	unsigned int holeFillNumBands; // Number of horizontal bands into which the current hole filling job splits its pyramid level
+	unsigned int* bandNumFilledHoles; // Array of numbers of holes filled in each band of the current frame
+	volatile unsigned int numFilledHoles; // Number of holes filled in the most recently filtered frame
 	float* validBuffer; // Buffer holding the most recent stable depth value for each pixel
+	bool vectorize; // Flag whether to use a vectorized filter kernel if supported by the CPU
+	RowFilterMethod rowFilterMethod; // Method to filter one row of a new frame, selected based on pixel format and CPU features
+	bool vectorizedRowFilter; // Flag whether the row filter method is vectorized
+	AdaptRowMethod adaptRowMethod; // Method to reset pixels indicating motion in one row of a new frame, selected based on pixel format
+	SpanFilterFunction spanFilterFunction; // Function to apply the spatial filter kernel to a span of pixels, selected based on CPU features
+	MedianSpanFunction medianSpanFunction; // Function to apply the median filter to a span of pixels, selected based on CPU features
+	float* medianBuffer; // Buffer holding the result of the median filter; created on first use
+	float* spatialBuffer; // Intermediate buffer holding the result of the spatial filter's horizontal pass
+	float* previousOutputBuffer; // Buffer holding the output values of each tile as of the last frame in which the tile was flagged as changed, i.e., the values incremental consumers hold
+	unsigned char* rowTileChanges; // Buffer of flags marking for each row of the current output frame which tile columns changed
+	unsigned int outputFrameIndex; // Index of the next output frame
+	volatile unsigned int numThreads; // Requested number of threads to filter frames in horizontal bands
+	WorkerPool* workerPool; // Pool of worker threads to filter bands in parallel, or null if frames are filtered by the filtering thread alone
+	unsigned int numBands; // Number of horizontal bands into which frames are split
+	bool applyCurrentMedianFilter; // Flag whether the median filter is applied to the current frame
+	bool applyCurrentSpatialFilter; // Flag whether the spatial filter is applied to the current frame
+	bool fuseCurrentFrame; // Flag whether the temporal filter runs the spatial filter's horizontal pass on the current frame
+	bool adaptCurrentFrame; // Flag whether the temporal filter resets pixels indicating motion in the current frame
+	bool fillCurrentFrame; // Flag whether holes are filled in the current frame
+	const unsigned char* currentInputFrame; // Input frame currently being filtered
+	float* currentOutputFrame; // Output frame currently being filtered
+	WorkerPool::BandFunction* temporalFunction; // Function entering one band of the current input frame into the averaging buffer
+	WorkerPool::BandFunction* medianFunction; // Function applying the median filter to one band
+	WorkerPool::BandFunction* storeMedianFunction; // Function copying one band of the median filter's result back into the output frame
+	WorkerPool::BandFunction* horizontalFunction; // Function applying the spatial filter's horizontal pass to one band
+	WorkerPool::BandFunction* verticalFunction; // Function applying the spatial filter's vertical pass to one band
+	WorkerPool::BandFunction* pullFunction; // Function pulling one band of a hole filling pyramid level from the next-finer level
+	WorkerPool::BandFunction* pushFunction; // Function pushing depth values from the next-coarser hole filling pyramid level into one band of a level
 	Threads::TripleBuffer<Kinect::FrameBuffer> outputFrames; // Triple buffer of output frames
 	OutputFrameFunction* outputFrameFunction; // Function called when a new output frame is ready
 	
 	/* Private methods: */
+	template <class DepthParam>
+	const ValidDepthBounds<DepthParam>& getValidDepthBounds(void) const; // Returns the per-pixel intervals of valid raw depth values of the given type
+	template <class PixelFormatParam>
+	typename PixelFormatParam::Sample* getAveragingSlot(unsigned int slotIndex) const // Returns the given slot of the averaging buffer
+		{
+		return reinterpret_cast<typename PixelFormatParam::Sample*>(averagingBuffer)+ptrdiff_t(slotIndex)*ptrdiff_t(size[1])*ptrdiff_t(size[0]);
+		}
+	template <class PixelFormatParam>
+	typename PixelFormatParam::Sum* getSumBuffer(void) const // Returns the plane of sums of valid samples
+		{
+		return static_cast<typename PixelFormatParam::Sum*>(sumBuffer);
+		}
+	template <class PixelFormatParam>
+	typename PixelFormatParam::SumSq* getSumSqBuffer(void) const // Returns the plane of sums of squares of valid samples
+		{
+		return static_cast<typename PixelFormatParam::SumSq*>(sumSqBuffer);
+		}
+	template <class PixelFormatParam>
+	void initPixelFormat(void); // Creates the valid depth bounds and the temporal filter's buffers for the given pixel format
+	void setValidDepthPlanes(const float minPlane[4],const float maxPlane[4]); // Calculates new per-pixel intervals of valid raw depth values from the given plane equations in depth image space, which take effect with the next filtered frame
+	template <class PixelFormatParam>
+	void selectScalarKernels(void); // Selects the scalar row filter and motion adaptation methods for the given pixel format
+	void selectFilterKernels(void); // Selects the fastest row filter method and span filter function supported by the pixel format and the CPU
+	template <class PixelFormatParam>
+	void filterRowScalar(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr); // Filters the given row of a new frame in the given pixel format from the given column to the end using scalar code
+	#if FRAMEFILTER_USE_X86_KERNELS
+	void filterRowSSE41(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr); // Ditto, for Kinect pixels, eight pixels at a time using SSE4.1 instructions
+	void filterRowAVX2(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr); // Ditto, for Kinect pixels, eight pixels at a time using AVX2 instructions
+	void filterRowMillimeterAVX2(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr); // Ditto, for millimeter pixels, eight pixels at a time using AVX2 instructions
+	#endif
+	template <class PixelFormatParam>
+	void filterRowRecursive(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr); // Filters the given row of a new frame in the given pixel format from the given column to the end using the recursive estimator
+	#if FRAMEFILTER_USE_X86_KERNELS
+	template <class PixelFormatParam>
+	void filterRowRecursiveAVX2(unsigned int y,unsigned int xStart,const void* ifRowPtr,float* nofRowPtr); // Ditto, eight pixels at a time using AVX2 instructions
+	#endif
+	static void filterSpanScalar(const float* sPtr,ptrdiff_t tapStride,const float* weights,int numTaps,float* dPtr,unsigned int spanLength); // Convolves a span of pixels with the given kernel using scalar code
+	#if FRAMEFILTER_USE_X86_KERNELS
+	static void filterSpanSSE(const float* sPtr,ptrdiff_t tapStride,const float* weights,int numTaps,float* dPtr,unsigned int spanLength); // Ditto, 16 pixels at a time using SSE instructions
+	static void filterSpanAVX(const float* sPtr,ptrdiff_t tapStride,const float* weights,int numTaps,float* dPtr,unsigned int spanLength); // Ditto, 32 pixels at a time using AVX instructions
+	#endif
+	static void medianSpanScalar(const float* const* sRowPtrs,unsigned int filterSize,float* dPtr,unsigned int spanLength); // Replaces a span of pixels by the medians of their 3x3 or 5x5 neighborhoods using scalar code
+	#if FRAMEFILTER_USE_X86_KERNELS
+	static void medianSpanSSE(const float* const* sRowPtrs,unsigned int filterSize,float* dPtr,unsigned int spanLength); // Ditto, four pixels at a time using SSE instructions
+	static void medianSpanAVX(const float* const* sRowPtrs,unsigned int filterSize,float* dPtr,unsigned int spanLength); // Ditto, eight pixels at a time using AVX instructions
+	#endif
+	void getBandRows(unsigned int band,unsigned int& y0,unsigned int& y1) const; // Returns the half-open range of rows covered by the given band
+	template <class PixelFormatParam>
+	void resetPixel(ptrdiff_t pixelOffset,typename PixelFormatParam::Pixel newVal); // Resets the temporal filter state of the given pixel to the given most recent raw depth value
+	template <class PixelFormatParam>
+	unsigned int adaptRowToMotion(unsigned int y,const void* ifRowPtr,float* nofRowPtr); // Resets pixels of the given filtered row of a new frame in the given pixel format that indicate motion; returns the number of reset pixels
+	void filterBandTemporal(unsigned int band); // Enters the given band of the current input frame into the averaging buffer
+	void filterRowMedian(unsigned int y,float* dRowPtr) const; // Applies the median filter to the given row of the output frame and writes the result to the given destination row
+	void filterBandMedian(unsigned int band); // Applies the median filter to the given band of the output frame
+	void storeBandMedian(unsigned int band); // Copies the given band of the median filter's result back into the output frame
+	void updateSpatialKernel(void); // Re-creates the spatial filter kernel for the requested radius
+	void filterRowHorizontal(const float* sRowPtr,float* dRowPtr) const; // Applies the spatial filter kernel to the given source row and writes the result to the given destination row
+	void filterBandHorizontal(unsigned int band); // Applies the spatial filter's horizontal pass to the given band
+	void filterBandVertical(unsigned int band); // Applies the spatial filter's vertical pass to the given band
+	void detectRowChanges(unsigned int y,unsigned int xStart,unsigned int xEnd,const float* rowPtr); // Flags the tile columns in which the given span of the given final output row moved from the last uploaded values by at least the hysteresis
+	void createHoleFillLevels(void); // Creates the coarser levels of the hole filling pyramid
+	void getHoleFillBandRows(unsigned int band,unsigned int& y0,unsigned int& y1) const; // Returns the half-open range of rows of the current hole filling pyramid level covered by the given band
+	void runHoleFillJob(const WorkerPool::BandFunction& bandFunction,unsigned int level); // Calls the given function on all bands of the given hole filling pyramid level
+	void pullBandHoles(unsigned int band); // Calculates the given band of the current hole filling pyramid level from the next-finer level
+	void pushBandHoles(unsigned int band); // Fills the given band of the current hole filling pyramid level from the next-coarser level
+	void fillHoles(void); // Fills holes in the current output frame within the hole filling time budget
+	void runBandJob(const WorkerPool::BandFunction& bandFunction,unsigned int numJobBands); // Calls the given function on the given number of bands, in parallel if there are worker threads
+	void runBandJob(const WorkerPool::BandFunction& bandFunction) // Ditto, on all bands
+		{
+		runBandJob(bandFunction,numBands);
+		}
+	void filterFrame(const void* inputFrameData,Kinect::FrameBuffer& outputFrame); // Filters the given input frame into the given output frame and stores the output frame's tile change mask
 	void* filterThreadMethod(void); // Method for the background filtering thread
 	
 	/* Constructors and destructors: */
 	public:
-	FrameFilter(const unsigned int sSize[2],unsigned int sNumAveragingSlots,const PixelDepthCorrection* sPixelDepthCorrection,const PTransform& depthProjection,const Plane& basePlane); // Creates a filter for frames of the given size and the given running average length
+	FrameFilter(const unsigned int sSize[2],unsigned int sNumAveragingSlots,TemporalFilterType sTemporalFilterType,DepthPixelFormat sPixelFormat,const PixelDepthCorrection* sPixelDepthCorrection,const PTransform& depthProjection,const Plane& basePlane); // Creates a filter for frames of the given size and pixel format, the given running average length, and the given temporal filter algorithm
 	~FrameFilter(void); // Destroys the frame filter
 	
 	/* Methods: */
+	static const char* getPixelFormatName(DepthPixelFormat pixelFormat); // Returns the name of the given pixel format
+	static bool parsePixelFormat(const char* name,DepthPixelFormat& pixelFormat); // Sets the given pixel format from its case-insensitive name; returns false if the name is not recognized
+	static bool parseNumThreads(const char* string,unsigned int& numThreads); // Sets the given number of filter threads from the given decimal string; returns false if the string is not a number between 1 and maxNumThreads
+	static bool parseSpatialFilterRadius(const char* string,unsigned int& spatialFilterRadius); // Sets the given spatial filter radius from the given decimal string; returns false if the string is not a number between 0 and maxSpatialFilterRadius
+	DepthPixelFormat getPixelFormat(void) const // Returns the format of raw depth pixels
+		{
+		return pixelFormat;
+		}
 	void setValidDepthInterval(unsigned int newMinDepth,unsigned int newMaxDepth); // Sets the interval of depth values considered by the depth image filter
 	void setValidElevationInterval(const PTransform& depthProjection,const Plane& basePlane,double newMinElevation,double newMaxElevation); // Sets the interval of elevations relative to the given base plane considered by the depth image filter
 	void setStableParameters(unsigned int newMinNumSamples,unsigned int newMaxVariance); // Sets the statistical properties to consider a pixel stable
 	void setHysteresis(float newHysteresis); // Sets the stable value hysteresis envelope
 	void setRetainValids(bool newRetainValids); // Sets whether the filter retains previous stable values for instable pixels
 	void setInstableValue(float newInstableValue); // Sets the depth value to assign to instable pixels
+	void setMotionAdaptive(float newMotionThreshold,unsigned int newNumMotionFrames); // Resets the temporal filter of pixels whose valid samples differ from their current values by more than the given threshold for the given number of consecutive frames; threshold 0 disables motion adaptation
+	unsigned int getNumFastResets(void) const // Returns the number of pixels reset due to motion in the most recently filtered frame
+		{
+		return numFastResets;
+		}
+	bool getHoleFilling(void) const // Returns true if holes in the temporally filtered frame are filled
+		{
+		return holeFilling;
+		}
+	void setHoleFilling(bool newHoleFilling); // Sets whether to fill holes, i.e., pixels without valid depth values, from surrounding pixels before the spatial filter
+	void setHoleFillingBudget(float newHoleFillingBudget); // Sets the time budget for hole filling per frame in milliseconds; larger holes remain partially unfilled if the budget runs out
+	unsigned int getNumFilledHoles(void) const // Returns the number of holes filled in the most recently filtered frame
+		{
+		return numFilledHoles;
+		}
+	bool getMedianFilter(void) const // Returns true if the median filter is applied to time-averaged depth values
+		{
+		return medianFilter;
+		}
+	void setMedianFilter(bool newMedianFilter); // Sets whether to replace time-averaged depth values by the medians of their neighborhoods before the spatial filter, to reject salt-and-pepper outliers
+	unsigned int getMedianFilterRadius(void) const // Returns the radius of the median filter's square neighborhood
+		{
+		return medianFilterRadius;
+		}
+	void setMedianFilterRadius(unsigned int newMedianFilterRadius); // Sets the radius of the median filter's square neighborhood; radius 1 selects 3x3 neighborhoods, and radius 2 selects 5x5 neighborhoods
 	void setSpatialFilter(bool newSpatialFilter); // Sets the spatial filtering flag
+	unsigned int getSpatialFilterRadius(void) const // Returns the radius of the spatial filter's Gaussian kernel
+		{
+		return spatialFilterRadius;
+		}
+	void setSpatialFilterRadius(unsigned int newSpatialFilterRadius); // Sets the radius of the spatial filter's Gaussian kernel, clamped to at most maxSpatialFilterRadius; the kernel's standard deviation is half its radius
+	bool getFuseSpatialFilter(void) const // Returns true if the spatial filter's horizontal pass is fused with the temporal filter
+		{
+		return fuseSpatialFilter;
+		}
+	void setFuseSpatialFilter(bool newFuseSpatialFilter); // Sets whether the spatial filter's horizontal pass is fused with the temporal filter or runs as a separate pass
+	unsigned int getNumThreads(void) const // Returns the number of threads filtering each frame
+		{
+		return numThreads;
+		}
+	void setNumThreads(unsigned int newNumThreads); // Sets the number of threads filtering each frame in horizontal bands, clamped to between 1 and maxNumThreads
+	TemporalFilterType getTemporalFilterType(void) const // Returns the temporal filter algorithm
+		{
+		return temporalFilterType;
+		}
+	bool getVectorized(void) const // Returns true if the filter uses a vectorized kernel
+		{
+		return vectorizedRowFilter;
+		}
+	void setVectorized(bool newVectorize); // Enables the fastest vectorized filter kernel supported by the CPU, or forces the scalar kernel
 	void setOutputFrameFunction(OutputFrameFunction* newOutputFrameFunction); // Sets the output function; adopts given functor object
-	void receiveRawFrame(const Kinect::FrameBuffer& newFrame); // Called to receive a new raw depth frame
+	Kinect::FrameBuffer createOutputFrame(void) const // Returns a new output frame with room for a tile change mask
+		{
+		return TileChangeMask::createFrame(size);
+		}
+	void filterFrame(const Kinect::FrameBuffer& rawFrame,Kinect::FrameBuffer& filteredFrame); // Synchronously filters the given raw depth frame into the given output frame created by createOutputFrame; must not be mixed with receiveRawFrame
+	void receiveRawFrame(const Kinect::FrameBuffer& newFrame); // Called to receive a new raw depth frame; never blocks, and drops the oldest pending frame if the filtering thread falls behind
+	unsigned int getNumReceivedFrames(void) const // Returns the number of raw depth frames received so far
+		{
+		return inputFrames.getNumPushed();
+		}
+	unsigned int getNumProcessedFrames(void) const // Returns the number of raw depth frames filtered by the background filtering thread so far
+		{
+		return __atomic_load_n(&numProcessedFrames,__ATOMIC_RELAXED);
+		}
+	unsigned int getNumDroppedFrames(void) const // Returns the number of raw depth frames dropped because the background filtering thread fell behind; received frames equal processed plus dropped frames, plus up to the input queue's capacity of queued frames and one frame being filtered
+		{
+		return inputFrames.getNumDropped();
+		}
 	bool lockNewFrame(void) // Locks the most recently produced output frame for reading; returns true if the locked frame is new
 		{
 		return outputFrames.lockNewValue();
@@ -0,0 +1,186 @@
+/***********************************************************************
+FrameRing - Class for a bounded, lock-free queue handing frames from a
+single producer thread to a single consumer thread, where the producer
+never blocks and drops the oldest queued frame if the queue is full.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "FrameRing.h"
+
+/***********************************************************************
+The producer stores frame i in slot i mod capacity by atomically
+exchanging the slot's entry pointer with its own filled entry, which
+hands it any frame i-capacity the consumer has not taken yet; that frame
+is the oldest queued frame, and is dropped. The consumer takes frames by
+atomically exchanging slot pointers with its own empty entry, so that
+every entry is owned by exactly one thread at any time. Both threads
+keep the entry they receive in an exchange as their next entry, which
+recycles a fixed set of entries and never allocates memory after
+construction. If the producer overtakes the consumer between the
+consumer reading the head index and taking a slot, the consumer receives
+a newer frame than expected; it then skips the frames in between to
+keep frames in order. Skipped frames are either overwritten and dropped
+by the producer later, or found and dropped by the consumer when it
+reaches their slots.
+***********************************************************************/
+
+/**************************
+Methods of class FrameRing:
+**************************/
+
+FrameRing::FrameRing(unsigned int sCapacity)
+	:capacity(sCapacity>0?sCapacity:1),
+	 entries(0),slots(0),producerEntry(0),consumerEntry(0),
+	 head(0),tail(0),
+	 numPushed(0),numProducerDrops(0),numConsumerDrops(0),
+	 consumerWaiting(false),shutdown(false)
+	{
+	/* Create one empty entry for each slot, and one each for the producer and consumer: */
+	entries=new Entry[capacity+2];
+	for(unsigned int i=0;i<capacity+2;++i)
+		{
+		entries[i].index=0;
+		entries[i].full=false;
+		}
+	slots=new Entry*[capacity];
+	for(unsigned int i=0;i<capacity;++i)
+		slots[i]=&entries[i];
+	producerEntry=&entries[capacity];
+	consumerEntry=&entries[capacity+1];
+	}
+
+FrameRing::~FrameRing(void)
+	{
+	/* Release all entries and their remaining frames: */
+	delete[] slots;
+	delete[] entries;
+	}
+
+void FrameRing::push(const Kinect::FrameBuffer& frame)
+	{
+	/* Fill the producer's entry with the frame: */
+	Entry* entry=producerEntry;
+	entry->frame=frame;
+	entry->index=head;
+	entry->full=true;
+
+	/* Store the entry in its slot and drop the frame it replaces, if the consumer did not take it: */
+	Entry* replaced=__atomic_exchange_n(&slots[head%capacity],entry,__ATOMIC_ACQ_REL);
+	if(replaced->full)
+		{
+		replaced->frame=Kinect::FrameBuffer();
+		replaced->full=false;
+		__atomic_store_n(&numProducerDrops,numProducerDrops+1,__ATOMIC_RELAXED);
+		}
+
+	/* Keep the replaced entry for the next pushed frame: */
+	producerEntry=replaced;
+
+	/* Publish the new frame: */
+	__atomic_store_n(&head,head+1,__ATOMIC_RELEASE);
+	__atomic_store_n(&numPushed,numPushed+1,__ATOMIC_RELAXED);
+
+	/* Wake up the consumer if it is blocked; the fence orders the head update before reading the waiting flag, matching the fence in waitAndPop: */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&consumerWaiting,__ATOMIC_RELAXED))
+		{
+		Threads::MutexCond::Lock wakeLock(wakeCond);
+		wakeCond.signal();
+		}
+	}
+
+bool FrameRing::pop(Kinect::FrameBuffer& frame)
+	{
+	while(true)
+		{
+		/* Bail out if the ring is empty; the tail can be ahead of the head if the consumer took a frame before the producer published it: */
+		unsigned int currentHead=__atomic_load_n(&head,__ATOMIC_ACQUIRE);
+		if(int(currentHead-tail)<=0)
+			return false;
+
+		/* Skip frames that were already overwritten by the producer: */
+		if(currentHead-tail>capacity)
+			tail=currentHead-capacity;
+
+		/* Take the oldest queued frame, and keep the entry it was stored in for the next popped frame: */
+		Entry* entry=__atomic_exchange_n(&slots[tail%capacity],consumerEntry,__ATOMIC_ACQ_REL);
+		consumerEntry=entry;
+		if(!entry->full)
+			{
+			/* The slot is empty; cannot happen while the producer is the only other thread accessing the ring, but skip it to be safe: */
+			++tail;
+			continue;
+			}
+		entry->full=false;
+
+		/* Discard the frame if it is older than the last popped frame: */
+		if(int(entry->index-tail)<0)
+			{
+			entry->frame=Kinect::FrameBuffer();
+			__atomic_store_n(&numConsumerDrops,numConsumerDrops+1,__ATOMIC_RELAXED);
+			continue;
+			}
+
+		/* Skip all older frames if the producer overtook the consumer while taking the frame: */
+		tail=entry->index+1;
+
+		/* Hand the frame to the caller: */
+		frame=entry->frame;
+		entry->frame=Kinect::FrameBuffer();
+		return true;
+		}
+	}
+
+bool FrameRing::waitAndPop(Kinect::FrameBuffer& frame)
+	{
+	while(!pop(frame))
+		{
+		Threads::MutexCond::Lock wakeLock(wakeCond);
+
+		/* Announce that the consumer is about to block, and check the ring again afterwards, so that the producer either sees the flag or the consumer sees the new frame: */
+		__atomic_store_n(&consumerWaiting,true,__ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		while(!shutdown&&int(__atomic_load_n(&head,__ATOMIC_ACQUIRE)-tail)<=0)
+			wakeCond.wait(wakeLock);
+		__atomic_store_n(&consumerWaiting,false,__ATOMIC_RELAXED);
+
+		/* Bail out if the ring was shut down: */
+		if(shutdown)
+			return false;
+		}
+
+	return true;
+	}
+
+void FrameRing::shutDown(void)
+	{
+	Threads::MutexCond::Lock wakeLock(wakeCond);
+	shutdown=true;
+	wakeCond.signal();
+	}
+
+unsigned int FrameRing::getNumPushed(void) const
+	{
+	return __atomic_load_n(&numPushed,__ATOMIC_RELAXED);
+	}
+
+unsigned int FrameRing::getNumDropped(void) const
+	{
+	return __atomic_load_n(&numProducerDrops,__ATOMIC_RELAXED)+__atomic_load_n(&numConsumerDrops,__ATOMIC_RELAXED);
+	}
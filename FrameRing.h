@@ -0,0 +1,80 @@
+/***********************************************************************
+FrameRing - Class for a bounded, lock-free queue handing frames from a
+single producer thread to a single consumer thread, where the producer
+never blocks and drops the oldest queued frame if the queue is full.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef FRAMERING_INCLUDED
+#define FRAMERING_INCLUDED
+
+#include <Threads/MutexCond.h>
+#include <Kinect/FrameBuffer.h>
+
+class FrameRing
+	{
+	/* Embedded classes: */
+	private:
+	struct Entry // Structure for a queued frame
+		{
+		/* Elements: */
+		public:
+		Kinect::FrameBuffer frame; // The frame
+		unsigned int index; // Index of the frame in the sequence of pushed frames
+		bool full; // Flag whether the entry holds a queued frame
+		};
+
+	/* Elements: */
+	unsigned int capacity; // Maximum number of queued frames
+	Entry* entries; // Array of capacity+2 pre-allocated entries, recycled between the slots, the producer, and the consumer
+	Entry** slots; // Array of slots each holding a full or an empty entry; slot pointers are only accessed atomically
+	Entry* producerEntry; // Empty entry owned by the producer, to be filled with the next pushed frame
+	Entry* consumerEntry; // Empty entry owned by the consumer, to be exchanged for the next popped frame
+	unsigned int head; // Index of the next pushed frame; only written by the producer
+	unsigned int tail; // Index of the next popped frame; only accessed by the consumer
+	unsigned int numPushed; // Number of frames pushed by the producer
+	unsigned int numProducerDrops; // Number of queued frames dropped by the producer to make room for new frames
+	unsigned int numConsumerDrops; // Number of queued frames dropped by the consumer because it already popped a newer frame
+	Threads::MutexCond wakeCond; // Condition variable to wake up a blocked consumer
+	bool consumerWaiting; // Flag whether the consumer is blocked or about to block on the condition variable
+	bool shutdown; // Flag whether the ring has been shut down
+
+	/* Constructors and destructors: */
+	public:
+	FrameRing(unsigned int sCapacity); // Creates an empty ring holding up to the given number of frames
+	private:
+	FrameRing(const FrameRing& source); // Prohibit copy constructor
+	FrameRing& operator=(const FrameRing& source); // Prohibit assignment operator
+	public:
+	~FrameRing(void); // Releases all queued frames
+
+	/* Methods: */
+	unsigned int getCapacity(void) const // Returns the maximum number of queued frames
+		{
+		return capacity;
+		}
+	void push(const Kinect::FrameBuffer& frame); // Pushes a frame; drops the oldest queued frame if the ring is full; must only be called by the producer
+	bool pop(Kinect::FrameBuffer& frame); // Pops the oldest queued frame into the given frame buffer without blocking; returns false if the ring is empty; must only be called by the consumer
+	bool waitAndPop(Kinect::FrameBuffer& frame); // Ditto, but blocks until a frame is available; returns false if the ring was shut down
+	void shutDown(void); // Shuts down the ring and wakes up a blocked consumer
+	unsigned int getNumPushed(void) const; // Returns the number of frames pushed so far; can be called from any thread
+	unsigned int getNumDropped(void) const; // Returns the number of pushed frames that were dropped without being popped; can be called from any thread; pushed frames that were neither popped nor dropped yet, up to the ring's capacity, are still queued
+	};
+
+#endif
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 
 #include "HandExtractor.h"
 
+#include <stdlib.h>
 #include <Misc/Utility.h>
 #include <Misc/FunctionCalls.h>
 #include <Math/Math.h>
@@ -36,36 +37,6 @@ namespace {
 Helper classes:
 **************/
 
-struct Span // Helper structure to extract foreground blobs from a depth image
-	{
-	/* Elements: */
-	public:
-	unsigned int y; // Row index of the span
-	unsigned int start; // Starting column of span
-	unsigned int end; // Ending column of span
-	unsigned int parent; // Span's parent span
-	unsigned int numPixels; // Number of pixels in the span's subtree
-	unsigned int blobId; // Blob ID of a root span
-	};
-
-struct BlobOrigin // Helper structure to store a point on the border of a foreground blob
-	{
-	/* Elements: */
-	public:
-	bool assigned; // Flag if the blob origin has already been assigned
-	unsigned int x,y; // Coordinates of blob origin in depth frame
-	const unsigned short* biPtr; // Pointer to blob origin in blob ID image
-	};
-
-struct Corner // Helper class to store corners in blob images
-	{
-	/* Elements: */
-	public:
-	int cornerType; // Corner type, +1: finger tip, -1: finger nook
-	unsigned start; // Boundary pixel index at which the corner started
-	int x,y; // Corner position in depth frame
-	};
-
 typedef Math::Interval<float> Interval;
 typedef Geometry::Point<float,2> Point2;
 typedef Geometry::Vector<float,2> Vector2;
@@ -228,13 +199,381 @@ const int HandExtractor::walkDy[8]={ 0, 1, 1, 1, 0,-1,-1,-1};
 Methods of class HandExtractor:
 ******************************/
 
+bool HandExtractor::canLinkSpans(const HandExtractor::DepthPixel* depthFrame,const HandExtractor::Span& span0,const HandExtractor::Span& span1) const
+	{
+	/* Check if the two spans have depth in common where they overlap: */
+	unsigned int o1=Misc::max(span1.start,span0.start);
+	unsigned int o2=Misc::min(span1.end,span0.end);
+	const DepthPixel* lrsPtr1=depthFrame+size_t(span1.y)*size_t(depthFrameSize[0])+o1;
+	const DepthPixel* lrsPtr0=lrsPtr1-depthFrameSize[0];
+	bool canLink=false;
+	for(unsigned int o=o1;o<o2&&!canLink;++o,++lrsPtr0,++lrsPtr1)
+		canLink=*lrsPtr0+maxDepthDist>=*lrsPtr1&&*lrsPtr0<=*lrsPtr1+maxDepthDist;
+	
+	return canLink;
+	}
+
+void HandExtractor::linkSpans(std::vector<HandExtractor::Span>& spanList,unsigned int span0,unsigned int span1)
+	{
+	/* Find the roots of the two spans' respective subtrees: */
+	unsigned int root1=span0;
+	while(root1!=spanList[root1].parent)
+		root1=spanList[root1].parent;
+	unsigned int root2=span1;
+	while(root2!=spanList[root2].parent)
+		root2=spanList[root2].parent;
+	
+	if(root1<root2)
+		{
+		/* Make the first span the new root: */
+		spanList[root2].parent=root1;
+		spanList[root1].numPixels+=spanList[root2].numPixels;
+		}
+	else if(root1>root2)
+		{
+		/* Make the second span the new root: */
+		spanList[root1].parent=root2;
+		spanList[root2].numPixels+=spanList[root1].numPixels;
+		}
+	}
+
+void HandExtractor::extractSpans(const HandExtractor::DepthPixel* depthFrame,unsigned int y0,unsigned int y1,std::vector<HandExtractor::Span>& spanList) const
+	{
+	spanList.clear();
+	unsigned int numSpans=0;
+	unsigned int lastRowSpan=0;
+	const DepthPixel* dfRowPtr=depthFrame+size_t(y0)*size_t(depthFrameSize[0]);
+	for(unsigned int y=y0;y<y1;++y,dfRowPtr+=depthFrameSize[0])
+		{
+		const unsigned char* fgRowPtr=currentForegroundMask!=0?currentForegroundMask+(dfRowPtr-depthFrame):0;
+		unsigned int x=regionMin[0];
+		const DepthPixel* dfPtr=dfRowPtr+x;
+		unsigned int rowSpan=numSpans;
+		while(true)
+			{
+			/* Find the beginning of the next foreground span: */
+			if(fgRowPtr!=0)
+				{
+				/* Use the shared foreground mask: */
+				for(;x<regionMax[0]&&fgRowPtr[x]==0;++x,++dfPtr)
+					;
+				}
+			else
+				{
+				for(;x<regionMax[0]&&*dfPtr>maxFgDepth;++x,++dfPtr)
+					;
+				}
+			if(x>=regionMax[0])
+				break;
+			
+			/* Start a new foreground span: */
+			Span newSpan;
+			newSpan.y=y;
+			newSpan.start=x;
+			
+			/* Trace out the current foreground span: */
+			DepthPixel lastDepth=*dfPtr;
+			++x;
+			++dfPtr;
+			for(;x<regionMax[0]&&(fgRowPtr!=0?fgRowPtr[x]!=0:*dfPtr<=maxFgDepth)&&*dfPtr+maxDepthDist>=lastDepth&&*dfPtr<=lastDepth+maxDepthDist;++x,++dfPtr)
+				lastDepth=*dfPtr;
+			
+			/* Finalize and store the new foreground span: */
+			newSpan.end=x;
+			newSpan.parent=numSpans;
+			newSpan.numPixels=newSpan.end-newSpan.start;
+			newSpan.blobId=invalidBlobId;
+			spanList.push_back(newSpan);
+			++numSpans;
+			
+			/* Skip any spans from the previous row that were just passed by: */
+			for(;lastRowSpan<rowSpan&&spanList[lastRowSpan].end<newSpan.start;++lastRowSpan)
+				;
+			
+			/* Merge the current span with any from the previous row with which it has depth in common: */
+			for(unsigned int lrs=lastRowSpan;lrs<rowSpan&&spanList[lrs].start<=newSpan.end;++lrs)
+				if(canLinkSpans(depthFrame,spanList[lrs],newSpan))
+					linkSpans(spanList,lrs,numSpans-1);
+			}
+		
+		/* Skip any leftover spans from the previous row: */
+		lastRowSpan=rowSpan;
+		}
+	}
+
+void HandExtractor::extractBandSpans(unsigned int band)
+	{
+	/* Calculate the band's row range inside the current region: */
+	unsigned int regionHeight=regionMax[1]-regionMin[1];
+	unsigned int y0=regionMin[1]+(unsigned int)((unsigned long)(band)*(unsigned long)(regionHeight)/(unsigned long)(numBands));
+	unsigned int y1=regionMin[1]+(unsigned int)((unsigned long)(band+1)*(unsigned long)(regionHeight)/(unsigned long)(numBands));
+	
+	/* Extract and label the band's spans with band-local indices: */
+	extractSpans(currentDepthFrame,y0,y1,bandSpans[band]);
+	}
+
+HandExtractor::Hand HandExtractor::transformHand(const HandExtractor::DetectedHand& detectedHand,unsigned int id) const
+	{
+	/* Transform the hand's center and radius from depth image space to camera space: */
+	Hand result;
+	result.center=depthProjection.transform(Point(detectedHand.center[0],detectedHand.center[1],detectedHand.depth));
+	result.radius=Geometry::dist(result.center,depthProjection.transform(Point(detectedHand.center[0]+detectedHand.radius,detectedHand.center[1],detectedHand.depth)));
+	result.id=id;
+	
+	return result;
+	}
+
+void HandExtractor::detectHands(const HandExtractor::DepthPixel* depthFrame,Images::RGBImage* blobImage,Images::RGBImage::Color* imgPtr,bool mergeDuplicates)
+	{
+	unsigned int level=pyramidLevel;
+	if(level==0)
+		{
+		/* Scan the entire region at full resolution: */
+		scanRegion(depthFrame,blobImage,imgPtr,mergeDuplicates);
+		return;
+		}
+	
+	/* Calculate the size of the region's min-depth pyramid level: */
+	unsigned int region0[2],region1[2],coarseSize[2];
+	for(int i=0;i<2;++i)
+		{
+		region0[i]=regionMin[i];
+		region1[i]=regionMax[i];
+		coarseSize[i]=(region1[i]-region0[i]+(1U<<level)-1U)>>level;
+		}
+	
+	/* Mark each coarse pixel whose block's minimum depth is in the foreground, i.e., where any of its pixels is in the foreground: */
+	coarseMask.assign(size_t(coarseSize[0])*size_t(coarseSize[1]),0U);
+	const DepthPixel* dfRowPtr=depthFrame+size_t(region0[1])*size_t(depthFrameSize[0]);
+	for(unsigned int y=region0[1];y<region1[1];++y,dfRowPtr+=depthFrameSize[0])
+		{
+		unsigned char* cmRowPtr=&coarseMask[size_t((y-region0[1])>>level)*size_t(coarseSize[0])];
+		if(currentForegroundMask!=0)
+			{
+			const unsigned char* fgRowPtr=currentForegroundMask+(dfRowPtr-depthFrame);
+			for(unsigned int x=region0[0];x<region1[0];++x)
+				cmRowPtr[(x-region0[0])>>level]|=fgRowPtr[x];
+			}
+		else
+			{
+			for(unsigned int x=region0[0];x<region1[0];++x)
+				cmRowPtr[(x-region0[0])>>level]|=dfRowPtr[x]<=maxFgDepth?1U:0U;
+			}
+		}
+	
+	/* Collect the bounding boxes of the coarse level's four-connected foreground components as candidate regions: */
+	candidateRegions.clear();
+	for(unsigned int start=0;start<coarseMask.size();++start)
+		{
+		if(coarseMask[start]!=1U)
+			continue;
+		
+		/* Flood-fill the component starting at the current coarse pixel: */
+		ScanRegion box;
+		box.min[0]=box.max[0]=start%coarseSize[0];
+		box.min[1]=box.max[1]=start/coarseSize[0];
+		unsigned int numCoarsePixels=0;
+		coarseMask[start]=2U;
+		coarseStack.clear();
+		coarseStack.push_back(start);
+		while(!coarseStack.empty())
+			{
+			unsigned int index=coarseStack.back();
+			coarseStack.pop_back();
+			++numCoarsePixels;
+			unsigned int cx=index%coarseSize[0];
+			unsigned int cy=index/coarseSize[0];
+			box.min[0]=Misc::min(box.min[0],cx);
+			box.max[0]=Misc::max(box.max[0],cx);
+			box.min[1]=Misc::min(box.min[1],cy);
+			box.max[1]=Misc::max(box.max[1],cy);
+			
+			/* Push all unvisited foreground neighbors: */
+			if(cx>0&&coarseMask[index-1]==1U)
+				{
+				coarseMask[index-1]=2U;
+				coarseStack.push_back(index-1);
+				}
+			if(cx<coarseSize[0]-1&&coarseMask[index+1]==1U)
+				{
+				coarseMask[index+1]=2U;
+				coarseStack.push_back(index+1);
+				}
+			if(cy>0&&coarseMask[index-coarseSize[0]]==1U)
+				{
+				coarseMask[index-coarseSize[0]]=2U;
+				coarseStack.push_back(index-coarseSize[0]);
+				}
+			if(cy<coarseSize[1]-1&&coarseMask[index+coarseSize[0]]==1U)
+				{
+				coarseMask[index+coarseSize[0]]=2U;
+				coarseStack.push_back(index+coarseSize[0]);
+				}
+			}
+		
+		/* Keep the component if it can contain enough full-resolution pixels to be a hand candidate: */
+		if((numCoarsePixels<<(2*level))>=minBlobSize)
+			{
+			for(int i=0;i<2;++i)
+				{
+				box.min[i]=region0[i]+(box.min[i]<<level);
+				box.max[i]=Misc::min(region0[i]+((box.max[i]+1U)<<level),region1[i]);
+				}
+			candidateRegions.push_back(box);
+			}
+		}
+	
+	/* Scan each candidate region at full resolution; every full-resolution blob lies entirely inside one candidate region, but candidate regions can overlap: */
+	for(std::vector<ScanRegion>::iterator crIt=candidateRegions.begin();crIt!=candidateRegions.end();++crIt)
+		{
+		for(int i=0;i<2;++i)
+			{
+			regionMin[i]=crIt->min[i];
+			regionMax[i]=crIt->max[i];
+			}
+		scanRegion(depthFrame,blobImage,imgPtr,true);
+		}
+	}
+
+void HandExtractor::scanTrackingRegions(const HandExtractor::DepthPixel* depthFrame,Images::RGBImage* blobImage,Images::RGBImage::Color* imgPtr)
+	{
+	scanRegions.clear();
+	
+	/* Create a region around each tracked hand's predicted position: */
+	for(std::vector<TrackedHand>::iterator thIt=trackedHands.begin();thIt!=trackedHands.end();++thIt)
+		{
+		float extent=thIt->hand.radius*2.0f+float(roiMargin);
+		ScanRegion region;
+		for(int i=0;i<2;++i)
+			{
+			float predicted=thIt->hand.center[i]+thIt->velocity[i];
+			region.min[i]=(unsigned int)(Math::clamp(Math::floor(predicted-extent),0.0f,float(depthFrameSize[i])));
+			region.max[i]=(unsigned int)(Math::clamp(Math::ceil(predicted+extent),0.0f,float(depthFrameSize[i])));
+			}
+		if(region.max[0]>region.min[0]+1&&region.max[1]>region.min[1]+1)
+			scanRegions.push_back(region);
+		}
+	
+	/* Create the current window of the rotating full-frame sweep; consecutive windows overlap by half their height: */
+	ScanRegion sweep;
+	sweep.min[0]=0;
+	sweep.max[0]=depthFrameSize[0];
+	sweep.min[1]=sweepRow;
+	sweep.max[1]=Misc::min(sweepRow+sweepHeight,depthFrameSize[1]);
+	scanRegions.push_back(sweep);
+	if(sweep.max[1]==depthFrameSize[1])
+		sweepRow=0;
+	else
+		sweepRow+=Misc::max(sweepHeight/2,1U);
+	
+	/* Merge overlapping regions so that no pixel is scanned twice: */
+	for(size_t i=0;i<scanRegions.size();++i)
+		for(size_t j=i+1;j<scanRegions.size();++j)
+			{
+			ScanRegion& r0=scanRegions[i];
+			ScanRegion& r1=scanRegions[j];
+			if(r0.min[0]<r1.max[0]&&r1.min[0]<r0.max[0]&&r0.min[1]<r1.max[1]&&r1.min[1]<r0.max[1])
+				{
+				/* Replace the first region with the union's bounding box, remove the second, and start over with the first: */
+				for(int k=0;k<2;++k)
+					{
+					r0.min[k]=Misc::min(r0.min[k],r1.min[k]);
+					r0.max[k]=Misc::max(r0.max[k],r1.max[k]);
+					}
+				scanRegions.erase(scanRegions.begin()+j);
+				j=i;
+				}
+			}
+	
+	/* Scan all regions for hands: */
+	for(std::vector<ScanRegion>::iterator srIt=scanRegions.begin();srIt!=scanRegions.end();++srIt)
+		{
+		for(int i=0;i<2;++i)
+			{
+			regionMin[i]=srIt->min[i];
+			regionMax[i]=srIt->max[i];
+			}
+		detectHands(depthFrame,blobImage,imgPtr,true);
+		}
+	}
+
+void HandExtractor::updateTrackedHands(void)
+	{
+	for(std::vector<DetectedHand>::iterator dhIt=detectedHands.begin();dhIt!=detectedHands.end();++dhIt)
+		dhIt->assigned=false;
+	
+	/* Match each tracked hand to the closest unassigned detected hand around its predicted position: */
+	std::vector<TrackedHand>::iterator keepIt=trackedHands.begin();
+	for(std::vector<TrackedHand>::iterator thIt=trackedHands.begin();thIt!=trackedHands.end();++thIt)
+		{
+		float predicted[2];
+		for(int i=0;i<2;++i)
+			predicted[i]=thIt->hand.center[i]+thIt->velocity[i];
+		float matchDist2=Math::sqr(thIt->hand.radius+float(roiMargin));
+		DetectedHand* match=0;
+		for(std::vector<DetectedHand>::iterator dhIt=detectedHands.begin();dhIt!=detectedHands.end();++dhIt)
+			{
+			float dist2=Math::sqr(dhIt->center[0]-predicted[0])+Math::sqr(dhIt->center[1]-predicted[1]);
+			if(!dhIt->assigned&&matchDist2>dist2)
+				{
+				match=&*dhIt;
+				matchDist2=dist2;
+				}
+			}
+		
+		if(match!=0)
+			{
+			/* Update the tracked hand's velocity and state from the matched detection: */
+			for(int i=0;i<2;++i)
+				thIt->velocity[i]=(thIt->velocity[i]+(match->center[i]-thIt->hand.center[i]))*0.5f;
+			thIt->hand=*match;
+			thIt->numMissedFrames=0;
+			match->assigned=true;
+			}
+		else if(++thIt->numMissedFrames<=maxMissedFrames)
+			{
+			/* Coast the tracked hand along its predicted path with decaying velocity: */
+			for(int i=0;i<2;++i)
+				{
+				thIt->hand.center[i]=predicted[i];
+				thIt->velocity[i]*=0.5f;
+				}
+			}
+		else
+			{
+			/* Drop the lost hand: */
+			continue;
+			}
+		
+		*keepIt=*thIt;
+		++keepIt;
+		}
+	trackedHands.erase(keepIt,trackedHands.end());
+	
+	/* Start tracking all unassigned detected hands under new IDs: */
+	for(std::vector<DetectedHand>::iterator dhIt=detectedHands.begin();dhIt!=detectedHands.end();++dhIt)
+		if(!dhIt->assigned)
+			{
+			TrackedHand newHand;
+			newHand.id=nextHandId;
+			if(++nextHandId==0)
+				nextHandId=1;
+			newHand.hand=*dhIt;
+			newHand.velocity[0]=newHand.velocity[1]=0.0f;
+			newHand.numMissedFrames=0;
+			trackedHands.push_back(newHand);
+			}
+	}
+
 void* HandExtractor::extractorThreadMethod(void)
 	{
 	unsigned int lastInputFrameVersion=0;
 	
 	while(true)
 		{
-		Kinect::FrameBuffer frame;
+		Kinect::FrameBuffer frame,foregroundMask,correctedDepth;
+		bool preprocessed;
+		DepthPixel frameMaxFgDepth=0;
 		{
 		Threads::MutexCond::Lock inputLock(inputCond);
 		
@@ -248,6 +587,13 @@ void* HandExtractor::extractorThreadMethod(void)
 		
 		/* Work on the new frame: */
 		frame=inputFrame;
+		preprocessed=inputPreprocessed;
+		if(preprocessed)
+			{
+			foregroundMask=inputForegroundMask;
+			correctedDepth=inputCorrectedDepth;
+			frameMaxFgDepth=inputMaxFgDepth;
+			}
 		lastInputFrameVersion=inputFrameVersion;
 		}
 		
@@ -255,7 +601,14 @@ void* HandExtractor::extractorThreadMethod(void)
 		HandList& newHandList=extractedHands.startNewValue();
 		
 		/* Extract hands from the new input frame: */
-		extractHands(frame.getData<DepthPixel>(),newHandList,0);
+		if(preprocessed)
+			{
+			/* Ignore the shared foreground mask if the maximum foreground depth changed while the frame was being preprocessed: */
+			const unsigned char* fgMask=frameMaxFgDepth==maxFgDepth?foregroundMask.getData<unsigned char>():0;
+			extractHands(frame.getData<DepthPixel>(),fgMask,correctedDepth.getData<float>(),newHandList,0);
+			}
+		else
+			extractHands(frame.getData<DepthPixel>(),newHandList,0);
 		
 		/* Finalize the new extracted hands list in the output buffer: */
 		extractedHands.postNewValue();
@@ -270,12 +623,16 @@ void* HandExtractor::extractorThreadMethod(void)
 
 HandExtractor::HandExtractor(const unsigned int sDepthFrameSize[2],const HandExtractor::PixelDepthCorrection* sPixelDepthCorrection,const PTransform& sDepthProjection)
 	:pixelDepthCorrection(sPixelDepthCorrection),depthProjection(sDepthProjection),
-	 inputFrameVersion(0),runExtractorThread(false),
-	 maxFgDepth(0x07ffU-1U),maxDepthDist(1),minBlobSize(1500),maxBlobSize(150000),
+	 inputPreprocessed(false),inputMaxFgDepth(0),inputFrameVersion(0),runExtractorThread(false),
+	 maxFgDepth(0x07ffU-1U),depthPreprocessor(0),maxDepthDist(1),minBlobSize(1500),maxBlobSize(150000),
 	 blobIdImage(0),
 	 snakeLength(50),snake(0),
 	 maxCornerEnterDist(28),minCenterDist(10),minCornerExitDist(32),
 	 minHandProbability(0.15f),
+	 numThreads(1),workerPool(0),numBands(1),bandSpans(0),currentDepthFrame(0),spanFunction(0),
+	 trackHands(false),maxMissedFrames(5),roiMargin(16),sweepHeight(120),sweepRow(0),nextHandId(1),
+	 pyramidLevel(0),
+	 currentForegroundMask(0),currentCorrectedDepth(0),
 	 handsExtractedFunction(0)
 	{
 	/* Copy the depth frame size: */
@@ -304,6 +661,9 @@ HandExtractor::HandExtractor(const unsigned int sDepthFrameSize[2],const HandExt
 	/* Initialize the edge walking snake: */
 	setSnakeLength(snakeLength);
 	
+	/* Create the band function for parallel span labelling: */
+	spanFunction=Misc::createFunctionCall(this,&HandExtractor::extractBandSpans);
+	
 	/* Start the hand extraction thread: */
 	runExtractorThread=true;
 	extractorThread.start(this,&HandExtractor::extractorThreadMethod);
@@ -319,13 +679,46 @@ HandExtractor::~HandExtractor(void)
 	}
 	extractorThread.join();
 	
+	delete workerPool;
+	delete[] bandSpans;
+	delete spanFunction;
 	delete[] blobIdImage;
 	delete[] snake;
 	}
 
+bool HandExtractor::parseNumThreads(const char* string,unsigned int& numThreads)
+	{
+	return WorkerPool::parseNumWorkers(string,1,numThreads);
+	}
+
+bool HandExtractor::parsePyramidLevel(const char* string,unsigned int& pyramidLevel)
+	{
+	/* Parse the entire string as a decimal number and check it against the valid range: */
+	char* end;
+	long value=strtol(string,&end,10);
+	if(end==string||*end!='\0'||value<0||value>long(maxPyramidLevel))
+		return false;
+	
+	pyramidLevel=(unsigned int)(value);
+	return true;
+	}
+
 void HandExtractor::setMaxFgDepth(DepthPixel newMaxFgDepth)
 	{
 	maxFgDepth=newMaxFgDepth;
+	
+	/* Calculate the shared foreground mask with the new maximum foreground depth from the next preprocessed frame on: */
+	if(depthPreprocessor!=0)
+		depthPreprocessor->setMaxFgDepth(newMaxFgDepth);
+	}
+
+void HandExtractor::setDepthPreprocessor(DepthPreprocessor& newDepthPreprocessor)
+	{
+	depthPreprocessor=&newDepthPreprocessor;
+	
+	/* Hand the current maximum foreground depth to the preprocessing stage and subscribe to its preprocessed frames: */
+	depthPreprocessor->setMaxFgDepth(maxFgDepth);
+	depthPreprocessor->addConsumer(Misc::createFunctionCall(this,&HandExtractor::receivePreprocessedFrame));
 	}
 
 void HandExtractor::setMaxDepthDist(unsigned int newMaxDepthDist)
@@ -355,8 +748,53 @@ void HandExtractor::setCornerDists(int newMaxCornerEnterDist,int newMinCenterDis
 	minCornerExitDist=newMinCornerExitDist;
 	}
 
+void HandExtractor::setNumThreads(unsigned int newNumThreads)
+	{
+	/* Request the new number of threads; the extraction thread will re-create its worker pool before processing the next frame: */
+	if(newNumThreads<1)
+		numThreads=1;
+	else if(newNumThreads>maxNumThreads)
+		numThreads=maxNumThreads;
+	else
+		numThreads=newNumThreads;
+	}
+
+void HandExtractor::setTrackHands(bool newTrackHands)
+	{
+	trackHands=newTrackHands;
+	}
+
+void HandExtractor::setTrackingParameters(unsigned int newMaxMissedFrames,unsigned int newRoiMargin,unsigned int newSweepHeight)
+	{
+	maxMissedFrames=newMaxMissedFrames;
+	roiMargin=newRoiMargin;
+	sweepHeight=newSweepHeight>2?newSweepHeight:2;
+	}
+
+void HandExtractor::setPyramidLevel(unsigned int newPyramidLevel)
+	{
+	/* Limit the pre-pass to quarter resolution; coarser levels merge separate blobs too eagerly: */
+	pyramidLevel=newPyramidLevel<=maxPyramidLevel?newPyramidLevel:maxPyramidLevel;
+	}
+
 void HandExtractor::extractHands(const HandExtractor::DepthPixel* depthFrame,HandExtractor::HandList& hands,Images::RGBImage* blobImage)
 	{
+	/* Extract hands using the hand extractor's own foreground test and depth correction: */
+	extractHands(depthFrame,0,0,hands,blobImage);
+	}
+
+void HandExtractor::extractHands(const DepthPreprocessor::Frame& frame,HandExtractor::HandList& hands,Images::RGBImage* blobImage)
+	{
+	/* Extract hands using the shared corrected depth frame, and the shared foreground mask unless it was calculated with a different maximum foreground depth: */
+	const unsigned char* fgMask=frame.maxFgDepth==maxFgDepth?frame.foregroundMask.getData<unsigned char>():0;
+	extractHands(frame.rawDepth.getData<DepthPixel>(),fgMask,frame.correctedDepth.getData<float>(),hands,blobImage);
+	}
+
+void HandExtractor::extractHands(const HandExtractor::DepthPixel* depthFrame,const unsigned char* foregroundMask,const float* correctedDepth,HandExtractor::HandList& hands,Images::RGBImage* blobImage)
+	{
+	currentForegroundMask=foregroundMask;
+	currentCorrectedDepth=correctedDepth;
+	
 	Images::RGBImage::Color* imgPtr=0;
 	if(blobImage!=0)
 		{
@@ -365,90 +803,104 @@ void HandExtractor::extractHands(const HandExtractor::DepthPixel* depthFrame,Han
 		imgPtr=blobImage->replacePixels();
 		}
 	
-	/* Extract all four-connected foreground blobs from the given depth frame: */
-	std::vector<Span> spans;
-	unsigned int numSpans=0;
-	unsigned int lastRowSpan=0;
-	const DepthPixel* dfRowPtr=depthFrame;
-	for(unsigned int y=0;y<depthFrameSize[1];++y,dfRowPtr+=depthFrameSize[0])
+	/* Re-create the worker pool if the requested number of threads changed: */
+	unsigned int newNumThreads=numThreads;
+	if(newNumThreads!=(workerPool!=0?workerPool->getNumWorkers():1U))
 		{
-		const DepthPixel* dfPtr=dfRowPtr;
-		unsigned int rowSpan=numSpans;
-		unsigned int x=0;
-		while(true)
+		delete workerPool;
+		workerPool=newNumThreads>1?new WorkerPool(newNumThreads):0;
+		delete[] bandSpans;
+		bandSpans=newNumThreads>1?new std::vector<Span>[newNumThreads]:0;
+		}
+	
+	detectedHands.clear();
+	if(!trackHands)
+		{
+		/* Scan the entire depth frame for hands: */
+		trackedHands.clear();
+		regionMin[0]=regionMin[1]=0;
+		regionMax[0]=depthFrameSize[0];
+		regionMax[1]=depthFrameSize[1];
+		detectHands(depthFrame,blobImage,imgPtr,false);
+		
+		/* Store all detected hands in camera space: */
+		hands.clear();
+		for(std::vector<DetectedHand>::iterator dhIt=detectedHands.begin();dhIt!=detectedHands.end();++dhIt)
+			hands.push_back(transformHand(*dhIt,0));
+		}
+	else
+		{
+		/* Scan regions around the tracked hands' predicted positions and the current sweep window, and update the tracked hands: */
+		scanTrackingRegions(depthFrame,blobImage,imgPtr);
+		updateTrackedHands();
+		
+		/* Store all tracked hands in camera space: */
+		hands.clear();
+		for(std::vector<TrackedHand>::iterator thIt=trackedHands.begin();thIt!=trackedHands.end();++thIt)
+			hands.push_back(transformHand(thIt->hand,thIt->id));
+		}
+	}
+
+void HandExtractor::scanRegion(const HandExtractor::DepthPixel* depthFrame,Images::RGBImage* blobImage,Images::RGBImage::Color* imgPtr,bool mergeDuplicates)
+	{
+	/* Split the region into one band per thread, but keep bands at least two rows high: */
+	unsigned int regionHeight=regionMax[1]-regionMin[1];
+	numBands=workerPool!=0?workerPool->getNumWorkers():1U;
+	if(numBands>regionHeight/2)
+		numBands=regionHeight/2;
+	if(numBands<1)
+		numBands=1;
+	
+	/* Extract all four-connected foreground blobs from the given depth frame, reusing the span lists' storage from previous frames: */
+	if(workerPool!=0&&numBands>1)
+		{
+		/* Extract and label each band's spans in parallel: */
+		currentDepthFrame=depthFrame;
+		workerPool->runJob(*spanFunction,numBands);
+		
+		/* Concatenate the bands' span lists, offsetting their parent indices: */
+		spans.clear();
+		for(unsigned int band=0;band<numBands;++band)
 			{
-			/* Find the beginning of the next foreground span: */
-			for(;x<depthFrameSize[0]&&*dfPtr>maxFgDepth;++x,++dfPtr)
-				;
-			if(x>=depthFrameSize[0])
-				break;
-			
-			/* Start a new foreground span: */
-			Span newSpan;
-			newSpan.y=y;
-			newSpan.start=x;
-			
-			/* Trace out the current foreground span: */
-			DepthPixel lastDepth=*dfPtr;
-			++x;
-			++dfPtr;
-			for(;x<depthFrameSize[0]&&*dfPtr<=maxFgDepth&&*dfPtr+maxDepthDist>=lastDepth&&*dfPtr<=lastDepth+maxDepthDist;++x,++dfPtr)
-				lastDepth=*dfPtr;
-			
-			/* Finalize and store the new foreground span: */
-			newSpan.end=x;
-			newSpan.parent=numSpans;
-			newSpan.numPixels=newSpan.end-newSpan.start;
-			newSpan.blobId=invalidBlobId;
-			spans.push_back(newSpan);
-			++numSpans;
-			
-			/* Skip any spans from the previous row that were just passed by: */
-			for(;lastRowSpan<rowSpan&&spans[lastRowSpan].end<newSpan.start;++lastRowSpan)
-				;
-			
-			/* Check if the current span links up with any from the previous row: */
-			for(unsigned int lrs=lastRowSpan;lrs<rowSpan&&spans[lrs].start<=newSpan.end;++lrs)
+			unsigned int offset=spans.size();
+			for(std::vector<Span>::iterator sIt=bandSpans[band].begin();sIt!=bandSpans[band].end();++sIt)
 				{
-				/* Check if the two spans have depth in common: */
-				unsigned int o1=Misc::max(newSpan.start,spans[lrs].start);
-				unsigned int o2=Misc::min(newSpan.end,spans[lrs].end);
-				const DepthPixel* lrsPtr1=dfRowPtr+o1;
-				const DepthPixel* lrsPtr0=lrsPtr1-depthFrameSize[0];
-				bool canLink=false;
-				for(unsigned int o=o1;o<o2&&!canLink;++o,++lrsPtr0,++lrsPtr1)
-					canLink=*lrsPtr0+maxDepthDist>=*lrsPtr1&&*lrsPtr0<=*lrsPtr1+maxDepthDist;
-				
-				/* Merge the two spans if they can link: */
-				if(canLink)
-					{
-					/* Find the roots of the two spans' respective subtrees: */
-					unsigned int root1=lrs;
-					while(root1!=spans[root1].parent)
-						root1=spans[root1].parent;
-					unsigned int root2=numSpans-1;
-					while(root2!=spans[root2].parent)
-						root2=spans[root2].parent;
-					
-					if(root1<root2)
-						{
-						/* Make the first span the new root: */
-						spans[root2].parent=root1;
-						spans[root1].numPixels+=spans[root2].numPixels;
-						}
-					else if(root1>root2)
-						{
-						/* Make the second span the new root: */
-						spans[root1].parent=root2;
-						spans[root2].numPixels+=spans[root1].numPixels;
-						}
-					}
+				spans.push_back(*sIt);
+				spans.back().parent+=offset;
 				}
 			}
 		
-		/* Skip any leftover spans from the previous row: */
-		lastRowSpan=rowSpan;
+		/* Link the spans across each boundary between adjacent bands: */
+		unsigned int bandStart=bandSpans[0].size();
+		for(unsigned int band=1;band<numBands;++band)
+			{
+			/* Find the spans in the last row of the previous band and in the first row of this band: */
+			unsigned int y=regionMin[1]+(unsigned int)((unsigned long)(band)*(unsigned long)(regionHeight)/(unsigned long)(numBands));
+			unsigned int lastRowSpan=bandStart;
+			while(lastRowSpan>0&&spans[lastRowSpan-1].y==y-1)
+				--lastRowSpan;
+			unsigned int bandEnd=bandStart+bandSpans[band].size();
+			for(unsigned int span=bandStart;span<bandEnd&&spans[span].y==y;++span)
+				{
+				/* Skip any spans from the previous row that were just passed by: */
+				for(;lastRowSpan<bandStart&&spans[lastRowSpan].end<spans[span].start;++lastRowSpan)
+					;
+				
+				/* Link the current span with all overlapping spans from the previous row with which it has depth in common: */
+				for(unsigned int lrs=lastRowSpan;lrs<bandStart&&spans[lrs].start<=spans[span].end;++lrs)
+					if(canLinkSpans(depthFrame,spans[lrs],spans[span]))
+						linkSpans(spans,lrs,span);
+				}
+			
+			bandStart=bandEnd;
+			}
 		}
+	else
+		{
+		/* Extract and label all spans on the extraction thread: */
+		extractSpans(depthFrame,regionMin[1],regionMax[1],spans);
+		}
+	unsigned int numSpans=spans.size();
 	
 	/* Assign consecutive blob IDs to all root spans: */
 	unsigned int nextBlobId=0;
@@ -518,23 +970,37 @@ void HandExtractor::extractHands(const HandExtractor::DepthPixel* depthFrame,Han
 	
 	#endif
 	
-	/* Create an array of blob origin points: */
-	BlobOrigin* blobOrigins=new BlobOrigin[nextBlobId];
+	/* Create an array of blob origin points, reusing its storage from previous frames: */
+	blobOrigins.resize(nextBlobId);
 	for(unsigned int i=0;i<nextBlobId;++i)
 		blobOrigins[i].assigned=false;
 	
+	/* Surround the region in the blob ID image with a layer of invalid blob IDs so that edge walking stays inside it: */
+	unsigned short* biRowPtr=blobIdImage+regionMin[1]*biStride+regionMin[0];
+	unsigned int regionWidth=regionMax[0]-regionMin[0];
+	for(unsigned int x=0;x<regionWidth+2;++x)
+		{
+		biRowPtr[x]=invalidBlobId;
+		biRowPtr[(regionHeight+1)*biStride+x]=invalidBlobId;
+		}
+	for(unsigned int y=1;y<=regionHeight;++y)
+		{
+		biRowPtr[y*biStride]=invalidBlobId;
+		biRowPtr[y*biStride+regionWidth+1]=invalidBlobId;
+		}
+	
 	/* Create the blob ID image: */
-	unsigned short* biRowPtr=blobIdImage+biStride+1;
+	biRowPtr+=biStride+1;
 	unsigned int spanIndex=0;
-	for(unsigned int y=0;y<depthFrameSize[1];++y,biRowPtr+=biStride)
+	for(unsigned int y=regionMin[1];y<regionMax[1];++y,biRowPtr+=biStride)
 		{
 		/* Process all spans and spaces between spans in the current row: */
-		unsigned int x=0;
+		unsigned int x=regionMin[0];
 		unsigned short* biPtr=biRowPtr;
 		while(true)
 			{
 			/* Find the start of the next span in the current row: */
-			unsigned int nextSpanStart=depthFrameSize[0];
+			unsigned int nextSpanStart=regionMax[0];
 			if(spanIndex<numSpans&&spans[spanIndex].y==y)
 				nextSpanStart=spans[spanIndex].start;
 			
@@ -543,7 +1009,7 @@ void HandExtractor::extractHands(const HandExtractor::DepthPixel* depthFrame,Han
 				*biPtr=invalidBlobId;
 			
 			/* Bail out if the current row is done: */
-			if(x==depthFrameSize[0])
+			if(x==regionMax[0])
 				break;
 			
 			/* Check if the current span's blob is valid, and encountered for the first time: */
@@ -566,16 +1032,12 @@ void HandExtractor::extractHands(const HandExtractor::DepthPixel* depthFrame,Han
 			}
 		}
 	
-	/* Initialize the result list: */
-	hands.clear();
-	
 	/* Walk around the edges of all foreground blobs in counter-clockwise order and decide whether they are hand-shaped: */
 	EdgePixel* snakeEnd=snake+snakeLength;
 	int enterDist2=Math::sqr(maxCornerEnterDist);
 	int centerDist2=Math::sqr(minCenterDist);
 	int exitDist2=Math::sqr(minCornerExitDist);
-	std::vector<Corner> corners;
-	corners.reserve(10);
+	corners.clear();
 	for(unsigned int blobId=0;blobId<nextBlobId;++blobId)
 		{
 		/* Initialize the edge-walking snake: */
@@ -817,7 +1279,17 @@ void HandExtractor::extractHands(const HandExtractor::DepthPixel* depthFrame,Han
 						
 						/* Calculate the hand's average depth in depth-corrected depth image space: */
 						depth=0.0f;
-						if(pixelDepthCorrection!=0)
+						if(currentCorrectedDepth!=0)
+							{
+							depth+=currentCorrectedDepth[t0.y*depthFrameSize[0]+t0.x];
+							depth+=currentCorrectedDepth[n1.y*depthFrameSize[0]+n1.x];
+							depth+=currentCorrectedDepth[t1.y*depthFrameSize[0]+t1.x];
+							depth+=currentCorrectedDepth[n2.y*depthFrameSize[0]+n2.x];
+							depth+=currentCorrectedDepth[t2.y*depthFrameSize[0]+t2.x];
+							depth+=currentCorrectedDepth[n3.y*depthFrameSize[0]+n3.x];
+							depth+=currentCorrectedDepth[t3.y*depthFrameSize[0]+t3.x];
+							}
+						else if(pixelDepthCorrection!=0)
 							{
 							ptrdiff_t t0Off=t0.y*depthFrameSize[0]+t0.x;
 							depth+=pixelDepthCorrection[t0Off].correct(float(depthFrame[t0Off]));
@@ -868,22 +1340,25 @@ void HandExtractor::extractHands(const HandExtractor::DepthPixel* depthFrame,Han
 			// DEBUGGING
 			// std::cout<<"Hand in depth space: "<<center[0]<<", "<<center[1]<<", "<<depth<<", "<<radius<<std::endl;
 			
-			/* Store the hand in camera space: */
-			Hand newHand;
-			newHand.center=depthProjection.transform(Point(center[0],center[1],depth));
-			newHand.radius=Geometry::dist(newHand.center,depthProjection.transform(Point(center[0]+radius,center[1],depth)));
-			hands.push_back(newHand);
-			
-			// DEBUGGING
-			// std::cout<<"Hand in camera space: "<<newHand.center[0]<<", "<<newHand.center[1]<<", "<<newHand.center[2]<<", "<<newHand.radius<<std::endl;
+			/* Store the hand in depth image space unless it was already detected in an overlapping region: */
+			bool duplicate=false;
+			if(mergeDuplicates)
+				for(std::vector<DetectedHand>::iterator dhIt=detectedHands.begin();dhIt!=detectedHands.end()&&!duplicate;++dhIt)
+					duplicate=Math::sqr(dhIt->center[0]-center[0])+Math::sqr(dhIt->center[1]-center[1])<Math::sqr(Misc::max(dhIt->radius,radius));
+			if(!duplicate)
+				{
+				DetectedHand newHand;
+				for(int i=0;i<2;++i)
+					newHand.center[i]=center[i];
+				newHand.depth=depth;
+				newHand.radius=radius;
+				detectedHands.push_back(newHand);
+				}
 			}
 		
 		/* Clean up: */
 		corners.clear();
 		}
-	
-	/* Clean up: */
-	delete[] blobOrigins;
 	}
 
 void HandExtractor::setHandsExtractedFunction(HandExtractor::HandsExtractedFunction* newHandsExtractedFunction)
@@ -898,6 +1373,23 @@ void HandExtractor::receiveRawFrame(const Kinect::FrameBuffer& newFrame)
 	
 	/* Store the new buffer in the input buffer: */
 	inputFrame=newFrame;
+	inputPreprocessed=false;
+	++inputFrameVersion;
+	
+	/* Signal the background thread: */
+	inputCond.signal();
+	}
+
+void HandExtractor::receivePreprocessedFrame(const DepthPreprocessor::Frame& newFrame)
+	{
+	Threads::MutexCond::Lock inputLock(inputCond);
+	
+	/* Store the new buffers in the input buffer: */
+	inputFrame=newFrame.rawDepth;
+	inputForegroundMask=newFrame.foregroundMask;
+	inputCorrectedDepth=newFrame.correctedDepth;
+	inputMaxFgDepth=newFrame.maxFgDepth;
+	inputPreprocessed=true;
 	++inputFrameVersion;
 	
 	/* Signal the background thread: */
@@ -33,6 +33,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Kinect/FrameSource.h>
 
 #include "Types.h"
+#include "WorkerPool.h"
+#include "DepthPreprocessor.h"
 
 /* Forward declarations: */
 namespace Misc {
@@ -53,10 +55,13 @@ class HandExtractor
 		public:
 		Point center; // Hand's center in depth image space
 		double radius; // Hand's approximate radius in depth image space
+		unsigned int id; // Hand's tracking ID, stable across frames while the hand is tracked; 0 if hand tracking is disabled
 		};
 	
 	typedef std::vector<Hand> HandList; // Type for lists of hand positions
 	typedef Misc::FunctionCall<const HandList&> HandsExtractedFunction; // Type for functions called when a new hand list has been extracted
+	static const unsigned int maxNumThreads=WorkerPool::maxNumWorkers; // Maximum number of threads labelling each frame's foreground spans
+	static const unsigned int maxPyramidLevel=2; // Maximum level of the min-depth pyramid pre-pass
 	
 	private:
 	struct EdgePixel // Helper structure storing an edge pixel of a blob
@@ -66,6 +71,63 @@ class HandExtractor
 		int x,y; // Position of edge pixel in depth frame
 		const unsigned short* biPtr; // Pointer to edge pixel in blob ID image
 		};
+	
+	struct Span // Helper structure to extract foreground blobs from a depth image
+		{
+		/* Elements: */
+		public:
+		unsigned int y; // Row index of the span
+		unsigned int start; // Starting column of span
+		unsigned int end; // Ending column of span
+		unsigned int parent; // Span's parent span
+		unsigned int numPixels; // Number of pixels in the span's subtree
+		unsigned int blobId; // Blob ID of a root span
+		};
+	
+	struct BlobOrigin // Helper structure to store a point on the border of a foreground blob
+		{
+		/* Elements: */
+		public:
+		bool assigned; // Flag if the blob origin has already been assigned
+		unsigned int x,y; // Coordinates of blob origin in depth frame
+		const unsigned short* biPtr; // Pointer to blob origin in blob ID image
+		};
+	
+	struct Corner // Helper class to store corners in blob images
+		{
+		/* Elements: */
+		public:
+		int cornerType; // Corner type, +1: finger tip, -1: finger nook
+		unsigned start; // Boundary pixel index at which the corner started
+		int x,y; // Corner position in depth frame
+		};
+	
+	struct DetectedHand // Helper structure to store a hand detected in the current depth frame
+		{
+		/* Elements: */
+		public:
+		float center[2]; // Hand's center in depth frame
+		float depth; // Hand's average depth value
+		float radius; // Hand's radius in depth frame pixels
+		bool assigned; // Flag if the detected hand has been assigned to a tracked hand
+		};
+	
+	struct TrackedHand // Helper structure to store a hand tracked across depth frames
+		{
+		/* Elements: */
+		public:
+		unsigned int id; // Hand's tracking ID
+		DetectedHand hand; // Hand's most recent position, depth, and radius in depth frame
+		float velocity[2]; // Hand's estimated velocity in depth frame pixels per frame
+		unsigned int numMissedFrames; // Number of consecutive frames in which the hand was not detected
+		};
+	
+	struct ScanRegion // Helper structure to store a rectangle of the depth frame to be scanned for hands
+		{
+		/* Elements: */
+		public:
+		unsigned int min[2],max[2]; // Rectangle's half-open pixel range
+		};
 
 	/* Elements: */
 	private:
@@ -75,11 +137,16 @@ class HandExtractor
 	
 	Threads::MutexCond inputCond; // Condition variable to signal arrival of a new input frame
 	Kinect::FrameBuffer inputFrame; // The most recent input frame
+	Kinect::FrameBuffer inputForegroundMask; // Shared foreground mask of the most recent input frame if it was preprocessed
+	Kinect::FrameBuffer inputCorrectedDepth; // Shared depth-corrected version of the most recent input frame if it was preprocessed
+	bool inputPreprocessed; // Flag whether the most recent input frame came from a depth preprocessor
+	DepthPixel inputMaxFgDepth; // Maximum foreground depth with which the shared foreground mask of the most recent input frame was calculated
 	unsigned int inputFrameVersion; // Version number of input frame
 	volatile bool runExtractorThread; // Flag to keep the background extraction thread running
 	Threads::Thread extractorThread; // The background filtering thread
 	
 	DepthPixel maxFgDepth; // Maximum depth value for foreground blobs
+	DepthPreprocessor* depthPreprocessor; // Shared preprocessing stage delivering input frames to this hand extractor, or null
 	unsigned int maxDepthDist; // Maximum depth distance between adjacent pixels to belong to the same foreground blob
 	unsigned int minBlobSize,maxBlobSize; // Minimum and maximum number of pixels to consider a blob a hand candidate
 	unsigned short* blobIdImage; // Image of per-pixel blob IDs with one pixel boundary layer
@@ -94,11 +161,46 @@ class HandExtractor
 	int minCenterDist; // Minimum distance from snake's center to line defined by its head and tail to enter corner state
 	int minCornerExitDist; // Minimum distance between snake's head and tail to leave corner state
 	float minHandProbability; // Minimum probability rating at which to accept a blob as a hand
+	std::vector<Span> spans; // List of foreground spans in the current depth frame; keeps its capacity between frames
+	unsigned int numThreads; // Requested number of threads labelling each frame's foreground spans in horizontal bands
+	WorkerPool* workerPool; // Pool of worker threads to label bands in parallel, or null if spans are labelled by the extraction thread alone
+	unsigned int numBands; // Number of horizontal bands into which the current frame is split
+	std::vector<Span>* bandSpans; // Array of per-band lists of foreground spans with band-local indices; keep their capacity between frames
+	const DepthPixel* currentDepthFrame; // Depth frame currently being labelled by the worker threads
+	WorkerPool::BandFunction* spanFunction; // Function extracting and labelling the foreground spans of one band
+	unsigned int regionMin[2],regionMax[2]; // Half-open pixel range of the depth frame region currently being scanned for hands
+	std::vector<DetectedHand> detectedHands; // List of hands detected in the current depth frame; keeps its capacity between frames
+	volatile bool trackHands; // Flag whether hands are tracked across frames by scanning regions around their predicted positions
+	unsigned int maxMissedFrames; // Maximum number of consecutive frames in which a tracked hand can go undetected before it is dropped
+	unsigned int roiMargin; // Margin in pixels around a tracked hand's predicted extent to scan for the hand in the next frame
+	unsigned int sweepHeight; // Height in rows of the window sweeping over the depth frame to find new hands while tracking
+	unsigned int sweepRow; // First row of the current sweep window
+	std::vector<TrackedHand> trackedHands; // List of currently tracked hands
+	unsigned int nextHandId; // Tracking ID to assign to the next newly detected hand
+	std::vector<ScanRegion> scanRegions; // List of depth frame regions to be scanned for hands in the current frame
+	volatile unsigned int pyramidLevel; // Level of the min-depth pyramid used to find foreground candidate regions before full-resolution scanning; 0 disables the pre-pass
+	std::vector<unsigned char> coarseMask; // Foreground mask of the current region at the pyramid level; keeps its capacity between frames
+	std::vector<unsigned int> coarseStack; // Stack of coarse pixel indices for flood-filling foreground components; keeps its capacity between frames
+	std::vector<ScanRegion> candidateRegions; // List of foreground candidate regions in the current region; keeps its capacity between frames
+	const unsigned char* currentForegroundMask; // Shared foreground mask of the depth frame currently being processed, or null to test raw depth values against maxFgDepth
+	const float* currentCorrectedDepth; // Shared depth-corrected version of the depth frame currently being processed, or null to apply per-pixel depth correction locally
+	std::vector<BlobOrigin> blobOrigins; // Array of origin points of the foreground blobs in the current depth frame; keeps its capacity between frames
+	std::vector<Corner> corners; // List of corners along the edge of the current foreground blob; keeps its capacity between blobs and frames
 	
 	Threads::TripleBuffer<HandList> extractedHands; // Triple buffer of lists of extracted hands
 	HandsExtractedFunction* handsExtractedFunction; // Function called when a new list of extracted hands is ready
 	
 	/* Private methods: */
+	bool canLinkSpans(const DepthPixel* depthFrame,const Span& span0,const Span& span1) const; // Returns true if the given spans from adjacent rows have depth in common; span0 is in the row above span1
+	static void linkSpans(std::vector<Span>& spanList,unsigned int span0,unsigned int span1); // Merges the subtrees containing the given spans, making the root with the smaller index the new root
+	void extractSpans(const DepthPixel* depthFrame,unsigned int y0,unsigned int y1,std::vector<Span>& spanList) const; // Extracts and labels the foreground spans in the given range of rows into the given span list
+	void extractBandSpans(unsigned int band); // Extracts and labels the foreground spans in the given band of the current depth frame
+	void scanRegion(const DepthPixel* depthFrame,Images::RGBImage* blobImage,Images::RGBImage::Color* imgPtr,bool mergeDuplicates); // Appends all hands detected in the current region to the detected hand list, optionally skipping hands that were already detected
+	void detectHands(const DepthPixel* depthFrame,Images::RGBImage* blobImage,Images::RGBImage::Color* imgPtr,bool mergeDuplicates); // Scans the current region for hands, restricted to foreground candidate regions found on the min-depth pyramid if enabled
+	Hand transformHand(const DetectedHand& detectedHand,unsigned int id) const; // Transforms the given detected hand from depth image space to camera space
+	void scanTrackingRegions(const DepthPixel* depthFrame,Images::RGBImage* blobImage,Images::RGBImage::Color* imgPtr); // Scans regions around all tracked hands and the current sweep window for hands
+	void updateTrackedHands(void); // Matches detected hands to tracked hands and updates their states
+	void extractHands(const DepthPixel* depthFrame,const unsigned char* foregroundMask,const float* correctedDepth,HandList& hands,Images::RGBImage* blobImage); // Extracts hands from the given depth frame using the given shared foreground mask and corrected depth frame if they are not null
 	void* extractorThreadMethod(void); // Method for the background hand extraction thread
 	
 	/* Constructors and destructors: */
@@ -111,11 +213,14 @@ class HandExtractor
 	~HandExtractor(void);
 	
 	/* Methods: */
+	static bool parseNumThreads(const char* string,unsigned int& numThreads); // Sets the given number of span labelling threads from the given decimal string; returns false if the string is not a number between 1 and maxNumThreads
+	static bool parsePyramidLevel(const char* string,unsigned int& pyramidLevel); // Sets the given min-depth pyramid level from the given decimal string; returns false if the string is not a number between 0 and maxPyramidLevel
 	DepthPixel getMaxFgDepth(void) const // Returns the maximum depth value for foreground blobs
 		{
 		return maxFgDepth;
 		}
-	void setMaxFgDepth(DepthPixel newMaxFgDepth); // Sets the maximum depth value for foreground blobs
+	void setMaxFgDepth(DepthPixel newMaxFgDepth); // Sets the maximum depth value for foreground blobs, and the foreground threshold of the shared preprocessing stage if there is one
+	void setDepthPreprocessor(DepthPreprocessor& newDepthPreprocessor); // Subscribes the hand extractor to the given shared preprocessing stage and keeps the stage's foreground threshold in sync with its own; must be called before the stage receives its first frame
 	unsigned int getMaxDepthDist(void) const // Returns the maximum depth distance between adjacent pixels to belong to the same foreground blob
 		{
 		return maxDepthDist;
@@ -148,9 +253,39 @@ class HandExtractor
 		return minCornerExitDist;
 		}
 	void setCornerDists(int newMaxCornerEnterDist,int newMinCenterDist,int newMinCornerExitDist); // Sets distances between snake's head and tail to enter and exit corner state, respectively
+	unsigned int getNumThreads(void) const // Returns the number of threads labelling each frame's foreground spans
+		{
+		return numThreads;
+		}
+	void setNumThreads(unsigned int newNumThreads); // Sets the number of threads labelling each frame's foreground spans in horizontal bands, clamped to between 1 and maxNumThreads
+	bool getTrackHands(void) const // Returns true if hands are tracked across frames
+		{
+		return trackHands;
+		}
+	void setTrackHands(bool newTrackHands); // Enables or disables tracking hands across frames by scanning regions around their predicted positions and a rotating sweep window
+	unsigned int getMaxMissedFrames(void) const // Returns the number of frames a tracked hand can go undetected
+		{
+		return maxMissedFrames;
+		}
+	unsigned int getRoiMargin(void) const // Returns the margin around tracked hands' predicted extents
+		{
+		return roiMargin;
+		}
+	unsigned int getSweepHeight(void) const // Returns the height of the sweep window
+		{
+		return sweepHeight;
+		}
+	void setTrackingParameters(unsigned int newMaxMissedFrames,unsigned int newRoiMargin,unsigned int newSweepHeight); // Sets the hand tracking parameters
+	unsigned int getPyramidLevel(void) const // Returns the level of the min-depth pyramid pre-pass
+		{
+		return pyramidLevel;
+		}
+	void setPyramidLevel(unsigned int newPyramidLevel); // Sets the level of the min-depth pyramid pre-pass; 0: disabled, 1: half resolution, 2: quarter resolution; clamped to at most maxPyramidLevel
 	void extractHands(const DepthPixel* depthFrame,HandList& hands,Images::RGBImage* blobImage); // Extracts hands from the given depth frame
+	void extractHands(const DepthPreprocessor::Frame& frame,HandList& hands,Images::RGBImage* blobImage); // Extracts hands from the given preprocessed depth frame, using its corrected depth values, and its foreground mask if it was calculated with the current maximum foreground depth
 	void setHandsExtractedFunction(HandsExtractedFunction* newHandsExtractedFunction); // Sets the output function; adopts given functor object
 	void receiveRawFrame(const Kinect::FrameBuffer& newFrame); // Called to receive a new raw depth frame
+	void receivePreprocessedFrame(const DepthPreprocessor::Frame& newFrame); // Called to receive a new preprocessed depth frame from a depth preprocessor
 	bool lockNewExtractedHands(void) // Locks the most recently produced output list of extracted hands for reading; returns true if the locked list is new
 		{
 		return extractedHands.lockNewValue();
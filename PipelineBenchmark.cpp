@@ -0,0 +1,1278 @@
+/***********************************************************************
+PipelineBenchmark - Utility to measure the per-frame cost of the
+Augmented Reality Sandbox's depth processing pipeline on synthetic depth
+frames, without requiring a depth camera or graphics hardware.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <Misc/SizedTypes.h>
+#include <Threads/Thread.h>
+#include <Kinect/FrameBuffer.h>
+
+#include "Types.h"
+#include "FrameFilter.h"
+#include "TileChangeMask.h"
+#include "FrameRing.h"
+#include "DepthPixelFormats.h"
+#include "DepthPreprocessor.h"
+#include "HandExtractor.h"
+#include "ValidDepthBounds.h"
+#include "FindBlobs.h"
+#include "CPUWaterSolver.h"
+
+/***********************************************************************
+Specialized blob property to accumulate the 3D centroids of blobs in raw
+depth frames the same way as the rain maker:
+***********************************************************************/
+
+template <>
+class BlobProperty<unsigned short>
+	{
+	/* Elements: */
+	private:
+	double pxs,pys,pzs; // Accumulated components of centroid
+	size_t numPixels; // Number of accumulated pixels
+	
+	/* Constructors and destructors: */
+	public:
+	BlobProperty(void)
+		:pxs(0.0),pys(0.0),pzs(0.0),
+		 numPixels(0)
+		{
+		}
+	
+	/* Methods: */
+	void addPixel(unsigned int x,unsigned int y,const unsigned short& pixelValue)
+		{
+		pxs+=double(x);
+		pys+=double(y);
+		pzs+=double(pixelValue);
+		++numPixels;
+		}
+	void merge(const BlobProperty& other)
+		{
+		pxs+=other.pxs;
+		pys+=other.pys;
+		pzs+=other.pzs;
+		numPixels+=other.numPixels;
+		}
+	bool operator==(const BlobProperty& other) const
+		{
+		return pxs==other.pxs&&pys==other.pys&&pzs==other.pzs&&numPixels==other.numPixels;
+		}
+	};
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+double getTime(void) // Returns the current monotonic time in seconds
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return double(ts.tv_sec)+double(ts.tv_nsec)*1.0e-9;
+	}
+
+/*****************************************************************
+Helper class to count hardware cache events of the calling thread:
+*****************************************************************/
+
+class CacheCounter
+	{
+	/* Elements: */
+	private:
+	int fds[2]; // File descriptors for the cache reference and cache miss counters, or -1 if unavailable
+
+	/* Private methods: */
+	static int openCounter(unsigned long long config) // Opens a disabled hardware event counter for the calling thread
+		{
+		struct perf_event_attr attr;
+		memset(&attr,0,sizeof(attr));
+		attr.type=PERF_TYPE_HARDWARE;
+		attr.size=sizeof(attr);
+		attr.config=config;
+		attr.disabled=1;
+		attr.exclude_kernel=1;
+		attr.exclude_hv=1;
+		return int(syscall(__NR_perf_event_open,&attr,0,-1,-1,0));
+		}
+
+	/* Constructors and destructors: */
+	public:
+	CacheCounter(void)
+		{
+		fds[0]=openCounter(PERF_COUNT_HW_CACHE_REFERENCES);
+		fds[1]=openCounter(PERF_COUNT_HW_CACHE_MISSES);
+		}
+	~CacheCounter(void)
+		{
+		for(int i=0;i<2;++i)
+			if(fds[i]>=0)
+				close(fds[i]);
+		}
+
+	/* Methods: */
+	bool isValid(void) const // Returns true if both counters are available
+		{
+		return fds[0]>=0&&fds[1]>=0;
+		}
+	void start(void) // Resets and enables the counters
+		{
+		for(int i=0;i<2;++i)
+			if(fds[i]>=0)
+				{
+				ioctl(fds[i],PERF_EVENT_IOC_RESET,0);
+				ioctl(fds[i],PERF_EVENT_IOC_ENABLE,0);
+				}
+		}
+	void stop(unsigned long long& references,unsigned long long& misses) // Disables the counters and returns their values
+		{
+		unsigned long long values[2]={0,0};
+		for(int i=0;i<2;++i)
+			if(fds[i]>=0)
+				{
+				ioctl(fds[i],PERF_EVENT_IOC_DISABLE,0);
+				if(read(fds[i],&values[i],sizeof(values[i]))!=ssize_t(sizeof(values[i])))
+					values[i]=0;
+				}
+		references=values[0];
+		misses=values[1];
+		}
+	};
+
+/******************************************************************
+Helper class to generate a repeatable stream of synthetic raw depth
+frames showing a sand surface with sensor noise and dropouts:
+******************************************************************/
+
+class SyntheticDepthSource
+	{
+	/* Elements: */
+	private:
+	unsigned int size[2]; // Frame size
+	FrameFilter::DepthPixelFormat pixelFormat; // Pixel format of generated frames
+	unsigned int randState; // State of the pseudo-random number generator
+
+	/* Private methods: */
+	unsigned int rand(void) // Returns a pseudo-random number in [0, 2^15)
+		{
+		randState=randState*1103515245U+12345U;
+		return (randState>>16)&0x7fffU;
+		}
+
+	static bool isHandPixel(int u,int v) // Returns true if the given pixel relative to the wrist is covered by a flat hand with four fingers and a thumb, reaching into the frame from the top
+		{
+		/* Check the forearm and palm: */
+		if(v<0)
+			return u>=-22&&u<22;
+		if(v<40)
+			return u>=-40&&(u<40||(u<70&&v>=5&&v<17));
+		
+		/* Check the four fingers of different lengths: */
+		static const int fingerLengths[4]={30,36,34,26};
+		int finger=(u+40)/20;
+		int fingerU=(u+40)%20;
+		return u>=-40&&finger<4&&fingerU>=2&&fingerU<14&&v<40+fingerLengths[finger];
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	SyntheticDepthSource(const unsigned int sSize[2],FrameFilter::DepthPixelFormat sPixelFormat)
+		:pixelFormat(sPixelFormat),randState(1U)
+		{
+		for(int i=0;i<2;++i)
+			size[i]=sSize[i];
+		}
+
+	/* Private methods: */
+	template <class PixelParam>
+	void fillFrame(PixelParam* dPtr,unsigned int frameIndex,PixelParam invalidPixel) // Fills the given frame with the synthetic depth frame of the given index
+		{
+		for(unsigned int y=0;y<size[1];++y)
+			for(unsigned int x=0;x<size[0];++x,++dPtr)
+				{
+				/* Sample a hilly sand surface, and let a hand sweep across the frame: */
+				double depth=900.0+60.0*sin(double(x)*0.021)*cos(double(y)*0.017);
+				int hx=int((frameIndex*7U)%size[0]);
+				if(isHandPixel(int(x)-hx,int(y)-int(size[1]/4)))
+					depth-=250.0;
+
+				/* Add sensor noise and random dropouts: */
+				if(rand()%50U==0U)
+					*dPtr=invalidPixel;
+				else
+					*dPtr=PixelParam(depth+double(rand()%5U)-2.0);
+				}
+		}
+
+	/* Methods: */
+	public:
+	Kinect::FrameBuffer createFrame(unsigned int frameIndex) // Creates the synthetic depth frame of the given index
+		{
+		/* Use each pixel format's marker for invalid pixels: */
+		if(pixelFormat==FrameFilter::FLOAT_DEPTH)
+			{
+			Kinect::FrameBuffer result(size[0],size[1],size[1]*size[0]*sizeof(float));
+			fillFrame(result.getData<float>(),frameIndex,float(NAN));
+			return result;
+			}
+		else
+			{
+			Kinect::FrameBuffer result(size[0],size[1],size[1]*size[0]*sizeof(unsigned short));
+			fillFrame(result.getData<unsigned short>(),frameIndex,pixelFormat==FrameFilter::KINECT_DEPTH?(unsigned short)(2047U):(unsigned short)(0U));
+			return result;
+			}
+		}
+	};
+
+/*********************************************************************
+Helper class to select the foreground pixels of filtered depth frames,
+i.e., the pixels closer to the camera than a given depth that were not
+marked as unstable:
+*********************************************************************/
+
+class ForegroundProperty
+	{
+	/* Embedded classes: */
+	public:
+	typedef float Pixel;
+	
+	/* Elements: */
+	private:
+	float maxDepth; // Maximum depth value of foreground pixels
+	
+	/* Constructors and destructors: */
+	public:
+	ForegroundProperty(float sMaxDepth)
+		:maxDepth(sMaxDepth)
+		{
+		}
+	
+	/* Methods: */
+	bool operator()(unsigned int x,unsigned int y,const Pixel& pixel) const
+		{
+		return pixel>0.0f&&pixel<maxDepth;
+		}
+	};
+
+/*******************************************************************
+Helper class to select the valid pixels of raw depth frames by their
+per-pixel intervals of valid raw depth values, like the rain maker:
+*******************************************************************/
+
+class RawValidProperty
+	{
+	/* Embedded classes: */
+	public:
+	typedef unsigned short Pixel;
+	
+	/* Elements: */
+	private:
+	const ValidDepthBounds<Pixel>& validDepthBounds; // Per-pixel intervals of valid raw depth values
+	
+	/* Constructors and destructors: */
+	public:
+	RawValidProperty(const ValidDepthBounds<Pixel>& sValidDepthBounds)
+		:validDepthBounds(sValidDepthBounds)
+		{
+		}
+	
+	/* Methods: */
+	bool operator()(unsigned int x,unsigned int y,const Pixel& pixel) const
+		{
+		return validDepthBounds.isValid(x,y,pixel);
+		}
+	};
+
+/*************************************************************
+Helper function to check whether two blob lists are identical:
+*************************************************************/
+
+template <class PixelParam>
+bool equalBlobs(const std::vector<Blob<PixelParam> >& blobs1,const std::vector<Blob<PixelParam> >& blobs2)
+	{
+	if(blobs1.size()!=blobs2.size())
+		return false;
+	for(size_t i=0;i<blobs1.size();++i)
+		{
+		const Blob<PixelParam>& b1=blobs1[i];
+		const Blob<PixelParam>& b2=blobs2[i];
+		if(b1.x!=b2.x||b1.y!=b2.y||!(b1.blobProperty==b2.blobProperty))
+			return false;
+		for(int j=0;j<2;++j)
+			if(b1.min[j]!=b2.min[j]||b1.max[j]!=b2.max[j])
+				return false;
+		}
+	return true;
+	}
+
+/******************************************************************
+Helper function to calculate a 64-bit FNV-1a checksum of a filtered
+depth frame's bit patterns:
+******************************************************************/
+
+Misc::UInt64 calcChecksum(const unsigned int size[2],const float* filteredFrame)
+	{
+	const unsigned char* fPtr=reinterpret_cast<const unsigned char*>(filteredFrame);
+	const unsigned char* fEnd=fPtr+size_t(size[1])*size_t(size[0])*sizeof(float);
+	Misc::UInt64 result=14695981039346656037ULL;
+	for(;fPtr!=fEnd;++fPtr)
+		{
+		result^=Misc::UInt64(*fPtr);
+		result*=1099511628211ULL;
+		}
+	return result;
+	}
+
+/*********************************************************************
+Helper class to save checksums of the filtered frames, and the
+extracted hands and foreground blobs, of a synthetic frame sequence to
+a golden file, or to compare them against a previously saved golden
+file:
+*********************************************************************/
+
+class GoldenFile
+	{
+	/* Elements: */
+	private:
+	std::fstream file; // The golden file
+	bool save; // Flag whether the golden file is being written
+	double positionTolerance; // Maximum allowed difference between hand and blob positions and sizes in pixels
+	unsigned int numFailedFrames; // Number of compared frames that did not match the golden file
+	
+	/* Private methods: */
+	static bool matches(double golden,double value,double tolerance) // Returns true if the given value is within the tolerance of the given golden value
+		{
+		return fabs(value-golden)<=tolerance;
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	GoldenFile(const char* fileName,bool sSave,const std::string& settings,double sPositionTolerance)
+		:file(fileName,sSave?std::ios::out|std::ios::trunc:std::ios::in),
+		 save(sSave),
+		 positionTolerance(sPositionTolerance),
+		 numFailedFrames(0)
+		{
+		if(!file.is_open())
+			throw std::runtime_error(std::string("Cannot open golden file ")+fileName);
+		if(save)
+			{
+			/* Write the file header: */
+			file<<"SARndbox golden output 2.0"<<std::endl;
+			file<<settings<<std::endl;
+			file<<std::setprecision(17);
+			}
+		else
+			{
+			/* Check the file header: */
+			std::string line;
+			if(!std::getline(file,line)||line!="SARndbox golden output 2.0")
+				throw std::runtime_error(std::string(fileName)+" is not a golden output file");
+			std::getline(file,line);
+			if(line!=settings)
+				throw std::runtime_error(std::string("Golden output was saved with settings \"")+line+"\", not \""+settings+"\"");
+			}
+		}
+	
+	/* Methods: */
+	bool processFrame(unsigned int frameIndex,const unsigned int size[2],const float* filteredFrame,const HandExtractor::HandList& hands,const std::vector<Blob<float> >& blobs) // Saves or compares the results of one frame; returns false if they don't match
+		{
+		Misc::UInt64 checksum=calcChecksum(size,filteredFrame);
+		if(save)
+			{
+			/* Write the frame's results as one line: */
+			file<<frameIndex<<' '<<std::hex<<std::setw(16)<<std::setfill('0')<<checksum<<std::dec<<std::setfill(' ');
+			file<<' '<<hands.size();
+			for(HandExtractor::HandList::const_iterator hIt=hands.begin();hIt!=hands.end();++hIt)
+				file<<' '<<hIt->center[0]<<' '<<hIt->center[1]<<' '<<hIt->radius;
+			file<<' '<<blobs.size();
+			for(std::vector<Blob<float> >::const_iterator bIt=blobs.begin();bIt!=blobs.end();++bIt)
+				file<<' '<<bIt->x<<' '<<bIt->y<<' '<<bIt->min[0]<<' '<<bIt->min[1]<<' '<<bIt->max[0]<<' '<<bIt->max[1];
+			file<<std::endl;
+			
+			return true;
+			}
+		
+		/* Read the frame's golden results: */
+		unsigned int goldenFrameIndex;
+		Misc::UInt64 goldenChecksum;
+		if(!(file>>goldenFrameIndex>>std::hex>>goldenChecksum>>std::dec)||goldenFrameIndex!=frameIndex)
+			throw std::runtime_error("Golden output file is truncated or corrupted");
+		
+		/* Compare the extracted hands: */
+		size_t numGoldenHands=0;
+		file>>numGoldenHands;
+		unsigned int numMismatchedHands=0;
+		for(size_t i=0;i<numGoldenHands;++i)
+			{
+			double golden[3];
+			file>>golden[0]>>golden[1]>>golden[2];
+			if(i>=hands.size()||!matches(golden[0],hands[i].center[0],positionTolerance)||!matches(golden[1],hands[i].center[1],positionTolerance)||!matches(golden[2],hands[i].radius,positionTolerance))
+				++numMismatchedHands;
+			}
+		
+		/* Compare the foreground blobs: */
+		size_t numGoldenBlobs=0;
+		file>>numGoldenBlobs;
+		unsigned int numMismatchedBlobs=0;
+		for(size_t i=0;i<numGoldenBlobs;++i)
+			{
+			double goldenPos[2];
+			unsigned int goldenMin[2],goldenMax[2];
+			file>>goldenPos[0]>>goldenPos[1]>>goldenMin[0]>>goldenMin[1]>>goldenMax[0]>>goldenMax[1];
+			if(i>=blobs.size()||!matches(goldenPos[0],blobs[i].x,positionTolerance)||!matches(goldenPos[1],blobs[i].y,positionTolerance))
+				++numMismatchedBlobs;
+			else
+				{
+				/* Allow bounding boxes to grow or shrink by the position tolerance: */
+				for(int j=0;j<2;++j)
+					if(!matches(goldenMin[j],blobs[i].min[j],positionTolerance+0.5)||!matches(goldenMax[j],blobs[i].max[j],positionTolerance+0.5))
+						{
+						++numMismatchedBlobs;
+						break;
+						}
+				}
+			}
+		if(!file)
+			throw std::runtime_error("Golden output file is truncated or corrupted");
+		
+		/* Report mismatches: */
+		if(checksum==goldenChecksum&&numGoldenHands==hands.size()&&numMismatchedHands==0&&numGoldenBlobs==blobs.size()&&numMismatchedBlobs==0)
+			return true;
+		std::cout<<"  Frame "<<frameIndex<<": ";
+		std::cout<<"checksum "<<std::hex<<std::setw(16)<<std::setfill('0')<<checksum<<" (golden "<<std::setw(16)<<goldenChecksum<<std::dec<<std::setfill(' ')<<"), ";
+		std::cout<<hands.size()<<" of "<<numGoldenHands<<" hands ("<<numMismatchedHands<<" mismatched), ";
+		std::cout<<blobs.size()<<" of "<<numGoldenBlobs<<" blobs ("<<numMismatchedBlobs<<" mismatched)"<<std::endl;
+		++numFailedFrames;
+		return false;
+		}
+	unsigned int getNumFailedFrames(void) const // Returns the number of compared frames that did not match the golden file
+		{
+		return numFailedFrames;
+		}
+	};
+
+/*****************************************************************
+Helper function to check that the frame filter's vectorized kernel
+produces the same bit patterns as its scalar kernel on a synthetic
+frame sequence, for all pixel formats and filter configurations:
+*****************************************************************/
+
+struct KernelCheckConfig // Structure describing a frame filter configuration to check
+	{
+	/* Elements: */
+	public:
+	const char* name; // Name of the configuration
+	FrameFilter::TemporalFilterType temporalFilterType; // Type of temporal filter
+	bool spatialFilter; // Flag whether to run the spatial filter
+	bool fuseSpatialFilter; // Flag whether to fuse the spatial filter with the temporal filter
+	unsigned int medianFilterRadius; // Radius of the median filter, or 0 to disable it
+	float motionThreshold; // Threshold for motion adaptation, or 0 to disable it
+	bool fillHoles; // Flag whether to fill holes
+	};
+
+bool checkVectorized(const unsigned int size[2],unsigned int numFrames)
+	{
+	static const KernelCheckConfig configs[]=
+		{
+		{"averaging buffer",FrameFilter::AVERAGING_BUFFER,true,true,0,0.0f,false},
+		{"recursive estimator",FrameFilter::RECURSIVE_ESTIMATOR,true,true,0,0.0f,false},
+		{"unfused spatial filter",FrameFilter::AVERAGING_BUFFER,true,false,0,0.0f,false},
+		{"no spatial filter",FrameFilter::AVERAGING_BUFFER,false,true,0,0.0f,false},
+		{"3x3 median filter",FrameFilter::AVERAGING_BUFFER,true,true,1,0.0f,false},
+		{"5x5 median filter",FrameFilter::AVERAGING_BUFFER,true,true,2,0.0f,false},
+		{"motion adaptation",FrameFilter::AVERAGING_BUFFER,true,true,0,20.0f,false},
+		{"hole filling",FrameFilter::AVERAGING_BUFFER,true,true,0,0.0f,true}
+		};
+	static const FrameFilter::DepthPixelFormat pixelFormats[3]={FrameFilter::KINECT_DEPTH,FrameFilter::MILLIMETER_DEPTH,FrameFilter::FLOAT_DEPTH};
+	
+	/* Create non-trivial per-pixel depth correction coefficients so that the kernels' correction steps are exercised: */
+	std::vector<FrameFilter::PixelDepthCorrection> pixelDepthCorrection(size[1]*size[0]);
+	std::vector<FrameFilter::PixelDepthCorrection>::iterator pdcIt=pixelDepthCorrection.begin();
+	for(unsigned int y=0;y<size[1];++y)
+		for(unsigned int x=0;x<size[0];++x,++pdcIt)
+			{
+			pdcIt->scale=1.0f+float((x+y)%7U)*0.001f;
+			pdcIt->offset=float(x%5U)*0.1f;
+			}
+	
+	size_t numPixels=size_t(size[1])*size_t(size[0]);
+	unsigned int numVectorizedConfigs=0;
+	unsigned int numFailedConfigs=0;
+	for(int pixelFormatIndex=0;pixelFormatIndex<3;++pixelFormatIndex)
+		for(size_t configIndex=0;configIndex<sizeof(configs)/sizeof(KernelCheckConfig);++configIndex)
+			{
+			const KernelCheckConfig& config=configs[configIndex];
+			FrameFilter::DepthPixelFormat pixelFormat=pixelFormats[pixelFormatIndex];
+			
+			/* Create two identically configured frame filters, one of which is forced to use the scalar kernel: */
+			FrameFilter* filters[2];
+			for(int i=0;i<2;++i)
+				{
+				filters[i]=new FrameFilter(size,10,config.temporalFilterType,pixelFormat,&pixelDepthCorrection[0],PTransform::identity,Plane(Plane::Vector(0,0,1),-1000.0));
+				if(pixelFormat==FrameFilter::KINECT_DEPTH)
+					filters[i]->setValidDepthInterval(0U,2046U);
+				filters[i]->setStableParameters(5,4);
+				filters[i]->setMotionAdaptive(config.motionThreshold,2);
+				filters[i]->setMedianFilter(config.medianFilterRadius>0);
+				if(config.medianFilterRadius>0)
+					filters[i]->setMedianFilterRadius(config.medianFilterRadius);
+				
+				/* Give hole filling enough time to always complete, so that both filters fill the same holes: */
+				filters[i]->setHoleFilling(config.fillHoles);
+				filters[i]->setHoleFillingBudget(1.0e6f);
+				filters[i]->setSpatialFilter(config.spatialFilter);
+				filters[i]->setFuseSpatialFilter(config.fuseSpatialFilter);
+				filters[i]->setVectorized(i!=0);
+				}
+			
+			/* Not all configurations have a vectorized temporal filter, but their spatial and median filters can still be vectorized: */
+			if(filters[1]->getVectorized())
+				++numVectorizedConfigs;
+			
+			/* Filter the same synthetic frame sequence with both filters and compare the results bit by bit: */
+			SyntheticDepthSource source(size,pixelFormat);
+			Kinect::FrameBuffer outputFrames[2];
+			for(int i=0;i<2;++i)
+				outputFrames[i]=filters[i]->createOutputFrame();
+			unsigned int firstMismatch=numFrames;
+			size_t numMismatchedPixels=0;
+			for(unsigned int frameIndex=0;frameIndex<numFrames&&firstMismatch==numFrames;++frameIndex)
+				{
+				Kinect::FrameBuffer inputFrame=source.createFrame(frameIndex);
+				for(int i=0;i<2;++i)
+					filters[i]->filterFrame(inputFrame,outputFrames[i]);
+				const Misc::UInt32* f0Ptr=outputFrames[0].getData<Misc::UInt32>();
+				const Misc::UInt32* f1Ptr=outputFrames[1].getData<Misc::UInt32>();
+				for(size_t j=0;j<numPixels;++j)
+					if(f0Ptr[j]!=f1Ptr[j])
+						++numMismatchedPixels;
+				if(numMismatchedPixels!=0)
+					firstMismatch=frameIndex;
+				}
+			for(int i=0;i<2;++i)
+				delete filters[i];
+			
+			if(firstMismatch!=numFrames)
+				{
+				std::cout<<"  "<<FrameFilter::getPixelFormatName(pixelFormat)<<" pixels, "<<config.name<<": ";
+				std::cout<<numMismatchedPixels<<" pixels differ between the scalar and vectorized kernels in frame "<<firstMismatch<<std::endl;
+				++numFailedConfigs;
+				}
+			}
+	
+	if(numFailedConfigs!=0)
+		{
+		std::cout<<numFailedConfigs<<" frame filter configurations do not produce identical results with the scalar and vectorized kernels"<<std::endl;
+		return false;
+		}
+	std::cout<<"The scalar and vectorized frame filter kernels produce identical results for all "<<3*sizeof(configs)/sizeof(KernelCheckConfig)<<" configurations";
+	std::cout<<" ("<<numVectorizedConfigs<<" with a vectorized temporal filter)"<<std::endl;
+	return true;
+	}
+
+/*******************************************************************
+Helper function to check that the CPU water solver's vectorized flux
+kernel produces the same bit patterns as its scalar kernel on a
+synthetic dam break over uneven bathymetry with rainfall:
+*******************************************************************/
+
+bool checkWaterSolver(const unsigned int size[2],unsigned int numSteps)
+	{
+	int width=int(size[0]);
+	int height=int(size[1]);
+	
+	/* Create a bathymetry of rolling hills and a raised pool of water in one corner: */
+	std::vector<float> bathymetry((width-1)*(height-1));
+	for(int y=0;y<height-1;++y)
+		for(int x=0;x<width-1;++x)
+			bathymetry[y*(width-1)+x]=2.0f*float(sin(double(x)*0.21)*cos(double(y)*0.17))+0.01f*float(x);
+	std::vector<float> waterLevel(width*height);
+	for(int y=0;y<height;++y)
+		for(int x=0;x<width;++x)
+			waterLevel[y*width+x]=x<width/3&&y<height/3?3.0f:-10.0f;
+	
+	/* Create a band of rainfall that leaves most of the water table dry: */
+	std::vector<float> waterRates(width*height,0.0f);
+	for(int y=height/2;y<height/2+4;++y)
+		for(int x=width/2;x<width;++x)
+			waterRates[y*width+x]=0.5f;
+	
+	bool result=true;
+	for(int skipDryTiles=0;skipDryTiles<2;++skipDryTiles)
+		{
+		/* Create a solver with the scalar and one with the vectorized flux kernel: */
+		const float cellSize[2]={1.0f,1.0f};
+		CPUWaterSolver* solvers[2];
+		for(int i=0;i<2;++i)
+			{
+			solvers[i]=new CPUWaterSolver(width,height,cellSize,-5.0f,1);
+			solvers[i]->setVectorized(i!=0);
+			solvers[i]->setSkipDryTiles(skipDryTiles!=0);
+			solvers[i]->updateBathymetry(&bathymetry[0]);
+			solvers[i]->setWaterLevel(&waterLevel[0]);
+			}
+		bool vectorized=solvers[1]->getVectorized();
+		
+		/* Run both solvers in lock step and compare their step sizes and quantities after every step: */
+		std::vector<float> quantities[2];
+		for(int i=0;i<2;++i)
+			quantities[i].resize(width*height*3);
+		unsigned int firstMismatch=numSteps;
+		for(unsigned int step=0;step<numSteps&&firstMismatch==numSteps;++step)
+			{
+			float stepSizes[2];
+			for(int i=0;i<2;++i)
+				{
+				stepSizes[i]=solvers[i]->runSimulationStep(false,&waterRates[0]);
+				solvers[i]->getQuantities(&quantities[i][0]);
+				}
+			if(memcmp(&stepSizes[0],&stepSizes[1],sizeof(float))!=0||memcmp(&quantities[0][0],&quantities[1][0],quantities[0].size()*sizeof(float))!=0)
+				firstMismatch=step;
+			}
+		for(int i=0;i<2;++i)
+			delete solvers[i];
+		
+		const char* mode=skipDryTiles!=0?"with dry tile skipping":"without dry tile skipping";
+		if(firstMismatch!=numSteps)
+			{
+			std::cout<<"  The scalar and vectorized water solver kernels differ "<<mode<<" in simulation step "<<firstMismatch<<std::endl;
+			result=false;
+			}
+		else if(!vectorized)
+			std::cout<<"  The water solver has no vectorized flux kernel for this CPU; compared the scalar kernel against itself "<<mode<<std::endl;
+		}
+	
+	if(result)
+		std::cout<<"The scalar and vectorized water solver kernels produce identical results over "<<numSteps<<" simulation steps"<<std::endl;
+	return result;
+	}
+
+/***************************************************************
+Helper functions and class to check the drop-oldest semantics of
+the frame ring, single-threaded and under concurrent access:
+***************************************************************/
+
+Kinect::FrameBuffer createIndexFrame(unsigned int index) // Returns a tiny frame holding the given index
+	{
+	Kinect::FrameBuffer result(1,1,sizeof(unsigned int));
+	*result.getData<unsigned int>()=index;
+	return result;
+	}
+
+bool checkPops(FrameRing& ring,unsigned int firstIndex,unsigned int lastIndex,unsigned int numDropped,const char* step) // Checks that the ring holds exactly the frames of the given index range and has dropped the given number of frames
+	{
+	bool result=true;
+	Kinect::FrameBuffer frame;
+	for(unsigned int index=firstIndex;index<=lastIndex&&result;++index)
+		result=ring.pop(frame)&&*frame.getData<unsigned int>()==index;
+	result=result&&!ring.pop(frame)&&ring.getNumDropped()==numDropped;
+	if(!result)
+		std::cout<<"  Frame ring does not hold frames "<<firstIndex<<" to "<<lastIndex<<" with "<<numDropped<<" dropped frames after "<<step<<std::endl;
+	return result;
+	}
+
+class RingStressTest
+	{
+	/* Elements: */
+	private:
+	FrameRing ring; // The tested frame ring
+	unsigned int numFrames; // Number of frames to push
+	unsigned int numPopped; // Number of frames popped by the consumer
+	unsigned int numOutOfOrder; // Number of popped frames that were not newer than the previously popped frame
+	
+	/* Private methods: */
+	void* producerThreadMethod(void)
+		{
+		/* Push all frames without pausing, then shut down the ring: */
+		for(unsigned int i=0;i<numFrames;++i)
+			ring.push(createIndexFrame(i));
+		ring.shutDown();
+		
+		return 0;
+		}
+	void consumeFrame(const Kinect::FrameBuffer& frame,unsigned int& nextIndex) // Checks a popped frame's order and occasionally stalls the consumer so that the producer overtakes it
+		{
+		unsigned int index=*frame.getData<unsigned int>();
+		if(index<nextIndex)
+			++numOutOfOrder;
+		nextIndex=index+1;
+		++numPopped;
+		if(index%64U==0U)
+			usleep(50);
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	RingStressTest(unsigned int sCapacity,unsigned int sNumFrames)
+		:ring(sCapacity),numFrames(sNumFrames),
+		 numPopped(0),numOutOfOrder(0)
+		{
+		}
+	
+	/* Methods: */
+	bool run(void) // Runs the test; returns true if no frames were lost, duplicated, or reordered
+		{
+		/* Pop frames while the producer thread is pushing them: */
+		Threads::Thread producerThread;
+		producerThread.start(this,&RingStressTest::producerThreadMethod);
+		Kinect::FrameBuffer frame;
+		unsigned int nextIndex=0;
+		while(ring.waitAndPop(frame))
+			consumeFrame(frame,nextIndex);
+		producerThread.join();
+		
+		/* Pop any frames still queued when the ring was shut down: */
+		while(ring.pop(frame))
+			consumeFrame(frame,nextIndex);
+		
+		/* Every pushed frame must have been popped or dropped exactly once: */
+		if(numOutOfOrder==0&&ring.getNumPushed()==numFrames&&numPopped+ring.getNumDropped()==numFrames)
+			return true;
+		std::cout<<"  Frame ring with capacity "<<ring.getCapacity()<<": "<<numFrames<<" frames pushed, "<<numPopped<<" popped ("<<numOutOfOrder<<" out of order), "<<ring.getNumDropped()<<" dropped"<<std::endl;
+		return false;
+		}
+	};
+
+bool checkFrameRing(void)
+	{
+	bool result=true;
+	
+	/* Check that a full ring drops its oldest frames: */
+	FrameRing ring(2);
+	for(unsigned int i=0;i<5;++i)
+		ring.push(createIndexFrame(i));
+	result=checkPops(ring,3,4,3,"pushing 5 frames")&&result;
+	
+	/* Check that the ring keeps dropping the oldest frames after partial pops: */
+	ring.push(createIndexFrame(5));
+	Kinect::FrameBuffer frame;
+	result=ring.pop(frame)&&*frame.getData<unsigned int>()==5&&result;
+	for(unsigned int i=6;i<9;++i)
+		ring.push(createIndexFrame(i));
+	result=checkPops(ring,7,8,4,"pushing 4 frames with one pop in between")&&result;
+	
+	/* Check that pushing to an empty ring drops nothing: */
+	ring.push(createIndexFrame(9));
+	result=checkPops(ring,9,9,4,"pushing 1 frame to an empty ring")&&result;
+	if(ring.getNumPushed()!=10)
+		{
+		std::cout<<"  Frame ring counted "<<ring.getNumPushed()<<" instead of 10 pushed frames"<<std::endl;
+		result=false;
+		}
+	
+	/* Check the ring under concurrent access with small and large capacities: */
+	for(unsigned int capacity=1;capacity<=8;capacity*=2)
+		{
+		RingStressTest stressTest(capacity,100000);
+		result=stressTest.run()&&result;
+		}
+	
+	if(result)
+		std::cout<<"The frame ring drops the oldest frames and never loses, duplicates, or reorders frames"<<std::endl;
+	else
+		std::cout<<"The frame ring failed its checks"<<std::endl;
+	return result;
+	}
+
+}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int sizes[2][2]={{640,480},{1024,1024}};
+	unsigned int numSizes=2;
+	unsigned int numAveragingSlots=30;
+	unsigned int numFilterThreads=1;
+	unsigned int numHandThreads=1;
+	bool shareDepthPreprocessing=false;
+	unsigned int numFrames=200;
+	bool vectorize=true;
+	bool spatialFilter=true;
+	unsigned int spatialFilterRadius=2;
+	bool fuseSpatialFilter=true;
+	FrameFilter::TemporalFilterType temporalFilterType=FrameFilter::AVERAGING_BUFFER;
+	FrameFilter::DepthPixelFormat pixelFormat=FrameFilter::KINECT_DEPTH;
+	float motionThreshold=0.0f;
+	unsigned int numMotionFrames=2;
+	bool fillHoles=false;
+	float holeFillingBudget=2.0f;
+	bool medianFilter=false;
+	unsigned int medianFilterRadius=1;
+	const char* goldenFileName=0;
+	bool saveGolden=false;
+	double positionTolerance=0.5;
+	bool framesSet=false;
+	bool checkKernels=false;
+	bool checkRing=false;
+	bool checkWaterKernels=false;
+	bool benchmarkBlobs=false;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"h")==0)
+				{
+				std::cout<<"Usage: PipelineBenchmark [option 1] ... [option n]"<<std::endl;
+				std::cout<<"  Options:"<<std::endl;
+				std::cout<<"  -h"<<std::endl;
+				std::cout<<"     Prints this help message"<<std::endl;
+				std::cout<<"  -size <width> <height>"<<std::endl;
+				std::cout<<"     Benchmarks frames of the given size instead of 640x480 and 1024x1024"<<std::endl;
+				std::cout<<"  -nas <num averaging slots>"<<std::endl;
+				std::cout<<"     Sets the number of averaging slots in the frame filter's averaging buffer"<<std::endl;
+				std::cout<<"     Default: 30"<<std::endl;
+				std::cout<<"  -rtf"<<std::endl;
+				std::cout<<"     Uses the frame filter's recursive temporal filter instead of its"<<std::endl;
+				std::cout<<"     averaging buffer"<<std::endl;
+				std::cout<<"  -dpf <depth pixel format>"<<std::endl;
+				std::cout<<"     Sets the pixel format of the synthetic depth frames (Kinect, Millimeter, or Float)"<<std::endl;
+				std::cout<<"     Default: Kinect"<<std::endl;
+				std::cout<<"  -ma <motion threshold> <num motion frames>"<<std::endl;
+				std::cout<<"     Enables the frame filter's motion adaptation"<<std::endl;
+				std::cout<<"  -fh <hole filling budget>"<<std::endl;
+				std::cout<<"     Enables the frame filter's hole filling with the given time budget in ms"<<std::endl;
+				std::cout<<"  -mf <median filter radius>"<<std::endl;
+				std::cout<<"     Enables the frame filter's median filter with 3x3 (radius 1) or 5x5"<<std::endl;
+				std::cout<<"     (radius 2) neighborhoods"<<std::endl;
+				std::cout<<"  -nft <num filter threads>"<<std::endl;
+				std::cout<<"     Sets the number of threads filtering each depth frame, between 1 and "<<FrameFilter::maxNumThreads<<std::endl;
+				std::cout<<"     Default: 1"<<std::endl;
+				std::cout<<"  -nht <num hand extractor threads>"<<std::endl;
+				std::cout<<"     Sets the number of threads labelling each golden frame's foreground spans,"<<std::endl;
+				std::cout<<"     between 1 and "<<HandExtractor::maxNumThreads<<std::endl;
+				std::cout<<"     Default: 1"<<std::endl;
+				std::cout<<"  -sdp"<<std::endl;
+				std::cout<<"     Extracts hands from each golden frame through a shared depth"<<std::endl;
+				std::cout<<"     preprocessing stage, using its foreground mask and corrected depth"<<std::endl;
+				std::cout<<"  -frames <num frames>"<<std::endl;
+				std::cout<<"     Sets the number of timed frames per frame size"<<std::endl;
+				std::cout<<"     Default: 200"<<std::endl;
+				std::cout<<"  -scalar"<<std::endl;
+				std::cout<<"     Forces the frame filter's scalar kernel"<<std::endl;
+				std::cout<<"  -nsf"<<std::endl;
+				std::cout<<"     Disables the frame filter's spatial filter"<<std::endl;
+				std::cout<<"  -sfr <spatial filter radius>"<<std::endl;
+				std::cout<<"     Sets the radius of the frame filter's Gaussian spatial filter kernel,"<<std::endl;
+				std::cout<<"     between 0 and "<<FrameFilter::maxSpatialFilterRadius<<std::endl;
+				std::cout<<"     Default: 2"<<std::endl;
+				std::cout<<"  -usf"<<std::endl;
+				std::cout<<"     Runs the spatial filter as separate passes instead of fusing it with"<<std::endl;
+				std::cout<<"     the temporal filter"<<std::endl;
+				std::cout<<"  -blobs"<<std::endl;
+				std::cout<<"     Times the blob finder against the original findBlobs implementation on"<<std::endl;
+				std::cout<<"     raw depth frames, using the rain maker's pixel and blob properties,"<<std::endl;
+				std::cout<<"     instead of timing the frame filter"<<std::endl;
+				std::cout<<"  -saveGolden <golden file name>"<<std::endl;
+				std::cout<<"     Saves checksums of the filtered frames, and the extracted hands and"<<std::endl;
+				std::cout<<"     foreground blobs, of a synthetic frame sequence to the given golden file"<<std::endl;
+				std::cout<<"     instead of timing the frame filter; uses 320x240 frames and 60 frames"<<std::endl;
+				std::cout<<"     unless overridden"<<std::endl;
+				std::cout<<"  -checkGolden <golden file name>"<<std::endl;
+				std::cout<<"     Compares the filtered frames, extracted hands, and foreground blobs of a"<<std::endl;
+				std::cout<<"     synthetic frame sequence against the given golden file; exits with"<<std::endl;
+				std::cout<<"     status 1 if any frame does not match"<<std::endl;
+				std::cout<<"  -checkVectorized"<<std::endl;
+				std::cout<<"     Checks that the frame filter's vectorized kernel produces bit-identical"<<std::endl;
+				std::cout<<"     results to its scalar kernel on a synthetic frame sequence for all pixel"<<std::endl;
+				std::cout<<"     formats and filter configurations; exits with status 1 if any result"<<std::endl;
+				std::cout<<"     differs"<<std::endl;
+				std::cout<<"  -checkWaterSolver"<<std::endl;
+				std::cout<<"     Checks that the CPU water solver's vectorized flux kernel produces"<<std::endl;
+				std::cout<<"     bit-identical results to its scalar kernel on a synthetic dam break;"<<std::endl;
+				std::cout<<"     exits with status 1 if any simulation step differs"<<std::endl;
+				std::cout<<"  -checkRing"<<std::endl;
+				std::cout<<"     Checks that the frame ring handing raw frames to background threads"<<std::endl;
+				std::cout<<"     drops the oldest queued frames when full, and never loses, duplicates,"<<std::endl;
+				std::cout<<"     or reorders frames under concurrent access; exits with status 1 if a"<<std::endl;
+				std::cout<<"     check fails"<<std::endl;
+				std::cout<<"  -tolerance <position tolerance>"<<std::endl;
+				std::cout<<"     Sets the maximum difference between hand and blob positions in pixels"<<std::endl;
+				std::cout<<"     when comparing against a golden file; filtered frames must always match"<<std::endl;
+				std::cout<<"     their golden checksums exactly"<<std::endl;
+				std::cout<<"     Default: 0.5"<<std::endl;
+				return 0;
+				}
+			else if(strcasecmp(argv[i]+1,"size")==0)
+				{
+				for(int j=0;j<2;++j)
+					{
+					++i;
+					sizes[0][j]=atoi(argv[i]);
+					}
+				numSizes=1;
+				}
+			else if(strcasecmp(argv[i]+1,"nas")==0)
+				{
+				++i;
+				numAveragingSlots=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"rtf")==0)
+				temporalFilterType=FrameFilter::RECURSIVE_ESTIMATOR;
+			else if(strcasecmp(argv[i]+1,"dpf")==0)
+				{
+				++i;
+				if(!FrameFilter::parsePixelFormat(argv[i],pixelFormat))
+					std::cerr<<"Ignoring unrecognized depth pixel format "<<argv[i]<<std::endl;
+				}
+			else if(strcasecmp(argv[i]+1,"ma")==0)
+				{
+				++i;
+				motionThreshold=float(atof(argv[i]));
+				++i;
+				numMotionFrames=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"fh")==0)
+				{
+				fillHoles=true;
+				++i;
+				holeFillingBudget=float(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"mf")==0)
+				{
+				medianFilter=true;
+				++i;
+				medianFilterRadius=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"nft")==0)
+				{
+				++i;
+				if(!FrameFilter::parseNumThreads(argv[i],numFilterThreads))
+					{
+					std::cerr<<"PipelineBenchmark: Invalid number of filter threads "<<argv[i]<<"; must be between 1 and "<<FrameFilter::maxNumThreads<<std::endl;
+					return 1;
+					}
+				}
+			else if(strcasecmp(argv[i]+1,"nht")==0)
+				{
+				++i;
+				if(!HandExtractor::parseNumThreads(argv[i],numHandThreads))
+					{
+					std::cerr<<"PipelineBenchmark: Invalid number of hand extractor threads "<<argv[i]<<"; must be between 1 and "<<HandExtractor::maxNumThreads<<std::endl;
+					return 1;
+					}
+				}
+			else if(strcasecmp(argv[i]+1,"sdp")==0)
+				shareDepthPreprocessing=true;
+			else if(strcasecmp(argv[i]+1,"frames")==0)
+				{
+				++i;
+				numFrames=atoi(argv[i]);
+				framesSet=true;
+				}
+			else if(strcasecmp(argv[i]+1,"scalar")==0)
+				vectorize=false;
+			else if(strcasecmp(argv[i]+1,"nsf")==0)
+				spatialFilter=false;
+			else if(strcasecmp(argv[i]+1,"sfr")==0)
+				{
+				++i;
+				if(!FrameFilter::parseSpatialFilterRadius(argv[i],spatialFilterRadius))
+					{
+					std::cerr<<"PipelineBenchmark: Invalid spatial filter radius "<<argv[i]<<"; must be between 0 and "<<FrameFilter::maxSpatialFilterRadius<<std::endl;
+					return 1;
+					}
+				}
+			else if(strcasecmp(argv[i]+1,"usf")==0)
+				fuseSpatialFilter=false;
+			else if(strcasecmp(argv[i]+1,"blobs")==0)
+				benchmarkBlobs=true;
+			else if(strcasecmp(argv[i]+1,"saveGolden")==0||strcasecmp(argv[i]+1,"checkGolden")==0)
+				{
+				saveGolden=strcasecmp(argv[i]+1,"saveGolden")==0;
+				++i;
+				goldenFileName=argv[i];
+				}
+			else if(strcasecmp(argv[i]+1,"checkVectorized")==0)
+				checkKernels=true;
+			else if(strcasecmp(argv[i]+1,"checkWaterSolver")==0)
+				checkWaterKernels=true;
+			else if(strcasecmp(argv[i]+1,"checkRing")==0)
+				checkRing=true;
+			else if(strcasecmp(argv[i]+1,"tolerance")==0)
+				{
+				++i;
+				positionTolerance=atof(argv[i]);
+				}
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring unrecognized command line argument "<<argv[i]<<std::endl;
+		}
+	if(checkRing)
+		return checkFrameRing()?0:1;
+	if(checkWaterKernels||checkKernels)
+		{
+		/* Use a frame size that is not a multiple of the kernels' vector widths: */
+		unsigned int checkSize[2]={157,117};
+		if(numSizes==1)
+			for(int i=0;i<2;++i)
+				checkSize[i]=sizes[0][i];
+		if(checkWaterKernels)
+			return checkWaterSolver(checkSize,framesSet?numFrames:200)?0:1;
+		return checkVectorized(checkSize,framesSet?numFrames:40)?0:1;
+		}
+	if(goldenFileName!=0)
+		{
+		/* Run a short sequence of small frames by default: */
+		if(numSizes!=1)
+			{
+			sizes[0][0]=320;
+			sizes[0][1]=240;
+			numSizes=1;
+			}
+		if(!framesSet)
+			numFrames=60;
+		}
+	if(numFrames<1)
+		numFrames=1;
+
+	for(unsigned int sizeIndex=0;sizeIndex<numSizes;++sizeIndex)
+		{
+		const unsigned int* size=sizes[sizeIndex];
+		
+		if(benchmarkBlobs)
+			{
+			/* Pre-generate a sequence of synthetic raw depth frames: */
+			SyntheticDepthSource source(size,FrameFilter::KINECT_DEPTH);
+			std::vector<Kinect::FrameBuffer> inputFrames;
+			for(unsigned int i=0;i<64;++i)
+				inputFrames.push_back(source.createFrame(i));
+			
+			/* Accept raw depth values above the sand surface as valid, like the rain maker's elevation range: */
+			ValidDepthBounds<unsigned short> validDepthBounds(size,0U,800U);
+			RawValidProperty valid(validDepthBounds);
+			
+			/* Time the original implementation: */
+			std::vector<std::vector<Blob<unsigned short> > > referenceBlobs(inputFrames.size());
+			unsigned long long numBlobs=0;
+			double startTime=getTime();
+			for(unsigned int i=0;i<numFrames;++i)
+				{
+				std::vector<Blob<unsigned short> > blobs=findBlobsReference(size,inputFrames[i%inputFrames.size()].getData<unsigned short>(),valid);
+				numBlobs+=blobs.size();
+				if(i<inputFrames.size())
+					referenceBlobs[i].swap(blobs);
+				}
+			double referenceElapsed=getTime()-startTime;
+			
+			/* Time the blob finder, reusing its storage between frames as the rain maker does: */
+			BlobFinder<unsigned short> blobFinder;
+			std::vector<Blob<unsigned short> > blobs;
+			unsigned int numMismatches=0;
+			startTime=getTime();
+			for(unsigned int i=0;i<numFrames;++i)
+				{
+				blobFinder.findBlobs(size,inputFrames[i%inputFrames.size()].getData<unsigned short>(),valid,blobs);
+				if(i<inputFrames.size()&&!equalBlobs(blobs,referenceBlobs[i]))
+					++numMismatches;
+				}
+			double elapsed=getTime()-startTime;
+			
+			/* Print the results: */
+			std::cout<<size[0]<<'x'<<size[1]<<" raw depth frames, "<<numBlobs/numFrames<<" blobs/frame:"<<std::endl;
+			std::cout<<"  findBlobs (original): "<<std::fixed<<std::setprecision(3)<<referenceElapsed*1000.0/double(numFrames)<<" ms/frame"<<std::endl;
+			std::cout<<"  BlobFinder: "<<std::fixed<<std::setprecision(3)<<elapsed*1000.0/double(numFrames)<<" ms/frame ("<<std::setprecision(2)<<referenceElapsed/elapsed<<"x)"<<std::endl;
+			if(numMismatches!=0)
+				{
+				std::cout<<"  "<<numMismatches<<" frames' blob lists differ from the original implementation"<<std::endl;
+				return 1;
+				}
+			
+			continue;
+			}
+
+		/* Create identity per-pixel depth correction coefficients: */
+		std::vector<FrameFilter::PixelDepthCorrection> pixelDepthCorrection(size[1]*size[0]);
+		for(std::vector<FrameFilter::PixelDepthCorrection>::iterator pdcIt=pixelDepthCorrection.begin();pdcIt!=pixelDepthCorrection.end();++pdcIt)
+			{
+			pdcIt->scale=1.0f;
+			pdcIt->offset=0.0f;
+			}
+
+		/* Create a frame filter for a camera looking straight down at a flat base plane: */
+		FrameFilter frameFilter(size,numAveragingSlots,temporalFilterType,pixelFormat,&pixelDepthCorrection[0],PTransform::identity,Plane(Plane::Vector(0,0,1),-1000.0));
+		if(pixelFormat==FrameFilter::KINECT_DEPTH)
+			frameFilter.setValidDepthInterval(0U,2046U);
+		frameFilter.setStableParameters((numAveragingSlots+1)/2,4);
+		frameFilter.setMotionAdaptive(motionThreshold,numMotionFrames);
+		frameFilter.setHoleFilling(fillHoles);
+		frameFilter.setHoleFillingBudget(holeFillingBudget);
+		frameFilter.setMedianFilter(medianFilter);
+		frameFilter.setMedianFilterRadius(medianFilterRadius);
+		frameFilter.setSpatialFilter(spatialFilter);
+		frameFilter.setSpatialFilterRadius(spatialFilterRadius);
+		frameFilter.setFuseSpatialFilter(fuseSpatialFilter);
+		frameFilter.setNumThreads(numFilterThreads);
+		frameFilter.setVectorized(vectorize);
+		
+		if(goldenFileName!=0)
+			{
+			/* Describe all settings that influence the results; the number of threads and the kernel type must not: */
+			std::ostringstream settings;
+			settings<<size[0]<<'x'<<size[1]<<' '<<FrameFilter::getPixelFormatName(pixelFormat)<<" pixels, "<<numFrames<<" frames, "<<numAveragingSlots<<(temporalFilterType==FrameFilter::RECURSIVE_ESTIMATOR?" slots (recursive)":" slots");
+			settings<<", motion "<<motionThreshold<<'/'<<numMotionFrames<<", holes "<<(fillHoles?holeFillingBudget:0.0f);
+			settings<<", median "<<(medianFilter?medianFilterRadius:0U)<<", spatial "<<(spatialFilter?spatialFilterRadius:0U);
+			
+			try
+				{
+				GoldenFile goldenFile(goldenFileName,saveGolden,settings.str(),positionTolerance);
+				
+				/* Extract hands from raw frames if they are 11-bit Kinect frames: */
+				HandExtractor* handExtractor=0;
+				DepthPreprocessor* depthPreprocessor=0;
+				if(pixelFormat==FrameFilter::KINECT_DEPTH)
+					{
+					handExtractor=new HandExtractor(size,&pixelDepthCorrection[0],PTransform::identity);
+					if(shareDepthPreprocessing)
+						{
+						/* Subscribe the hand extractor to a shared preprocessing stage before setting its foreground threshold, which must reach the stage: */
+						depthPreprocessor=new DepthPreprocessor(size,&pixelDepthCorrection[0],KinectDepthPixels::getMinValid(),KinectDepthPixels::getMaxValid());
+						handExtractor->setDepthPreprocessor(*depthPreprocessor);
+						}
+					handExtractor->setMaxFgDepth(800U);
+					handExtractor->setMaxDepthDist(8U);
+					handExtractor->setBlobSizeRange(200U,150000U);
+					handExtractor->setNumThreads(numHandThreads);
+					}
+				
+				/* Process the synthetic frame sequence from the beginning, without warming up the frame filter: */
+				SyntheticDepthSource source(size,pixelFormat);
+				Kinect::FrameBuffer outputFrame=frameFilter.createOutputFrame();
+				ForegroundProperty foreground(800.0f);
+				for(unsigned int i=0;i<numFrames;++i)
+					{
+					Kinect::FrameBuffer inputFrame=source.createFrame(i);
+					frameFilter.filterFrame(inputFrame,outputFrame);
+					HandExtractor::HandList hands;
+					if(depthPreprocessor!=0)
+						{
+						DepthPreprocessor::Frame preprocessedFrame;
+						depthPreprocessor->preprocessFrame(inputFrame,preprocessedFrame);
+						if(preprocessedFrame.maxFgDepth!=handExtractor->getMaxFgDepth())
+							throw std::runtime_error("Shared preprocessing stage did not receive the hand extractor's foreground threshold");
+						handExtractor->extractHands(preprocessedFrame,hands,0);
+						}
+					else if(handExtractor!=0)
+						handExtractor->extractHands(inputFrame.getData<HandExtractor::DepthPixel>(),hands,0);
+					std::vector<Blob<float> > blobs=findBlobs(size,outputFrame.getData<float>(),foreground);
+					goldenFile.processFrame(i,size,outputFrame.getData<float>(),hands,blobs);
+					}
+				delete handExtractor;
+				delete depthPreprocessor;
+				
+				/* Print the results: */
+				if(saveGolden)
+					std::cout<<"Saved golden output for "<<settings.str()<<" to "<<goldenFileName<<std::endl;
+				else if(goldenFile.getNumFailedFrames()==0)
+					std::cout<<"All "<<numFrames<<" frames match golden output "<<goldenFileName<<std::endl;
+				else
+					{
+					std::cout<<goldenFile.getNumFailedFrames()<<" of "<<numFrames<<" frames do not match golden output "<<goldenFileName<<std::endl;
+					return 1;
+					}
+				}
+			catch(const std::runtime_error& err)
+				{
+				std::cerr<<"Golden output test failed due to exception "<<err.what()<<std::endl;
+				return 1;
+				}
+			
+			return 0;
+			}
+
+		/* Pre-generate a sequence of synthetic input frames so that frame generation is not timed: */
+		SyntheticDepthSource source(size,pixelFormat);
+		std::vector<Kinect::FrameBuffer> inputFrames;
+		for(unsigned int i=0;i<64;++i)
+			inputFrames.push_back(source.createFrame(i));
+		Kinect::FrameBuffer outputFrame=frameFilter.createOutputFrame();
+
+		/* Fill the averaging buffer before timing: */
+		for(unsigned int i=0;i<numAveragingSlots;++i)
+			frameFilter.filterFrame(inputFrames[i%inputFrames.size()],outputFrame);
+
+		/* Time the frame filter: */
+		CacheCounter cacheCounter;
+		cacheCounter.start();
+		double startTime=getTime();
+		unsigned long long numFastResets=0;
+		unsigned long long numFilledHoles=0;
+		unsigned long long numChangedTiles=0;
+		for(unsigned int i=0;i<numFrames;++i)
+			{
+			frameFilter.filterFrame(inputFrames[i%inputFrames.size()],outputFrame);
+			numFastResets+=frameFilter.getNumFastResets();
+			numFilledHoles+=frameFilter.getNumFilledHoles();
+			
+			/* Count the changed tiles: */
+			const TileChangeMask& changeMask=TileChangeMask::get(outputFrame);
+			unsigned int numTiles=changeMask.getNumTiles()[1]*changeMask.getNumTiles()[0];
+			for(unsigned int j=0;j<numTiles;++j)
+				if(changeMask.getTiles()[j]!=0)
+					++numChangedTiles;
+			}
+		double elapsed=getTime()-startTime;
+		unsigned long long cacheReferences,cacheMisses;
+		cacheCounter.stop(cacheReferences,cacheMisses);
+
+		/* Print the results: */
+		std::cout<<size[0]<<'x'<<size[1]<<", "<<numAveragingSlots<<(temporalFilterType==FrameFilter::RECURSIVE_ESTIMATOR?" slots (recursive), ":" slots, ")<<FrameFilter::getPixelFormatName(pixelFormat)<<" pixels, "<<numFilterThreads<<" thread(s), "<<(frameFilter.getVectorized()?"vectorized":"scalar")<<" kernel:"<<std::endl;
+		std::cout<<"  FrameFilter: "<<std::fixed<<std::setprecision(3)<<elapsed*1000.0/double(numFrames)<<" ms/frame"<<std::endl;
+		std::cout<<"  Cache references/frame: ";
+		if(cacheCounter.isValid())
+			std::cout<<cacheReferences/numFrames;
+		else
+			std::cout<<"n/a";
+		std::cout<<", cache misses/frame: ";
+		if(cacheCounter.isValid())
+			std::cout<<cacheMisses/numFrames;
+		else
+			std::cout<<"n/a";
+		if(numFilterThreads>1)
+			std::cout<<" (calling thread only)";
+		std::cout<<std::endl;
+		if(motionThreshold>0.0f)
+			std::cout<<"  Fast-reset pixels/frame: "<<numFastResets/numFrames<<std::endl;
+		if(fillHoles)
+			std::cout<<"  Filled holes/frame: "<<numFilledHoles/numFrames<<std::endl;
+		std::cout<<"  Changed tiles/frame: "<<numChangedTiles/numFrames<<" of "<<TileChangeMask::getNumTiles(size[1])*TileChangeMask::getNumTiles(size[0])<<std::endl;
+		}
+
+	return 0;
+	}
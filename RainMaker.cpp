@@ -26,6 +26,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Geometry/HVector.h>
 #include <Geometry/Plane.h>
 
+#include "DepthPixelFormats.h"
+#include "ValidDepthBounds.h"
 #include "FindBlobs.h"
 
 template <>
@@ -116,48 +118,16 @@ class ValidPixelProperty // Functor class to identify valid pixels in raw depth
 	private:
 	float minPlane[4]; // Plane equation of the lower bound of valid depth values in depth image space
 	float maxPlane[4]; // Plane equation of the upper bound of valid depth values in depth image space
+	const ValidDepthBounds<RainMaker::RawDepth>& validDepthBounds; // Per-pixel intervals of raw depth values between the lower and upper planes
+	const unsigned char* validMask; // Shared per-pixel validity mask of the current depth frame, or null to test pixels against the per-pixel intervals
+	unsigned int validMaskWidth; // Width of the shared validity mask
 	Geometry::Matrix<float,3,4> colorDepthHomography; // Homography from 3D depth image space into 2D color image space
 	unsigned int colorSize[2]; // Width and height of color frames
 	const unsigned char* colorFrame; // The current color frame
 	
-	/* Constructors and destructors: */
-	public:
-	ValidPixelProperty(const float sMinPlane[4],const float sMaxPlane[4],const Geometry::Matrix<float,3,4>& sColorDepthHomography,const unsigned int sColorSize[2])
-		:colorDepthHomography(sColorDepthHomography),
-		 colorFrame(0)
-		{
-		/* Copy the min and max plane equations: */
-		for(int i=0;i<4;++i)
-			minPlane[i]=sMinPlane[i];
-		for(int i=0;i<4;++i)
-			maxPlane[i]=sMaxPlane[i];
-		
-		/* Copy the color image size: */
-		for(int i=0;i<2;++i)
-			colorSize[i]=sColorSize[i];
-		}
-	
-	/* Methods: */
-	public:
-	void setColorFrame(const unsigned char* newColorFrame) // Sets the color frame for the next blob extraction
-		{
-		colorFrame=newColorFrame;
-		}
-	bool operator()(unsigned int x,unsigned int y,const unsigned short& pixel) const
+	/* Private methods: */
+	bool checkColor(float px,float py,float pz) const // Checks the color of a pixel that passed the plane test
 		{
-		return operator()(x,y,float(pixel));
-		}
-	bool operator()(unsigned int x,unsigned int y,const float& pixel) const
-		{
-		/* Plug the pixel into the plane equations to determine its validity: */
-		float px=float(x)+0.5f;
-		float py=float(y)+0.5f;
-		float pz=pixel;
-		float minD=minPlane[0]*px+minPlane[1]*py+minPlane[2]*pz+minPlane[3];
-		float maxD=maxPlane[0]*px+maxPlane[1]*py+maxPlane[2]*pz+maxPlane[3];
-		if(minD<0.0f||maxD>0.0f)
-			return false;
-		
 		#if 0
 		
 		/* Project the pixel into the color frame: */
@@ -196,6 +166,61 @@ class ValidPixelProperty // Functor class to identify valid pixels in raw depth
 		
 		#endif
 		}
+	
+	/* Constructors and destructors: */
+	public:
+	ValidPixelProperty(const float sMinPlane[4],const float sMaxPlane[4],const ValidDepthBounds<RainMaker::RawDepth>& sValidDepthBounds,const Geometry::Matrix<float,3,4>& sColorDepthHomography,const unsigned int sColorSize[2])
+		:validDepthBounds(sValidDepthBounds),
+		 validMask(0),validMaskWidth(0),
+		 colorDepthHomography(sColorDepthHomography),
+		 colorFrame(0)
+		{
+		/* Copy the min and max plane equations: */
+		for(int i=0;i<4;++i)
+			minPlane[i]=sMinPlane[i];
+		for(int i=0;i<4;++i)
+			maxPlane[i]=sMaxPlane[i];
+		
+		/* Copy the color image size: */
+		for(int i=0;i<2;++i)
+			colorSize[i]=sColorSize[i];
+		}
+	
+	/* Methods: */
+	public:
+	void setColorFrame(const unsigned char* newColorFrame) // Sets the color frame for the next blob extraction
+		{
+		colorFrame=newColorFrame;
+		}
+	void setValidMask(const unsigned char* newValidMask,unsigned int newValidMaskWidth) // Sets a shared validity mask for the next blob extraction, or null to use the per-pixel intervals
+		{
+		validMask=newValidMask;
+		validMaskWidth=newValidMaskWidth;
+		}
+	bool operator()(unsigned int x,unsigned int y,const unsigned short& pixel) const
+		{
+		/* Check the pixel against the shared validity mask or its precomputed interval of valid raw depth values: */
+		if(validMask!=0)
+			{
+			if(validMask[size_t(y)*size_t(validMaskWidth)+size_t(x)]==0U)
+				return false;
+			}
+		else if(!validDepthBounds.isValid(x,y,pixel))
+			return false;
+		
+		return checkColor(float(x)+0.5f,float(y)+0.5f,float(pixel));
+		}
+	bool operator()(unsigned int x,unsigned int y,const float& pixel) const
+		{
+		/* Plug the pixel into the plane equations to determine its validity: */
+		float px=float(x)+0.5f;
+		float py=float(y)+0.5f;
+		float pz=pixel;
+		if(!ValidDepthBounds<RainMaker::RawDepth>::isValid(px,py,pz,minPlane,maxPlane))
+			return false;
+		
+		return checkColor(px,py,pz);
+		}
 	};
 
 /**************************
@@ -204,10 +229,11 @@ Methods of class RainMaker:
 
 template <class DepthPixelParam>
 inline
-void RainMaker::extractBlobs(const Kinect::FrameBuffer& depthFrame,const ValidPixelProperty& vpp,RainMaker::BlobList& blobsCc)
+void RainMaker::extractBlobs(const Kinect::FrameBuffer& depthFrame,const ValidPixelProperty& vpp,BlobFinder<DepthPixelParam>& blobFinder,RainMaker::BlobList& blobsCc)
 	{
 	/* Extract raw blobs from the depth frame: */
-	std::vector< ::Blob<DepthPixelParam> > blobsDic=findBlobs(depthSize,depthFrame.getData<DepthPixelParam>(),vpp);
+	std::vector< ::Blob<DepthPixelParam> > blobsDic;
+	blobFinder.findBlobs(depthSize,depthFrame.getData<DepthPixelParam>(),vpp,blobsDic);
 	
 	/* Transform all blobs larger than the threshold to camera space: */
 	blobsCc.reserve(blobsDic.size());
@@ -239,11 +265,16 @@ void* RainMaker::detectionThreadMethod(void)
 	unsigned int lastInputColorFrameVersion=0;
 	
 	/* Create a pixel validity decider: */
-	ValidPixelProperty vpp(minPlane,maxPlane,colorDepthHomography,colorSize);
+	ValidPixelProperty vpp(minPlane,maxPlane,*validDepthBounds,colorDepthHomography,colorSize);
+	
+	/* Create blob finders for both depth pixel types that keep their storage between frames: */
+	BlobFinder<unsigned short> rawBlobFinder;
+	BlobFinder<float> floatBlobFinder;
 	
 	while(true)
 		{
-		Kinect::FrameBuffer depthFrame,colorFrame;
+		Kinect::FrameBuffer depthFrame,validMask,colorFrame;
+		bool preprocessed;
 		{
 		Threads::MutexCond::Lock inputLock(inputCond);
 		
@@ -257,6 +288,9 @@ void* RainMaker::detectionThreadMethod(void)
 		
 		/* Work on the new frames: */
 		depthFrame=inputDepthFrame;
+		preprocessed=inputPreprocessed;
+		if(preprocessed)
+			validMask=inputValidMask;
 		colorFrame=inputColorFrame;
 		lastInputDepthFrameVersion=inputDepthFrameVersion;
 		lastInputColorFrameVersion=inputColorFrameVersion;
@@ -267,12 +301,15 @@ void* RainMaker::detectionThreadMethod(void)
 			/* Set the most recent color frame in the pixel validator: */
 			vpp.setColorFrame(colorFrame.getData<unsigned char>());
 			
+			/* Use the depth frame's shared validity mask if it was preprocessed: */
+			vpp.setValidMask(preprocessed?validMask.getData<unsigned char>():0,depthSize[0]);
+			
 			/* Detect all objects in the depth frame between the min and max planes: */
 			BlobList blobsCc;
 			if(depthIsFloat)
-				extractBlobs<float>(depthFrame,vpp,blobsCc);
+				extractBlobs<float>(depthFrame,vpp,floatBlobFinder,blobsCc);
 			else
-				extractBlobs<unsigned short>(depthFrame,vpp,blobsCc);
+				extractBlobs<unsigned short>(depthFrame,vpp,rawBlobFinder,blobsCc);
 			
 			/* Call the callback function: */
 			(*outputBlobsFunction)(blobsCc);
@@ -284,6 +321,7 @@ void* RainMaker::detectionThreadMethod(void)
 
 RainMaker::RainMaker(const unsigned int sDepthSize[2],const unsigned int sColorSize[2],const RainMaker::PTransform& sDepthProjection,const RainMaker::PTransform& sColorProjection,const RainMaker::Plane& basePlane,double minElevation,double maxElevation,int sMinBlobSize)
 	:depthIsFloat(false),
+	 validDepthBounds(0),
 	 outputBlobsFunction(0)
 	{
 	/* Remember the frame sizes: */
@@ -308,6 +346,7 @@ RainMaker::RainMaker(const unsigned int sDepthSize[2],const unsigned int sColorS
 		colorDepthHomography(2,j)=float(hom.getMatrix()(3,j));
 	
 	/* Initialize the input frame slot: */
+	inputPreprocessed=false;
 	inputDepthFrameVersion=0;
 	inputColorFrameVersion=0;
 	
@@ -327,6 +366,10 @@ RainMaker::RainMaker(const unsigned int sDepthSize[2],const unsigned int sColorS
 	for(int i=0;i<4;++i)
 		minPlane[i]=float(maxPlaneDic[i]*maxPlaneScale);
 	
+	/* Calculate the per-pixel intervals of valid raw depth values: */
+	validDepthBounds=new ValidDepthBounds<RawDepth>(depthSize,KinectDepthPixels::getMinValid(),KinectDepthPixels::getMaxValid());
+	validDepthBounds->setPlanes(0,minPlane,maxPlane);
+	
 	/* Initialize the blob detector: */
 	minBlobSize=sMinBlobSize;
 	
@@ -346,6 +389,7 @@ RainMaker::~RainMaker(void)
 	detectionThread.join();
 	
 	/* Release all allocated resources: */
+	delete validDepthBounds;
 	delete outputBlobsFunction;
 	}
 
@@ -360,12 +404,36 @@ void RainMaker::setOutputBlobsFunction(RainMaker::OutputBlobsFunction* newOutput
 	outputBlobsFunction=newOutputBlobsFunction;
 	}
 
+void RainMaker::setDepthPreprocessor(DepthPreprocessor& newDepthPreprocessor)
+	{
+	/* Preprocessed frames share the preprocessing stage's raw integer depth frames: */
+	depthIsFloat=false;
+	
+	/* Subscribe to the preprocessing stage's preprocessed frames: */
+	newDepthPreprocessor.addConsumer(Misc::createFunctionCall(this,&RainMaker::receivePreprocessedDepthFrame));
+	}
+
 void RainMaker::receiveRawDepthFrame(const Kinect::FrameBuffer& newDepthFrame)
 	{
 	Threads::MutexCond::Lock inputLock(inputCond);
 	
 	/* Store the new buffer in the input buffer: */
 	inputDepthFrame=newDepthFrame;
+	inputPreprocessed=false;
+	++inputDepthFrameVersion;
+	
+	/* Signal the background thread: */
+	inputCond.signal();
+	}
+
+void RainMaker::receivePreprocessedDepthFrame(const DepthPreprocessor::Frame& newDepthFrame)
+	{
+	Threads::MutexCond::Lock inputLock(inputCond);
+	
+	/* Store the new buffers in the input buffer: */
+	inputDepthFrame=newDepthFrame.rawDepth;
+	inputValidMask=newDepthFrame.validMask;
+	inputPreprocessed=true;
 	++inputDepthFrameVersion;
 	
 	/* Signal the background thread: */
@@ -31,6 +31,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <Geometry/ProjectiveTransformation.h>
 #include <Kinect/FrameBuffer.h>
 
+#include "DepthPreprocessor.h"
+
 /* Forward declarations: */
 namespace Misc {
 template <class ParameterParam>
@@ -40,6 +42,10 @@ namespace Geometry {
 template <class ScalarParam,int dimensionParam>
 class Plane;
 }
+template <class DepthParam>
+class ValidDepthBounds;
+template <class PixelParam>
+class BlobFinder;
 class ValidPixelProperty;
 
 class RainMaker
@@ -72,9 +78,12 @@ class RainMaker
 	Geometry::Matrix<float,3,4> colorDepthHomography; // Homography from 3D depth image space into 2D color image space
 	float minPlane[4]; // Plane equation of the lower bound of valid depth values in depth image space
 	float maxPlane[4]; // Plane equation of the upper bound of valid depth values in depth image space
+	ValidDepthBounds<RawDepth>* validDepthBounds; // Per-pixel intervals of raw depth values between the lower and upper bounds of valid depth values
 	int minBlobSize; // Minimum size of objects to be detected
 	Threads::MutexCond inputCond; // Condition variable to signal arrival of a new input frame
 	Kinect::FrameBuffer inputDepthFrame; // The most recent input depth frame
+	Kinect::FrameBuffer inputValidMask; // Shared validity mask of the most recent input depth frame if it was preprocessed
+	bool inputPreprocessed; // Flag whether the most recent input depth frame came from a depth preprocessor
 	unsigned int inputDepthFrameVersion; // Version number of input depth frame
 	Kinect::FrameBuffer inputColorFrame; // The most recent input color frame
 	unsigned int inputColorFrameVersion; // Version number of input color frame
@@ -84,7 +93,7 @@ class RainMaker
 	
 	/* Private methods: */
 	template <class DepthPixelParam>
-	void extractBlobs(const Kinect::FrameBuffer& depthFrame,const ValidPixelProperty& vpp,BlobList& blobsCc);
+	void extractBlobs(const Kinect::FrameBuffer& depthFrame,const ValidPixelProperty& vpp,BlobFinder<DepthPixelParam>& blobFinder,BlobList& blobsCc);
 	void* detectionThreadMethod(void); // Method for the object detection thread
 	
 	/* Constructors and destructors: */
@@ -95,7 +104,9 @@ class RainMaker
 	/* Methods: */
 	void setDepthIsFloat(bool newDepthIsFloat); // Sets whether incoming depth frames have float pixel values
 	void setOutputBlobsFunction(OutputBlobsFunction* newOutputBlobsFunction); // Sets the output function; adopts given functor object
+	void setDepthPreprocessor(DepthPreprocessor& newDepthPreprocessor); // Subscribes the rain maker to the given shared preprocessing stage, whose frames have integer pixel values; must be called before the stage receives its first frame
 	void receiveRawDepthFrame(const Kinect::FrameBuffer& newDepthFrame); // Called to receive a new raw depth frame
+	void receivePreprocessedDepthFrame(const DepthPreprocessor::Frame& newDepthFrame); // Called to receive a new preprocessed depth frame; uses the preprocessor's validity mask instead of the rain maker's own elevation range
 	void receiveRawColorFrame(const Kinect::FrameBuffer& newColorFrame); // Called to receive a new raw color frame
 	};
 
@@ -106,6 +106,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include "SurfaceRenderer.h"
 #include "WaterTable2.h"
 #include "HandExtractor.h"
+#include "DepthPreprocessor.h"
+#include "DepthPixelFormats.h"
 #include "RemoteServer.h"
 #include "WaterRenderer.h"
 #include "GlobalWaterTool.h"
@@ -120,7 +122,7 @@ Methods of class Sandbox::DataItem:
 **********************************/
 
 Sandbox::DataItem::DataItem(void)
-	:waterTableTime(0.0),
+	:waterTableTime(0.0),waterValidationTime(-1.0),
 	 shadowFramebufferObject(0),shadowDepthTextureObject(0)
 	{
 	/* Check if all required extensions are supported: */
@@ -252,7 +254,9 @@ void Sandbox::rawDepthFrameDispatcher(const Kinect::FrameBuffer& frameBuffer)
 	/* Pass the received frame to the frame filter and the hand extractor: */
 	if(frameFilter!=0&&!pauseUpdates)
 		frameFilter->receiveRawFrame(frameBuffer);
-	if(handExtractor!=0)
+	if(depthPreprocessor!=0)
+		depthPreprocessor->receiveRawFrame(frameBuffer);
+	else if(handExtractor!=0)
 		handExtractor->receiveRawFrame(frameBuffer);
 	}
 
@@ -477,6 +481,37 @@ void printUsage(void)
 	std::cout<<"     Sets the number of averaging slots in the frame filter; latency is"<<std::endl;
 	std::cout<<"     <num averaging slots> * 1/30 s"<<std::endl;
 	std::cout<<"     Default: 30"<<std::endl;
+	std::cout<<"  -rtf"<<std::endl;
+	std::cout<<"     Replaces the frame filter's averaging buffer with a recursive"<<std::endl;
+	std::cout<<"     estimator that needs constant memory per pixel; <num averaging"<<std::endl;
+	std::cout<<"     slots> then sets the estimator's equivalent window length"<<std::endl;
+	std::cout<<"  -nft <num filter threads>"<<std::endl;
+	std::cout<<"     Sets the number of threads filtering each depth frame in horizontal"<<std::endl;
+	std::cout<<"     bands, between 1 and "<<FrameFilter::maxNumThreads<<std::endl;
+	std::cout<<"     Default: 1"<<std::endl;
+	std::cout<<"  -nht <num hand extractor threads>"<<std::endl;
+	std::cout<<"     Sets the number of threads labelling each depth frame's foreground"<<std::endl;
+	std::cout<<"     spans for hand extraction in horizontal bands, between 1 and "<<HandExtractor::maxNumThreads<<std::endl;
+	std::cout<<"     Default: 1"<<std::endl;
+	std::cout<<"  -th"<<std::endl;
+	std::cout<<"     Tracks hands across depth frames, scanning only regions around"<<std::endl;
+	std::cout<<"     tracked hands and a rotating sweep window for new hands"<<std::endl;
+	std::cout<<"  -hpl <hand pyramid level>"<<std::endl;
+	std::cout<<"     Finds foreground regions on a half- (1) or quarter-resolution (2)"<<std::endl;
+	std::cout<<"     min-depth pyramid before extracting hands at full resolution only"<<std::endl;
+	std::cout<<"     inside those regions; 0 disables the pre-pass; between 0 and "<<HandExtractor::maxPyramidLevel<<std::endl;
+	std::cout<<"     Default: 0"<<std::endl;
+	std::cout<<"  -sdp"<<std::endl;
+	std::cout<<"     Applies depth correction and validity and foreground tests to each"<<std::endl;
+	std::cout<<"     raw depth frame once in a shared preprocessing stage, and hands the"<<std::endl;
+	std::cout<<"     results to the hand extractor"<<std::endl;
+	std::cout<<"  -sfr <spatial filter radius>"<<std::endl;
+	std::cout<<"     Sets the radius of the frame filter's Gaussian spatial filter kernel"<<std::endl;
+	std::cout<<"     in depth image pixels, between 0 and "<<FrameFilter::maxSpatialFilterRadius<<std::endl;
+	std::cout<<"     Default: 2"<<std::endl;
+	std::cout<<"  -usf"<<std::endl;
+	std::cout<<"     Runs the frame filter's spatial filter as separate passes instead"<<std::endl;
+	std::cout<<"     of fusing it with the temporal filter"<<std::endl;
 	std::cout<<"  -sp <min num samples> <max variance>"<<std::endl;
 	std::cout<<"     Sets the frame filter parameters minimum number of valid samples"<<std::endl;
 	std::cout<<"     and maximum sample variance before convergence"<<std::endl;
@@ -484,13 +519,56 @@ void printUsage(void)
 	std::cout<<"  -he <hysteresis envelope>"<<std::endl;
 	std::cout<<"     Sets the size of the hysteresis envelope used for jitter removal"<<std::endl;
 	std::cout<<"     Default: 0.1"<<std::endl;
+	std::cout<<"  -ma <motion threshold> <num motion frames>"<<std::endl;
+	std::cout<<"     Resets the frame filter's temporal filter for pixels whose depth"<<std::endl;
+	std::cout<<"     differs from their current value by more than the motion threshold"<<std::endl;
+	std::cout<<"     for the given number of consecutive frames, to show changes to the"<<std::endl;
+	std::cout<<"     sand surface without averaging latency; threshold 0 disables"<<std::endl;
+	std::cout<<"     Default: 0 2"<<std::endl;
+	std::cout<<"  -fh <hole filling budget>"<<std::endl;
+	std::cout<<"     Fills holes in the frame filter's output from surrounding pixels,"<<std::endl;
+	std::cout<<"     spending at most about the given time in ms per frame"<<std::endl;
+	std::cout<<"     Default: disabled"<<std::endl;
+	std::cout<<"  -mf <median filter radius>"<<std::endl;
+	std::cout<<"     Replaces the frame filter's output by the medians of 3x3 (radius 1)"<<std::endl;
+	std::cout<<"     or 5x5 (radius 2) neighborhoods before the spatial filter, to reject"<<std::endl;
+	std::cout<<"     flickering outliers; radius 0 disables"<<std::endl;
+	std::cout<<"     Default: 0"<<std::endl;
 	std::cout<<"  -wts <water grid width> <water grid height>"<<std::endl;
 	std::cout<<"     Sets the width and height of the water flow simulation grid"<<std::endl;
 	std::cout<<"     Default: 640 480"<<std::endl;
+	std::cout<<"  -wus <water upsampling factor>"<<std::endl;
+	std::cout<<"     Runs the water flow simulation on a grid coarser than the water grid"<<std::endl;
+	std::cout<<"     size by the given factor along each axis, and interpolates the"<<std::endl;
+	std::cout<<"     rendered water from the coarse grid along the full-resolution surface;"<<std::endl;
+	std::cout<<"     between 1 and "<<WaterRenderer::maxUpsamplingFactor<<std::endl;
+	std::cout<<"     Default: 1"<<std::endl;
 	std::cout<<"  -ws <water speed> <water max steps>"<<std::endl;
 	std::cout<<"     Sets the relative speed of the water simulation and the maximum"<<std::endl;
 	std::cout<<"     number of simulation steps per frame"<<std::endl;
 	std::cout<<"     Default: 1.0 30"<<std::endl;
+	std::cout<<"  -wsf"<<std::endl;
+	std::cout<<"     Determines the water simulation's step sizes on the GPU instead of"<<std::endl;
+	std::cout<<"     reading each one back, so that the simulation never waits for the GPU;"<<std::endl;
+	std::cout<<"     simulation time that does not fit into a frame's steps is carried over"<<std::endl;
+	std::cout<<"     to the next frame"<<std::endl;
+	std::cout<<"  -nwt <num water threads>"<<std::endl;
+	std::cout<<"     Runs the water simulation on the CPU using the given number of"<<std::endl;
+	std::cout<<"     threads instead of on the GPU; 0 runs it on the GPU; between 0 and "<<WaterTable2::maxNumCPUThreads<<std::endl;
+	std::cout<<"     Default: 0"<<std::endl;
+	std::cout<<"  -wsd"<<std::endl;
+	std::cout<<"     Skips dry 32x32-cell tiles of the water table that have no wet"<<std::endl;
+	std::cout<<"     neighbors, on the GPU or on the CPU (see -nwt)"<<std::endl;
+	std::cout<<"  -whp"<<std::endl;
+	std::cout<<"     Stores the water simulation's temporal derivatives and water rates in"<<std::endl;
+	std::cout<<"     16-bit floats to reduce memory bandwidth; water levels and momenta"<<std::endl;
+	std::cout<<"     remain 32-bit floats"<<std::endl;
+	std::cout<<"  -wvp"<<std::endl;
+	std::cout<<"     Validates the water simulation's half-precision storage (see -whp) by"<<std::endl;
+	std::cout<<"     flooding the sandbox up to the base plane, running a second, 32-bit"<<std::endl;
+	std::cout<<"     simulation in lockstep, and printing both total water volumes once"<<std::endl;
+	std::cout<<"     per second; water tools and water control changes only affect the"<<std::endl;
+	std::cout<<"     half-precision simulation; cannot be combined with -wsf or -nwt"<<std::endl;
 	std::cout<<"  -rer <min rain elevation> <max rain elevation>"<<std::endl;
 	std::cout<<"     Sets the elevation range of the rain cloud level relative to the"<<std::endl;
 	std::cout<<"     ground plane in cm"<<std::endl;
@@ -552,8 +630,8 @@ Sandbox::Sandbox(int& argc,char**& argv)
 	 camera(0),pixelDepthCorrection(0),
 	 frameFilter(0),pauseUpdates(false),
 	 depthImageRenderer(0),
-	 waterTable(0),
-	 handExtractor(0),addWaterFunction(0),addWaterFunctionRegistered(false),
+	 waterTable(0),referenceWaterTable(0),
+	 handExtractor(0),depthPreprocessor(0),addWaterFunction(0),addWaterFunctionRegistered(false),
 	 sun(0),
 	 activeDem(0),
 	 mainMenu(0),pauseUpdatesToggle(0),waterControlDialog(0),
@@ -579,15 +657,34 @@ Sandbox::Sandbox(int& argc,char**& argv)
 	if(haveHeightMapPlane)
 		heightMapPlane=cfg.retrieveValue<Plane>("./heightMapPlane");
 	unsigned int numAveragingSlots=cfg.retrieveValue<unsigned int>("./numAveragingSlots",30);
+	bool recursiveTemporalFilter=cfg.retrieveValue<bool>("./recursiveTemporalFilter",false);
+	unsigned int numFilterThreads=cfg.retrieveValue<unsigned int>("./numFilterThreads",1);
+	unsigned int numHandExtractorThreads=cfg.retrieveValue<unsigned int>("./numHandExtractorThreads",1);
+	bool trackHands=cfg.retrieveValue<bool>("./trackHands",false);
+	unsigned int handPyramidLevel=cfg.retrieveValue<unsigned int>("./handPyramidLevel",0);
+	bool shareDepthPreprocessing=cfg.retrieveValue<bool>("./shareDepthPreprocessing",false);
+	unsigned int spatialFilterRadius=cfg.retrieveValue<unsigned int>("./spatialFilterRadius",2);
+	bool fuseSpatialFilter=cfg.retrieveValue<bool>("./fuseSpatialFilter",true);
 	unsigned int minNumSamples=cfg.retrieveValue<unsigned int>("./minNumSamples",10);
 	unsigned int maxVariance=cfg.retrieveValue<unsigned int>("./maxVariance",2);
 	float hysteresis=cfg.retrieveValue<float>("./hysteresis",0.1f);
+	float motionThreshold=cfg.retrieveValue<float>("./motionThreshold",0.0f);
+	unsigned int numMotionFrames=cfg.retrieveValue<unsigned int>("./numMotionFrames",2);
+	bool fillHoles=cfg.retrieveValue<bool>("./fillHoles",false);
+	float holeFillingBudget=cfg.retrieveValue<float>("./holeFillingBudget",2.0f);
+	unsigned int medianFilterRadius=cfg.retrieveValue<unsigned int>("./medianFilterRadius",0);
 	Misc::FixedArray<unsigned int,2> wtSize;
 	wtSize[0]=640;
 	wtSize[1]=480;
 	wtSize=cfg.retrieveValue<Misc::FixedArray<unsigned int,2> >("./waterTableSize",wtSize);
+	unsigned int waterUpsamplingFactor=cfg.retrieveValue<unsigned int>("./waterUpsamplingFactor",1);
 	waterSpeed=cfg.retrieveValue<double>("./waterSpeed",1.0);
 	waterMaxSteps=cfg.retrieveValue<unsigned int>("./waterMaxSteps",30U);
+	waterStallFree=cfg.retrieveValue<bool>("./waterStallFree",false);
+	unsigned int numWaterThreads=cfg.retrieveValue<unsigned int>("./numWaterThreads",0);
+	bool waterSkipDryTiles=cfg.retrieveValue<bool>("./waterSkipDryTiles",false);
+	bool waterHalfPrecision=cfg.retrieveValue<bool>("./waterHalfPrecision",false);
+	bool waterValidatePrecision=cfg.retrieveValue<bool>("./waterValidatePrecision",false);
 	Math::Interval<double> rainElevationRange=cfg.retrieveValue<Math::Interval<double> >("./rainElevationRange",Math::Interval<double>(-1000.0,1000.0));
 	rainStrength=cfg.retrieveValue<GLfloat>("./rainStrength",0.25f);
 	double evaporationRate=cfg.retrieveValue<double>("./evaporationRate",0.0);
@@ -670,6 +767,38 @@ Sandbox::Sandbox(int& argc,char**& argv)
 				++i;
 				numAveragingSlots=atoi(argv[i]);
 				}
+			else if(strcasecmp(argv[i]+1,"rtf")==0)
+				recursiveTemporalFilter=true;
+			else if(strcasecmp(argv[i]+1,"nft")==0)
+				{
+				++i;
+				if(!FrameFilter::parseNumThreads(argv[i],numFilterThreads))
+					Misc::throwStdErr("Sandbox: Invalid number of filter threads %s; must be between 1 and %u",argv[i],FrameFilter::maxNumThreads);
+				}
+			else if(strcasecmp(argv[i]+1,"nht")==0)
+				{
+				++i;
+				if(!HandExtractor::parseNumThreads(argv[i],numHandExtractorThreads))
+					Misc::throwStdErr("Sandbox: Invalid number of hand extractor threads %s; must be between 1 and %u",argv[i],HandExtractor::maxNumThreads);
+				}
+			else if(strcasecmp(argv[i]+1,"th")==0)
+				trackHands=true;
+			else if(strcasecmp(argv[i]+1,"hpl")==0)
+				{
+				++i;
+				if(!HandExtractor::parsePyramidLevel(argv[i],handPyramidLevel))
+					Misc::throwStdErr("Sandbox: Invalid hand pyramid level %s; must be between 0 and %u",argv[i],HandExtractor::maxPyramidLevel);
+				}
+			else if(strcasecmp(argv[i]+1,"sdp")==0)
+				shareDepthPreprocessing=true;
+			else if(strcasecmp(argv[i]+1,"sfr")==0)
+				{
+				++i;
+				if(!FrameFilter::parseSpatialFilterRadius(argv[i],spatialFilterRadius))
+					Misc::throwStdErr("Sandbox: Invalid spatial filter radius %s; must be between 0 and %u",argv[i],FrameFilter::maxSpatialFilterRadius);
+				}
+			else if(strcasecmp(argv[i]+1,"usf")==0)
+				fuseSpatialFilter=false;
 			else if(strcasecmp(argv[i]+1,"sp")==0)
 				{
 				++i;
@@ -682,6 +811,24 @@ Sandbox::Sandbox(int& argc,char**& argv)
 				++i;
 				hysteresis=float(atof(argv[i]));
 				}
+			else if(strcasecmp(argv[i]+1,"ma")==0)
+				{
+				++i;
+				motionThreshold=float(atof(argv[i]));
+				++i;
+				numMotionFrames=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"fh")==0)
+				{
+				fillHoles=true;
+				++i;
+				holeFillingBudget=float(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"mf")==0)
+				{
+				++i;
+				medianFilterRadius=atoi(argv[i]);
+				}
 			else if(strcasecmp(argv[i]+1,"wts")==0)
 				{
 				for(int j=0;j<2;++j)
@@ -690,6 +837,12 @@ Sandbox::Sandbox(int& argc,char**& argv)
 					wtSize[j]=(unsigned int)(atoi(argv[i]));
 					}
 				}
+			else if(strcasecmp(argv[i]+1,"wus")==0)
+				{
+				++i;
+				if(!WaterRenderer::parseUpsamplingFactor(argv[i],waterUpsamplingFactor))
+					Misc::throwStdErr("Sandbox: Invalid water upsampling factor %s; must be between 1 and %u",argv[i],WaterRenderer::maxUpsamplingFactor);
+				}
 			else if(strcasecmp(argv[i]+1,"ws")==0)
 				{
 				++i;
@@ -697,6 +850,20 @@ Sandbox::Sandbox(int& argc,char**& argv)
 				++i;
 				waterMaxSteps=atoi(argv[i]);
 				}
+			else if(strcasecmp(argv[i]+1,"wsf")==0)
+				waterStallFree=true;
+			else if(strcasecmp(argv[i]+1,"nwt")==0)
+				{
+				++i;
+				if(!WaterTable2::parseNumCPUThreads(argv[i],numWaterThreads))
+					Misc::throwStdErr("Sandbox: Invalid number of water threads %s; must be between 0 and %u",argv[i],WaterTable2::maxNumCPUThreads);
+				}
+			else if(strcasecmp(argv[i]+1,"wsd")==0)
+				waterSkipDryTiles=true;
+			else if(strcasecmp(argv[i]+1,"whp")==0)
+				waterHalfPrecision=true;
+			else if(strcasecmp(argv[i]+1,"wvp")==0)
+				waterValidatePrecision=true;
 			else if(strcasecmp(argv[i]+1,"rer")==0)
 				{
 				++i;
@@ -930,18 +1097,46 @@ Sandbox::Sandbox(int& argc,char**& argv)
 	evaporationRate*=sf;
 	demDistScale*=sf;
 	
-	/* Create the frame filter object: */
-	frameFilter=new FrameFilter(frameSize,numAveragingSlots,pixelDepthCorrection,cameraIps.depthProjection,basePlane);
+	/* Create the frame filter object for the 11-bit Kinect depth frames that all 3D camera frame sources deliver: */
+	if(numFilterThreads<1||numFilterThreads>FrameFilter::maxNumThreads)
+		Misc::throwStdErr("Sandbox: Invalid number of filter threads %u; must be between 1 and %u",numFilterThreads,FrameFilter::maxNumThreads);
+	if(spatialFilterRadius>FrameFilter::maxSpatialFilterRadius)
+		Misc::throwStdErr("Sandbox: Invalid spatial filter radius %u; must be between 0 and %u",spatialFilterRadius,FrameFilter::maxSpatialFilterRadius);
+	frameFilter=new FrameFilter(frameSize,numAveragingSlots,recursiveTemporalFilter?FrameFilter::RECURSIVE_ESTIMATOR:FrameFilter::AVERAGING_BUFFER,FrameFilter::KINECT_DEPTH,pixelDepthCorrection,cameraIps.depthProjection,basePlane);
 	frameFilter->setValidElevationInterval(cameraIps.depthProjection,basePlane,elevationRange.getMin(),elevationRange.getMax());
 	frameFilter->setStableParameters(minNumSamples,maxVariance);
 	frameFilter->setHysteresis(hysteresis);
+	frameFilter->setMotionAdaptive(motionThreshold,numMotionFrames);
+	frameFilter->setHoleFilling(fillHoles);
+	frameFilter->setHoleFillingBudget(holeFillingBudget);
+	frameFilter->setMedianFilter(medianFilterRadius>0);
+	if(medianFilterRadius>0)
+		frameFilter->setMedianFilterRadius(medianFilterRadius);
 	frameFilter->setSpatialFilter(true);
+	frameFilter->setSpatialFilterRadius(spatialFilterRadius);
+	frameFilter->setFuseSpatialFilter(fuseSpatialFilter);
+	frameFilter->setNumThreads(numFilterThreads);
 	frameFilter->setOutputFrameFunction(Misc::createFunctionCall(this,&Sandbox::receiveFilteredFrame));
 	
 	if(waterSpeed>0.0)
 		{
 		/* Create the hand extractor object: */
+		if(numHandExtractorThreads<1||numHandExtractorThreads>HandExtractor::maxNumThreads)
+			Misc::throwStdErr("Sandbox: Invalid number of hand extractor threads %u; must be between 1 and %u",numHandExtractorThreads,HandExtractor::maxNumThreads);
+		if(handPyramidLevel>HandExtractor::maxPyramidLevel)
+			Misc::throwStdErr("Sandbox: Invalid hand pyramid level %u; must be between 0 and %u",handPyramidLevel,HandExtractor::maxPyramidLevel);
 		handExtractor=new HandExtractor(frameSize,pixelDepthCorrection,cameraIps.depthProjection);
+		handExtractor->setNumThreads(numHandExtractorThreads);
+		handExtractor->setTrackHands(trackHands);
+		handExtractor->setPyramidLevel(handPyramidLevel);
+		
+		if(shareDepthPreprocessing)
+			{
+			/* Create a shared preprocessing stage and subscribe the hand extractor to it: */
+			depthPreprocessor=new DepthPreprocessor(frameSize,pixelDepthCorrection,KinectDepthPixels::getMinValid(),KinectDepthPixels::getMaxValid());
+			depthPreprocessor->setValidElevationInterval(cameraIps.depthProjection,basePlane,elevationRange.getMin(),elevationRange.getMax());
+			handExtractor->setDepthPreprocessor(*depthPreprocessor);
+			}
 		}
 	
 	/* Start streaming depth frames: */
@@ -977,15 +1172,41 @@ Sandbox::Sandbox(int& argc,char**& argv)
 	
 	if(waterSpeed>0.0)
 		{
-		/* Initialize the water flow simulator: */
-		waterTable=new WaterTable2(wtSize[0],wtSize[1],depthImageRenderer,basePlaneCorners);
+		/* Reject simulation modes that the validation scenario's lockstep GPU simulations cannot reproduce: */
+		if(waterValidatePrecision&&waterStallFree)
+			Misc::throwStdErr("Sandbox: Water precision validation (-wvp) cannot be combined with stall-free water simulation (-wsf), which does not run in lockstep");
+		if(numWaterThreads>WaterTable2::maxNumCPUThreads)
+			Misc::throwStdErr("Sandbox: Invalid number of water threads %u; must be between 0 and %u",numWaterThreads,WaterTable2::maxNumCPUThreads);
+		if(waterValidatePrecision&&numWaterThreads>0)
+			Misc::throwStdErr("Sandbox: Water precision validation (-wvp) cannot be combined with CPU water simulation (-nwt), which does not use half-precision storage");
+		
+		/* Initialize the water flow simulator, reducing its grid size by the upsampling factor: */
+		if(waterUpsamplingFactor<1||waterUpsamplingFactor>WaterRenderer::maxUpsamplingFactor)
+			Misc::throwStdErr("Sandbox: Invalid water upsampling factor %u; must be between 1 and %u",waterUpsamplingFactor,WaterRenderer::maxUpsamplingFactor);
+		unsigned int wtSimSize[2];
+		for(int i=0;i<2;++i)
+			wtSimSize[i]=Math::max(wtSize[i]/waterUpsamplingFactor,2U);
+		waterTable=new WaterTable2(wtSimSize[0],wtSimSize[1],depthImageRenderer,basePlaneCorners);
 		waterTable->setElevationRange(elevationRange.getMin(),rainElevationRange.getMax());
 		waterTable->setWaterDeposit(evaporationRate);
+		waterTable->setNumCPUThreads(numWaterThreads);
+		waterTable->setSkipDryTiles(waterSkipDryTiles);
+		waterTable->setHalfPrecision(waterHalfPrecision||waterValidatePrecision);
 		
 		/* Register a render function with the water table: */
 		addWaterFunction=Misc::createFunctionCall(this,&Sandbox::addWater);
 		waterTable->addRenderFunction(addWaterFunction);
 		addWaterFunctionRegistered=true;
+		
+		if(waterValidatePrecision)
+			{
+			/* Create a full-precision reference water flow simulator running the same scenario on the GPU: */
+			referenceWaterTable=new WaterTable2(wtSimSize[0],wtSimSize[1],depthImageRenderer,basePlaneCorners);
+			referenceWaterTable->setElevationRange(elevationRange.getMin(),rainElevationRange.getMax());
+			referenceWaterTable->setWaterDeposit(evaporationRate);
+			referenceWaterTable->setSkipDryTiles(waterSkipDryTiles);
+			referenceWaterTable->addRenderFunction(addWaterFunction);
+			}
 		}
 	
 	if(useRemoteServer)
@@ -1024,12 +1245,13 @@ Sandbox::Sandbox(int& argc,char**& argv)
 			if(rsIt->renderWaterSurface)
 				{
 				/* Create a water renderer: */
-				rsIt->waterRenderer=new WaterRenderer(waterTable);
+				rsIt->waterRenderer=new WaterRenderer(waterTable,waterUpsamplingFactor);
 				}
 			else
 				{
 				rsIt->surfaceRenderer->setWaterTable(waterTable);
 				rsIt->surfaceRenderer->setAdvectWaterTexture(true);
+				rsIt->surfaceRenderer->setUpsampleWater(waterUpsamplingFactor>1);
 				rsIt->surfaceRenderer->setWaterOpacity(rsIt->waterOpacity);
 				}
 			}
@@ -1080,9 +1302,11 @@ Sandbox::~Sandbox(void)
 	camera->stopStreaming();
 	delete camera;
 	delete frameFilter;
+	delete depthPreprocessor;
 	
 	/* Delete helper objects: */
 	delete waterTable;
+	delete referenceWaterTable;
 	delete depthImageRenderer;
 	delete handExtractor;
 	delete addWaterFunction;
@@ -1163,8 +1387,8 @@ void Sandbox::frame(void)
 	/* Check if the filtered frame has been updated: */
 	if(filteredFrames.lockNewValue())
 		{
-		/* Update the depth image renderer's depth image: */
-		depthImageRenderer->setDepthImage(filteredFrames.getLockedValue());
+		/* Update the depth image renderer's depth image; the frame filter's tile change masks allow incremental texture uploads: */
+		depthImageRenderer->setIncrementalDepthImage(filteredFrames.getLockedValue());
 		}
 	
 	if(handExtractor!=0)
@@ -1383,6 +1607,17 @@ void Sandbox::frame(void)
 					else
 						std::cerr<<"Wrong number of arguments for dippingBedThickness control pipe command"<<std::endl;
 					}
+				else if(isToken(tokens[0],"frameFilterStatistics"))
+					{
+					if(tokens.size()==1)
+						{
+						/* Print the frame filter's frame counters: */
+						if(frameFilter!=0)
+							std::cout<<"Frame filter: "<<frameFilter->getNumReceivedFrames()<<" frames received, "<<frameFilter->getNumProcessedFrames()<<" processed, "<<frameFilter->getNumDroppedFrames()<<" dropped, "<<frameFilter->getNumFilledHoles()<<" holes filled in the last frame"<<std::endl;
+						}
+					else
+						std::cerr<<"Wrong number of arguments for frameFilterStatistics control pipe command"<<std::endl;
+					}
 				else
 					std::cerr<<"Unrecognized control pipe command "<<tokens[0]<<std::endl;
 				}
@@ -1420,6 +1655,8 @@ void Sandbox::display(GLContextData& contextData) const
 		
 		/* Update the water table's bathymetry grid: */
 		waterTable->updateBathymetry(contextData);
+		if(referenceWaterTable!=0)
+			referenceWaterTable->updateBathymetry(contextData);
 		
 		/* Check if the grid request is active and wants bathymetry data: */
 		if(request.isActive()&&request.bathymetryBuffer!=0)
@@ -1430,31 +1667,73 @@ void Sandbox::display(GLContextData& contextData) const
 			glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
 			}
 		
+		if(referenceWaterTable!=0&&dataItem->waterValidationTime<0.0)
+			{
+			/* Start the validation scenario by flooding both water tables up to the base plane: */
+			std::vector<GLfloat> floodGrid(waterTable->getSize()[0]*waterTable->getSize()[1],0.0f);
+			waterTable->setWaterLevel(&floodGrid[0],contextData);
+			referenceWaterTable->setWaterLevel(&floodGrid[0],contextData);
+			dataItem->waterValidationTime=Vrui::getApplicationTime();
+			}
+		
 		/* Run the water flow simulation's main pass: */
 		GLfloat totalTimeStep=GLfloat(Vrui::getFrameTime()*waterSpeed);
-		unsigned int numSteps=0;
-		while(numSteps<waterMaxSteps-1U&&totalTimeStep>1.0e-8f)
+		if(referenceWaterTable!=0)
 			{
-			/* Run with a self-determined time step to maintain stability: */
-			waterTable->setMaxStepSize(totalTimeStep);
-			GLfloat timeStep=waterTable->runSimulationStep(false,contextData);
-			totalTimeStep-=timeStep;
-			++numSteps;
+			/* Run the reference water table in lockstep, using the step sizes determined by the main water table: */
+			unsigned int numSteps=0;
+			while(numSteps<waterMaxSteps-1U&&totalTimeStep>1.0e-8f)
+				{
+				waterTable->setMaxStepSize(totalTimeStep);
+				GLfloat timeStep=waterTable->runSimulationStep(false,contextData);
+				referenceWaterTable->setMaxStepSize(timeStep);
+				referenceWaterTable->runSimulationStep(true,contextData);
+				totalTimeStep-=timeStep;
+				++numSteps;
+				}
+			
+			if(Vrui::getApplicationTime()>=dataItem->waterValidationTime)
+				{
+				/* Compare the total water volumes held by both water tables: */
+				double volume=waterTable->calcWaterVolume(contextData);
+				double referenceVolume=referenceWaterTable->calcWaterVolume(contextData);
+				double relDiff=referenceVolume>0.0?(volume-referenceVolume)/referenceVolume:0.0;
+				std::cout<<"Water volume: 16-bit "<<volume<<", 32-bit "<<referenceVolume<<", relative difference "<<relDiff<<std::endl;
+				dataItem->waterValidationTime=Vrui::getApplicationTime()+1.0;
+				}
 			}
-		#if 0
-		if(totalTimeStep>1.0e-8f)
+		else if(waterStallFree||waterTable->getNumCPUThreads()>0)
 			{
-			std::cout<<'.'<<std::flush;
-			/* Force the final step to avoid simulation slow-down: */
-			waterTable->setMaxStepSize(totalTimeStep);
-			GLfloat timeStep=waterTable->runSimulationStep(true,contextData);
-			totalTimeStep-=timeStep;
-			++numSteps;
+			/* Let the water table determine and limit its step sizes on the GPU or CPU, carrying left-over time into the next frame: */
+			if(waterMaxSteps>1U)
+				waterTable->runSimulationSteps(totalTimeStep,waterMaxSteps-1U,contextData);
+			}
+		else
+			{
+			unsigned int numSteps=0;
+			while(numSteps<waterMaxSteps-1U&&totalTimeStep>1.0e-8f)
+				{
+				/* Run with a self-determined time step to maintain stability: */
+				waterTable->setMaxStepSize(totalTimeStep);
+				GLfloat timeStep=waterTable->runSimulationStep(false,contextData);
+				totalTimeStep-=timeStep;
+				++numSteps;
+				}
+			#if 0
+			if(totalTimeStep>1.0e-8f)
+				{
+				std::cout<<'.'<<std::flush;
+				/* Force the final step to avoid simulation slow-down: */
+				waterTable->setMaxStepSize(totalTimeStep);
+				GLfloat timeStep=waterTable->runSimulationStep(true,contextData);
+				totalTimeStep-=timeStep;
+				++numSteps;
+				}
+			#else
+			if(totalTimeStep>1.0e-8f)
+				std::cout<<"Ran out of time by "<<totalTimeStep<<std::endl;
+			#endif
 			}
-		#else
-		if(totalTimeStep>1.0e-8f)
-			std::cout<<"Ran out of time by "<<totalTimeStep<<std::endl;
-		#endif
 		
 		/* Check if the grid request is active and wants water level data: */
 		if(request.isActive()&&request.waterLevelBuffer!=0)
@@ -68,6 +68,7 @@ class DEM;
 class SurfaceRenderer;
 class WaterTable2;
 class HandExtractor;
+class DepthPreprocessor;
 typedef Misc::FunctionCall<GLContextData&> AddWaterFunction;
 class RemoteServer;
 class WaterRenderer;
@@ -85,6 +86,7 @@ class Sandbox:public Vrui::Application,public GLObject
 		/* Elements: */
 		public:
 		double waterTableTime; // Simulation time stamp of the water table in this OpenGL context
+		double waterValidationTime; // Application time of the next water volume validation report in this OpenGL context, or negative if the validation scenario has not been started
 		GLsizei shadowBufferSize[2]; // Size of the shadow rendering frame buffer
 		GLuint shadowFramebufferObject; // Frame buffer object to render shadow maps
 		GLuint shadowDepthTextureObject; // Depth texture for the shadow rendering frame buffer
@@ -208,10 +210,13 @@ class Sandbox:public Vrui::Application,public GLObject
 	Scalar boxSize; // Radius of sphere around sandbox area
 	Box bbox; // Bounding box around all potential surfaces
 	WaterTable2* waterTable; // Water flow simulation object
+	WaterTable2* referenceWaterTable; // Water flow simulation object storing all textures in 32-bit floats, run in lockstep with the main one to validate half-precision storage, or null
 	double waterSpeed; // Relative speed of water flow simulation
 	unsigned int waterMaxSteps; // Maximum number of water simulation steps per frame
+	bool waterStallFree; // Flag whether the water flow simulation determines its step sizes on the GPU without waiting for it
 	GLfloat rainStrength; // Amount of water deposited by rain tools and objects on each water simulation step
 	HandExtractor* handExtractor; // Object to detect splayed hands above the sand surface to make rain
+	DepthPreprocessor* depthPreprocessor; // Shared per-frame depth correction and validity and foreground tests for raw depth consumers other than the frame filter, or null
 	const AddWaterFunction* addWaterFunction; // Render function registered with the water table
 	bool addWaterFunctionRegistered; // Flag if the water adding function is currently registered with the water table
 	mutable GridRequest gridRequest; // Structure holding pending grid read-back requests
@@ -0,0 +1,632 @@
+/***********************************************************************
+StreamBenchmark - Utility to measure the per-stage latency of the
+Augmented Reality Sandbox's depth processing pipeline on pre-recorded 3D
+video streams, without requiring Vrui, a display, or a depth camera.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <Misc/FunctionCalls.h>
+#include <Threads/Mutex.h>
+#include <IO/OpenFile.h>
+#include <IO/ValueSource.h>
+#include <Math/Interval.h>
+#include <Geometry/GeometryValueCoders.h>
+#include <Kinect/FrameBuffer.h>
+#include <Kinect/FrameSource.h>
+#include <Kinect/FileFrameSource.h>
+
+#include "Types.h"
+#include "Config.h"
+#include "FrameFilter.h"
+#include "HandExtractor.h"
+
+/***********************************************************************
+Replacement global allocation functions counting the heap allocations
+made by all threads of the process, including the pipeline stages'
+worker threads, to check that the pipeline does not allocate in steady
+state:
+***********************************************************************/
+
+namespace {
+
+unsigned long long numAllocations=0; // Number of heap allocations made by all threads; only accessed atomically
+
+inline unsigned long long getNumAllocations(void) // Returns the number of heap allocations made so far
+	{
+	return __atomic_load_n(&numAllocations,__ATOMIC_RELAXED);
+	}
+
+}
+
+void* operator new(size_t size)
+	{
+	__atomic_fetch_add(&numAllocations,1,__ATOMIC_RELAXED);
+	void* result=malloc(size>0?size:1);
+	if(result==0)
+		throw std::bad_alloc();
+	return result;
+	}
+
+void operator delete(void* ptr) noexcept
+	{
+	free(ptr);
+	}
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+double getTime(void) // Returns the current monotonic time in seconds
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return double(ts.tv_sec)+double(ts.tv_nsec)*1.0e-9;
+	}
+
+bool resetPeakRss(void) // Resets the process's peak resident set size to its current resident set size; returns false if the kernel does not support resetting it
+	{
+	int fd=open("/proc/self/clear_refs",O_WRONLY);
+	if(fd<0)
+		return false;
+	bool result=write(fd,"5",1)==1;
+	close(fd);
+	return result;
+	}
+
+long getPeakRss(void) // Returns the process's peak resident set size in kB, or -1 if it cannot be determined
+	{
+	FILE* statusFile=fopen("/proc/self/status","r");
+	if(statusFile==0)
+		return -1;
+	long result=-1;
+	char line[256];
+	while(fgets(line,sizeof(line),statusFile)!=0)
+		if(strncmp(line,"VmHWM:",6)==0)
+			{
+			result=atol(line+6);
+			break;
+			}
+	fclose(statusFile);
+	return result;
+	}
+
+/**************************************************************
+Helper class to collect depth frames from a streaming 3D camera:
+**************************************************************/
+
+class FrameCollector
+	{
+	/* Elements: */
+	private:
+	Threads::Mutex framesMutex; // Mutex protecting the list of collected frames
+	std::vector<Kinect::FrameBuffer> frames; // List of collected frames
+	size_t maxNumFrames; // Maximum number of frames to collect
+
+	/* Constructors and destructors: */
+	public:
+	FrameCollector(size_t sMaxNumFrames)
+		:maxNumFrames(sMaxNumFrames)
+		{
+		}
+
+	/* Methods: */
+	void receiveFrame(const Kinect::FrameBuffer& frame) // Callback receiving depth frames from the camera's streaming thread
+		{
+		Threads::Mutex::Lock framesLock(framesMutex);
+		if(frames.size()<maxNumFrames)
+			frames.push_back(frame);
+		}
+	size_t getNumFrames(void) // Returns the number of frames collected so far
+		{
+		Threads::Mutex::Lock framesLock(framesMutex);
+		return frames.size();
+		}
+	bool isFull(void) // Returns true if the maximum number of frames has been collected
+		{
+		Threads::Mutex::Lock framesLock(framesMutex);
+		return frames.size()>=maxNumFrames;
+		}
+	std::vector<Kinect::FrameBuffer>& getFrames(void) // Returns the list of collected frames; must only be called after streaming stopped
+		{
+		return frames;
+		}
+	};
+
+/******************************************************************
+Helper class to accumulate per-frame latencies of a pipeline stage:
+******************************************************************/
+
+class LatencyStatistics
+	{
+	/* Elements: */
+	private:
+	std::vector<double> latencies; // List of recorded latencies in seconds
+
+	/* Methods: */
+	public:
+	void reserve(size_t numFrames) // Prepares for the given number of frames, to keep allocations out of timed loops
+		{
+		latencies.reserve(numFrames);
+		}
+	void add(double latency) // Records the latency of one frame
+		{
+		latencies.push_back(latency);
+		}
+	double getTotal(void) const // Returns the sum of all recorded latencies
+		{
+		double result=0.0;
+		for(std::vector<double>::const_iterator lIt=latencies.begin();lIt!=latencies.end();++lIt)
+			result+=*lIt;
+		return result;
+		}
+	void print(const char* stageName) const // Prints the mean, median, and 99th percentile latencies in ms
+		{
+		std::cout<<"  "<<stageName<<": ";
+		if(latencies.empty())
+			{
+			std::cout<<"no frames"<<std::endl;
+			return;
+			}
+
+		/* Find the percentiles as the values of the given ranks in the sorted list of latencies: */
+		std::vector<double> sorted(latencies);
+		std::sort(sorted.begin(),sorted.end());
+		size_t p50Index=(sorted.size()*50+99)/100-1;
+		size_t p99Index=(sorted.size()*99+99)/100-1;
+		std::cout<<std::fixed<<std::setprecision(3);
+		std::cout<<"mean "<<getTotal()*1000.0/double(latencies.size())<<" ms";
+		std::cout<<", p50 "<<sorted[p50Index]*1000.0<<" ms";
+		std::cout<<", p99 "<<sorted[p99Index]*1000.0<<" ms"<<std::endl;
+		}
+	};
+
+}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	const char* frameFilePrefix=0;
+	std::string sandboxLayoutFileName=CONFIG_CONFIGDIR;
+	sandboxLayoutFileName.push_back('/');
+	sandboxLayoutFileName.append(CONFIG_DEFAULTBOXLAYOUTFILENAME);
+	Math::Interval<double> elevationRange(-1000.0,1000.0);
+	unsigned int maxNumFrames=300;
+	unsigned int numPasses=1;
+	unsigned int numAveragingSlots=30;
+	FrameFilter::TemporalFilterType temporalFilterType=FrameFilter::AVERAGING_BUFFER;
+	unsigned int numFilterThreads=1;
+	unsigned int numHandThreads=1;
+	bool trackHands=false;
+	unsigned int handPyramidLevel=0;
+	bool vectorize=true;
+	unsigned int minNumSamples=10;
+	unsigned int maxVariance=2;
+	float hysteresis=0.1f;
+	float motionThreshold=0.0f;
+	unsigned int numMotionFrames=2;
+	bool fillHoles=false;
+	float holeFillingBudget=2.0f;
+	unsigned int medianFilterRadius=0;
+	bool spatialFilter=true;
+	unsigned int spatialFilterRadius=2;
+	bool fuseSpatialFilter=true;
+	bool extractHands=true;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"h")==0)
+				{
+				std::cout<<"Usage: StreamBenchmark -f <frame file name prefix> [option 1] ... [option n]"<<std::endl;
+				std::cout<<"  Options:"<<std::endl;
+				std::cout<<"  -h"<<std::endl;
+				std::cout<<"     Prints this help message"<<std::endl;
+				std::cout<<"  -f <frame file name prefix>"<<std::endl;
+				std::cout<<"     Reads a pre-recorded 3D video stream from a pair of color/depth"<<std::endl;
+				std::cout<<"     files of the given file name prefix"<<std::endl;
+				std::cout<<"  -frames <max num frames>"<<std::endl;
+				std::cout<<"     Sets the maximum number of depth frames read from the recording"<<std::endl;
+				std::cout<<"     Default: 300"<<std::endl;
+				std::cout<<"  -passes <num passes>"<<std::endl;
+				std::cout<<"     Sets the number of times the recorded frames are pushed through"<<std::endl;
+				std::cout<<"     the pipeline"<<std::endl;
+				std::cout<<"     Default: 1"<<std::endl;
+				std::cout<<"  -slf <sandbox layout file name>"<<std::endl;
+				std::cout<<"     Reads the base plane from the sandbox layout file of the given name"<<std::endl;
+				std::cout<<"     Default: "<<CONFIG_CONFIGDIR<<'/'<<CONFIG_DEFAULTBOXLAYOUTFILENAME<<std::endl;
+				std::cout<<"  -er <min elevation> <max elevation>"<<std::endl;
+				std::cout<<"     Sets the range of valid sand surface elevations relative to the"<<std::endl;
+				std::cout<<"     base plane in cm"<<std::endl;
+				std::cout<<"     Default: -1000.0 1000.0"<<std::endl;
+				std::cout<<"  -nas <num averaging slots>"<<std::endl;
+				std::cout<<"     Sets the number of averaging slots in the frame filter's averaging buffer"<<std::endl;
+				std::cout<<"     Default: 30"<<std::endl;
+				std::cout<<"  -rtf"<<std::endl;
+				std::cout<<"     Uses the frame filter's recursive temporal filter instead of its"<<std::endl;
+				std::cout<<"     averaging buffer"<<std::endl;
+				std::cout<<"  -nft <num filter threads>"<<std::endl;
+				std::cout<<"     Sets the number of threads filtering each depth frame, between 1 and "<<FrameFilter::maxNumThreads<<std::endl;
+				std::cout<<"     Default: 1"<<std::endl;
+				std::cout<<"  -nht <num hand extractor threads>"<<std::endl;
+				std::cout<<"     Sets the number of threads labelling each depth frame's foreground spans,"<<std::endl;
+				std::cout<<"     between 1 and "<<HandExtractor::maxNumThreads<<std::endl;
+				std::cout<<"     Default: 1"<<std::endl;
+				std::cout<<"  -th"<<std::endl;
+				std::cout<<"     Tracks hands across frames, scanning only regions around tracked hands"<<std::endl;
+				std::cout<<"     and a rotating sweep window"<<std::endl;
+				std::cout<<"  -hpl <hand pyramid level>"<<std::endl;
+				std::cout<<"     Finds hand candidate regions on a half- (1) or quarter-resolution (2)"<<std::endl;
+				std::cout<<"     min-depth pyramid first, between 0 and "<<HandExtractor::maxPyramidLevel<<std::endl;
+				std::cout<<"     Default: 0"<<std::endl;
+				std::cout<<"  -scalar"<<std::endl;
+				std::cout<<"     Forces the frame filter's scalar kernel"<<std::endl;
+				std::cout<<"  -sp <min num samples> <max variance>"<<std::endl;
+				std::cout<<"     Sets the frame filter's stability parameters"<<std::endl;
+				std::cout<<"     Default: 10 2"<<std::endl;
+				std::cout<<"  -he <hysteresis envelope>"<<std::endl;
+				std::cout<<"     Sets the frame filter's hysteresis envelope"<<std::endl;
+				std::cout<<"     Default: 0.1"<<std::endl;
+				std::cout<<"  -ma <motion threshold> <num motion frames>"<<std::endl;
+				std::cout<<"     Enables the frame filter's motion adaptation"<<std::endl;
+				std::cout<<"  -fh <hole filling budget>"<<std::endl;
+				std::cout<<"     Enables the frame filter's hole filling with the given time budget in ms"<<std::endl;
+				std::cout<<"  -mf <median filter radius>"<<std::endl;
+				std::cout<<"     Enables the frame filter's median filter with 3x3 (radius 1) or 5x5"<<std::endl;
+				std::cout<<"     (radius 2) neighborhoods"<<std::endl;
+				std::cout<<"  -nsf"<<std::endl;
+				std::cout<<"     Disables the frame filter's spatial filter"<<std::endl;
+				std::cout<<"  -sfr <spatial filter radius>"<<std::endl;
+				std::cout<<"     Sets the radius of the frame filter's Gaussian spatial filter kernel,"<<std::endl;
+				std::cout<<"     between 0 and "<<FrameFilter::maxSpatialFilterRadius<<std::endl;
+				std::cout<<"     Default: 2"<<std::endl;
+				std::cout<<"  -usf"<<std::endl;
+				std::cout<<"     Runs the spatial filter as separate passes instead of fusing it with"<<std::endl;
+				std::cout<<"     the temporal filter"<<std::endl;
+				std::cout<<"  -nhe"<<std::endl;
+				std::cout<<"     Skips the hand extractor stage"<<std::endl;
+				return 0;
+				}
+			else if(strcasecmp(argv[i]+1,"f")==0)
+				{
+				++i;
+				frameFilePrefix=argv[i];
+				}
+			else if(strcasecmp(argv[i]+1,"frames")==0)
+				{
+				++i;
+				maxNumFrames=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"passes")==0)
+				{
+				++i;
+				numPasses=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"slf")==0)
+				{
+				++i;
+				sandboxLayoutFileName=argv[i];
+				}
+			else if(strcasecmp(argv[i]+1,"er")==0)
+				{
+				++i;
+				double elevationMin=atof(argv[i]);
+				++i;
+				double elevationMax=atof(argv[i]);
+				elevationRange=Math::Interval<double>(elevationMin,elevationMax);
+				}
+			else if(strcasecmp(argv[i]+1,"nas")==0)
+				{
+				++i;
+				numAveragingSlots=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"rtf")==0)
+				temporalFilterType=FrameFilter::RECURSIVE_ESTIMATOR;
+			else if(strcasecmp(argv[i]+1,"nft")==0)
+				{
+				++i;
+				if(!FrameFilter::parseNumThreads(argv[i],numFilterThreads))
+					{
+					std::cerr<<"StreamBenchmark: Invalid number of filter threads "<<argv[i]<<"; must be between 1 and "<<FrameFilter::maxNumThreads<<std::endl;
+					return 1;
+					}
+				}
+			else if(strcasecmp(argv[i]+1,"nht")==0)
+				{
+				++i;
+				if(!HandExtractor::parseNumThreads(argv[i],numHandThreads))
+					{
+					std::cerr<<"StreamBenchmark: Invalid number of hand extractor threads "<<argv[i]<<"; must be between 1 and "<<HandExtractor::maxNumThreads<<std::endl;
+					return 1;
+					}
+				}
+			else if(strcasecmp(argv[i]+1,"th")==0)
+				trackHands=true;
+			else if(strcasecmp(argv[i]+1,"hpl")==0)
+				{
+				++i;
+				if(!HandExtractor::parsePyramidLevel(argv[i],handPyramidLevel))
+					{
+					std::cerr<<"StreamBenchmark: Invalid hand pyramid level "<<argv[i]<<"; must be between 0 and "<<HandExtractor::maxPyramidLevel<<std::endl;
+					return 1;
+					}
+				}
+			else if(strcasecmp(argv[i]+1,"scalar")==0)
+				vectorize=false;
+			else if(strcasecmp(argv[i]+1,"sp")==0)
+				{
+				++i;
+				minNumSamples=atoi(argv[i]);
+				++i;
+				maxVariance=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"he")==0)
+				{
+				++i;
+				hysteresis=float(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"ma")==0)
+				{
+				++i;
+				motionThreshold=float(atof(argv[i]));
+				++i;
+				numMotionFrames=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"fh")==0)
+				{
+				fillHoles=true;
+				++i;
+				holeFillingBudget=float(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"mf")==0)
+				{
+				++i;
+				medianFilterRadius=atoi(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"nsf")==0)
+				spatialFilter=false;
+			else if(strcasecmp(argv[i]+1,"sfr")==0)
+				{
+				++i;
+				if(!FrameFilter::parseSpatialFilterRadius(argv[i],spatialFilterRadius))
+					{
+					std::cerr<<"StreamBenchmark: Invalid spatial filter radius "<<argv[i]<<"; must be between 0 and "<<FrameFilter::maxSpatialFilterRadius<<std::endl;
+					return 1;
+					}
+				}
+			else if(strcasecmp(argv[i]+1,"usf")==0)
+				fuseSpatialFilter=false;
+			else if(strcasecmp(argv[i]+1,"nhe")==0)
+				extractHands=false;
+			else
+				std::cerr<<"Ignoring unrecognized command line option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"Ignoring unrecognized command line argument "<<argv[i]<<std::endl;
+		}
+	if(frameFilePrefix==0)
+		{
+		std::cerr<<"Usage: StreamBenchmark -f <frame file name prefix> [option 1] ... [option n]"<<std::endl;
+		return 1;
+		}
+	if(maxNumFrames<1)
+		maxNumFrames=1;
+	if(numPasses<1)
+		numPasses=1;
+
+	/* Read the base plane equation from the sandbox layout file: */
+	Plane basePlane;
+	{
+	IO::ValueSource layoutSource(IO::openFile(sandboxLayoutFileName.c_str()));
+	layoutSource.skipWs();
+	std::string s=layoutSource.readLine();
+	basePlane=Misc::ValueCoder<Plane>::decode(s.c_str(),s.c_str()+s.length());
+	basePlane.normalize();
+	}
+
+	/* Open the selected pre-recorded 3D video files: */
+	std::string colorFileName=frameFilePrefix;
+	colorFileName.append(".color");
+	std::string depthFileName=frameFilePrefix;
+	depthFileName.append(".depth");
+	Kinect::FileFrameSource camera(IO::openFile(colorFileName.c_str()),IO::openFile(depthFileName.c_str()));
+	unsigned int frameSize[2];
+	for(int i=0;i<2;++i)
+		frameSize[i]=camera.getActualFrameSize(Kinect::FrameSource::DEPTH)[i];
+
+	/* Get the camera's per-pixel depth correction parameters and evaluate it on the depth frame's pixel grid: */
+	std::vector<FrameFilter::PixelDepthCorrection> pixelDepthCorrection(frameSize[1]*frameSize[0]);
+	Kinect::FrameSource::DepthCorrection* depthCorrection=camera.getDepthCorrectionParameters();
+	if(depthCorrection!=0)
+		{
+		FrameFilter::PixelDepthCorrection* pdc=depthCorrection->getPixelCorrection(frameSize);
+		std::copy(pdc,pdc+frameSize[1]*frameSize[0],pixelDepthCorrection.begin());
+		delete[] pdc;
+		delete depthCorrection;
+		}
+	else
+		{
+		/* Use identity depth correction: */
+		for(std::vector<FrameFilter::PixelDepthCorrection>::iterator pdcIt=pixelDepthCorrection.begin();pdcIt!=pixelDepthCorrection.end();++pdcIt)
+			{
+			pdcIt->scale=1.0f;
+			pdcIt->offset=0.0f;
+			}
+		}
+
+	/* Get the camera's intrinsic parameters: */
+	Kinect::FrameSource::IntrinsicParameters cameraIps=camera.getIntrinsicParameters();
+
+	/*********************************************************************
+	Decode the recorded depth frames into memory before timing anything.
+	The file frame source plays recordings back at their recorded frame
+	rate; collecting the frames up front keeps both the playback pacing
+	and the decompression cost out of the measurements, so that the timed
+	loop runs the pipeline as fast as it can.
+	*********************************************************************/
+
+	std::cout<<"Reading up to "<<maxNumFrames<<" depth frames from "<<depthFileName<<"..."<<std::flush;
+	FrameCollector collector(maxNumFrames);
+	camera.startStreaming(0,Misc::createFunctionCall(&collector,&FrameCollector::receiveFrame));
+
+	/* Wait until enough frames arrived, or until the recording ended and no more frames arrive: */
+	size_t lastNumFrames=0;
+	double lastFrameTime=getTime();
+	while(!collector.isFull())
+		{
+		usleep(10000);
+		size_t numFrames=collector.getNumFrames();
+		if(numFrames!=lastNumFrames)
+			{
+			lastNumFrames=numFrames;
+			lastFrameTime=getTime();
+			}
+		else if(getTime()-lastFrameTime>=2.0)
+			break;
+		}
+	camera.stopStreaming();
+	std::vector<Kinect::FrameBuffer>& frames=collector.getFrames();
+	std::cout<<" read "<<frames.size()<<" frames of "<<frameSize[0]<<'x'<<frameSize[1]<<" pixels"<<std::endl;
+	if(frames.empty())
+		{
+		std::cerr<<"StreamBenchmark: No depth frames in "<<depthFileName<<std::endl;
+		return 1;
+		}
+
+	/* Reset the peak resident set size so that it measures the pipeline's own memory use from here on: */
+	bool havePeakRss=resetPeakRss();
+	long peakRss0=getPeakRss();
+
+	/* Create a frame filter for the sandbox's base plane and valid elevation range, as the sandbox does: */
+	FrameFilter frameFilter(frameSize,numAveragingSlots,temporalFilterType,FrameFilter::KINECT_DEPTH,&pixelDepthCorrection[0],cameraIps.depthProjection,basePlane);
+	frameFilter.setValidElevationInterval(cameraIps.depthProjection,basePlane,elevationRange.getMin(),elevationRange.getMax());
+	frameFilter.setStableParameters(minNumSamples,maxVariance);
+	frameFilter.setHysteresis(hysteresis);
+	frameFilter.setMotionAdaptive(motionThreshold,numMotionFrames);
+	frameFilter.setHoleFilling(fillHoles);
+	frameFilter.setHoleFillingBudget(holeFillingBudget);
+	frameFilter.setMedianFilter(medianFilterRadius>0);
+	if(medianFilterRadius>0)
+		frameFilter.setMedianFilterRadius(medianFilterRadius);
+	frameFilter.setSpatialFilter(spatialFilter);
+	frameFilter.setSpatialFilterRadius(spatialFilterRadius);
+	frameFilter.setFuseSpatialFilter(fuseSpatialFilter);
+	frameFilter.setNumThreads(numFilterThreads);
+	frameFilter.setVectorized(vectorize);
+	Kinect::FrameBuffer outputFrame=frameFilter.createOutputFrame();
+
+	/* Create a hand extractor with default parameters: */
+	HandExtractor handExtractor(frameSize,&pixelDepthCorrection[0],cameraIps.depthProjection);
+	handExtractor.setNumThreads(numHandThreads);
+	handExtractor.setTrackHands(trackHands);
+	handExtractor.setPyramidLevel(handPyramidLevel);
+	HandExtractor::HandList hands;
+
+	/* Reserve room for the hand list so that only the pipeline's own allocations are counted: */
+	hands.reserve(64);
+
+	/* Push all frames through the pipeline, but only record latencies after the frame filter's averaging buffer filled up on the first pass: */
+	size_t numWarmupFrames=numAveragingSlots<frames.size()?numAveragingSlots:0;
+	size_t numTimedFrames=frames.size()*numPasses-numWarmupFrames;
+	LatencyStatistics filterLatencies,handLatencies,totalLatencies;
+	filterLatencies.reserve(numTimedFrames);
+	handLatencies.reserve(numTimedFrames);
+	totalLatencies.reserve(numTimedFrames);
+	unsigned long long numHands=0;
+	unsigned long long numFilterAllocations=0;
+	unsigned long long numHandAllocations=0;
+	double startTime=getTime();
+	for(unsigned int pass=0;pass<numPasses;++pass)
+		for(size_t frameIndex=0;frameIndex<frames.size();++frameIndex)
+			{
+			/* Start the throughput clock with the first timed frame: */
+			bool timed=pass>0||frameIndex>=numWarmupFrames;
+			if(timed&&pass==0&&frameIndex==numWarmupFrames)
+				startTime=getTime();
+
+			/* Run the frame filter stage, whose worker threads are done when it returns: */
+			unsigned long long allocations0=getNumAllocations();
+			double t0=getTime();
+			frameFilter.filterFrame(frames[frameIndex],outputFrame);
+			double t1=getTime();
+			unsigned long long allocations1=getNumAllocations();
+
+			/* Run the hand extractor stage on the raw frame, as the sandbox does: */
+			if(extractHands)
+				{
+				hands.clear();
+				handExtractor.extractHands(frames[frameIndex].getData<HandExtractor::DepthPixel>(),hands,0);
+				}
+			double t2=getTime();
+			unsigned long long allocations2=getNumAllocations();
+
+			if(timed)
+				{
+				filterLatencies.add(t1-t0);
+				handLatencies.add(t2-t1);
+				totalLatencies.add(t2-t0);
+				numHands+=hands.size();
+				numFilterAllocations+=allocations1-allocations0;
+				numHandAllocations+=allocations2-allocations1;
+				}
+			}
+	double elapsed=getTime()-startTime;
+
+	/* Query the increment of the process's peak resident set size caused by the pipeline: */
+	long peakRss1=getPeakRss();
+
+	/* Print the results: */
+	std::cout<<numTimedFrames<<" timed frames, "<<FrameFilter::getPixelFormatName(FrameFilter::KINECT_DEPTH)<<" pixels, "<<numAveragingSlots<<(temporalFilterType==FrameFilter::RECURSIVE_ESTIMATOR?" slots (recursive), ":" slots, ")<<numFilterThreads<<" filter thread(s), "<<(frameFilter.getVectorized()?"vectorized":"scalar")<<" kernel:"<<std::endl;
+	filterLatencies.print("FrameFilter");
+	std::cout<<"  FrameFilter heap allocations in timed frames: "<<numFilterAllocations<<std::endl;
+	if(extractHands)
+		{
+		handLatencies.print("HandExtractor");
+		std::cout<<"  Hands/frame: "<<std::setprecision(3)<<double(numHands)/double(numTimedFrames)<<std::endl;
+		std::cout<<"  HandExtractor heap allocations in timed frames: "<<numHandAllocations<<std::endl;
+		}
+	totalLatencies.print("Pipeline");
+	std::cout<<"  Throughput: "<<std::setprecision(1)<<double(numTimedFrames)/elapsed<<" frames/s"<<std::endl;
+	if(havePeakRss&&peakRss0>=0&&peakRss1>=0)
+		std::cout<<"  Pipeline peak RSS increment: "<<std::setprecision(1)<<double(peakRss1-peakRss0)/1024.0<<" MB"<<std::endl;
+	else
+		std::cout<<"  Pipeline peak RSS increment: unavailable (kernel cannot reset VmHWM)"<<std::endl;
+
+	/* Fail if any pipeline stage allocated heap memory after warming up: */
+	if(numFilterAllocations+numHandAllocations!=0)
+		{
+		std::cerr<<"StreamBenchmark: The pipeline made "<<numFilterAllocations+numHandAllocations<<" heap allocations after warming up"<<std::endl;
+		return 1;
+		}
+
+	return 0;
+	}
@@ -260,12 +260,15 @@ GLhandleARB SurfaceRenderer::createSinglePassSurfaceShader(const GLLightTracker&
 			vertexUniforms+="\
 				uniform mat4 waterTransform; // Transformation from camera space to water level texture coordinate space\n";
 			vertexVaryings+="\
-				varying vec2 waterTexCoord; // Texture coordinate for water level texture\n";
+				varying vec2 waterTexCoord; // Texture coordinate for water level texture\n\
+				varying float waterElevation; // Elevation of the surface in water level texture space\n";
 			
 			/* Add water handling code to vertex shader's main function: */
 			vertexMain+="\
 				/* Transform the vertex from camera space to water level texture coordinate space: */\n\
-				waterTexCoord=(waterTransform*vertexCc).xy;\n\
+				vec4 vertexWc=waterTransform*vertexCc;\n\
+				waterTexCoord=vertexWc.xy;\n\
+				waterElevation=vertexWc.z;\n\
 				\n";
 			}
 		
@@ -392,6 +395,7 @@ GLhandleARB SurfaceRenderer::createSinglePassSurfaceShader(const GLLightTracker&
 			/* Declare the water handling functions: */
 			fragmentDeclarations+="\
 				void addWaterColor(in vec2,inout vec4);\n\
+				void addWaterColorUpsampled(in vec2,inout vec4);\n\
 				void addWaterColorAdvected(inout vec4);\n";
 			
 			/* Compile the water handling shader: */
@@ -405,6 +409,13 @@ GLhandleARB SurfaceRenderer::createSinglePassSurfaceShader(const GLLightTracker&
 					addWaterColorAdvected(baseColor);\n\
 					\n";
 				}
+			else if(upsampleWater)
+				{
+				fragmentMain+="\
+					/* Modulate the base color with water color interpolated from a coarser water table: */\n\
+					addWaterColorUpsampled(gl_FragCoord.xy,baseColor);\n\
+					\n";
+				}
 			else
 				{
 				fragmentMain+="\
@@ -584,7 +595,7 @@ SurfaceRenderer::SurfaceRenderer(const DepthImageRenderer* sDepthImageRenderer)
 	 dippingBedPlane(Plane::Vector(0,0,1),0.0f),dippingBedThickness(1),
 	 dem(0),demDistScale(1.0f),
 	 illuminate(false),
-	 waterTable(0),advectWaterTexture(false),waterOpacity(2.0f),
+	 waterTable(0),advectWaterTexture(false),upsampleWater(false),waterOpacity(2.0f),
 	 surfaceSettingsVersion(1),
 	 animationTime(0.0)
 	{
@@ -746,6 +757,12 @@ void SurfaceRenderer::setAdvectWaterTexture(bool newAdvectWaterTexture)
 	++surfaceSettingsVersion;
 	}
 
+void SurfaceRenderer::setUpsampleWater(bool newUpsampleWater)
+	{
+	upsampleWater=newUpsampleWater;
+	++surfaceSettingsVersion;
+	}
+
 void SurfaceRenderer::setWaterOpacity(GLfloat newWaterOpacity)
 	{
 	/* Set the new opacity factor: */
@@ -94,6 +94,7 @@ class SurfaceRenderer:public GLObject
 	
 	WaterTable2* waterTable; // Pointer to the water table object; if NULL, water is ignored
 	bool advectWaterTexture; // Flag whether water texture coordinates are advected to visualize water flow
+	bool upsampleWater; // Flag whether water levels are interpolated from the surrounding wet cells and compared against the surface's own elevation, for water tables of lower resolution than the surface
 	GLfloat waterOpacity; // Scaling factor for water opacity
 	
 	unsigned int surfaceSettingsVersion; // Version number of surface settings to invalidate surface rendering shader on changes
@@ -124,6 +125,7 @@ class SurfaceRenderer:public GLObject
 	void setIlluminate(bool newIlluminate); // Sets the illumination flag
 	void setWaterTable(WaterTable2* newWaterTable); // Sets the pointer to the water table; NULL disables water handling
 	void setAdvectWaterTexture(bool newAdvectWaterTexture); // Sets the water texture coordinate advection flag
+	void setUpsampleWater(bool newUpsampleWater); // Sets the water level upsampling flag
 	void setWaterOpacity(GLfloat newWaterOpacity); // Sets the water opacity factor
 	void setAnimationTime(double newAnimationTime); // Sets the time for water animation in seconds
 	void renderSinglePass(const int viewport[4],const PTransform& projection,const OGTransform& modelview,GLContextData& contextData) const; // Renders the surface in a single pass using the current surface settings
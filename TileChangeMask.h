@@ -0,0 +1,93 @@
+/***********************************************************************
+TileChangeMask - Class to mark which square tiles of a float-pixel depth
+frame changed from the previous frame in a sequence of frames. A mask is
+stored in a frame's buffer immediately after the frame's pixels.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef TILECHANGEMASK_INCLUDED
+#define TILECHANGEMASK_INCLUDED
+
+#include <stddef.h>
+#include <Kinect/FrameBuffer.h>
+
+class TileChangeMask
+	{
+	/* Embedded classes: */
+	public:
+	static const unsigned int tileSize=32; // Width and height of tiles in pixels
+
+	/* Elements: */
+	private:
+	unsigned int frameIndex; // Index of the frame in its sequence of frames, to detect skipped frames
+	unsigned int numTiles[2]; // Number of tiles horizontally and vertically; followed by one change flag per tile in row-major order
+
+	/* Private methods: */
+	static size_t getMaskOffset(const unsigned int frameSize[2]) // Returns the offset of the mask inside a frame buffer of the given frame size
+		{
+		return size_t(frameSize[1])*size_t(frameSize[0])*sizeof(float);
+		}
+
+	/* Methods: */
+	public:
+	static unsigned int getNumTiles(unsigned int frameSize) // Returns the number of tiles covering the given number of pixels
+		{
+		return (frameSize+tileSize-1)/tileSize;
+		}
+	static Kinect::FrameBuffer createFrame(const unsigned int frameSize[2]) // Creates a float-pixel frame of the given size with room for a tile change mask
+		{
+		return Kinect::FrameBuffer(frameSize[0],frameSize[1],getMaskOffset(frameSize)+sizeof(TileChangeMask)+size_t(getNumTiles(frameSize[1]))*size_t(getNumTiles(frameSize[0])));
+		}
+	static TileChangeMask& get(Kinect::FrameBuffer& frame) // Returns the tile change mask stored in the given frame created by createFrame
+		{
+		return *reinterpret_cast<TileChangeMask*>(frame.getData<unsigned char>()+getMaskOffset(frame.getSize()));
+		}
+	static const TileChangeMask& get(const Kinect::FrameBuffer& frame) // Ditto
+		{
+		return *reinterpret_cast<const TileChangeMask*>(frame.getData<unsigned char>()+getMaskOffset(frame.getSize()));
+		}
+	void setFrame(const unsigned int frameSize[2],unsigned int newFrameIndex) // Sets the mask's frame index and number of tiles for the given frame size
+		{
+		frameIndex=newFrameIndex;
+		for(int i=0;i<2;++i)
+			numTiles[i]=getNumTiles(frameSize[i]);
+		}
+	unsigned int getFrameIndex(void) const // Returns the index of the mask's frame
+		{
+		return frameIndex;
+		}
+	const unsigned int* getNumTiles(void) const // Returns the number of tiles horizontally and vertically
+		{
+		return numTiles;
+		}
+	unsigned char* getTiles(void) // Returns the array of tile change flags
+		{
+		return reinterpret_cast<unsigned char*>(this+1);
+		}
+	const unsigned char* getTiles(void) const // Ditto
+		{
+		return reinterpret_cast<const unsigned char*>(this+1);
+		}
+	bool isChanged(unsigned int tileX,unsigned int tileY) const // Returns true if the given tile changed from the previous frame
+		{
+		return getTiles()[tileY*numTiles[0]+tileX]!=0;
+		}
+	};
+
+#endif
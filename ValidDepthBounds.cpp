@@ -0,0 +1,302 @@
+/***********************************************************************
+ValidDepthBounds - Class to represent the set of valid raw depth values
+between a lower and an upper plane in depth image space as a per-pixel
+interval of raw depth values, for integer or floating-point depth values.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "ValidDepthBounds.h"
+
+#include <string.h>
+
+namespace {
+
+/***********************************************************************
+Helper class to evaluate one of the two plane inequalities for all raw
+depth values of a single pixel. Depth correction, the plane equation,
+and the comparison are all monotonic in the raw depth value, even under
+IEEE rounding, meaning that the set of raw depth values satisfying one
+inequality is always a prefix or a suffix of the set of all raw depth
+values, and the set satisfying both is an interval.
+***********************************************************************/
+
+class PlaneTest
+	{
+	/* Elements: */
+	private:
+	float planeXY; // Sum of the plane equation's x and y terms for the pixel
+	float planeZ; // Plane equation's z coefficient
+	float planeOffset; // Plane equation's offset
+	float scale,offset; // Pixel's depth correction coefficients
+	bool lower; // Flag whether the test accepts points on the positive side of the plane
+
+	/* Constructors and destructors: */
+	public:
+	PlaneTest(const float plane[4],float px,float py,float sScale,float sOffset,bool sLower)
+		:planeXY(plane[0]*px+plane[1]*py),planeZ(plane[2]),planeOffset(plane[3]),
+		 scale(sScale),offset(sOffset),
+		 lower(sLower)
+		{
+		}
+
+	/* Methods: */
+	bool operator()(float depth) const // Evaluates the inequality exactly like ValidDepthBounds::isValid
+		{
+		float d=planeXY+planeZ*(depth*scale+offset)+planeOffset;
+		return lower?d>=0.0f:d<=0.0f;
+		}
+	double estimateCrossing(void) const // Returns an estimate of the raw depth value where the plane test changes its result
+		{
+		return (-(double(planeXY)+double(planeOffset))/double(planeZ)-double(offset))/double(scale);
+		}
+	};
+
+/***********************************************************************
+Helper classes to enumerate raw depth values in increasing order by
+unsigned integer ordinals. Non-negative IEEE floating-point numbers
+compare in the same order as their bit patterns, which therefore serve
+as ordinals for floating-point depth values.
+***********************************************************************/
+
+template <class DepthParam>
+class DepthOrdinals;
+
+template <>
+class DepthOrdinals<unsigned short>
+	{
+	/* Methods: */
+	public:
+	static unsigned int getOrdinal(unsigned short depth) // Returns the ordinal of the given depth value
+		{
+		return depth;
+		}
+	static unsigned short getDepth(unsigned int ordinal) // Returns the depth value of the given ordinal
+		{
+		return (unsigned short)(ordinal);
+		}
+	static unsigned int getOrdinal(double depth,unsigned int min,unsigned int max) // Returns the ordinal of an approximate depth value, clamped to the given range of ordinals
+		{
+		if(!(depth>=double(min)))
+			return min;
+		else if(depth>=double(max))
+			return max;
+		else
+			return (unsigned int)(depth);
+		}
+	};
+
+template <>
+class DepthOrdinals<float>
+	{
+	/* Methods: */
+	public:
+	static unsigned int getOrdinal(float depth)
+		{
+		unsigned int result;
+		memcpy(&result,&depth,sizeof(float));
+		return result;
+		}
+	static float getDepth(unsigned int ordinal)
+		{
+		float result;
+		memcpy(&result,&ordinal,sizeof(float));
+		return result;
+		}
+	static unsigned int getOrdinal(double depth,unsigned int min,unsigned int max)
+		{
+		if(!(depth>=double(getDepth(min))))
+			return min;
+		else if(depth>=double(getDepth(max)))
+			return max;
+		else
+			return getOrdinal(float(depth));
+		}
+	};
+
+template <class DepthParam>
+unsigned int findFirstPassing(const PlaneTest& test,bool pass,unsigned int start,unsigned int min,unsigned int max) // Returns the smallest ordinal in the given range for which the given test has the given result, which must be the case for max but not for min
+	{
+	typedef DepthOrdinals<DepthParam> Ordinals;
+
+	/* Bracket the crossing with steps of increasing size starting at the given estimate: */
+	unsigned int lo=min; // Ordinal known to not have the given result
+	unsigned int hi=max; // Ordinal known to have the given result
+	if(start>min&&start<max)
+		{
+		unsigned int step=1U;
+		if(test(Ordinals::getDepth(start))==pass)
+			{
+			hi=start;
+			while(hi-lo>step&&test(Ordinals::getDepth(hi-step))==pass)
+				{
+				hi-=step;
+				step*=2U;
+				}
+			if(hi-lo>step)
+				lo=hi-step;
+			}
+		else
+			{
+			lo=start;
+			while(hi-lo>step&&test(Ordinals::getDepth(lo+step))!=pass)
+				{
+				lo+=step;
+				step*=2U;
+				}
+			if(hi-lo>step)
+				hi=lo+step;
+			}
+		}
+
+	/* Narrow down the crossing by bisection: */
+	while(hi-lo>1U)
+		{
+		unsigned int mid=lo+(hi-lo)/2U;
+		if(test(Ordinals::getDepth(mid))==pass)
+			hi=mid;
+		else
+			lo=mid;
+		}
+
+	return hi;
+	}
+
+template <class DepthParam>
+bool findInterval(const PlaneTest& test,unsigned int minOrdinal,unsigned int maxOrdinal,unsigned int& min,unsigned int& max) // Finds the interval of ordinals in the given range whose raw depth values pass the given test; returns false if there are none
+	{
+	typedef DepthOrdinals<DepthParam> Ordinals;
+
+	/* Check the extremal raw depth values: */
+	bool first=test(Ordinals::getDepth(minOrdinal));
+	bool last=test(Ordinals::getDepth(maxOrdinal));
+	if(first&&last)
+		{
+		/* All raw depth values pass: */
+		min=minOrdinal;
+		max=maxOrdinal;
+		return true;
+		}
+	if(!first&&!last)
+		{
+		/* No raw depth values pass: */
+		return false;
+		}
+
+	/* Start the search for the crossing at the analytic estimate, and refine it by evaluating the exact test: */
+	unsigned int start=Ordinals::getOrdinal(test.estimateCrossing(),minOrdinal,maxOrdinal);
+	if(last)
+		{
+		/* Find the smallest passing raw depth value: */
+		min=findFirstPassing<DepthParam>(test,true,start,minOrdinal,maxOrdinal);
+		max=maxOrdinal;
+		}
+	else
+		{
+		/* Find the largest passing raw depth value: */
+		min=minOrdinal;
+		max=findFirstPassing<DepthParam>(test,false,start,minOrdinal,maxOrdinal)-1U;
+		}
+
+	return true;
+	}
+
+}
+
+/*********************************
+Methods of class ValidDepthBounds:
+*********************************/
+
+template <class DepthParam>
+ValidDepthBounds<DepthParam>::ValidDepthBounds(const unsigned int sSize[2],typename ValidDepthBounds<DepthParam>::RawDepth sMinValidDepth,typename ValidDepthBounds<DepthParam>::RawDepth sMaxValidDepth)
+	:minValidDepth(sMinValidDepth),maxValidDepth(sMaxValidDepth),
+	 minDepths(0),maxDepths(0)
+	{
+	/* Remember the frame size: */
+	for(int i=0;i<2;++i)
+		size[i]=sSize[i];
+
+	/* Initialize the bounds to accept all raw depth values that can be valid: */
+	minDepths=new RawDepth[size[1]*size[0]];
+	maxDepths=new RawDepth[size[1]*size[0]];
+	for(unsigned int i=0;i<size[1]*size[0];++i)
+		{
+		minDepths[i]=minValidDepth;
+		maxDepths[i]=maxValidDepth;
+		}
+	}
+
+template <class DepthParam>
+ValidDepthBounds<DepthParam>::~ValidDepthBounds(void)
+	{
+	delete[] minDepths;
+	delete[] maxDepths;
+	}
+
+template <class DepthParam>
+void ValidDepthBounds<DepthParam>::setPlanes(const typename ValidDepthBounds<DepthParam>::PixelDepthCorrection* pixelDepthCorrection,const float minPlane[4],const float maxPlane[4])
+	{
+	typedef DepthOrdinals<DepthParam> Ordinals;
+
+	/* Search for intervals in the range of raw depth values that can be valid: */
+	unsigned int minOrdinal=Ordinals::getOrdinal(minValidDepth);
+	unsigned int maxOrdinal=Ordinals::getOrdinal(maxValidDepth);
+
+	RawDepth* minPtr=minDepths;
+	RawDepth* maxPtr=maxDepths;
+	const PixelDepthCorrection* pdcPtr=pixelDepthCorrection;
+	for(unsigned int y=0;y<size[1];++y)
+		{
+		float py=float(y)+0.5f;
+		for(unsigned int x=0;x<size[0];++x,++minPtr,++maxPtr)
+			{
+			float px=float(x)+0.5f;
+
+			/* Get the pixel's depth correction coefficients; a scale of 1 and offset of 0 reproduce uncorrected depth values exactly: */
+			float scale=1.0f;
+			float offset=0.0f;
+			if(pdcPtr!=0)
+				{
+				scale=pdcPtr->scale;
+				offset=pdcPtr->offset;
+				++pdcPtr;
+				}
+
+			/* Intersect the intervals of raw depth values passing the minimum and maximum plane tests: */
+			unsigned int min0,max0,min1,max1;
+			if(findInterval<DepthParam>(PlaneTest(minPlane,px,py,scale,offset,true),minOrdinal,maxOrdinal,min0,max0)&&findInterval<DepthParam>(PlaneTest(maxPlane,px,py,scale,offset,false),minOrdinal,maxOrdinal,min1,max1)&&min0<=max1&&min1<=max0)
+				{
+				*minPtr=Ordinals::getDepth(min0>min1?min0:min1);
+				*maxPtr=Ordinals::getDepth(max0<max1?max0:max1);
+				}
+			else
+				{
+				/* Mark the pixel as having no valid raw depth values: */
+				*minPtr=maxValidDepth;
+				*maxPtr=minValidDepth;
+				}
+			}
+		}
+	}
+
+/***********************************************************************
+Force instantiation of all standard ValidDepthBounds classes:
+***********************************************************************/
+
+template class ValidDepthBounds<unsigned short>;
+template class ValidDepthBounds<float>;
@@ -0,0 +1,77 @@
+/***********************************************************************
+ValidDepthBounds - Class to represent the set of valid raw depth values
+between a lower and an upper plane in depth image space as a per-pixel
+interval of raw depth values, for integer or floating-point depth values.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef VALIDDEPTHBOUNDS_INCLUDED
+#define VALIDDEPTHBOUNDS_INCLUDED
+
+#include <stddef.h>
+#include <Kinect/FrameSource.h>
+
+template <class DepthParam>
+class ValidDepthBounds
+	{
+	/* Embedded classes: */
+	public:
+	typedef DepthParam RawDepth; // Data type for raw depth values; instantiated for unsigned short and float
+	typedef Kinect::FrameSource::DepthCorrection::PixelCorrection PixelDepthCorrection; // Type for per-pixel depth correction factors
+
+	/* Elements: */
+	private:
+	unsigned int size[2]; // Width and height of depth frames
+	RawDepth minValidDepth,maxValidDepth; // Interval of raw depth values that can be valid; all per-pixel intervals are inside
+	RawDepth* minDepths; // Image of smallest valid raw depth value for each pixel
+	RawDepth* maxDepths; // Image of largest valid raw depth value for each pixel; smaller than the smallest value if a pixel has no valid values
+
+	/* Constructors and destructors: */
+	public:
+	ValidDepthBounds(const unsigned int sSize[2],RawDepth sMinValidDepth,RawDepth sMaxValidDepth); // Creates bounds for depth frames of the given size that accept all raw depth values in the given interval
+	private:
+	ValidDepthBounds(const ValidDepthBounds& source); // Prohibit copy constructor
+	ValidDepthBounds& operator=(const ValidDepthBounds& source); // Prohibit assignment operator
+	public:
+	~ValidDepthBounds(void);
+
+	/* Methods: */
+	static bool isValid(float px,float py,float correctedDepth,const float minPlane[4],const float maxPlane[4]) // Returns true if the given depth-corrected point in depth image space is between the given planes
+		{
+		float minD=minPlane[0]*px+minPlane[1]*py+minPlane[2]*correctedDepth+minPlane[3];
+		float maxD=maxPlane[0]*px+maxPlane[1]*py+maxPlane[2]*correctedDepth+maxPlane[3];
+		return minD>=0.0f&&maxD<=0.0f;
+		}
+	void setPlanes(const PixelDepthCorrection* pixelDepthCorrection,const float minPlane[4],const float maxPlane[4]); // Calculates the raw depth intervals that pass the plane test after per-pixel depth correction; uses uncorrected raw depth values if pixelDepthCorrection is null
+	const RawDepth* getMinDepths(void) const // Returns the image of smallest valid raw depth values
+		{
+		return minDepths;
+		}
+	const RawDepth* getMaxDepths(void) const // Returns the image of largest valid raw depth values
+		{
+		return maxDepths;
+		}
+	bool isValid(unsigned int x,unsigned int y,RawDepth depth) const // Returns true if the given raw depth value is valid for the given pixel
+		{
+		ptrdiff_t index=ptrdiff_t(y)*ptrdiff_t(size[0])+ptrdiff_t(x);
+		return depth>=minDepths[index]&&depth<=maxDepths[index];
+		}
+	};
+
+#endif
@@ -25,6 +25,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 // DEBUGGING
 #include <iostream>
 
+#include <stdlib.h>
+#include <Misc/ThrowStdErr.h>
 #include <GL/gl.h>
 #include <GL/GLVertexArrayParts.h>
 #include <GL/GLContextData.h>
@@ -76,14 +78,16 @@ WaterRenderer::DataItem::~DataItem(void)
 Methods of class WaterRenderer:
 ******************************/
 
-WaterRenderer::WaterRenderer(const WaterTable2* sWaterTable)
-	:waterTable(sWaterTable)
+WaterRenderer::WaterRenderer(const WaterTable2* sWaterTable,unsigned int sUpsamplingFactor)
+	:waterTable(sWaterTable),
+	 upsamplingFactor(sUpsamplingFactor<1?1:sUpsamplingFactor>maxUpsamplingFactor?maxUpsamplingFactor:sUpsamplingFactor)
 	{
 	/* Copy the water table's grid sizes and grid cell size: */
 	for(int i=0;i<2;++i)
 		{
 		bathymetryGridSize[i]=waterTable->getSize()[i]-1;
 		waterGridSize[i]=waterTable->getSize()[i];
+		renderGridSize[i]=waterGridSize[i]*upsamplingFactor;
 		cellSize[i]=waterTable->getCellSize()[i];
 		}
 	
@@ -117,33 +121,54 @@ void WaterRenderer::initContext(GLContextData& contextData) const
 	
 	/* Upload the grid of template vertices into the vertex buffer: */
 	glBindBufferARB(GL_ARRAY_BUFFER_ARB,dataItem->vertexBuffer);
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB,waterGridSize[1]*waterGridSize[0]*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB,renderGridSize[1]*renderGridSize[0]*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
 	Vertex* vPtr=static_cast<Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB));
-	for(unsigned int y=0;y<waterGridSize[1];++y)
-		for(unsigned int x=0;x<waterGridSize[0];++x,++vPtr)
+	if(vPtr==0)
+		{
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB,0);
+		Misc::throwStdErr("WaterRenderer: Unable to create vertex buffer for %u x %u render grid",renderGridSize[0],renderGridSize[1]);
+		}
+	GLfloat vertexScale=1.0f/GLfloat(upsamplingFactor);
+	for(unsigned int y=0;y<renderGridSize[1];++y)
+		for(unsigned int x=0;x<renderGridSize[0];++x,++vPtr)
 			{
-			/* Set the template vertex' position to the pixel center's position: */
-			vPtr->position[0]=GLfloat(x)+0.5f;
-			vPtr->position[1]=GLfloat(y)+0.5f;
+			/* Set the template vertex' position to the render grid pixel center's position in water level grid space: */
+			vPtr->position[0]=(GLfloat(x)+0.5f)*vertexScale;
+			vPtr->position[1]=(GLfloat(y)+0.5f)*vertexScale;
 			}
 	glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
 	glBindBufferARB(GL_ARRAY_BUFFER_ARB,0);
 	
 	/* Upload the surface's triangle indices into the index buffer: */
 	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,dataItem->indexBuffer);
-	glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB,(waterGridSize[1]-1)*waterGridSize[0]*2*sizeof(GLuint),0,GL_STATIC_DRAW_ARB);
+	glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB,(renderGridSize[1]-1)*renderGridSize[0]*2*sizeof(GLuint),0,GL_STATIC_DRAW_ARB);
 	GLuint* iPtr=static_cast<GLuint*>(glMapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,GL_WRITE_ONLY_ARB));
-	for(unsigned int y=1;y<waterGridSize[1];++y)
-		for(unsigned int x=0;x<waterGridSize[0];++x,iPtr+=2)
+	if(iPtr==0)
+		{
+		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,0);
+		Misc::throwStdErr("WaterRenderer: Unable to create index buffer for %u x %u render grid",renderGridSize[0],renderGridSize[1]);
+		}
+	for(unsigned int y=1;y<renderGridSize[1];++y)
+		for(unsigned int x=0;x<renderGridSize[0];++x,iPtr+=2)
 			{
-			iPtr[0]=GLuint(y*waterGridSize[0]+x);
-			iPtr[1]=GLuint((y-1)*waterGridSize[0]+x);
+			iPtr[0]=GLuint(y*renderGridSize[0]+x);
+			iPtr[1]=GLuint((y-1)*renderGridSize[0]+x);
 			}
 	glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
 	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,0);
 	
 	/* Create the water rendering shader: */
-	dataItem->waterShader=linkVertexAndFragmentShader("WaterRenderingShader");
+	if(upsamplingFactor>1)
+		{
+		/* Combine the upsampling vertex shader with the regular fragment shader: */
+		GLhandleARB vertexShader=compileVertexShader("WaterRenderingUpsampledShader");
+		GLhandleARB fragmentShader=compileFragmentShader("WaterRenderingShader");
+		dataItem->waterShader=glLinkShader(vertexShader,fragmentShader);
+		glDeleteObjectARB(vertexShader);
+		glDeleteObjectARB(fragmentShader);
+		}
+	else
+		dataItem->waterShader=linkVertexAndFragmentShader("WaterRenderingShader");
 	GLint* ulPtr=dataItem->waterShaderUniforms;
 	*(ulPtr++)=glGetUniformLocationARB(dataItem->waterShader,"quantitySampler");
 	*(ulPtr++)=glGetUniformLocationARB(dataItem->waterShader,"bathymetrySampler");
@@ -152,6 +177,18 @@ void WaterRenderer::initContext(GLContextData& contextData) const
 	*(ulPtr++)=glGetUniformLocationARB(dataItem->waterShader,"projectionModelviewGridMatrix");
 	}
 
+bool WaterRenderer::parseUpsamplingFactor(const char* string,unsigned int& upsamplingFactor)
+	{
+	/* Parse the entire string as a decimal number and check it against the valid range: */
+	char* end;
+	long value=strtol(string,&end,10);
+	if(end==string||*end!='\0'||value<1||value>long(maxUpsamplingFactor))
+		return false;
+	
+	upsamplingFactor=(unsigned int)(value);
+	return true;
+	}
+
 void WaterRenderer::render(const PTransform& projection,const OGTransform& modelview,GLContextData& contextData) const
 	{
 	/* Get the data item: */
@@ -173,6 +210,20 @@ void WaterRenderer::render(const PTransform& projection,const OGTransform& model
 	/* Bind the bathymetry texture: */
 	glActiveTextureARB(GL_TEXTURE1_ARB);
 	waterTable->bindBathymetryTexture(contextData);
+	static const GLenum bathymetryParameterNames[4]={GL_TEXTURE_MIN_FILTER,GL_TEXTURE_MAG_FILTER,GL_TEXTURE_WRAP_S,GL_TEXTURE_WRAP_T};
+	GLint bathymetryParameters[4];
+	if(upsamplingFactor>1)
+		{
+		/* Save the sampling parameters of the bathymetry texture, which is shared with the water simulation: */
+		for(int i=0;i<4;++i)
+			glGetTexParameteriv(GL_TEXTURE_RECTANGLE_ARB,bathymetryParameterNames[i],&bathymetryParameters[i]);
+		
+		/* Interpolate the bathymetry grid between its vertices: */
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+		}
 	glUniform1iARB(*(ulPtr++),1);
 	
 	/* Calculate and upload the vertex transformation from grid space to eye space: */
@@ -206,10 +257,17 @@ void WaterRenderer::render(const PTransform& projection,const OGTransform& model
 	GLVertexArrayParts::enable(Vertex::getPartsMask());
 	glVertexPointer(static_cast<const Vertex*>(0));
 	GLuint* indexPtr=0;
-	for(unsigned int y=1;y<waterGridSize[1];++y,indexPtr+=waterGridSize[0]*2)
-		glDrawElements(GL_QUAD_STRIP,waterGridSize[0]*2,GL_UNSIGNED_INT,indexPtr);
+	for(unsigned int y=1;y<renderGridSize[1];++y,indexPtr+=renderGridSize[0]*2)
+		glDrawElements(GL_QUAD_STRIP,renderGridSize[0]*2,GL_UNSIGNED_INT,indexPtr);
 	GLVertexArrayParts::disable(Vertex::getPartsMask());
 	
+	if(upsamplingFactor>1)
+		{
+		/* Restore the bathymetry texture's sampling parameters for the water simulation: */
+		for(int i=0;i<4;++i)
+			glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,bathymetryParameterNames[i],bathymetryParameters[i]);
+		}
+	
 	/* Unbind all textures and buffers: */
 	glBindBufferARB(GL_ARRAY_BUFFER_ARB,0);
 	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB,0);
@@ -36,6 +36,9 @@ class WaterTable2;
 class WaterRenderer:public GLObject
 	{
 	/* Embedded classes: */
+	public:
+	static const unsigned int maxUpsamplingFactor=8; // Maximum number of rendered vertices per water level grid cell along each axis
+	
 	private:
 	typedef GLGeometry::Vertex<void,0,void,0,void,GLfloat,2> Vertex; // Type for template vertices
 	
@@ -61,18 +64,21 @@ class WaterRenderer:public GLObject
 	const WaterTable2* waterTable; // Water table whose water surface is rendered
 	unsigned int bathymetryGridSize[2]; // Size of vertex-centered bathymetry grid
 	unsigned int waterGridSize[2]; // Size of cell-centered water level grid; one cell larger than bathymetry grid
+	unsigned int upsamplingFactor; // Number of rendered vertices per water level grid cell along each axis; water level is interpolated from the surrounding wet cells if larger than one
+	unsigned int renderGridSize[2]; // Size of the rendered vertex grid
 	GLfloat cellSize[2]; // Cell size of the bathymetry and water level grids in world coordinate units
 	PTransform gridTransform; // Vertex transformation from grid space to world space
 	PTransform tangentGridTransform; // Transposed tangent plane transformation from grid space to world space
 	
 	/* Constructors and destructors: */
 	public:
-	WaterRenderer(const WaterTable2* sWaterTable); // Creates a water renderer for the given water table
+	WaterRenderer(const WaterTable2* sWaterTable,unsigned int sUpsamplingFactor); // Creates a water renderer for the given water table, rendering the given number of vertices per water level grid cell along each axis, clamped to between 1 and maxUpsamplingFactor
 	
 	/* Methods from GLObject: */
 	virtual void initContext(GLContextData& contextData) const;
 	
 	/* New methods: */
+	static bool parseUpsamplingFactor(const char* string,unsigned int& upsamplingFactor); // Sets the given upsampling factor from the given decimal string; returns false if the string is not a number between 1 and maxUpsamplingFactor
 	void render(const PTransform& projection,const OGTransform& modelview,GLContextData& contextData) const; // Renders the water surface
 	};
 
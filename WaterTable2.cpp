@@ -33,16 +33,20 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <GL/Extensions/GLARBDrawBuffers.h>
 #include <GL/Extensions/GLARBFragmentShader.h>
 #include <GL/Extensions/GLARBMultitexture.h>
+#include <GL/Extensions/GLARBPixelBufferObject.h>
 #include <GL/Extensions/GLARBShaderObjects.h>
 #include <GL/Extensions/GLARBTextureFloat.h>
 #include <GL/Extensions/GLARBTextureRectangle.h>
 #include <GL/Extensions/GLARBTextureRg.h>
+#include <GL/Extensions/GLARBVertexBufferObject.h>
 #include <GL/Extensions/GLARBVertexShader.h>
 #include <GL/Extensions/GLEXTFramebufferObject.h>
+#include <GL/Extensions/GLEXTPackedDepthStencil.h>
 #include <GL/GLContextData.h>
 #include <GL/GLTransformationWrappers.h>
 
 #include "DepthImageRenderer.h"
+#include "CPUWaterSolver.h"
 #include "ShaderHelper.h"
 
 // DEBUGGING
@@ -82,27 +86,40 @@ Methods of class WaterTable2::DataItem:
 WaterTable2::DataItem::DataItem(void)
 	:currentBathymetry(0),bathymetryVersion(0),currentQuantity(0),
 	 derivativeTextureObject(0),waterTextureObject(0),
-	 bathymetryFramebufferObject(0),derivativeFramebufferObject(0),maxStepSizeFramebufferObject(0),integrationFramebufferObject(0),waterFramebufferObject(0),
-	 bathymetryShader(0),waterAdaptShader(0),derivativeShader(0),maxStepSizeShader(0),boundaryShader(0),eulerStepShader(0),rungeKuttaStepShader(0),waterAddShader(0),waterShader(0)
+	 currentStepState(0),numStepStateReads(0),estimatedStepSize(0.0f),laggedRemainingTime(0.0f),
+	 bathymetryFramebufferObject(0),derivativeFramebufferObject(0),maxStepSizeFramebufferObject(0),integrationFramebufferObject(0),waterFramebufferObject(0),stepStateFramebufferObject(0),
+	 wetTileRowTextureObject(0),currentActiveTiles(0),skippingDryTiles(false),tileStencilRenderbufferObject(0),wetTileRowFramebufferObject(0),activeTileFramebufferObject(0),
+	 bathymetryShader(0),waterAdaptShader(0),derivativeShader(0),maxStepSizeShader(0),boundaryShader(0),eulerStepShader(0),rungeKuttaStepShader(0),waterAddShader(0),waterShader(0),
+	 stepSizeShader(0),deferredEulerStepShader(0),deferredRungeKuttaStepShader(0),deferredWaterShader(0),
+	 wetTileShader(0),activeTileShader(0),tileStencilShader(0),tileSyncShader(0),
+	 cpuSolver(0),cpuQuantityVersion(0)
 	{
 	for(int i=0;i<2;++i)
 		{
 		bathymetryTextureObjects[i]=0;
 		maxStepSizeTextureObjects[i]=0;
+		stepStateTextureObjects[i]=0;
+		activeTileTextureObjects[i]=0;
 		}
 	for(int i=0;i<3;++i)
+		{
 		quantityTextureObjects[i]=0;
+		stepStateBufferObjects[i]=0;
+		}
 	
 	/* Initialize all required OpenGL extensions: */
 	GLARBDrawBuffers::initExtension();
 	GLARBFragmentShader::initExtension();
 	GLARBMultitexture::initExtension();
+	GLARBPixelBufferObject::initExtension();
 	GLARBShaderObjects::initExtension();
 	GLARBTextureFloat::initExtension();
 	GLARBTextureRectangle::initExtension();
 	GLARBTextureRg::initExtension();
+	GLARBVertexBufferObject::initExtension();
 	GLARBVertexShader::initExtension();
 	GLEXTFramebufferObject::initExtension();
+	GLEXTPackedDepthStencil::initExtension();
 	}
 
 WaterTable2::DataItem::~DataItem(void)
@@ -113,11 +130,19 @@ WaterTable2::DataItem::~DataItem(void)
 	glDeleteTextures(1,&derivativeTextureObject);
 	glDeleteTextures(2,maxStepSizeTextureObjects);
 	glDeleteTextures(1,&waterTextureObject);
+	glDeleteTextures(2,stepStateTextureObjects);
+	glDeleteTextures(1,&wetTileRowTextureObject);
+	glDeleteTextures(2,activeTileTextureObjects);
+	glDeleteBuffersARB(3,stepStateBufferObjects);
+	glDeleteRenderbuffersEXT(1,&tileStencilRenderbufferObject);
 	glDeleteFramebuffersEXT(1,&bathymetryFramebufferObject);
 	glDeleteFramebuffersEXT(1,&derivativeFramebufferObject);
 	glDeleteFramebuffersEXT(1,&maxStepSizeFramebufferObject);
 	glDeleteFramebuffersEXT(1,&integrationFramebufferObject);
 	glDeleteFramebuffersEXT(1,&waterFramebufferObject);
+	glDeleteFramebuffersEXT(1,&stepStateFramebufferObject);
+	glDeleteFramebuffersEXT(1,&wetTileRowFramebufferObject);
+	glDeleteFramebuffersEXT(1,&activeTileFramebufferObject);
 	glDeleteObjectARB(bathymetryShader);
 	glDeleteObjectARB(waterAdaptShader);
 	glDeleteObjectARB(derivativeShader);
@@ -127,6 +152,17 @@ WaterTable2::DataItem::~DataItem(void)
 	glDeleteObjectARB(rungeKuttaStepShader);
 	glDeleteObjectARB(waterAddShader);
 	glDeleteObjectARB(waterShader);
+	glDeleteObjectARB(stepSizeShader);
+	glDeleteObjectARB(deferredEulerStepShader);
+	glDeleteObjectARB(deferredRungeKuttaStepShader);
+	glDeleteObjectARB(deferredWaterShader);
+	glDeleteObjectARB(wetTileShader);
+	glDeleteObjectARB(activeTileShader);
+	glDeleteObjectARB(tileStencilShader);
+	glDeleteObjectARB(tileSyncShader);
+	
+	/* Shut down the CPU-side simulator: */
+	delete cpuSolver;
 	}
 
 /****************************
@@ -197,6 +233,49 @@ void WaterTable2::calcTransformations(void)
 			*wttmPtr=GLfloat(wttm(i,j));
 	}
 
+int WaterTable2::reduceMaxStepSize(WaterTable2::DataItem* dataItem) const
+	{
+	/* Set up the maximum step size reduction shader: */
+	glUseProgramObjectARB(dataItem->maxStepSizeShader);
+	
+	/* Bind the maximum step size computation frame buffer: */
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->maxStepSizeFramebufferObject);
+	
+	/* Reduce the maximum step size texture in a sequence of half-reduction steps: */
+	int reducedWidth=size[0];
+	int reducedHeight=size[1];
+	int currentMaxStepSizeTexture=0;
+	while(reducedWidth>1||reducedHeight>1)
+		{
+		/* Set up the simulation frame buffer for maximum step size reduction: */
+		glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-currentMaxStepSizeTexture));
+		
+		/* Reduce the viewport by a factor of two: */
+		glViewport(0,0,(reducedWidth+1)/2,(reducedHeight+1)/2);
+		glUniformARB(dataItem->maxStepSizeShaderUniformLocations[0],GLfloat(reducedWidth-1),GLfloat(reducedHeight-1));
+		
+		/* Bind the current max step size texture: */
+		glActiveTextureARB(GL_TEXTURE0_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->maxStepSizeTextureObjects[currentMaxStepSizeTexture]);
+		glUniform1iARB(dataItem->maxStepSizeShaderUniformLocations[1],0);
+		
+		/* Run the reduction step: */
+		glBegin(GL_QUADS);
+		glVertex2i(0,0);
+		glVertex2i(size[0],0);
+		glVertex2i(size[0],size[1]);
+		glVertex2i(0,size[1]);
+		glEnd();
+		
+		/* Go to the next step: */
+		reducedWidth=(reducedWidth+1)/2;
+		reducedHeight=(reducedHeight+1)/2;
+		currentMaxStepSizeTexture=1-currentMaxStepSizeTexture;
+		}
+	
+	return currentMaxStepSizeTexture;
+	}
+
 GLfloat WaterTable2::calcDerivative(WaterTable2::DataItem* dataItem,GLuint quantityTextureObject,bool calcMaxStepSize) const
 	{
 	/*********************************************************************
@@ -242,45 +321,10 @@ GLfloat WaterTable2::calcDerivative(WaterTable2::DataItem* dataItem,GLuint quant
 	
 	if(calcMaxStepSize)
 		{
-		/* Set up the maximum step size reduction shader: */
-		glUseProgramObjectARB(dataItem->maxStepSizeShader);
-		
-		/* Bind the maximum step size computation frame buffer: */
-		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->maxStepSizeFramebufferObject);
+		/* Reduce the maximum step size texture: */
+		int currentMaxStepSizeTexture=reduceMaxStepSize(dataItem);
 		
-		/* Reduce the maximum step size texture in a sequence of half-reduction steps: */
-		int reducedWidth=size[0];
-		int reducedHeight=size[1];
-		int currentMaxStepSizeTexture=0;
-		while(reducedWidth>1||reducedHeight>1)
-			{
-			/* Set up the simulation frame buffer for maximum step size reduction: */
-			glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-currentMaxStepSizeTexture));
-			
-			/* Reduce the viewport by a factor of two: */
-			glViewport(0,0,(reducedWidth+1)/2,(reducedHeight+1)/2);
-			glUniformARB(dataItem->maxStepSizeShaderUniformLocations[0],GLfloat(reducedWidth-1),GLfloat(reducedHeight-1));
-			
-			/* Bind the current max step size texture: */
-			glActiveTextureARB(GL_TEXTURE0_ARB);
-			glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->maxStepSizeTextureObjects[currentMaxStepSizeTexture]);
-			glUniform1iARB(dataItem->maxStepSizeShaderUniformLocations[1],0);
-			
-			/* Run the reduction step: */
-			glBegin(GL_QUADS);
-			glVertex2i(0,0);
-			glVertex2i(size[0],0);
-			glVertex2i(size[0],size[1]);
-			glVertex2i(0,size[1]);
-			glEnd();
-			
-			/* Go to the next step: */
-			reducedWidth=(reducedWidth+1)/2;
-			reducedHeight=(reducedHeight+1)/2;
-			currentMaxStepSizeTexture=1-currentMaxStepSizeTexture;
-			}
-		
-		/* Read the final value written into the last reduced 1x1 frame buffer: */
+		/* Read the final value written into the last reduced 1x1 frame buffer, which waits for the GPU to finish all pending work: */
 		glReadBuffer(GL_COLOR_ATTACHMENT0_EXT+currentMaxStepSizeTexture);
 		glReadPixels(0,0,1,1,GL_LUMINANCE,GL_FLOAT,&stepSize);
 		
@@ -291,14 +335,433 @@ GLfloat WaterTable2::calcDerivative(WaterTable2::DataItem* dataItem,GLuint quant
 	return stepSize;
 	}
 
+void WaterTable2::activateAllTiles(WaterTable2::DataItem* dataItem) const
+	{
+	/* Save OpenGL state: */
+	GLfloat currentClearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE,currentClearColor);
+	
+	/* Clear the most recent active tile texture: */
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->activeTileFramebufferObject);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+dataItem->currentActiveTiles);
+	glClearColor(1.0f,0.0f,0.0f,0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	
+	/* Restore OpenGL state: */
+	glClearColor(currentClearColor[0],currentClearColor[1],currentClearColor[2],currentClearColor[3]);
+	}
+
+void WaterTable2::updateActiveTiles(WaterTable2::DataItem* dataItem,bool waterRendered) const
+	{
+	/* Synchronize all skipped tiles if the previous simulation step did not skip dry tiles, or if the quantities were replaced since: */
+	if(!dataItem->skippingDryTiles)
+		{
+		activateAllTiles(dataItem);
+		dataItem->skippingDryTiles=true;
+		}
+	
+	/* Keep the previous simulation step's active tiles for comparison: */
+	dataItem->currentActiveTiles=1-dataItem->currentActiveTiles;
+	glDisable(GL_STENCIL_TEST);
+	
+	if(waterDeposit>0.0f)
+		{
+		/* Water deposited everywhere wets all tiles: */
+		activateAllTiles(dataItem);
+		}
+	else
+		{
+		/*******************************************************************
+		Flag the tiles holding or receiving water one row of cells at a
+		time, and then activate every tile for which any row of it or of
+		its eight neighbors is flagged. All flags stay on the GPU.
+		*******************************************************************/
+		
+		/* Set up the wet tile row frame buffer: */
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->wetTileRowFramebufferObject);
+		glViewport(0,0,numTiles[0],size[1]);
+		
+		/* Set up the wet tile flagging shader: */
+		glUseProgramObjectARB(dataItem->wetTileShader);
+		glUniformARB(dataItem->wetTileShaderUniformLocations[0],GLfloat(CPUWaterSolver::tileSize));
+		glUniformARB(dataItem->wetTileShaderUniformLocations[1],GLfloat(size[0]));
+		glUniform1iARB(dataItem->wetTileShaderUniformLocations[2],waterRendered?1:0);
+		glActiveTextureARB(GL_TEXTURE0_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[dataItem->currentBathymetry]);
+		glUniform1iARB(dataItem->wetTileShaderUniformLocations[3],0);
+		glActiveTextureARB(GL_TEXTURE1_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
+		glUniform1iARB(dataItem->wetTileShaderUniformLocations[4],1);
+		glActiveTextureARB(GL_TEXTURE2_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->waterTextureObject);
+		glUniform1iARB(dataItem->wetTileShaderUniformLocations[5],2);
+		
+		/* Flag the wet tiles in each row of cells: */
+		glBegin(GL_QUADS);
+		glVertex2i(0,0);
+		glVertex2i(size[0],0);
+		glVertex2i(size[0],size[1]);
+		glVertex2i(0,size[1]);
+		glEnd();
+		
+		/* Set up the active tile frame buffer: */
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->activeTileFramebufferObject);
+		glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+dataItem->currentActiveTiles);
+		glViewport(0,0,numTiles[0],numTiles[1]);
+		
+		/* Set up the tile activation shader: */
+		glUseProgramObjectARB(dataItem->activeTileShader);
+		glUniformARB(dataItem->activeTileShaderUniformLocations[0],GLfloat(CPUWaterSolver::tileSize));
+		glActiveTextureARB(GL_TEXTURE0_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->wetTileRowTextureObject);
+		glUniform1iARB(dataItem->activeTileShaderUniformLocations[1],0);
+		
+		/* Activate the tiles: */
+		glBegin(GL_QUADS);
+		glVertex2i(0,0);
+		glVertex2i(size[0],0);
+		glVertex2i(size[0],size[1]);
+		glVertex2i(0,size[1]);
+		glEnd();
+		}
+	
+	/*********************************************************************
+	Mark the cells of the most recent active tiles in stencil bit 0, and
+	those of the previous step's active tiles in stencil bit 1.
+	*********************************************************************/
+	
+	/* Set up the integration frame buffer, which shares the stencil buffer with the temporal derivative frame buffer, without any color buffers: */
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
+	glDrawBuffer(GL_NONE);
+	glViewport(0,0,size[0],size[1]);
+	glStencilMask(0x3U);
+	glClearStencil(0);
+	glClear(GL_STENCIL_BUFFER_BIT);
+	
+	/* Set up the active tile stencil shader: */
+	glUseProgramObjectARB(dataItem->tileStencilShader);
+	glUniformARB(dataItem->tileStencilShaderUniformLocations[0],GLfloat(CPUWaterSolver::tileSize));
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glUniform1iARB(dataItem->tileStencilShaderUniformLocations[1],0);
+	
+	/* Mark the cells of both sets of active tiles: */
+	glEnable(GL_STENCIL_TEST);
+	glStencilOp(GL_KEEP,GL_KEEP,GL_REPLACE);
+	for(int i=0;i<2;++i)
+		{
+		glStencilFunc(GL_ALWAYS,1<<i,0x3U);
+		glStencilMask(1U<<i);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->activeTileTextureObjects[i==0?dataItem->currentActiveTiles:1-dataItem->currentActiveTiles]);
+		glBegin(GL_QUADS);
+		glVertex2i(0,0);
+		glVertex2i(size[0],0);
+		glVertex2i(size[0],size[1]);
+		glVertex2i(0,size[1]);
+		glEnd();
+		}
+	glStencilOp(GL_KEEP,GL_KEEP,GL_KEEP);
+	glStencilMask(0x0U);
+	
+	/*********************************************************************
+	Copy the most recent conserved quantities of the tiles deactivated by
+	this step into the other quantity and the intermediate quantity
+	textures, so that all three hold the same quantities while the tiles
+	are skipped.
+	*********************************************************************/
+	
+	GLenum syncDrawBuffers[2]={GLenum(GL_COLOR_ATTACHMENT0_EXT+(1-dataItem->currentQuantity)),GLenum(GL_COLOR_ATTACHMENT0_EXT+2)};
+	glDrawBuffersARB(2,syncDrawBuffers);
+	glStencilFunc(GL_EQUAL,0x2,0x3U);
+	glUseProgramObjectARB(dataItem->tileSyncShader);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
+	glUniform1iARB(dataItem->tileSyncShaderUniformLocations[0],0);
+	glBegin(GL_QUADS);
+	glVertex2i(0,0);
+	glVertex2i(size[0],0);
+	glVertex2i(size[0],size[1]);
+	glVertex2i(0,size[1]);
+	glEnd();
+	
+	/* Reset the maximum step sizes of all cells, as skipped cells do not write theirs: */
+	GLfloat currentClearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE,currentClearColor);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->maxStepSizeFramebufferObject);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+	glClearColor(10000.0f,0.0f,0.0f,0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glClearColor(currentClearColor[0],currentClearColor[1],currentClearColor[2],currentClearColor[3]);
+	
+	/* Restrict the following simulation passes to the cells of the most recent active tiles: */
+	glStencilFunc(GL_EQUAL,0x1,0x1U);
+	}
+
+void WaterTable2::integrate(WaterTable2::DataItem* dataItem,GLfloat stepSize,bool deferredStepSize,bool waterRendered,GLContextData& contextData) const
+	{
+	/* Bind the GPU-side step size state to the highest texture unit used by any of the following shaders: */
+	if(deferredStepSize)
+		{
+		glActiveTextureARB(GL_TEXTURE3_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->stepStateTextureObjects[dataItem->currentStepState]);
+		}
+	
+	/*********************************************************************
+	Step 2: Perform the tentative Euler integration step.
+	*********************************************************************/
+	
+	/* Set up the Euler step integration frame buffer: */
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+2);
+	glViewport(0,0,size[0],size[1]);
+	
+	/* Set up the Euler integration step shader: */
+	if(deferredStepSize)
+		{
+		glUseProgramObjectARB(dataItem->deferredEulerStepShader);
+		glUniformARB(dataItem->deferredEulerStepShaderUniformLocations[0],attenuation);
+		glUniform1iARB(dataItem->deferredEulerStepShaderUniformLocations[3],3);
+		}
+	else
+		{
+		glUseProgramObjectARB(dataItem->eulerStepShader);
+		glUniformARB(dataItem->eulerStepShaderUniformLocations[0],stepSize);
+		glUniformARB(dataItem->eulerStepShaderUniformLocations[1],Math::pow(attenuation,stepSize));
+		}
+	const GLint* eulerSamplerLocations=deferredStepSize?dataItem->deferredEulerStepShaderUniformLocations+1:dataItem->eulerStepShaderUniformLocations+2;
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
+	glUniform1iARB(eulerSamplerLocations[0],0);
+	glActiveTextureARB(GL_TEXTURE1_ARB);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->derivativeTextureObject);
+	glUniform1iARB(eulerSamplerLocations[1],1);
+	
+	/* Run the Euler integration step: */
+	glBegin(GL_QUADS);
+	glVertex2i(0,0);
+	glVertex2i(size[0],0);
+	glVertex2i(size[0],size[1]);
+	glVertex2i(0,size[1]);
+	glEnd();
+	
+	/*********************************************************************
+	Step 3: Calculate temporal derivative of intermediate quantities.
+	*********************************************************************/
+	
+	calcDerivative(dataItem,dataItem->quantityTextureObjects[2],false);
+	
+	/*********************************************************************
+	Step 4: Perform the final Runge-Kutta integration step.
+	*********************************************************************/
+	
+	/* Set up the Runge-Kutta step integration frame buffer: */
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-dataItem->currentQuantity));
+	glViewport(0,0,size[0],size[1]);
+	
+	/* Set up the Runge-Kutta integration step shader: */
+	if(deferredStepSize)
+		{
+		glUseProgramObjectARB(dataItem->deferredRungeKuttaStepShader);
+		glUniformARB(dataItem->deferredRungeKuttaStepShaderUniformLocations[0],attenuation);
+		glUniform1iARB(dataItem->deferredRungeKuttaStepShaderUniformLocations[4],3);
+		}
+	else
+		{
+		glUseProgramObjectARB(dataItem->rungeKuttaStepShader);
+		glUniformARB(dataItem->rungeKuttaStepShaderUniformLocations[0],stepSize);
+		glUniformARB(dataItem->rungeKuttaStepShaderUniformLocations[1],Math::pow(attenuation,stepSize));
+		}
+	const GLint* rungeKuttaSamplerLocations=deferredStepSize?dataItem->deferredRungeKuttaStepShaderUniformLocations+1:dataItem->rungeKuttaStepShaderUniformLocations+2;
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
+	glUniform1iARB(rungeKuttaSamplerLocations[0],0);
+	glActiveTextureARB(GL_TEXTURE1_ARB);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[2]);
+	glUniform1iARB(rungeKuttaSamplerLocations[1],1);
+	glActiveTextureARB(GL_TEXTURE2_ARB);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->derivativeTextureObject);
+	glUniform1iARB(rungeKuttaSamplerLocations[2],2);
+	
+	/* Run the Runge-Kutta integration step: */
+	glBegin(GL_QUADS);
+	glVertex2i(0,0);
+	glVertex2i(size[0],0);
+	glVertex2i(size[0],size[1]);
+	glVertex2i(0,size[1]);
+	glEnd();
+	
+	if(dryBoundary)
+		{
+		/* Set up the boundary condition shader to enforce dry boundaries: */
+		glUseProgramObjectARB(dataItem->boundaryShader);
+		glActiveTextureARB(GL_TEXTURE0_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[dataItem->currentBathymetry]);
+		glUniform1iARB(dataItem->boundaryShaderUniformLocations[0],0);
+		
+		/* Run the boundary condition shader on the outermost layer of pixels: */
+		//glColorMask(GL_TRUE,GL_FALSE,GL_FALSE,GL_FALSE);
+		glBegin(GL_LINE_LOOP);
+		glVertex2f(0.5f,0.5f);
+		glVertex2f(GLfloat(size[0])-0.5f,0.5f);
+		glVertex2f(GLfloat(size[0])-0.5f,GLfloat(size[1])-0.5f);
+		glVertex2f(0.5f,GLfloat(size[1])-0.5f);
+		glEnd();
+		//glColorMask(GL_TRUE,GL_TRUE,GL_TRUE,GL_TRUE);
+		}
+	
+	/* Update the current quantities: */
+	dataItem->currentQuantity=1-dataItem->currentQuantity;
+	
+	if(waterDeposit!=0.0f||!renderFunctions.empty())
+		{
+		/*******************************************************************
+		Step 5: Render all water sources and sinks additively into the water
+		texture. With a GPU-side step size, render water rates and let the
+		water update shader scale them by the step size; the rates might
+		already have been rendered to find the active tiles.
+		*******************************************************************/
+		
+		GLfloat waterStepSize=deferredStepSize?1.0f:stepSize;
+		if(!waterRendered)
+			renderWaterAdders(dataItem,waterStepSize,waterDeposit*waterStepSize,contextData);
+		
+		/*******************************************************************
+		Step 6: Update the conserved quantities based on the water texture.
+		*******************************************************************/
+		
+		/* Set up the integration frame buffer to update the conserved quantities based on the water texture: */
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
+		glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-dataItem->currentQuantity));
+		glViewport(0,0,size[0],size[1]);
+		
+		/* Set up the water update shader: */
+		const GLint* waterSamplerLocations;
+		if(deferredStepSize)
+			{
+			glUseProgramObjectARB(dataItem->deferredWaterShader);
+			glUniform1iARB(dataItem->deferredWaterShaderUniformLocations[3],3);
+			waterSamplerLocations=dataItem->deferredWaterShaderUniformLocations;
+			}
+		else
+			{
+			glUseProgramObjectARB(dataItem->waterShader);
+			waterSamplerLocations=dataItem->waterShaderUniformLocations;
+			}
+		glActiveTextureARB(GL_TEXTURE0_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[dataItem->currentBathymetry]);
+		glUniform1iARB(waterSamplerLocations[0],0);
+		glActiveTextureARB(GL_TEXTURE1_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
+		glUniform1iARB(waterSamplerLocations[1],1);
+		glActiveTextureARB(GL_TEXTURE2_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->waterTextureObject);
+		glUniform1iARB(waterSamplerLocations[2],2);
+		
+		/* Run the water update: */
+		glBegin(GL_QUADS);
+		glVertex2i(0,0);
+		glVertex2i(size[0],0);
+		glVertex2i(size[0],size[1]);
+		glVertex2i(0,size[1]);
+		glEnd();
+		
+		/* Update the current quantities: */
+		dataItem->currentQuantity=1-dataItem->currentQuantity;
+		}
+	
+	if(deferredStepSize)
+		{
+		/* Unbind the GPU-side step size state: */
+		glActiveTextureARB(GL_TEXTURE3_ARB);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+		}
+	}
+
+void WaterTable2::renderWaterAdders(WaterTable2::DataItem* dataItem,GLfloat waterStepSize,GLfloat clearValue,GLContextData& contextData) const
+	{
+	/* Save OpenGL state: */
+	GLfloat currentClearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE,currentClearColor);
+	
+	/* Set up and clear the water frame buffer: */
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->waterFramebufferObject);
+	glViewport(0,0,size[0],size[1]);
+	glClearColor(clearValue,0.0f,0.0f,0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	
+	/* Enable additive rendering: */
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE,GL_ONE);
+	
+	/* Set up the water adding shader: */
+	glUseProgramObjectARB(dataItem->waterAddShader);
+	glUniformMatrix4fvARB(dataItem->waterAddShaderUniformLocations[0],1,GL_FALSE,waterAddPmvMatrix);
+	glUniform1fARB(dataItem->waterAddShaderUniformLocations[1],waterStepSize);
+	
+	/* Bind the water texture: */
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->waterTextureObject);
+	glUniform1iARB(dataItem->waterAddShaderUniformLocations[2],0);
+	
+	/* Call all render functions: */
+	for(std::vector<const AddWaterFunction*>::const_iterator rfIt=renderFunctions.begin();rfIt!=renderFunctions.end();++rfIt)
+		(**rfIt)(contextData);
+	
+	/* Restore OpenGL state: */
+	glDisable(GL_BLEND);
+	glClearColor(currentClearColor[0],currentClearColor[1],currentClearColor[2],currentClearColor[3]);
+	}
+
+const GLfloat* WaterTable2::readWaterRates(WaterTable2::DataItem* dataItem,GLContextData& contextData) const
+	{
+	/* Bail out if there is nothing to render; the CPU-side simulator adds the water deposit by itself: */
+	if(renderFunctions.empty())
+		return 0;
+	
+	/* Save relevant OpenGL state: */
+	glPushAttrib(GL_COLOR_BUFFER_BIT|GL_VIEWPORT_BIT);
+	GLint currentFrameBuffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT,&currentFrameBuffer);
+	
+	/* Render water amounts per second into the water texture: */
+	renderWaterAdders(dataItem,1.0f,0.0f,contextData);
+	
+	/* Read back the water texture: */
+	dataItem->cpuWaterRates.resize(size[0]*size[1]);
+	glReadBuffer(GL_COLOR_ATTACHMENT0_EXT);
+	glReadPixels(0,0,size[0],size[1],GL_RED,GL_FLOAT,&dataItem->cpuWaterRates[0]);
+	glReadBuffer(GL_NONE);
+	
+	/* Unbind all shaders and textures: */
+	glUseProgramObjectARB(0);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+	
+	/* Restore OpenGL state: */
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFrameBuffer);
+	glPopAttrib();
+	
+	return &dataItem->cpuWaterRates[0];
+	}
+
+void WaterTable2::updateCPUSolver(WaterTable2::DataItem* dataItem) const
+	{
+	dataItem->cpuSolver->setSchemeParameters(theta,g,epsilon);
+	dataItem->cpuSolver->setAttenuation(attenuation);
+	dataItem->cpuSolver->setMaxStepSize(maxStepSize);
+	dataItem->cpuSolver->setWaterDeposit(waterDeposit);
+	dataItem->cpuSolver->setDryBoundary(dryBoundary);
+	dataItem->cpuSolver->setSkipDryTiles(skipDryTiles);
+	}
+
 WaterTable2::WaterTable2(GLsizei width,GLsizei height,const GLfloat sCellSize[2])
 	:depthImageRenderer(0),
 	 baseTransform(ONTransform::identity),
-	 dryBoundary(true)
+	 dryBoundary(true),numCPUThreads(0),skipDryTiles(false),halfPrecision(false)
 	{
 	/* Initialize the water table size and cell size: */
 	size[0]=width;
 	size[1]=height;
+	for(int i=0;i<2;++i)
+		numTiles[i]=(size[i]+CPUWaterSolver::tileSize-1)/CPUWaterSolver::tileSize;
 	for(int i=0;i<2;++i)
 		cellSize[i]=sCellSize[i];
 	
@@ -325,11 +788,13 @@ WaterTable2::WaterTable2(GLsizei width,GLsizei height,const GLfloat sCellSize[2]
 
 WaterTable2::WaterTable2(GLsizei width,GLsizei height,const DepthImageRenderer* sDepthImageRenderer,const Point basePlaneCorners[4])
 	:depthImageRenderer(sDepthImageRenderer),
-	 dryBoundary(true)
+	 dryBoundary(true),numCPUThreads(0),skipDryTiles(false),halfPrecision(false)
 	{
 	/* Initialize the water table size: */
 	size[0]=width;
 	size[1]=height;
+	for(int i=0;i<2;++i)
+		numTiles[i]=(size[i]+CPUWaterSolver::tileSize-1)/CPUWaterSolver::tileSize;
 	
 	/* Project the corner points to the base plane and calculate their centroid: */
 	const Plane& basePlane=depthImageRenderer->getBasePlane();
@@ -423,6 +888,13 @@ void WaterTable2::initContext(GLContextData& contextData) const
 	delete[] q;
 	}
 	
+	if(numCPUThreads>0)
+		{
+		/* Create a CPU-side simulator matching the initial bathymetry and quantity textures: */
+		dataItem->cpuSolver=new CPUWaterSolver(size[0],size[1],cellSize,GLfloat(domain.min[2]),numCPUThreads);
+		dataItem->cpuQuantityVersion=dataItem->cpuSolver->getVersion();
+		}
+	
 	{
 	/* Create the cell-centered temporal derivative texture: */
 	glGenTextures(1,&dataItem->derivativeTextureObject);
@@ -432,7 +904,7 @@ void WaterTable2::initContext(GLContextData& contextData) const
 	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_S,GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_T,GL_CLAMP);
 	GLfloat* qt=makeBuffer(size[0],size[1],3,0.0,0.0,0.0);
-	glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,0,GL_RGB32F,size[0],size[1],0,GL_RGB,GL_FLOAT,qt);
+	glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,0,halfPrecision?GL_RGB16F:GL_RGB32F,size[0],size[1],0,GL_RGB,GL_FLOAT,qt);
 	delete[] qt;
 	}
 	
@@ -461,13 +933,63 @@ void WaterTable2::initContext(GLContextData& contextData) const
 	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_S,GL_CLAMP);
 	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_T,GL_CLAMP);
 	GLfloat* w=makeBuffer(size[0],size[1],1,0.0);
-	glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,0,GL_R32F,size[0],size[1],0,GL_LUMINANCE,GL_FLOAT,w);
+	glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,0,halfPrecision?GL_R16F:GL_R32F,size[0],size[1],0,GL_LUMINANCE,GL_FLOAT,w);
 	delete[] w;
 	}
 	
+	{
+	/* Create the GPU-side step size state textures: */
+	glGenTextures(2,dataItem->stepStateTextureObjects);
+	GLfloat ss[4]={0.0f,0.0f,0.0f,0.0f};
+	for(int i=0;i<2;++i)
+		{
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->stepStateTextureObjects[i]);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_S,GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_T,GL_CLAMP);
+		glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,0,GL_RGBA32F_ARB,1,1,0,GL_RGBA,GL_FLOAT,ss);
+		}
+	}
+	
+	{
+	/* Create the texture flagging the tiles holding or receiving water in each row of cells: */
+	glGenTextures(1,&dataItem->wetTileRowTextureObject);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->wetTileRowTextureObject);
+	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_S,GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_T,GL_CLAMP);
+	GLfloat* wtr=makeBuffer(numTiles[0],size[1],1,1.0);
+	glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,0,GL_R8,numTiles[0],size[1],0,GL_LUMINANCE,GL_FLOAT,wtr);
+	delete[] wtr;
+	}
+	
+	{
+	/* Create the active tile textures, with all tiles initially active: */
+	glGenTextures(2,dataItem->activeTileTextureObjects);
+	GLfloat* at=makeBuffer(numTiles[0],numTiles[1],1,1.0);
+	for(int i=0;i<2;++i)
+		{
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->activeTileTextureObjects[i]);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_S,GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_RECTANGLE_ARB,GL_TEXTURE_WRAP_T,GL_CLAMP);
+		glTexImage2D(GL_TEXTURE_RECTANGLE_ARB,0,GL_R8,numTiles[0],numTiles[1],0,GL_LUMINANCE,GL_FLOAT,at);
+		}
+	delete[] at;
+	}
+	
 	/* Protect the newly-created textures: */
 	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
 	
+	/* Create the stencil buffer marking the cells of active tiles; only its stencil component is attached, so depth testing never applies to simulation passes: */
+	glGenRenderbuffersEXT(1,&dataItem->tileStencilRenderbufferObject);
+	glBindRenderbufferEXT(GL_RENDERBUFFER_EXT,dataItem->tileStencilRenderbufferObject);
+	glRenderbufferStorageEXT(GL_RENDERBUFFER_EXT,GL_DEPTH24_STENCIL8_EXT,size[0],size[1]);
+	glBindRenderbufferEXT(GL_RENDERBUFFER_EXT,0);
+	
 	/* Save the currently bound frame buffer: */
 	GLint currentFrameBuffer;
 	glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT,&currentFrameBuffer);
@@ -495,6 +1017,9 @@ void WaterTable2::initContext(GLContextData& contextData) const
 	GLenum drawBuffers[2]={GL_COLOR_ATTACHMENT0_EXT,GL_COLOR_ATTACHMENT1_EXT};
 	glDrawBuffersARB(2,drawBuffers);
 	glReadBuffer(GL_NONE);
+	
+	/* Attach the active tile stencil buffer: */
+	glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,GL_STENCIL_ATTACHMENT_EXT,GL_RENDERBUFFER_EXT,dataItem->tileStencilRenderbufferObject);
 	}
 	
 	{
@@ -514,9 +1039,10 @@ void WaterTable2::initContext(GLContextData& contextData) const
 	glGenFramebuffersEXT(1,&dataItem->integrationFramebufferObject);
 	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
 	
-	/* Attach the quantity textures to the integration step frame buffer: */
+	/* Attach the quantity textures and the active tile stencil buffer to the integration step frame buffer: */
 	for(int i=0;i<3;++i)
 		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,GL_COLOR_ATTACHMENT0_EXT+i,GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[i],0);
+	glFramebufferRenderbufferEXT(GL_FRAMEBUFFER_EXT,GL_STENCIL_ATTACHMENT_EXT,GL_RENDERBUFFER_EXT,dataItem->tileStencilRenderbufferObject);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
 	}
@@ -532,9 +1058,53 @@ void WaterTable2::initContext(GLContextData& contextData) const
 	glReadBuffer(GL_NONE);
 	}
 	
+	{
+	/* Create the step size state frame buffer: */
+	glGenFramebuffersEXT(1,&dataItem->stepStateFramebufferObject);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->stepStateFramebufferObject);
+	
+	/* Attach the step size state textures to the step size state frame buffer: */
+	for(int i=0;i<2;++i)
+		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,GL_COLOR_ATTACHMENT0_EXT+i,GL_TEXTURE_RECTANGLE_ARB,dataItem->stepStateTextureObjects[i],0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	}
+	
+	{
+	/* Create the wet tile row frame buffer: */
+	glGenFramebuffersEXT(1,&dataItem->wetTileRowFramebufferObject);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->wetTileRowFramebufferObject);
+	
+	/* Attach the wet tile row texture to the wet tile row frame buffer: */
+	glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,GL_COLOR_ATTACHMENT0_EXT,GL_TEXTURE_RECTANGLE_ARB,dataItem->wetTileRowTextureObject,0);
+	glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT);
+	glReadBuffer(GL_NONE);
+	}
+	
+	{
+	/* Create the active tile frame buffer: */
+	glGenFramebuffersEXT(1,&dataItem->activeTileFramebufferObject);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->activeTileFramebufferObject);
+	
+	/* Attach the active tile textures to the active tile frame buffer: */
+	for(int i=0;i<2;++i)
+		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,GL_COLOR_ATTACHMENT0_EXT+i,GL_TEXTURE_RECTANGLE_ARB,dataItem->activeTileTextureObjects[i],0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	}
+	
 	/* Restore the previously bound frame buffer: */
 	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFrameBuffer);
 	
+	/* Create the pixel buffer objects to read back step size states without stalling: */
+	glGenBuffersARB(3,dataItem->stepStateBufferObjects);
+	for(int i=0;i<3;++i)
+		{
+		glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,dataItem->stepStateBufferObjects[i]);
+		glBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB,4*sizeof(GLfloat),0,GL_STREAM_READ_ARB);
+		}
+	glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,0);
+	
 	/* Create a simple vertex shader to render quads in pixel space: */
 	static const char* vertexShaderSourceTemplate="void main(){gl_Position=vec4(gl_Vertex.x*%f-1.0,gl_Vertex.y*%f-1.0,0.0,1.0);}";
 	char vertexShaderSource[256];
@@ -578,76 +1148,176 @@ void WaterTable2::initContext(GLContextData& contextData) const
 	dataItem->derivativeShaderUniformLocations[5]=glGetUniformLocationARB(dataItem->derivativeShader,"quantitySampler");
 	}
 	
-	/* Create the maximum step size gathering shader: */
+	/* Create the maximum step size gathering shader: */
+	{
+	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2MaxStepSizeShader");
+	dataItem->maxStepSizeShader=glLinkShader(vertexShader,fragmentShader);
+	glDeleteObjectARB(vertexShader);
+	glDeleteObjectARB(fragmentShader);
+	dataItem->maxStepSizeShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->maxStepSizeShader,"fullTextureSize");
+	dataItem->maxStepSizeShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->maxStepSizeShader,"maxStepSizeSampler");
+	}
+	
+	/* Create the boundary condition shader: */
+	{
+	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2BoundaryShader");
+	dataItem->boundaryShader=glLinkShader(vertexShader,fragmentShader);
+	glDeleteObjectARB(vertexShader);
+	glDeleteObjectARB(fragmentShader);
+	dataItem->boundaryShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->boundaryShader,"bathymetrySampler");
+	}
+	
+	/* Create the Euler integration step shader: */
+	{
+	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2EulerStepShader");
+	dataItem->eulerStepShader=glLinkShader(vertexShader,fragmentShader);
+	glDeleteObjectARB(vertexShader);
+	glDeleteObjectARB(fragmentShader);
+	dataItem->eulerStepShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->eulerStepShader,"stepSize");
+	dataItem->eulerStepShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->eulerStepShader,"attenuation");
+	dataItem->eulerStepShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->eulerStepShader,"quantitySampler");
+	dataItem->eulerStepShaderUniformLocations[3]=glGetUniformLocationARB(dataItem->eulerStepShader,"derivativeSampler");
+	}
+	
+	/* Create the Runge-Kutta integration step shader: */
+	{
+	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2RungeKuttaStepShader");
+	dataItem->rungeKuttaStepShader=glLinkShader(vertexShader,fragmentShader);
+	glDeleteObjectARB(vertexShader);
+	glDeleteObjectARB(fragmentShader);
+	dataItem->rungeKuttaStepShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"stepSize");
+	dataItem->rungeKuttaStepShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"attenuation");
+	dataItem->rungeKuttaStepShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"quantitySampler");
+	dataItem->rungeKuttaStepShaderUniformLocations[3]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"quantityStarSampler");
+	dataItem->rungeKuttaStepShaderUniformLocations[4]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"derivativeSampler");
+	}
+	
+	/* Create the water adder rendering shader: */
+	{
+	GLhandleARB vertexShader=compileVertexShader("Water2WaterAddShader");
+	GLhandleARB fragmentShader=compileFragmentShader("Water2WaterAddShader");
+	dataItem->waterAddShader=glLinkShader(vertexShader,fragmentShader);
+	glDeleteObjectARB(vertexShader);
+	glDeleteObjectARB(fragmentShader);
+	dataItem->waterAddShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->waterAddShader,"pmv");
+	dataItem->waterAddShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->waterAddShader,"stepSize");
+	dataItem->waterAddShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->waterAddShader,"waterSampler");
+	}
+	
+	/* Create the water shader: */
+	{
+	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2WaterUpdateShader");
+	dataItem->waterShader=glLinkShader(vertexShader,fragmentShader);
+	glDeleteObjectARB(vertexShader);
+	glDeleteObjectARB(fragmentShader);
+	dataItem->waterShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->waterShader,"bathymetrySampler");
+	dataItem->waterShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->waterShader,"quantitySampler");
+	dataItem->waterShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->waterShader,"waterSampler");
+	}
+	
+	/* Create the step size state update shader: */
+	{
+	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2StepSizeShader");
+	dataItem->stepSizeShader=glLinkShader(vertexShader,fragmentShader);
+	glDeleteObjectARB(vertexShader);
+	glDeleteObjectARB(fragmentShader);
+	dataItem->stepSizeShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->stepSizeShader,"maxStepSize");
+	dataItem->stepSizeShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->stepSizeShader,"frameTime");
+	dataItem->stepSizeShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->stepSizeShader,"maxStepSizeSampler");
+	dataItem->stepSizeShaderUniformLocations[3]=glGetUniformLocationARB(dataItem->stepSizeShader,"stepStateSampler");
+	}
+	
+	/* Create the Euler integration step shader using the GPU-side step size: */
+	{
+	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2DeferredEulerStepShader");
+	dataItem->deferredEulerStepShader=glLinkShader(vertexShader,fragmentShader);
+	glDeleteObjectARB(vertexShader);
+	glDeleteObjectARB(fragmentShader);
+	dataItem->deferredEulerStepShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->deferredEulerStepShader,"attenuation");
+	dataItem->deferredEulerStepShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->deferredEulerStepShader,"quantitySampler");
+	dataItem->deferredEulerStepShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->deferredEulerStepShader,"derivativeSampler");
+	dataItem->deferredEulerStepShaderUniformLocations[3]=glGetUniformLocationARB(dataItem->deferredEulerStepShader,"stepStateSampler");
+	}
+	
+	/* Create the Runge-Kutta integration step shader using the GPU-side step size: */
 	{
 	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
-	GLhandleARB fragmentShader=compileFragmentShader("Water2MaxStepSizeShader");
-	dataItem->maxStepSizeShader=glLinkShader(vertexShader,fragmentShader);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2DeferredRungeKuttaStepShader");
+	dataItem->deferredRungeKuttaStepShader=glLinkShader(vertexShader,fragmentShader);
 	glDeleteObjectARB(vertexShader);
 	glDeleteObjectARB(fragmentShader);
-	dataItem->maxStepSizeShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->maxStepSizeShader,"fullTextureSize");
-	dataItem->maxStepSizeShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->maxStepSizeShader,"maxStepSizeSampler");
+	dataItem->deferredRungeKuttaStepShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->deferredRungeKuttaStepShader,"attenuation");
+	dataItem->deferredRungeKuttaStepShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->deferredRungeKuttaStepShader,"quantitySampler");
+	dataItem->deferredRungeKuttaStepShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->deferredRungeKuttaStepShader,"quantityStarSampler");
+	dataItem->deferredRungeKuttaStepShaderUniformLocations[3]=glGetUniformLocationARB(dataItem->deferredRungeKuttaStepShader,"derivativeSampler");
+	dataItem->deferredRungeKuttaStepShaderUniformLocations[4]=glGetUniformLocationARB(dataItem->deferredRungeKuttaStepShader,"stepStateSampler");
 	}
 	
-	/* Create the boundary condition shader: */
+	/* Create the water shader using the GPU-side step size: */
 	{
 	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
-	GLhandleARB fragmentShader=compileFragmentShader("Water2BoundaryShader");
-	dataItem->boundaryShader=glLinkShader(vertexShader,fragmentShader);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2DeferredWaterUpdateShader");
+	dataItem->deferredWaterShader=glLinkShader(vertexShader,fragmentShader);
 	glDeleteObjectARB(vertexShader);
 	glDeleteObjectARB(fragmentShader);
-	dataItem->boundaryShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->boundaryShader,"bathymetrySampler");
+	dataItem->deferredWaterShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->deferredWaterShader,"bathymetrySampler");
+	dataItem->deferredWaterShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->deferredWaterShader,"quantitySampler");
+	dataItem->deferredWaterShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->deferredWaterShader,"waterSampler");
+	dataItem->deferredWaterShaderUniformLocations[3]=glGetUniformLocationARB(dataItem->deferredWaterShader,"stepStateSampler");
 	}
 	
-	/* Create the Euler integration step shader: */
+	/* Create the wet tile flagging shader: */
 	{
 	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
-	GLhandleARB fragmentShader=compileFragmentShader("Water2EulerStepShader");
-	dataItem->eulerStepShader=glLinkShader(vertexShader,fragmentShader);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2WetTileShader");
+	dataItem->wetTileShader=glLinkShader(vertexShader,fragmentShader);
 	glDeleteObjectARB(vertexShader);
 	glDeleteObjectARB(fragmentShader);
-	dataItem->eulerStepShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->eulerStepShader,"stepSize");
-	dataItem->eulerStepShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->eulerStepShader,"attenuation");
-	dataItem->eulerStepShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->eulerStepShader,"quantitySampler");
-	dataItem->eulerStepShaderUniformLocations[3]=glGetUniformLocationARB(dataItem->eulerStepShader,"derivativeSampler");
+	dataItem->wetTileShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->wetTileShader,"tileSize");
+	dataItem->wetTileShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->wetTileShader,"gridWidth");
+	dataItem->wetTileShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->wetTileShader,"checkWater");
+	dataItem->wetTileShaderUniformLocations[3]=glGetUniformLocationARB(dataItem->wetTileShader,"bathymetrySampler");
+	dataItem->wetTileShaderUniformLocations[4]=glGetUniformLocationARB(dataItem->wetTileShader,"quantitySampler");
+	dataItem->wetTileShaderUniformLocations[5]=glGetUniformLocationARB(dataItem->wetTileShader,"waterSampler");
 	}
 	
-	/* Create the Runge-Kutta integration step shader: */
+	/* Create the tile activation shader: */
 	{
 	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
-	GLhandleARB fragmentShader=compileFragmentShader("Water2RungeKuttaStepShader");
-	dataItem->rungeKuttaStepShader=glLinkShader(vertexShader,fragmentShader);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2ActiveTileShader");
+	dataItem->activeTileShader=glLinkShader(vertexShader,fragmentShader);
 	glDeleteObjectARB(vertexShader);
 	glDeleteObjectARB(fragmentShader);
-	dataItem->rungeKuttaStepShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"stepSize");
-	dataItem->rungeKuttaStepShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"attenuation");
-	dataItem->rungeKuttaStepShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"quantitySampler");
-	dataItem->rungeKuttaStepShaderUniformLocations[3]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"quantityStarSampler");
-	dataItem->rungeKuttaStepShaderUniformLocations[4]=glGetUniformLocationARB(dataItem->rungeKuttaStepShader,"derivativeSampler");
+	dataItem->activeTileShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->activeTileShader,"tileSize");
+	dataItem->activeTileShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->activeTileShader,"wetTileRowSampler");
 	}
 	
-	/* Create the water adder rendering shader: */
+	/* Create the active tile stencil shader: */
 	{
-	GLhandleARB vertexShader=compileVertexShader("Water2WaterAddShader");
-	GLhandleARB fragmentShader=compileFragmentShader("Water2WaterAddShader");
-	dataItem->waterAddShader=glLinkShader(vertexShader,fragmentShader);
+	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2TileStencilShader");
+	dataItem->tileStencilShader=glLinkShader(vertexShader,fragmentShader);
 	glDeleteObjectARB(vertexShader);
 	glDeleteObjectARB(fragmentShader);
-	dataItem->waterAddShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->waterAddShader,"pmv");
-	dataItem->waterAddShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->waterAddShader,"stepSize");
-	dataItem->waterAddShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->waterAddShader,"waterSampler");
+	dataItem->tileStencilShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->tileStencilShader,"tileSize");
+	dataItem->tileStencilShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->tileStencilShader,"activeTileSampler");
 	}
 	
-	/* Create the water shader: */
+	/* Create the deactivated tile synchronization shader: */
 	{
 	GLhandleARB vertexShader=glCompileVertexShaderFromString(vertexShaderSource);
-	GLhandleARB fragmentShader=compileFragmentShader("Water2WaterUpdateShader");
-	dataItem->waterShader=glLinkShader(vertexShader,fragmentShader);
+	GLhandleARB fragmentShader=compileFragmentShader("Water2TileSyncShader");
+	dataItem->tileSyncShader=glLinkShader(vertexShader,fragmentShader);
 	glDeleteObjectARB(vertexShader);
 	glDeleteObjectARB(fragmentShader);
-	dataItem->waterShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->waterShader,"bathymetrySampler");
-	dataItem->waterShaderUniformLocations[1]=glGetUniformLocationARB(dataItem->waterShader,"quantitySampler");
-	dataItem->waterShaderUniformLocations[2]=glGetUniformLocationARB(dataItem->waterShader,"waterSampler");
+	dataItem->tileSyncShaderUniformLocations[0]=glGetUniformLocationARB(dataItem->tileSyncShader,"quantitySampler");
 	}
 	}
 
@@ -699,6 +1369,26 @@ void WaterTable2::setDryBoundary(bool newDryBoundary)
 	dryBoundary=newDryBoundary;
 	}
 
+bool WaterTable2::parseNumCPUThreads(const char* string,unsigned int& numCPUThreads)
+	{
+	return WorkerPool::parseNumWorkers(string,0,numCPUThreads);
+	}
+
+void WaterTable2::setNumCPUThreads(unsigned int newNumCPUThreads)
+	{
+	numCPUThreads=newNumCPUThreads<=maxNumCPUThreads?newNumCPUThreads:maxNumCPUThreads;
+	}
+
+void WaterTable2::setSkipDryTiles(bool newSkipDryTiles)
+	{
+	skipDryTiles=newSkipDryTiles;
+	}
+
+void WaterTable2::setHalfPrecision(bool newHalfPrecision)
+	{
+	halfPrecision=newHalfPrecision;
+	}
+
 void WaterTable2::updateBathymetry(GLContextData& contextData) const
 	{
 	/* Get the data item: */
@@ -724,50 +1414,65 @@ void WaterTable2::updateBathymetry(GLContextData& contextData) const
 		/* Render the surface into the bathymetry grid: */
 		depthImageRenderer->renderElevation(bathymetryPmv,contextData);
 		
-		/* Set up the integration frame buffer to update the conserved quantities based on bathymetry changes: */
-		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
-		glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-dataItem->currentQuantity));
-		glViewport(0,0,size[0],size[1]);
-		
-		/* Set up the bathymetry update shader: */
-		glUseProgramObjectARB(dataItem->bathymetryShader);
-		glActiveTextureARB(GL_TEXTURE0_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[dataItem->currentBathymetry]);
-		glUniform1iARB(dataItem->bathymetryShaderUniformLocations[0],0);
-		glActiveTextureARB(GL_TEXTURE1_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[1-dataItem->currentBathymetry]);
-		glUniform1iARB(dataItem->bathymetryShaderUniformLocations[1],1);
-		
-		glActiveTextureARB(GL_TEXTURE2_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
-		glUniform1iARB(dataItem->bathymetryShaderUniformLocations[2],2);
-		
-		/* Run the bathymetry update: */
-		glBegin(GL_QUADS);
-		glVertex2i(0,0);
-		glVertex2i(size[0],0);
-		glVertex2i(size[0],size[1]);
-		glVertex2i(0,size[1]);
-		glEnd();
-		
-		/* Unbind all shaders and textures: */
-		glUseProgramObjectARB(0);
-		glActiveTextureARB(GL_TEXTURE2_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
-		glActiveTextureARB(GL_TEXTURE1_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
-		glActiveTextureARB(GL_TEXTURE0_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+		if(dataItem->cpuSolver!=0)
+			{
+			/* Read back the new bathymetry grid and update the CPU-side simulator's conserved quantities: */
+			dataItem->cpuGridBuffer.resize((size[0]-1)*(size[1]-1));
+			glReadBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-dataItem->currentBathymetry));
+			glReadPixels(0,0,size[0]-1,size[1]-1,GL_RED,GL_FLOAT,&dataItem->cpuGridBuffer[0]);
+			glReadBuffer(GL_NONE);
+			dataItem->cpuSolver->updateBathymetry(&dataItem->cpuGridBuffer[0]);
+			}
+		else
+			{
+			/* Set up the integration frame buffer to update the conserved quantities based on bathymetry changes: */
+			glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
+			glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-dataItem->currentQuantity));
+			glViewport(0,0,size[0],size[1]);
+			
+			/* Set up the bathymetry update shader: */
+			glUseProgramObjectARB(dataItem->bathymetryShader);
+			glActiveTextureARB(GL_TEXTURE0_ARB);
+			glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[dataItem->currentBathymetry]);
+			glUniform1iARB(dataItem->bathymetryShaderUniformLocations[0],0);
+			glActiveTextureARB(GL_TEXTURE1_ARB);
+			glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[1-dataItem->currentBathymetry]);
+			glUniform1iARB(dataItem->bathymetryShaderUniformLocations[1],1);
+			
+			glActiveTextureARB(GL_TEXTURE2_ARB);
+			glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
+			glUniform1iARB(dataItem->bathymetryShaderUniformLocations[2],2);
+			
+			/* Run the bathymetry update: */
+			glBegin(GL_QUADS);
+			glVertex2i(0,0);
+			glVertex2i(size[0],0);
+			glVertex2i(size[0],size[1]);
+			glVertex2i(0,size[1]);
+			glEnd();
+			
+			/* Unbind all shaders and textures: */
+			glUseProgramObjectARB(0);
+			glActiveTextureARB(GL_TEXTURE2_ARB);
+			glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+			glActiveTextureARB(GL_TEXTURE1_ARB);
+			glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+			glActiveTextureARB(GL_TEXTURE0_ARB);
+			glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+			
+			/* Update the quantity grid, which changed in all tiles: */
+			dataItem->currentQuantity=1-dataItem->currentQuantity;
+			dataItem->skippingDryTiles=false;
+			}
 		
 		/* Restore OpenGL state: */
 		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFrameBuffer);
 		glClearColor(currentClearColor[0],currentClearColor[1],currentClearColor[2],currentClearColor[3]);
 		glPopAttrib();
 		
-		/* Update the bathymetry and quantity grids: */
+		/* Update the bathymetry grid: */
 		dataItem->currentBathymetry=1-dataItem->currentBathymetry;
 		dataItem->bathymetryVersion=depthImageRenderer->getDepthImageVersion();
-		dataItem->currentQuantity=1-dataItem->currentQuantity;
 		}
 	}
 
@@ -776,6 +1481,17 @@ void WaterTable2::updateBathymetry(const GLfloat* bathymetryGrid,GLContextData&
 	/* Get the data item: */
 	DataItem* dataItem=contextData.retrieveDataItem<DataItem>(this);
 	
+	if(dataItem->cpuSolver!=0)
+		{
+		/* Upload the new bathymetry grid for rendering and update the CPU-side simulator's conserved quantities: */
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[1-dataItem->currentBathymetry]);
+		glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB,0,0,0,size[0]-1,size[1]-1,GL_LUMINANCE,GL_FLOAT,bathymetryGrid);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+		dataItem->cpuSolver->updateBathymetry(bathymetryGrid);
+		dataItem->currentBathymetry=1-dataItem->currentBathymetry;
+		return;
+		}
+	
 	/* Set up the integration frame buffer to update the conserved quantities based on bathymetry changes: */
 	glPushAttrib(GL_VIEWPORT_BIT);
 	GLint currentFrameBuffer;
@@ -821,9 +1537,10 @@ void WaterTable2::updateBathymetry(const GLfloat* bathymetryGrid,GLContextData&
 	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFrameBuffer);
 	glPopAttrib();
 
-	/* Update the bathymetry and quantity grids: */
+	/* Update the bathymetry and quantity grids; the quantities changed in all tiles: */
 	dataItem->currentBathymetry=1-dataItem->currentBathymetry;
 	dataItem->currentQuantity=1-dataItem->currentQuantity;
+	dataItem->skippingDryTiles=false;
 	}
 
 void WaterTable2::setWaterLevel(const GLfloat* waterGrid,GLContextData& contextData) const
@@ -831,6 +1548,13 @@ void WaterTable2::setWaterLevel(const GLfloat* waterGrid,GLContextData& contextD
 	/* Get the data item: */
 	DataItem* dataItem=contextData.retrieveDataItem<DataItem>(this);
 	
+	if(dataItem->cpuSolver!=0)
+		{
+		/* Let the CPU-side simulator adapt the new water level to the current bathymetry: */
+		dataItem->cpuSolver->setWaterLevel(waterGrid);
+		return;
+		}
+	
 	/* Set up the integration frame buffer to adapt the new water level to the current bathymetry: */
 	glPushAttrib(GL_VIEWPORT_BIT);
 	GLint currentFrameBuffer;
@@ -874,8 +1598,9 @@ void WaterTable2::setWaterLevel(const GLfloat* waterGrid,GLContextData& contextD
 	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFrameBuffer);
 	glPopAttrib();
 
-	/* Update the quantity grid: */
+	/* Update the quantity grid, which changed in all tiles: */
 	dataItem->currentQuantity=1-dataItem->currentQuantity;
+	dataItem->skippingDryTiles=false;
 	}
 
 GLfloat WaterTable2::runSimulationStep(bool forceStepSize,GLContextData& contextData) const
@@ -883,175 +1608,154 @@ GLfloat WaterTable2::runSimulationStep(bool forceStepSize,GLContextData& context
 	/* Get the data item: */
 	DataItem* dataItem=contextData.retrieveDataItem<DataItem>(this);
 	
+	if(dataItem->cpuSolver!=0)
+		{
+		/* Run the simulation step on the CPU: */
+		updateCPUSolver(dataItem);
+		return dataItem->cpuSolver->runSimulationStep(forceStepSize,readWaterRates(dataItem,contextData));
+		}
+	
 	/* Save relevant OpenGL state: */
-	glPushAttrib(GL_COLOR_BUFFER_BIT|GL_VIEWPORT_BIT);
+	glPushAttrib(GL_COLOR_BUFFER_BIT|GL_STENCIL_BUFFER_BIT|GL_VIEWPORT_BIT);
 	GLint currentFrameBuffer;
 	glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT,&currentFrameBuffer);
 	
+	if(skipDryTiles)
+		{
+		/* Render the water rates and find the tiles that need to be simulated: */
+		bool addWater=waterDeposit!=0.0f||!renderFunctions.empty();
+		if(addWater)
+			renderWaterAdders(dataItem,1.0f,waterDeposit,contextData);
+		updateActiveTiles(dataItem,addWater);
+		}
+	else
+		dataItem->skippingDryTiles=false;
+	
 	/*********************************************************************
 	Step 1: Calculate temporal derivative of most recent quantities.
 	*********************************************************************/
 	
 	GLfloat stepSize=calcDerivative(dataItem,dataItem->quantityTextureObjects[dataItem->currentQuantity],!forceStepSize);
 	
-	/*********************************************************************
-	Step 2: Perform the tentative Euler integration step.
-	*********************************************************************/
-	
-	/* Set up the Euler step integration frame buffer: */
-	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
-	glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+2);
-	glViewport(0,0,size[0],size[1]);
+	/* Run the remaining steps with the step size read back from the GPU, which requires rendering the water amounts for that step size: */
+	integrate(dataItem,stepSize,false,false,contextData);
 	
-	/* Set up the Euler integration step shader: */
-	glUseProgramObjectARB(dataItem->eulerStepShader);
-	glUniformARB(dataItem->eulerStepShaderUniformLocations[0],stepSize);
-	glUniformARB(dataItem->eulerStepShaderUniformLocations[1],Math::pow(attenuation,stepSize));
-	glActiveTextureARB(GL_TEXTURE0_ARB);
-	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
-	glUniform1iARB(dataItem->eulerStepShaderUniformLocations[2],0);
+	/* Unbind all shaders and textures: */
+	glUseProgramObjectARB(0);
+	glActiveTextureARB(GL_TEXTURE2_ARB);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
 	glActiveTextureARB(GL_TEXTURE1_ARB);
-	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->derivativeTextureObject);
-	glUniform1iARB(dataItem->eulerStepShaderUniformLocations[3],1);
-	
-	/* Run the Euler integration step: */
-	glBegin(GL_QUADS);
-	glVertex2i(0,0);
-	glVertex2i(size[0],0);
-	glVertex2i(size[0],size[1]);
-	glVertex2i(0,size[1]);
-	glEnd();
-	
-	/*********************************************************************
-	Step 3: Calculate temporal derivative of intermediate quantities.
-	*********************************************************************/
-	
-	calcDerivative(dataItem,dataItem->quantityTextureObjects[2],false);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+	glActiveTextureARB(GL_TEXTURE0_ARB);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
 	
-	/*********************************************************************
-	Step 4: Perform the final Runge-Kutta integration step.
-	*********************************************************************/
+	/* Restore OpenGL state: */
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFrameBuffer);
+	glPopAttrib();
 	
-	/* Set up the Runge-Kutta step integration frame buffer: */
-	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
-	glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-dataItem->currentQuantity));
-	glViewport(0,0,size[0],size[1]);
+	/* Return the Runge-Kutta step's step size: */
+	return stepSize;
+	}
+
+unsigned int WaterTable2::runSimulationSteps(GLfloat totalTimeStep,unsigned int maxNumSteps,GLContextData& contextData) const
+	{
+	/* Get the data item: */
+	DataItem* dataItem=contextData.retrieveDataItem<DataItem>(this);
 	
-	/* Set up the Runge-Kutta integration step shader: */
-	glUseProgramObjectARB(dataItem->rungeKuttaStepShader);
-	glUniformARB(dataItem->rungeKuttaStepShaderUniformLocations[0],stepSize);
-	glUniformARB(dataItem->rungeKuttaStepShaderUniformLocations[1],Math::pow(attenuation,stepSize));
-	glActiveTextureARB(GL_TEXTURE0_ARB);
-	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
-	glUniform1iARB(dataItem->rungeKuttaStepShaderUniformLocations[2],0);
-	glActiveTextureARB(GL_TEXTURE1_ARB);
-	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[2]);
-	glUniform1iARB(dataItem->rungeKuttaStepShaderUniformLocations[3],1);
-	glActiveTextureARB(GL_TEXTURE2_ARB);
-	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->derivativeTextureObject);
-	glUniform1iARB(dataItem->rungeKuttaStepShaderUniformLocations[4],2);
+	if(totalTimeStep<=0.0f||maxNumSteps==0)
+		return 0;
 	
-	/* Run the Runge-Kutta integration step: */
-	glBegin(GL_QUADS);
-	glVertex2i(0,0);
-	glVertex2i(size[0],0);
-	glVertex2i(size[0],size[1]);
-	glVertex2i(0,size[1]);
-	glEnd();
+	if(dataItem->cpuSolver!=0)
+		{
+		/* Run the simulation steps on the CPU, which knows each step size right away: */
+		updateCPUSolver(dataItem);
+		return dataItem->cpuSolver->runSimulationSteps(totalTimeStep,maxNumSteps,readWaterRates(dataItem,contextData));
+		}
 	
-	if(dryBoundary)
+	/* Estimate the number of steps needed to use up the given time and any left-over time from the step size observed a few frames ago: */
+	unsigned int numSteps=maxNumSteps;
+	if(dataItem->estimatedStepSize>0.0f)
 		{
-		/* Set up the boundary condition shader to enforce dry boundaries: */
-		glUseProgramObjectARB(dataItem->boundaryShader);
-		glActiveTextureARB(GL_TEXTURE0_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[dataItem->currentBathymetry]);
-		glUniform1iARB(dataItem->boundaryShaderUniformLocations[0],0);
-		
-		/* Run the boundary condition shader on the outermost layer of pixels: */
-		//glColorMask(GL_TRUE,GL_FALSE,GL_FALSE,GL_FALSE);
-		glBegin(GL_LINE_LOOP);
-		glVertex2f(0.5f,0.5f);
-		glVertex2f(GLfloat(size[0])-0.5f,0.5f);
-		glVertex2f(GLfloat(size[0])-0.5f,GLfloat(size[1])-0.5f);
-		glVertex2f(0.5f,GLfloat(size[1])-0.5f);
-		glEnd();
-		//glColorMask(GL_TRUE,GL_TRUE,GL_TRUE,GL_TRUE);
+		GLfloat estimatedNumSteps=Math::ceil((totalTimeStep+dataItem->laggedRemainingTime)/dataItem->estimatedStepSize)+1.0f;
+		if(estimatedNumSteps<GLfloat(numSteps))
+			numSteps=(unsigned int)(estimatedNumSteps);
 		}
 	
-	/* Update the current quantities: */
-	dataItem->currentQuantity=1-dataItem->currentQuantity;
+	/* Save relevant OpenGL state: */
+	glPushAttrib(GL_COLOR_BUFFER_BIT|GL_STENCIL_BUFFER_BIT|GL_VIEWPORT_BIT);
+	GLint currentFrameBuffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT,&currentFrameBuffer);
 	
-	if(waterDeposit!=0.0f||!renderFunctions.empty())
+	if(!skipDryTiles)
+		dataItem->skippingDryTiles=false;
+	bool addWater=waterDeposit!=0.0f||!renderFunctions.empty();
+	for(unsigned int step=0;step<numSteps;++step)
 		{
-		/* Save OpenGL state: */
-		GLfloat currentClearColor[4];
-		glGetFloatv(GL_COLOR_CLEAR_VALUE,currentClearColor);
-		
-		/*******************************************************************
-		Step 5: Render all water sources and sinks additively into the water
-		texture.
-		*******************************************************************/
-		
-		/* Set up and clear the water frame buffer: */
-		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->waterFramebufferObject);
-		glViewport(0,0,size[0],size[1]);
-		glClearColor(waterDeposit*stepSize,0.0f,0.0f,0.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		
-		/* Enable additive rendering: */
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_ONE,GL_ONE);
-		
-		/* Set up the water adding shader: */
-		glUseProgramObjectARB(dataItem->waterAddShader);
-		glUniformMatrix4fvARB(dataItem->waterAddShaderUniformLocations[0],1,GL_FALSE,waterAddPmvMatrix);
-		glUniform1fARB(dataItem->waterAddShaderUniformLocations[1],stepSize);
-		
-		/* Bind the water texture: */
-		glActiveTextureARB(GL_TEXTURE0_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->waterTextureObject);
-		glUniform1iARB(dataItem->waterAddShaderUniformLocations[2],0);
-		
-		/* Call all render functions: */
-		for(std::vector<const AddWaterFunction*>::const_iterator rfIt=renderFunctions.begin();rfIt!=renderFunctions.end();++rfIt)
-			(**rfIt)(contextData);
-		
-		/* Restore OpenGL state: */
-		glDisable(GL_BLEND);
-		glClearColor(currentClearColor[0],currentClearColor[1],currentClearColor[2],currentClearColor[3]);
+		if(skipDryTiles)
+			{
+			/* Render the water rates, which the water update pass uses as they are, and find the tiles that need to be simulated: */
+			if(addWater)
+				renderWaterAdders(dataItem,1.0f,waterDeposit,contextData);
+			updateActiveTiles(dataItem,addWater);
+			}
 		
 		/*******************************************************************
-		Step 6: Update the conserved quantities based on the water texture.
+		Step 1: Calculate temporal derivative of most recent quantities and
+		reduce the maximum step size, but do not read it back.
 		*******************************************************************/
 		
-		/* Set up the integration frame buffer to update the conserved quantities based on the water texture: */
-		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->integrationFramebufferObject);
-		glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-dataItem->currentQuantity));
-		glViewport(0,0,size[0],size[1]);
+		calcDerivative(dataItem,dataItem->quantityTextureObjects[dataItem->currentQuantity],false);
+		int currentMaxStepSizeTexture=reduceMaxStepSize(dataItem);
 		
-		/* Set up the water update shader: */
-		glUseProgramObjectARB(dataItem->waterShader);
+		/* Update the GPU-side step size state; the first step of each call adds the given time to the remaining time: */
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->stepStateFramebufferObject);
+		glDrawBuffer(GL_COLOR_ATTACHMENT0_EXT+(1-dataItem->currentStepState));
+		glViewport(0,0,1,1);
+		glUseProgramObjectARB(dataItem->stepSizeShader);
+		glUniformARB(dataItem->stepSizeShaderUniformLocations[0],maxStepSize);
+		glUniformARB(dataItem->stepSizeShaderUniformLocations[1],step==0?totalTimeStep:0.0f);
 		glActiveTextureARB(GL_TEXTURE0_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->bathymetryTextureObjects[dataItem->currentBathymetry]);
-		glUniform1iARB(dataItem->waterShaderUniformLocations[0],0);
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->maxStepSizeTextureObjects[currentMaxStepSizeTexture]);
+		glUniform1iARB(dataItem->stepSizeShaderUniformLocations[2],0);
 		glActiveTextureARB(GL_TEXTURE1_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
-		glUniform1iARB(dataItem->waterShaderUniformLocations[1],1);
-		glActiveTextureARB(GL_TEXTURE2_ARB);
-		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->waterTextureObject);
-		glUniform1iARB(dataItem->waterShaderUniformLocations[2],2);
-		
-		/* Run the water update: */
+		glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->stepStateTextureObjects[dataItem->currentStepState]);
+		glUniform1iARB(dataItem->stepSizeShaderUniformLocations[3],1);
 		glBegin(GL_QUADS);
 		glVertex2i(0,0);
 		glVertex2i(size[0],0);
 		glVertex2i(size[0],size[1]);
 		glVertex2i(0,size[1]);
 		glEnd();
+		dataItem->currentStepState=1-dataItem->currentStepState;
 		
-		/* Update the current quantities: */
-		dataItem->currentQuantity=1-dataItem->currentQuantity;
+		/* Run the remaining steps with the GPU-side step size; steps after the remaining time ran out use a step size of zero: */
+		integrate(dataItem,0.0f,true,skipDryTiles,contextData);
+		}
+	
+	/* Queue an asynchronous read-back of the final step size state into the next pixel buffer object: */
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->stepStateFramebufferObject);
+	glReadBuffer(GL_COLOR_ATTACHMENT0_EXT+dataItem->currentStepState);
+	unsigned int nextBuffer=dataItem->numStepStateReads%3U;
+	glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,dataItem->stepStateBufferObjects[nextBuffer]);
+	glReadPixels(0,0,1,1,GL_RGBA,GL_FLOAT,0);
+	glReadBuffer(GL_NONE);
+	++dataItem->numStepStateReads;
+	
+	/* Retrieve the oldest read-back, which was queued two calls ago and has long been completed by the GPU: */
+	if(dataItem->numStepStateReads>=3U)
+		{
+		glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,dataItem->stepStateBufferObjects[dataItem->numStepStateReads%3U]);
+		const GLfloat* stepState=static_cast<const GLfloat*>(glMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB,GL_READ_ONLY_ARB));
+		if(stepState!=0)
+			{
+			/* Update the average step size from the consumed time and the number of non-empty steps: */
+			if(stepState[3]>0.0f)
+				dataItem->estimatedStepSize=stepState[2]/stepState[3];
+			dataItem->laggedRemainingTime=stepState[1];
+			glUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+			}
 		}
+	glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB,0);
 	
 	/* Unbind all shaders and textures: */
 	glUseProgramObjectARB(0);
@@ -1066,8 +1770,7 @@ GLfloat WaterTable2::runSimulationStep(bool forceStepSize,GLContextData& context
 	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFrameBuffer);
 	glPopAttrib();
 	
-	/* Return the Runge-Kutta step's step size: */
-	return stepSize;
+	return numSteps;
 	}
 
 void WaterTable2::bindBathymetryTexture(GLContextData& contextData) const
@@ -1086,6 +1789,15 @@ void WaterTable2::bindQuantityTexture(GLContextData& contextData) const
 	
 	/* Bind the conserved quantities texture: */
 	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,dataItem->quantityTextureObjects[dataItem->currentQuantity]);
+	
+	if(dataItem->cpuSolver!=0&&dataItem->cpuQuantityVersion!=dataItem->cpuSolver->getVersion())
+		{
+		/* Upload the CPU-side simulator's most recent conserved quantities: */
+		dataItem->cpuGridBuffer.resize(size[0]*size[1]*3);
+		dataItem->cpuSolver->getQuantities(&dataItem->cpuGridBuffer[0]);
+		glTexSubImage2D(GL_TEXTURE_RECTANGLE_ARB,0,0,0,size[0],size[1],GL_RGB,GL_FLOAT,&dataItem->cpuGridBuffer[0]);
+		dataItem->cpuQuantityVersion=dataItem->cpuSolver->getVersion();
+		}
 	}
 
 void WaterTable2::uploadWaterTextureTransform(GLint location) const
@@ -1093,3 +1805,37 @@ void WaterTable2::uploadWaterTextureTransform(GLint location) const
 	/* Upload the matrix to OpenGL: */
 	glUniformMatrix4fvARB(location,1,GL_FALSE,waterTextureTransformMatrix);
 	}
+
+double WaterTable2::calcWaterVolume(GLContextData& contextData) const
+	{
+	/* Read back the current conserved quantity grid's water surface elevations: */
+	std::vector<GLfloat> waterGrid(size[0]*size[1]);
+	bindQuantityTexture(contextData);
+	glGetTexImage(GL_TEXTURE_RECTANGLE_ARB,0,GL_RED,GL_FLOAT,&waterGrid[0]);
+	
+	/* Read back the current bathymetry grid: */
+	GLsizei bSize[2]={size[0]-1,size[1]-1};
+	std::vector<GLfloat> bathymetryGrid(bSize[0]*bSize[1]);
+	bindBathymetryTexture(contextData);
+	glGetTexImage(GL_TEXTURE_RECTANGLE_ARB,0,GL_RED,GL_FLOAT,&bathymetryGrid[0]);
+	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+	
+	/* Accumulate the water column heights of all cells over the cells' average bathymetries, clamping at the grid edges like the simulation shaders: */
+	double result=0.0;
+	for(GLsizei y=0;y<size[1];++y)
+		{
+		const GLfloat* b0Row=&bathymetryGrid[Math::max(y-1,0)*bSize[0]];
+		const GLfloat* b1Row=&bathymetryGrid[Math::min(y,bSize[1]-1)*bSize[0]];
+		const GLfloat* wPtr=&waterGrid[y*size[0]];
+		for(GLsizei x=0;x<size[0];++x,++wPtr)
+			{
+			GLsizei x0=Math::max(x-1,0);
+			GLsizei x1=Math::min(x,bSize[0]-1);
+			GLfloat b=(b0Row[x0]+b0Row[x1]+b1Row[x0]+b1Row[x1])*0.25f;
+			if(*wPtr>b)
+				result+=double(*wPtr-b);
+			}
+		}
+	
+	return result*double(cellSize[0])*double(cellSize[1]);
+	}
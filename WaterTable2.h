@@ -35,9 +35,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
 #include <GL/GLContextData.h>
 
 #include "Types.h"
+#include "WorkerPool.h"
 
 /* Forward declarations: */
 class DepthImageRenderer;
+class CPUWaterSolver;
 
 typedef Misc::FunctionCall<GLContextData&> AddWaterFunction; // Type for render functions called to locally add water to the water table
 
@@ -47,6 +49,7 @@ class WaterTable2:public GLObject
 	public:
 	typedef Geometry::Box<Scalar,3> Box;
 	typedef Geometry::OrthonormalTransformation<Scalar,3> ONTransform;
+	static const unsigned int maxNumCPUThreads=WorkerPool::maxNumWorkers; // Maximum number of threads running the water flow simulation on the CPU
 	
 	private:
 	struct DataItem:public GLObject::DataItem // Structure holding per-context state
@@ -61,11 +64,25 @@ class WaterTable2:public GLObject
 		GLuint derivativeTextureObject; // Three-component color texture object holding the cell-centered temporal derivative grid
 		GLuint maxStepSizeTextureObjects[2]; // Double-buffered one-component color texture objects to gather the maximum step size for Runge-Kutta integration steps
 		GLuint waterTextureObject; // One-component color texture object to add or remove water to/from the conserved quantity grid
+		GLuint stepStateTextureObjects[2]; // Double-buffered 1x1 four-component color texture objects holding the GPU-side step size state (step size, remaining time, consumed time, number of steps) for stall-free simulation
+		int currentStepState; // Index of step state texture containing the most recent step state
+		GLuint stepStateBufferObjects[3]; // Ring of pixel buffer objects to read back step states asynchronously
+		unsigned int numStepStateReads; // Number of step state read-backs issued so far
+		GLfloat estimatedStepSize; // Average step size from the most recent completed step state read-back, or 0 if unknown
+		GLfloat laggedRemainingTime; // Simulation time left over from the most recent completed step state read-back
 		GLuint bathymetryFramebufferObject; // Frame buffer used to render the bathymetry surface into the bathymetry grid
 		GLuint derivativeFramebufferObject; // Frame buffer used for temporal derivative computation
 		GLuint maxStepSizeFramebufferObject; // Frame buffer used to calculate the maximum integration step size
 		GLuint integrationFramebufferObject; // Frame buffer used for the Euler and Runge-Kutta integration steps
 		GLuint waterFramebufferObject; // Frame buffer used for the water rendering step
+		GLuint stepStateFramebufferObject; // Frame buffer used to update the GPU-side step size state
+		GLuint wetTileRowTextureObject; // One-component color texture object flagging, for each row of cells, the tiles holding or receiving water in that row
+		GLuint activeTileTextureObjects[2]; // Double-buffered one-component color texture objects flagging the tiles simulated by the most recent and the previous simulation step
+		int currentActiveTiles; // Index of active tile texture containing the most recent active tiles
+		bool skippingDryTiles; // Flag whether the most recent simulation step skipped dry tiles and the quantities were not replaced since; otherwise, the next step skipping dry tiles synchronizes all tiles it skips
+		GLuint tileStencilRenderbufferObject; // Stencil buffer marking the cells of active tiles, shared by the temporal derivative and integration frame buffers
+		GLuint wetTileRowFramebufferObject; // Frame buffer used to flag the tiles holding or receiving water row by row
+		GLuint activeTileFramebufferObject; // Frame buffer used to flag the active tiles
 		GLhandleARB bathymetryShader; // Shader to update cell-centered conserved quantities after a change to the bathymetry grid
 		GLint bathymetryShaderUniformLocations[3];
 		GLhandleARB waterAdaptShader; // Shader to adapt a new conserved quantity grid to the current bathymetry grid
@@ -84,6 +101,26 @@ class WaterTable2:public GLObject
 		GLint waterAddShaderUniformLocations[3];
 		GLhandleARB waterShader; // Shader to add or remove water from the conserved quantities grid
 		GLint waterShaderUniformLocations[3];
+		GLhandleARB stepSizeShader; // Shader to update the GPU-side step size state from the reduced maximum step size
+		GLint stepSizeShaderUniformLocations[4];
+		GLhandleARB deferredEulerStepShader; // Shader to compute an Euler integration step with the step size from the GPU-side step size state
+		GLint deferredEulerStepShaderUniformLocations[4];
+		GLhandleARB deferredRungeKuttaStepShader; // Shader to compute a Runge-Kutta integration step with the step size from the GPU-side step size state
+		GLint deferredRungeKuttaStepShaderUniformLocations[5];
+		GLhandleARB deferredWaterShader; // Shader to add or remove water from the conserved quantities grid with the step size from the GPU-side step size state
+		GLint deferredWaterShaderUniformLocations[4];
+		GLhandleARB wetTileShader; // Shader to flag the tiles holding or receiving water row by row
+		GLint wetTileShaderUniformLocations[6];
+		GLhandleARB activeTileShader; // Shader to activate tiles that hold or receive water or have neighbors that do
+		GLint activeTileShaderUniformLocations[2];
+		GLhandleARB tileStencilShader; // Shader to mark the cells of active tiles in the stencil buffer
+		GLint tileStencilShaderUniformLocations[2];
+		GLhandleARB tileSyncShader; // Shader to copy the most recent conserved quantities of deactivated tiles into the other quantity textures
+		GLint tileSyncShaderUniformLocations[1];
+		CPUWaterSolver* cpuSolver; // Water flow simulator running on the CPU, or null if the simulation runs on the GPU
+		unsigned int cpuQuantityVersion; // Version number of the CPU-side conserved quantity grid most recently uploaded into the current quantity texture
+		std::vector<GLfloat> cpuGridBuffer; // Staging buffer to read back bathymetry grids and upload conserved quantity grids for the CPU-side simulator
+		std::vector<GLfloat> cpuWaterRates; // Staging buffer to read back rendered water amounts per second for the CPU-side simulator
 		
 		/* Constructors and destructors: */
 		DataItem(void);
@@ -92,6 +129,7 @@ class WaterTable2:public GLObject
 	
 	/* Elements: */
 	GLsizei size[2]; // Width and height of water table in pixels
+	GLsizei numTiles[2]; // Number of tiles horizontally and vertically that are skipped as a whole if they and their neighbors are dry
 	const DepthImageRenderer* depthImageRenderer; // Renderer object used to update the water table's bathymetry grid
 	ONTransform baseTransform; // Transformation from camera space to upright elevation map space
 	Box domain; // Domain of elevation map space in rotated camera space
@@ -109,10 +147,20 @@ class WaterTable2:public GLObject
 	std::vector<const AddWaterFunction*> renderFunctions; // A list of functions that are called after each water flow simulation step to locally add or remove water from the water table
 	GLfloat waterDeposit; // A fixed amount of water added at every iteration of the flow simulation, for evaporation etc.
 	bool dryBoundary; // Flag whether to enforce dry boundary conditions at the end of each simulation step
+	unsigned int numCPUThreads; // Number of threads running the water flow simulation on the CPU, or 0 if the simulation runs on the GPU
+	bool skipDryTiles; // Flag whether the simulation skips tiles that neither hold nor receive water and have no neighbors that do
+	bool halfPrecision; // Flag whether the temporal derivative and water textures store 16-bit floats; conserved quantities are always stored in 32-bit floats
 	
 	/* Private methods: */
 	void calcTransformations(void); // Calculates derived transformations
+	int reduceMaxStepSize(DataItem* dataItem) const; // Reduces the maximum step size texture written by the last temporal derivative computation to a single pixel; returns the index of the maximum step size texture holding the result
 	GLfloat calcDerivative(DataItem* dataItem,GLuint quantityTextureObject,bool calcMaxStepSize) const; // Calculates the temporal derivative of the conserved quantities in the given texture object and returns maximum step size if flag is true
+	void activateAllTiles(DataItem* dataItem) const; // Flags all tiles as active in the most recent active tile texture, so that the next simulation step synchronizes the quantities of all tiles it skips
+	void updateActiveTiles(DataItem* dataItem,bool waterRendered) const; // Activates the tiles holding or receiving water and their neighbors, marks their cells in the stencil buffer, synchronizes the quantities of deactivated tiles, and enables the stencil test for the following simulation passes; flag is true if the water texture holds the current water rates
+	void integrate(DataItem* dataItem,GLfloat stepSize,bool deferredStepSize,bool waterRendered,GLContextData& contextData) const; // Runs the integration and water update passes of a simulation step whose temporal derivative was already calculated, using the given step size or the GPU-side step size state if the first flag is true; water sources and sinks are not rendered again if the second flag is true
+	void renderWaterAdders(DataItem* dataItem,GLfloat waterStepSize,GLfloat clearValue,GLContextData& contextData) const; // Renders all water sources and sinks for the given step size additively into the water texture after clearing it to the given value
+	const GLfloat* readWaterRates(DataItem* dataItem,GLContextData& contextData) const; // Renders all water sources and sinks as amounts per second and reads them back for the CPU-side simulator; returns null if there are none
+	void updateCPUSolver(DataItem* dataItem) const; // Forwards the current simulation parameters to the CPU-side simulator
 	
 	/* Constructors and destructors: */
 	public:
@@ -163,13 +211,31 @@ class WaterTable2:public GLObject
 		}
 	void setWaterDeposit(GLfloat newWaterDeposit); // Sets the amount of deposited water
 	void setDryBoundary(bool newDryBoundary); // Enables or disables enforcement of dry boundaries
+	unsigned int getNumCPUThreads(void) const // Returns the number of threads running the water flow simulation on the CPU, or 0 if it runs on the GPU
+		{
+		return numCPUThreads;
+		}
+	static bool parseNumCPUThreads(const char* string,unsigned int& numCPUThreads); // Sets the given number of CPU simulation threads from the given decimal string; returns false if the string is not a number between 0 and maxNumCPUThreads
+	void setNumCPUThreads(unsigned int newNumCPUThreads); // Runs the water flow simulation on the CPU using the given number of threads, clamped to at most maxNumCPUThreads, or on the GPU if 0; must be called before the water table is initialized in any OpenGL context
+	bool getSkipDryTiles(void) const // Returns true if the simulation skips dry tiles
+		{
+		return skipDryTiles;
+		}
+	void setSkipDryTiles(bool newSkipDryTiles); // Enables or disables skipping of tiles that neither hold nor receive water and have no neighbors that do
+	bool getHalfPrecision(void) const // Returns true if intermediate simulation textures store 16-bit floats
+		{
+		return halfPrecision;
+		}
+	void setHalfPrecision(bool newHalfPrecision); // Enables or disables 16-bit float storage for intermediate simulation textures; must be called before the water table is initialized in any OpenGL context
 	void updateBathymetry(GLContextData& contextData) const; // Prepares the water table for subsequent calls to the runSimulationStep() method
 	void updateBathymetry(const GLfloat* bathymetryGrid,GLContextData& contextData) const; // Updates the bathymetry directly with a vertex-centered elevation grid of grid size minus 1
 	void setWaterLevel(const GLfloat* waterGrid,GLContextData& contextData) const; // Sets the current water level to the given grid, and resets flux components to zero
 	GLfloat runSimulationStep(bool forceStepSize,GLContextData& contextData) const; // Runs a water flow simulation step, always uses maxStepSize if flag is true (may lead to instability); returns step size taken by Runge-Kutta integration step
+	unsigned int runSimulationSteps(GLfloat totalTimeStep,unsigned int maxNumSteps,GLContextData& contextData) const; // Advances the water flow simulation by the given time using at most the given number of self-determined steps, without ever waiting for the GPU; time that does not fit is carried over to the next call; returns the number of steps run
 	void bindBathymetryTexture(GLContextData& contextData) const; // Binds the bathymetry texture object to the active texture unit
 	void bindQuantityTexture(GLContextData& contextData) const; // Binds the most recent conserved quantities texture object to the active texture unit
 	void uploadWaterTextureTransform(GLint location) const; // Uploads the water texture transformation into the GLSL 4x4 matrix at the given uniform location
+	double calcWaterVolume(GLContextData& contextData) const; // Returns the total volume of water currently held by the water table in cubic world coordinate units; reads back the conserved quantity and bathymetry grids and waits for the GPU
 	GLsizei getBathymetrySize(int index) const // Returns the width or height of the bathymetry grid
 		{
 		return size[index]-1;
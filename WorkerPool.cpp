@@ -0,0 +1,142 @@
+/***********************************************************************
+WorkerPool - Class to process jobs split into independent bands on a
+persistent set of worker threads.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#include "WorkerPool.h"
+
+#include <stdlib.h>
+#include <Misc/FunctionCalls.h>
+
+/***************************
+Methods of class WorkerPool:
+***************************/
+
+bool WorkerPool::processBand(Threads::MutexCond::Lock& jobLock)
+	{
+	/* Bail out if all bands of the current job have been claimed: */
+	if(nextBand>=numBands)
+		return false;
+	
+	/* Claim the next band: */
+	unsigned int band=nextBand;
+	++nextBand;
+	
+	/* Process the band without holding the lock: */
+	jobCond.unlock();
+	(*bandFunction)(band);
+	jobCond.lock();
+	
+	/* Wake up the submitting thread if this was the last unfinished band: */
+	if(--numUnfinishedBands==0)
+		jobCond.broadcast();
+	
+	return true;
+	}
+
+void* WorkerPool::workerThreadMethod(void)
+	{
+	Threads::MutexCond::Lock jobLock(jobCond);
+	unsigned int lastJobVersion=jobVersion;
+	
+	while(true)
+		{
+		/* Wait until a new job arrives or the pool shuts down: */
+		while(runWorkerThreads&&lastJobVersion==jobVersion)
+			jobCond.wait(jobLock);
+		
+		/* Bail out if the pool is shutting down: */
+		if(!runWorkerThreads)
+			break;
+		
+		/* Process bands of the new job until all have been claimed: */
+		lastJobVersion=jobVersion;
+		while(processBand(jobLock))
+			;
+		}
+	
+	return 0;
+	}
+
+WorkerPool::WorkerPool(unsigned int sNumWorkers)
+	:numWorkers(sNumWorkers>0?sNumWorkers:1),
+	 workerThreads(0),
+	 runWorkerThreads(true),
+	 jobVersion(0),bandFunction(0),numBands(0),nextBand(0),numUnfinishedBands(0)
+	{
+	/* Start the background worker threads; the submitting thread is the first worker: */
+	workerThreads=new Threads::Thread[numWorkers-1];
+	for(unsigned int i=0;i<numWorkers-1;++i)
+		workerThreads[i].start(this,&WorkerPool::workerThreadMethod);
+	}
+
+WorkerPool::~WorkerPool(void)
+	{
+	/* Shut down the worker threads: */
+	{
+	Threads::MutexCond::Lock jobLock(jobCond);
+	runWorkerThreads=false;
+	jobCond.broadcast();
+	}
+	for(unsigned int i=0;i<numWorkers-1;++i)
+		workerThreads[i].join();
+	delete[] workerThreads;
+	}
+
+bool WorkerPool::parseNumWorkers(const char* string,unsigned int minNumWorkers,unsigned int& numWorkers)
+	{
+	/* Parse the entire string as a decimal number and check it against the valid range: */
+	char* end;
+	long value=strtol(string,&end,10);
+	if(end==string||*end!='\0'||value<long(minNumWorkers)||value>long(maxNumWorkers))
+		return false;
+	
+	numWorkers=(unsigned int)(value);
+	return true;
+	}
+
+void WorkerPool::runJob(const WorkerPool::BandFunction& newBandFunction,unsigned int newNumBands)
+	{
+	/* Process single-band jobs or jobs on single-worker pools directly: */
+	if(newNumBands<=1||numWorkers==1)
+		{
+		for(unsigned int band=0;band<newNumBands;++band)
+			newBandFunction(band);
+		return;
+		}
+	
+	Threads::MutexCond::Lock jobLock(jobCond);
+	
+	/* Post the new job and wake up the worker threads: */
+	bandFunction=&newBandFunction;
+	numBands=newNumBands;
+	nextBand=0;
+	numUnfinishedBands=numBands;
+	++jobVersion;
+	jobCond.broadcast();
+	
+	/* Help process bands until all have been claimed: */
+	while(processBand(jobLock))
+		;
+	
+	/* Wait until all bands have been finished: */
+	while(numUnfinishedBands>0)
+		jobCond.wait(jobLock);
+	}
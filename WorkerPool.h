@@ -0,0 +1,76 @@
+/***********************************************************************
+WorkerPool - Class to process jobs split into independent bands on a
+persistent set of worker threads.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#ifndef WORKERPOOL_INCLUDED
+#define WORKERPOOL_INCLUDED
+
+#include <Threads/Thread.h>
+#include <Threads/MutexCond.h>
+
+/* Forward declarations: */
+namespace Misc {
+template <class ParameterParam>
+class FunctionCall;
+}
+
+class WorkerPool
+	{
+	/* Embedded classes: */
+	public:
+	typedef Misc::FunctionCall<unsigned int> BandFunction; // Type for functions processing one band of a job; parameter is the band index
+	static const unsigned int maxNumWorkers=64; // Maximum total number of workers in a pool
+	
+	/* Elements: */
+	private:
+	unsigned int numWorkers; // Number of threads processing bands, including the thread submitting jobs
+	Threads::Thread* workerThreads; // Array of background worker threads
+	Threads::MutexCond jobCond; // Condition variable to signal arrival of a new job and completion of all of a job's bands
+	volatile bool runWorkerThreads; // Flag to keep the background worker threads running
+	unsigned int jobVersion; // Version number of the current job
+	const BandFunction* bandFunction; // Function processing one band of the current job
+	unsigned int numBands; // Number of bands in the current job
+	unsigned int nextBand; // Index of the next band of the current job to be processed
+	unsigned int numUnfinishedBands; // Number of bands of the current job that have not been finished yet
+	
+	/* Private methods: */
+	bool processBand(Threads::MutexCond::Lock& jobLock); // Processes the next band of the current job while temporarily releasing the given lock; returns false if there are no bands left
+	void* workerThreadMethod(void); // Method for the background worker threads
+	
+	/* Constructors and destructors: */
+	public:
+	WorkerPool(unsigned int sNumWorkers); // Creates a pool with the given total number of workers, including the thread submitting jobs
+	private:
+	WorkerPool(const WorkerPool& source); // Prohibit copy constructor
+	WorkerPool& operator=(const WorkerPool& source); // Prohibit assignment operator
+	public:
+	~WorkerPool(void); // Shuts down all worker threads
+	
+	/* Methods: */
+	static bool parseNumWorkers(const char* string,unsigned int minNumWorkers,unsigned int& numWorkers); // Sets the given number of workers from the given decimal string; returns false if the string is not a number between minNumWorkers and maxNumWorkers
+	unsigned int getNumWorkers(void) const // Returns the total number of workers
+		{
+		return numWorkers;
+		}
+	void runJob(const BandFunction& newBandFunction,unsigned int newNumBands); // Calls the given function for all band indices in [0, newNumBands) in parallel; returns when all bands are finished
+	};
+
+#endif
@@ -147,6 +147,33 @@ uniform float waterOpacity;
 uniform float waterAnimationTime;
 
 varying vec2 waterTexCoord; // Texture coordinate for water level texture
+varying float waterElevation; // Elevation of the surface in water level texture space
+
+/***********************************************************************
+Helper function to mix the water color into the base color of a
+fragment under a water column of the given height:
+***********************************************************************/
+
+void mixWaterColor(in vec2 fragCoord,in float waterLevel,inout vec4 baseColor)
+	{
+	/* Calculate the water color: */
+	// float colorW=max(snoise(vec3(fragCoord*0.05,waterAnimationTime*0.25)),0.0); // Simple noise function
+	// float colorW=max(turb(vec3(fragCoord*0.05,waterAnimationTime*0.25)),0.0); // Turbulence noise
+	
+	vec3 wn=normalize(vec3((texture2DRect(quantitySampler,vec2(waterTexCoord.x-1.0,waterTexCoord.y)).r-
+	                        texture2DRect(quantitySampler,vec2(waterTexCoord.x+1.0,waterTexCoord.y)).r)*waterCellSize.y,
+	                       (texture2DRect(quantitySampler,vec2(waterTexCoord.x,waterTexCoord.y-1.0)).r-
+	                        texture2DRect(quantitySampler,vec2(waterTexCoord.x,waterTexCoord.y+1.0)).r)*waterCellSize.x,
+	                       2.0*waterCellSize.x*waterCellSize.y));
+	float colorW=pow(dot(wn,normalize(vec3(0.075,0.075,1.0))),100.0)*1.0-0.0;
+	
+	vec4 waterColor=vec4(colorW,colorW,1.0,1.0); // Water
+	// vec4 waterColor=vec4(1.0-colorW,1.0-colorW*2.0,0.0,1.0); // Lava
+	// vec4 waterColor=vec4(0.0,0.0,1.0,1.0); // Blue
+	
+	/* Mix the water color with the base surface color based on the water level: */
+	baseColor=mix(baseColor,waterColor,min(waterLevel*waterOpacity,1.0));
+	}
 
 /***********************************************************************
 Water shading function using a one-component water level texture and
@@ -164,24 +191,50 @@ void addWaterColor(in vec2 fragCoord,inout vec4 baseColor)
 	
 	/* Check if the surface is under water: */
 	if(waterLevel>0.0)
+		mixWaterColor(fragCoord,waterLevel,baseColor);
+	}
+
+/***********************************************************************
+Water shading function for water level textures of lower resolution than
+the surface. Interpolates the water surface from the surrounding wet
+cells only, and compares it against the fragment's own elevation
+instead of the coarse cell-averaged bathymetry, so that shorelines
+follow the surface at full resolution:
+***********************************************************************/
+
+void addWaterColorUpsampled(in vec2 fragCoord,inout vec4 baseColor)
+	{
+	/* Find the four cells whose centers surround this fragment, and the fragment's position between them: */
+	vec2 tc=waterTexCoord-vec2(0.5,0.5);
+	vec2 c0=floor(tc)+vec2(0.5,0.5);
+	vec2 f=tc-floor(tc);
+	
+	/* Get the water surface elevations of the four cells: */
+	vec4 w=vec4(texture2DRect(quantitySampler,c0).r,
+	            texture2DRect(quantitySampler,vec2(c0.x+1.0,c0.y)).r,
+	            texture2DRect(quantitySampler,vec2(c0.x,c0.y+1.0)).r,
+	            texture2DRect(quantitySampler,vec2(c0.x+1.0,c0.y+1.0)).r);
+	
+	/* Get the four cells' bathymetry elevations from single linearly-filtered lookups between their corner vertices: */
+	vec4 b=vec4(texture2DRect(bathymetrySampler,c0-vec2(0.5,0.5)).r,
+	            texture2DRect(bathymetrySampler,vec2(c0.x+0.5,c0.y-0.5)).r,
+	            texture2DRect(bathymetrySampler,vec2(c0.x-0.5,c0.y+0.5)).r,
+	            texture2DRect(bathymetrySampler,c0+vec2(0.5,0.5)).r);
+	
+	/* Calculate bilinear interpolation weights and drop all dry cells: */
+	vec4 weights=vec4((1.0-f.x)*(1.0-f.y),f.x*(1.0-f.y),(1.0-f.x)*f.y,f.x*f.y);
+	weights*=vec4(greaterThan(w,b));
+	float weightSum=dot(weights,vec4(1.0,1.0,1.0,1.0));
+	
+	/* Check if any of the surrounding cells hold water: */
+	if(weightSum>0.0)
 		{
-		/* Calculate the water color: */
-		// float colorW=max(snoise(vec3(fragCoord*0.05,waterAnimationTime*0.25)),0.0); // Simple noise function
-		// float colorW=max(turb(vec3(fragCoord*0.05,waterAnimationTime*0.25)),0.0); // Turbulence noise
-		
-		vec3 wn=normalize(vec3((texture2DRect(quantitySampler,vec2(waterTexCoord.x-1.0,waterTexCoord.y)).r-
-		                        texture2DRect(quantitySampler,vec2(waterTexCoord.x+1.0,waterTexCoord.y)).r)*waterCellSize.y,
-		                       (texture2DRect(quantitySampler,vec2(waterTexCoord.x,waterTexCoord.y-1.0)).r-
-		                        texture2DRect(quantitySampler,vec2(waterTexCoord.x,waterTexCoord.y+1.0)).r)*waterCellSize.x,
-		                       2.0*waterCellSize.x*waterCellSize.y));
-		float colorW=pow(dot(wn,normalize(vec3(0.075,0.075,1.0))),100.0)*1.0-0.0;
+		/* Calculate the water column height above this fragment from the interpolated water surface: */
+		float waterLevel=dot(weights,w)/weightSum-waterElevation;
 		
-		vec4 waterColor=vec4(colorW,colorW,1.0,1.0); // Water
-		// vec4 waterColor=vec4(1.0-colorW,1.0-colorW*2.0,0.0,1.0); // Lava
-		// vec4 waterColor=vec4(0.0,0.0,1.0,1.0); // Blue
-		
-		/* Mix the water color with the base surface color based on the water level: */
-		baseColor=mix(baseColor,waterColor,min(waterLevel*waterOpacity,1.0));
+		/* Check if the surface is under water: */
+		if(waterLevel>0.0)
+			mixWaterColor(fragCoord,waterLevel,baseColor);
 		}
 	}
 
@@ -0,0 +1,40 @@
+/***********************************************************************
+Water2ActiveTileShader - Shader to activate the tiles that hold or
+receive water or have neighbors that do, to skip dry tiles.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#extension GL_ARB_texture_rectangle : enable
+
+uniform float tileSize; // Width and height of a tile in cells
+uniform sampler2DRect wetTileRowSampler;
+
+void main()
+	{
+	/* Check the rows of cells of this fragment's tile and of the tiles above and below it, for it and its left and right neighbors: */
+	float y0=(gl_FragCoord.y-1.5)*tileSize+0.5;
+	float y1=y0+3.0*tileSize;
+	float active=0.0;
+	for(float y=y0;y<y1&&active==0.0;y+=1.0)
+		active=max(max(texture2DRect(wetTileRowSampler,vec2(gl_FragCoord.x-1.0,y)).r,
+		               texture2DRect(wetTileRowSampler,vec2(gl_FragCoord.x,y)).r),
+		           texture2DRect(wetTileRowSampler,vec2(gl_FragCoord.x+1.0,y)).r);
+	
+	gl_FragColor=vec4(active,0.0,0.0,0.0);
+	}
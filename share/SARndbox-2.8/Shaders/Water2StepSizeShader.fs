@@ -0,0 +1,56 @@
+/***********************************************************************
+Water2StepSizeShader - Shader to update the GPU-side step size state
+for stall-free simulation from the reduced maximum step size.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#extension GL_ARB_texture_rectangle : enable
+
+uniform float maxStepSize; // Client-specified maximum step size
+uniform float frameTime; // Simulation time to add at the first step of a frame, or 0.0 for subsequent steps
+uniform sampler2DRect maxStepSizeSampler; // Reduced 1x1 maximum step size texture
+uniform sampler2DRect stepStateSampler; // Previous step size state (step size, remaining time, consumed time, number of steps)
+
+void main()
+	{
+	/* Get the previous step size state: */
+	vec4 state=texture2DRect(stepStateSampler,vec2(0.5,0.5));
+	float remaining=state.g;
+	float consumed=state.b;
+	float numSteps=state.a;
+	
+	if(frameTime>0.0)
+		{
+		/* Start a new frame, carrying over at most one frame's worth of left-over time: */
+		remaining=min(remaining,frameTime)+frameTime;
+		consumed=0.0;
+		numSteps=0.0;
+		}
+	
+	/* Take the largest stable step that does not exceed the remaining time: */
+	float stepSize=0.0;
+	if(remaining>1.0e-8)
+		{
+		stepSize=min(min(texture2DRect(maxStepSizeSampler,vec2(0.5,0.5)).r,maxStepSize),remaining);
+		numSteps+=1.0;
+		}
+	
+	/* Write the new step size state: */
+	gl_FragColor=vec4(stepSize,remaining-stepSize,consumed+stepSize,numSteps);
+	}
@@ -0,0 +1,35 @@
+/***********************************************************************
+Water2TileStencilShader - Shader to mark the cells of active tiles in
+the stencil buffer, to skip dry tiles.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#extension GL_ARB_texture_rectangle : enable
+
+uniform float tileSize; // Width and height of a tile in cells
+uniform sampler2DRect activeTileSampler;
+
+void main()
+	{
+	/* Reject the fragment if its tile is not active: */
+	if(texture2DRect(activeTileSampler,floor((gl_FragCoord.xy-vec2(0.5,0.5))/tileSize)+vec2(0.5,0.5)).r<0.5)
+		discard;
+	
+	gl_FragColor=vec4(0.0,0.0,0.0,0.0);
+	}
@@ -0,0 +1,34 @@
+/***********************************************************************
+Water2TileSyncShader - Shader to copy the conserved quantities of
+deactivated tiles into the other quantity textures, to skip dry tiles.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#extension GL_ARB_texture_rectangle : enable
+#extension GL_ARB_draw_buffers : enable
+
+uniform sampler2DRect quantitySampler;
+
+void main()
+	{
+	/* Copy the quantities into both draw buffers: */
+	vec4 q=vec4(texture2DRect(quantitySampler,gl_FragCoord.xy).rgb,0.0);
+	gl_FragData[0]=q;
+	gl_FragData[1]=q;
+	}
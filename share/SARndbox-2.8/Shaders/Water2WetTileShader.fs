@@ -0,0 +1,54 @@
+/***********************************************************************
+Water2WetTileShader - Shader to flag the tiles holding or receiving
+water in each row of cells, to skip dry tiles.
+Copyright (c) 2026 the SARndbox contributors
+
+This file is part of the Augmented Reality Sandbox (SARndbox).
+
+The Augmented Reality Sandbox is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the
+License, or (at your option) any later version.
+
+The Augmented Reality Sandbox is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Augmented Reality Sandbox; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+***********************************************************************/
+
+#extension GL_ARB_texture_rectangle : enable
+
+uniform float tileSize; // Width and height of a tile in cells
+uniform float gridWidth; // Width of the water table in cells
+uniform bool checkWater; // Flag whether the water texture holds the current water rates
+uniform sampler2DRect bathymetrySampler;
+uniform sampler2DRect quantitySampler;
+uniform sampler2DRect waterSampler;
+
+void main()
+	{
+	/* Calculate the range of cells of this fragment's tile in this fragment's row: */
+	float x0=(gl_FragCoord.x-0.5)*tileSize+0.5;
+	float x1=min(x0+tileSize,gridWidth);
+	float y=gl_FragCoord.y;
+	
+	/* Check whether any cell holds or receives water: */
+	float wet=0.0;
+	for(float x=x0;x<x1&&wet==0.0;x+=1.0)
+		{
+		/* Calculate the bathymetry elevation at the center of the cell: */
+		float b=(texture2DRect(bathymetrySampler,vec2(x-1.0,y-1.0)).r+
+		         texture2DRect(bathymetrySampler,vec2(x,y-1.0)).r+
+		         texture2DRect(bathymetrySampler,vec2(x-1.0,y)).r+
+		         texture2DRect(bathymetrySampler,vec2(x,y)).r)*0.25;
+		
+		if(texture2DRect(quantitySampler,vec2(x,y)).r>b||(checkWater&&texture2DRect(waterSampler,vec2(x,y)).r>0.0))
+			wet=1.0;
+		}
+	
+	gl_FragColor=vec4(wet,0.0,0.0,0.0);
+	}